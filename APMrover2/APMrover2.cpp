@@ -304,7 +304,7 @@ void Rover::one_second_loop(void)
 
 void Rover::update_GPS_50Hz(void)
 {
-    static uint32_t last_gps_reading[GPS_MAX_INSTANCES];
+    static uint32_t last_gps_reading[GPS_MAX_INSTANCES+GPS_BLENDING_AVAILABLE];
     gps.update();
 
     for (uint8_t i=0; i<gps.num_sensors(); i++) {
@@ -315,6 +315,15 @@ void Rover::update_GPS_50Hz(void)
             }
         }
     }
+#if GPS_BLENDING_AVAILABLE
+    if (gps.blending() &&
+        gps.last_message_time_ms(GPS_BLENDED_INSTANCE) != last_gps_reading[GPS_BLENDED_INSTANCE]) {
+        last_gps_reading[GPS_BLENDED_INSTANCE] = gps.last_message_time_ms(GPS_BLENDED_INSTANCE);
+        if (should_log(MASK_LOG_GPS)) {
+            DataFlash.Log_Write_GPS(gps, GPS_BLENDED_INSTANCE, current_loc.alt);
+        }
+    }
+#endif
 }
 
 
@@ -25,33 +25,52 @@
 #include "Plane.h"
 
 #define SCHED_TASK(func) FUNCTOR_BIND(&plane, &Plane::func, void)
+#define SCHED_TRIGGER(func) FUNCTOR_BIND(&plane, &Plane::func, uint32_t)
+
+// rate of the EKF updates, which the EKF is tuned for
+#define EKF_RATE_HZ 100
+
+/*
+  rate loop table - these tasks take us from an IMU sample to new
+  servo outputs, and are run in order on every main loop tick. An
+  interval of zero runs the task at the main loop rate (SCHED_LOOP_RATE),
+  otherwise intervals are in 20ms units as in the main table. The
+  times are the latency budget in microseconds for a 50Hz loop. The
+  EKF runs at EKF_RATE_HZ whatever the loop rate, on the IMU data
+  accumulated by ahrs_update, and its time is for one run
+ */
+const AP_Scheduler::Task Plane::fast_tasks[] PROGMEM = {
+    { SCHED_TASK(read_radio),             1,    700 },
+    { SCHED_TASK(check_short_failsafe),   1,   1000 },
+    { SCHED_TASK(ahrs_update),            0,   2000 },
+    { SCHED_TASK(ekf_update), AP_SCHEDULER_RATE_HZ(EKF_RATE_HZ), 4400 },
+    { SCHED_TASK(update_speed_height),    1,   1600 },
+    { SCHED_TASK(update_flight_mode),     0,   1400 },
+    { SCHED_TASK(stabilize),              0,   3500 },
+    { SCHED_TASK(set_servos),             0,   1600 },
+};
 
 /*
   scheduler table - all regular tasks are listed here, along with how
   often they should be called (in 20ms units) and the maximum time
-  they are expected to take (in microseconds)
+  they are expected to take (in microseconds). Tasks with a trigger
+  are run when it fires, at most as often as their interval
  */
 const AP_Scheduler::Task Plane::scheduler_tasks[] PROGMEM = {
-    { SCHED_TASK(read_radio),             1,    700 }, // 0
-    { SCHED_TASK(check_short_failsafe),   1,   1000 },
-    { SCHED_TASK(ahrs_update),            1,   6400 },
-    { SCHED_TASK(update_speed_height),    1,   1600 },
-    { SCHED_TASK(update_flight_mode),     1,   1400 },
-    { SCHED_TASK(stabilize),              1,   3500 },
-    { SCHED_TASK(set_servos),             1,   1600 },
-    { SCHED_TASK(read_control_switch),    7,   1000 },
+    { SCHED_TASK(read_control_switch),    7,   1000 }, // 0
     { SCHED_TASK(gcs_retry_deferred),     1,   1000 },
     { SCHED_TASK(update_GPS_50Hz),        1,   2500 },
-    { SCHED_TASK(update_GPS_10Hz),        5,   2500 }, // 10
+    { SCHED_TASK(update_GPS_10Hz),        1,   2500, SCHED_TRIGGER(gps_message_time) },
+    { SCHED_TASK(update_position),        5,    200 },
     { SCHED_TASK(navigate),               5,   3000 },
-    { SCHED_TASK(update_compass),         5,   1200 },
+    { SCHED_TASK(update_compass),         5,   1200, SCHED_TRIGGER(compass_sample_count) },
     { SCHED_TASK(read_airspeed),          5,   1200 },
     { SCHED_TASK(update_alt),             5,   3400 },
     { SCHED_TASK(adjust_altitude_target), 5,   1000 },
-    { SCHED_TASK(obc_fs_check),           5,   1000 },
+    { SCHED_TASK(obc_fs_check),           5,   1000 }, // 10
     { SCHED_TASK(gcs_update),             1,   1700 },
     { SCHED_TASK(gcs_data_stream_send),   1,   3000 },
-    { SCHED_TASK(update_events),		  1,   1500 }, // 20
+    { SCHED_TASK(update_events),		  1,   1500 },
     { SCHED_TASK(check_usb_mux),          5,    300 },
     { SCHED_TASK(read_battery),           5,   1000 },
     { SCHED_TASK(compass_accumulate),     1,   1500 },
@@ -59,19 +78,19 @@ const AP_Scheduler::Task Plane::scheduler_tasks[] PROGMEM = {
     { SCHED_TASK(update_notify),          1,    300 },
     { SCHED_TASK(read_rangefinder),       1,    500 },
 #if OPTFLOW == ENABLED
-    { SCHED_TASK(update_optical_flow),    1,    500 },
+    { SCHED_TASK(update_optical_flow),    1,    500 }, // 20
 #endif
     { SCHED_TASK(one_second_loop),       50,   1000 },
     { SCHED_TASK(check_long_failsafe),   15,   1000 },
     { SCHED_TASK(read_receiver_rssi),     5,   1000 },
-    { SCHED_TASK(airspeed_ratio_update), 50,   1000 }, // 30
+    { SCHED_TASK(airspeed_ratio_update), 50,   1000 },
     { SCHED_TASK(update_mount),           1,   1500 },
     { SCHED_TASK(log_perf_info),        500,   1000 },
     { SCHED_TASK(compass_save),        3000,   2500 },
     { SCHED_TASK(update_logging1),        5,   1700 },
     { SCHED_TASK(update_logging2),        5,   1700 },
 #if FRSKY_TELEM_ENABLED == ENABLED
-    { SCHED_TASK(frsky_telemetry_send),  10,    100 },
+    { SCHED_TASK(frsky_telemetry_send),  10,    100 }, // 30
 #endif
     { SCHED_TASK(terrain_update),         5,    500 },
 };
@@ -90,9 +109,18 @@ void Plane::setup()
     rssi_analog_source = hal.analogin->channel(ANALOG_INPUT_NONE);
 
     init_ardupilot();
+}
 
-    // initialise the main loop scheduler
-    scheduler.init(&scheduler_tasks[0], sizeof(scheduler_tasks)/sizeof(scheduler_tasks[0]));
+// initialise the main loop scheduler, with the task tables in 50Hz ticks
+void Plane::init_scheduler()
+{
+    scheduler.init(&scheduler_tasks[0], sizeof(scheduler_tasks)/sizeof(scheduler_tasks[0]),
+                   &fast_tasks[0], sizeof(fast_tasks)/sizeof(fast_tasks[0]),
+                   50);
+
+    // the EKF runs every get_rate_ticks() loops, on the IMU samples
+    // accumulated in between
+    ahrs.set_ekf_rate_div(scheduler.get_rate_ticks(EKF_RATE_HZ));
 }
 
 void Plane::loop()
@@ -119,14 +147,19 @@ void Plane::loop()
     // tell the scheduler one tick has passed
     scheduler.tick();
 
+    // run the rate loop, from the INS sample we have just woken up
+    // for through to the servo outputs
+    scheduler.run_fast(timer);
+
     // run all the tasks that are due to run. Note that we only
     // have to call this once per loop, as the tasks are scheduled
     // in multiples of the main loop tick. So if they don't run on
     // the first call to the scheduler they won't run on a later
     // call until scheduler.tick() is called again
-    uint32_t remaining = (timer + 20000) - micros();
-    if (remaining > 19500) {
-        remaining = 19500;
+    uint32_t loop_period_us = scheduler.get_loop_period_us();
+    uint32_t remaining = (timer + loop_period_us) - micros();
+    if (remaining > loop_period_us - loop_period_us/40) {
+        remaining = loop_period_us - loop_period_us/40;
     }
     scheduler.run(remaining);
 }
@@ -142,7 +175,9 @@ void Plane::ahrs_update()
         gcs_update();
     }
 
-    ahrs.update();
+    // read the IMU and keep the attitude current. The EKF itself
+    // runs from ekf_update()
+    ahrs.update_fast();
 
     if (should_log(MASK_LOG_ATTITUDE_FAST)) {
         Log_Write_Attitude();
@@ -162,6 +197,14 @@ void Plane::ahrs_update()
     steer_state.locked_course_err = wrap_PI(steer_state.locked_course_err);
 }
 
+/*
+  run the EKF at EKF_RATE_HZ
+ */
+void Plane::ekf_update()
+{
+    ahrs.update_EKF();
+}
+
 /*
   update 50Hz speed/height controller
  */
@@ -197,6 +240,7 @@ void Plane::update_compass(void)
 {
     if (g.compass_enabled && compass.read()) {
         ahrs.set_compass(&compass);
+        report_compass_cal();
         compass.learn_offsets();
         if (should_log(MASK_LOG_COMPASS)) {
             DataFlash.Log_Write_Compass(compass);
@@ -206,6 +250,15 @@ void Plane::update_compass(void)
     }
 }
 
+/*
+  scheduler trigger for update_compass, changing when the compass
+  drivers have new samples
+ */
+uint32_t Plane::compass_sample_count(void)
+{
+    return compass.sample_count();
+}
+
 /*
   if the compass is enabled then try to accumulate a reading
  */
@@ -316,6 +369,7 @@ void Plane::one_second_loop()
     }
 
     ins.set_raw_logging(should_log(MASK_LOG_IMU_RAW));
+    set_replay_logging();
 }
 
 void Plane::log_perf_info()
@@ -324,11 +378,16 @@ void Plane::log_perf_info()
         gcs_send_text_fmt(PSTR("G_Dt_max=%lu G_Dt_min=%lu\n"), 
                           (unsigned long)G_Dt_max, 
                           (unsigned long)G_Dt_min);
+        gcs_send_text_fmt(PSTR("rate loop latency=%u budget=%u overruns=%u\n"),
+                          (unsigned)scheduler.get_fast_latency_max_usec(),
+                          (unsigned)scheduler.get_fast_budget_usec(),
+                          (unsigned)scheduler.get_fast_overruns());
     }
     if (should_log(MASK_LOG_PM))
         Log_Write_Performance();
     G_Dt_max = 0;
     G_Dt_min = 0;
+    scheduler.reset_fast_stats();
     resetPerfData();
 }
 
@@ -389,7 +448,7 @@ void Plane::airspeed_ratio_update(void)
  */
 void Plane::update_GPS_50Hz(void)
 {
-    static uint32_t last_gps_reading[GPS_MAX_INSTANCES];
+    static uint32_t last_gps_reading[GPS_MAX_INSTANCES+GPS_BLENDING_AVAILABLE];
     gps.update();
 
     for (uint8_t i=0; i<gps.num_sensors(); i++) {
@@ -400,15 +459,40 @@ void Plane::update_GPS_50Hz(void)
             }
         }
     }
+#if GPS_BLENDING_AVAILABLE
+    if (gps.blending() &&
+        gps.last_message_time_ms(GPS_BLENDED_INSTANCE) != last_gps_reading[GPS_BLENDED_INSTANCE]) {
+        last_gps_reading[GPS_BLENDED_INSTANCE] = gps.last_message_time_ms(GPS_BLENDED_INSTANCE);
+        if (should_log(MASK_LOG_GPS)) {
+            Log_Write_GPS(GPS_BLENDED_INSTANCE);
+        }
+    }
+#endif
 }
 
 /*
-  read update GPS position - 10Hz update
+  scheduler trigger for update_GPS_10Hz, changing with each new GPS
+  message
  */
-void Plane::update_GPS_10Hz(void)
+uint32_t Plane::gps_message_time(void)
+{
+    return gps.last_message_time_ms();
+}
+
+/*
+  get position from AHRS
+ */
+void Plane::update_position(void)
 {
-    // get position from AHRS
     have_position = ahrs.get_position(current_loc);
+}
+
+/*
+  read update GPS position - run on each new GPS message
+ */
+void Plane::update_GPS_10Hz(void)
+{
+    update_position();
 
     static uint32_t last_gps_msg_ms;
     if (gps.last_message_time_ms() != last_gps_msg_ms && gps.status() >= AP_GPS::GPS_OK_FIX_3D) {
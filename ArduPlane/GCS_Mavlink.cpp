@@ -291,7 +291,7 @@ void Plane::send_extended_status1(mavlink_channel_t chan)
         control_sensors_present,
         control_sensors_enabled,
         control_sensors_health,
-        (uint16_t)(scheduler.load_average(20000) * 1000),
+        (uint16_t)(scheduler.load_average(scheduler.get_loop_period_us()) * 1000),
         battery.voltage() * 1000, // mV
         battery_current,        // in 10mA units
         battery_remaining,      // in %
@@ -1126,6 +1126,25 @@ void GCS_MAVLINK::handleMessage(mavlink_message_t* msg)
                 } else {
                     result = MAV_RESULT_FAILED;
                 }
+#if COMPASS_CAL_ENABLED
+            } else if (is_equal(packet.param2,1.0f)) {
+                // batch compass calibration, saved on success. The
+                // progress is reported in text messages
+                if (hal.util->get_soft_armed() || !plane.compass.start_calibration_all(true)) {
+                    result = MAV_RESULT_FAILED;
+                } else {
+                    memset(plane.compass_cal_state.completion, 0, sizeof(plane.compass_cal_state.completion));
+                    plane.compass_cal_state.reported_mask = 0;
+                    plane.compass_cal_state.active = true;
+                    result = MAV_RESULT_ACCEPTED;
+                }
+            } else if (is_equal(packet.param2,2.0f)) {
+                // cancel a compass calibration
+                plane.compass.cancel_calibration_all();
+                plane.compass_cal_state.active = false;
+                send_text_P(SEVERITY_LOW, PSTR("Compass calibration cancelled"));
+                result = MAV_RESULT_ACCEPTED;
+#endif
             } else if (is_equal(packet.param3,1.0f)) {
                 plane.init_barometer();
                 if (plane.airspeed.enabled()) {
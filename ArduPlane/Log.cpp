@@ -513,9 +513,22 @@ void Plane::Log_Read(uint16_t log_num, int16_t start_page, int16_t end_page)
 }
 #endif // CLI_ENABLED
 
+// enable replay logging with its budget if the REPLAY bit is set
+void Plane::set_replay_logging(void)
+{
+    if (should_log(MASK_LOG_REPLAY)) {
+        DataFlash.SetReplayLogging((uint32_t)constrain_int16(g.log_replay_rate, 1, 1000) * 1024UL);
+    } else {
+        DataFlash.SetReplayLogging(0);
+    }
+}
+
 // start a new log
 void Plane::start_logging() 
 {
+    DataFlash.set_log_quotas((uint32_t)constrain_int16(g.log_file_max, 0, 4095) * 1024UL * 1024UL,
+                             (uint64_t)constrain_int16(g.log_total_max, 0, 32767) * 1024UL * 1024UL);
+    DataFlash.set_log_compression(g.log_compress != 0);
     DataFlash.StartNewLog();
     DataFlash.Log_Write_Message_P(PSTR(FIRMWARE_STRING));
 #if defined(PX4_GIT_VERSION) && defined(NUTTX_GIT_VERSION)
@@ -531,12 +544,25 @@ void Plane::start_logging()
     Log_Write_Startup(TYPE_GROUNDSTART_MSG);
 }
 
+/*
+  maximum rates of the slower changing messages written with
+  ATTITUDE_FAST logging
+ */
+static const struct LogRate log_rates[] = {
+    { LOG_EKF2_MSG, 100, 1 },
+    { LOG_EKF3_MSG,  40, 1 },
+    { LOG_EKF4_MSG, 100, 1 },
+    { LOG_EKF5_MSG,  40, 1 },
+    { LOG_AHR2_MSG,  40, 1 },
+};
+
 /*
   initialise logging subsystem
  */
 void Plane::log_init(void)
 {
     DataFlash.Init(log_structure, sizeof(log_structure)/sizeof(log_structure[0]));
+    DataFlash.SetLogRates(log_rates, sizeof(log_rates)/sizeof(log_rates[0]));
     if (!DataFlash.CardInserted()) {
         gcs_send_text_P(SEVERITY_LOW, PSTR("No dataflash card inserted"));
         g.log_bitmask.set(0);
@@ -557,5 +583,7 @@ int8_t Plane::process_logs(uint8_t argc, const Menu::arg *argv)
     return 0;
 }
 
+void Plane::set_replay_logging(void) {}
+
 
 #endif // LOGGING_ENABLED
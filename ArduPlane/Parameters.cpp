@@ -329,7 +329,7 @@ const AP_Param::Info Plane::var_info[] PROGMEM = {
 
     // @Param: FENCE_TOTAL
     // @DisplayName: Fence Total
-    // @Description: Number of geofence points currently loaded
+    // @Description: Number of geofence points currently loaded. The points are the return point, then the boundary with its first point repeated at the end, then any exclusion zones the plane must stay out of, each also closed by repeating its first point
     // @User: Advanced
     GSCALAR(fence_total,            "FENCE_TOTAL",    0),
 
@@ -784,10 +784,41 @@ const AP_Param::Info Plane::var_info[] PROGMEM = {
     // @DisplayName: Log bitmask
     // @Description: Bitmap of what log types to enable in dataflash. This values is made up of the sum of each of the log types you want to be saved on dataflash. On a PX4 or Pixhawk the large storage size of a microSD card means it is usually best just to enable all log types by setting this to 65535. On APM2 the smaller 4 MByte dataflash means you need to be more selective in your logging or you may run out of log space while flying (in which case it will wrap and overwrite the start of the log). The individual bits are ATTITUDE_FAST=1, ATTITUDE_MEDIUM=2, GPS=4, PerformanceMonitoring=8, ControlTuning=16, NavigationTuning=32, Mode=64, IMU=128, Commands=256, Battery=512, Compass=1024, TECS=2048, Camera=4096, RCandServo=8192, Sonar=16384, Arming=32768, LogWhenDisarmed=65536, FullLogsArmedOnly=65535, FullLogsWhenDisarmed=131071
     // @Values: 0:Disabled,5190:APM2-Default,65535:PX4/Pixhawk-Default
-    // @Bitmask: 0:ATTITUDE_FAST,1:ATTITUDE_MED,2:GPS,3:PM,4:CTUN,5:NTUN,6:MODE,7:IMU,8:CMD,9:CURRENT,10:COMPASS,11:TECS,12:CAMERA,13:RC,14:SONAR,15:ARM/DISARM,16:WHEN_DISARMED,19:IMU_RAW
+    // @Bitmask: 0:ATTITUDE_FAST,1:ATTITUDE_MED,2:GPS,3:PM,4:CTUN,5:NTUN,6:MODE,7:IMU,8:CMD,9:CURRENT,10:COMPASS,11:TECS,12:CAMERA,13:RC,14:SONAR,15:ARM/DISARM,16:WHEN_DISARMED,19:IMU_RAW,20:REPLAY
     // @User: Advanced
     GSCALAR(log_bitmask,            "LOG_BITMASK",    DEFAULT_LOG_BITMASK),
 
+    // @Param: LOG_FILE_MAX
+    // @DisplayName: Maximum log file size
+    // @Description: When a log file on the microSD card reaches this size a new log is started, with the formats and parameters written again. Zero means no limit. Only applies to boards logging to files
+    // @Units: MByte
+    // @Range: 0 4095
+    // @User: Advanced
+    GSCALAR(log_file_max,           "LOG_FILE_MAX",   0),
+
+    // @Param: LOG_TOTAL_MAX
+    // @DisplayName: Maximum total log size
+    // @Description: When a new log is started the oldest logs are deleted until the logs on the microSD card, plus LOG_FILE_MAX for the new log, fit in this size. Set LOG_FILE_MAX as well to bound the space used by a single long flight. Zero means no limit. Only applies to boards logging to files
+    // @Units: MByte
+    // @Range: 0 32767
+    // @User: Advanced
+    GSCALAR(log_total_max,          "LOG_TOTAL_MAX",  0),
+
+    // @Param: LOG_REPLAY_RATE
+    // @DisplayName: Replay logging budget
+    // @Description: The most data per second that replay logging may write when the REPLAY bit of LOG_BITMASK is set. Replay logging records every IMU, GPS, barometer, compass and airspeed sample the EKF uses, so Tools/Replay can reproduce the EKF output of a flight. Samples beyond the budget are dropped and counted in the RFRM message
+    // @Units: kB/s
+    // @Range: 1 1000
+    // @User: Advanced
+    GSCALAR(log_replay_rate,        "LOG_REPLAY_RATE", 20),
+
+    // @Param: LOG_COMPRESS
+    // @DisplayName: Compress finished logs
+    // @Description: When enabled, logs on the microSD card are compressed in the background once they are finished, saving space on the card. Compressed logs are decompressed as they are downloaded over MAVLink. Only applies to boards logging to files
+    // @Values: 0:Disabled,1:Enabled
+    // @User: Advanced
+    GSCALAR(log_compress,           "LOG_COMPRESS",   0),
+
     // @Param: RST_SWITCH_CH
     // @DisplayName: Reset Switch Channel
     // @Description: RC channel to use to reset to last flight mode	after geofence takeover.
@@ -139,6 +139,10 @@ public:
         k_param_rudder_only,
         k_param_gcs3,            // 93
         k_param_gcs_pid_mask,
+        k_param_log_file_max,
+        k_param_log_total_max,
+        k_param_log_replay_rate,
+        k_param_log_compress,
 
         // 100: Arming parameters
         k_param_arming = 100,
@@ -438,6 +442,10 @@ public:
     AP_Int8 reverse_ch2_elevon;
     AP_Int16 num_resets;
     AP_Int32 log_bitmask;
+    AP_Int16 log_file_max;
+    AP_Int16 log_total_max;
+    AP_Int16 log_replay_rate;
+    AP_Int8 log_compress;
     AP_Int8 reset_switch_chan;
     AP_Int8 reset_mission_chan;
     AP_Int32 airspeed_cruise_cm;
@@ -134,8 +134,8 @@ private:
     AP_Vehicle::FixedWing aparm;
     AP_HAL::BetterStream* cliSerial;
 
-    // the rate we run the main loop 
-    const AP_InertialSensor::Sample_rate ins_sample_rate = AP_InertialSensor::RATE_50HZ;
+    // the rate we run the main loop, set from SCHED_LOOP_RATE
+    AP_InertialSensor::Sample_rate ins_sample_rate = AP_InertialSensor::RATE_50HZ;
 
     // Global parameters are all contained within the 'g' class.
     Parameters g;
@@ -242,6 +242,17 @@ private:
     // external failsafe boards during baro and airspeed calibration
     bool in_calibration;
 
+#if COMPASS_CAL_ENABLED
+    // progress of a compass calibration started by the GCS, which is
+    // reported in text messages
+    struct {
+        bool active;
+        uint8_t completion[COMPASS_MAX_INSTANCES];
+        // compasses whose result has been reported
+        uint8_t reported_mask;
+    } compass_cal_state;
+#endif
+
 
     // GCS selection
     AP_SerialManager serial_manager;
@@ -640,6 +651,7 @@ private:
 
     AP_Param param_loader {var_info};
 
+    static const AP_Scheduler::Task fast_tasks[];
     static const AP_Scheduler::Task scheduler_tasks[];
     static const AP_Param::Info var_info[];
 
@@ -698,6 +710,7 @@ private:
     void Log_Write_Airspeed(void);
     void Log_Read(uint16_t log_num, int16_t start_page, int16_t end_page);
     void start_logging();
+    void set_replay_logging(void);
     void load_parameters(void);
     void adjust_altitude_target();
     void setup_glide_slope(void);
@@ -819,6 +832,7 @@ private:
     void print_accel_offsets_and_scaling(void);
     void print_gyro_offsets(void);
     void init_ardupilot();
+    void init_scheduler();
     void startup_ground(void);
     enum FlightMode get_previous_mode();
     void set_mode(enum FlightMode mode);
@@ -844,10 +858,15 @@ private:
     int8_t takeoff_tail_hold(void);
     void print_hit_enter();
     void ahrs_update();
+    void ekf_update();
     void update_speed_height(void);
     void update_GPS_50Hz(void);
     void update_GPS_10Hz(void);
+    void update_position(void);
     void update_compass(void);
+    void report_compass_cal(void);
+    uint32_t gps_message_time(void);
+    uint32_t compass_sample_count(void);
     void update_alt(void);
     void obc_fs_check(void);
     void compass_accumulate(void);
@@ -39,6 +39,12 @@ static struct GeofenceState {
     int32_t guided_lng;
     /* point 0 is the return point */
     Vector2l *boundary;
+    /* points in the inclusion boundary, including the closing point */
+    uint8_t boundary_points;
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+    // indexed copy of the boundary and exclusion zones for fast checks
+    PolygonFence polygon;
+#endif
 } *geofence_state;
 
 
@@ -86,6 +92,51 @@ void Plane::set_fence_point_with_index(Vector2l &point, unsigned i)
     }
 }
 
+/*
+  number of points in the closed zone starting at points[0], including
+  the point that closes it, or 0 if the zone is not closed within n
+  points
+ */
+static uint8_t geofence_zone_length(const Vector2l *points, uint8_t n)
+{
+    for (uint8_t i=3; i<n; i++) {
+        if (points[i].x == points[0].x && points[i].y == points[0].y) {
+            return i+1;
+        }
+    }
+    return 0;
+}
+
+/*
+  true if the location is outside the inclusion boundary or inside
+  one of the exclusion zones that follow it
+ */
+static bool geofence_outside(const Vector2l &location)
+{
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+    if (geofence_state->polygon.num_zones() > 0) {
+        return geofence_state->polygon.outside(location);
+    }
+#endif
+    const Vector2l *points = &geofence_state->boundary[1];
+    uint8_t n = geofence_state->num_points - 1;
+    uint8_t i = geofence_state->boundary_points;
+    if (Polygon_outside(location, points, i)) {
+        return true;
+    }
+    while (i < n) {
+        uint8_t len = geofence_zone_length(&points[i], n - i);
+        if (len == 0) {
+            break;
+        }
+        if (!Polygon_outside(location, &points[i], len)) {
+            return true;
+        }
+        i += len;
+    }
+    return false;
+}
+
 /*
  *  allocate and fill the geofence state structure
  */
@@ -124,11 +175,43 @@ void Plane::geofence_load(void)
     }
     geofence_state->num_points = i;
 
-    if (!Polygon_complete(&geofence_state->boundary[1], geofence_state->num_points-1)) {
-        // first point and last point must be the same
-        goto failed;
+    /*
+      after the return point comes the inclusion boundary, then any
+      exclusion zones. The first point of each is repeated to close it
+     */
+    {
+        const Vector2l *points = &geofence_state->boundary[1];
+        uint8_t n = geofence_state->num_points - 1;
+        uint8_t len = geofence_zone_length(points, n);
+        if (len == 0) {
+            // first point and last point must be the same
+            goto failed;
+        }
+        geofence_state->boundary_points = len;
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+        geofence_state->polygon.clear();
+        bool indexed = geofence_state->polygon.add_zone(points, len, true);
+#endif
+        for (uint8_t z=len; z<n; z+=len) {
+            len = geofence_zone_length(&points[z], n - z);
+            if (len == 0) {
+                // an exclusion zone is not closed
+                goto failed;
+            }
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+            indexed = indexed && geofence_state->polygon.add_zone(&points[z], len, false);
+#endif
+        }
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+        if (!indexed) {
+            // too many zones, check them one at a time instead
+            geofence_state->polygon.clear();
+        } else {
+            geofence_state->polygon.build();
+        }
+#endif
     }
-    if (Polygon_outside(geofence_state->boundary[0], &geofence_state->boundary[1], geofence_state->num_points-1)) {
+    if (geofence_outside(geofence_state->boundary[0])) {
         // return point needs to be inside the fence
         goto failed;
     }
@@ -324,7 +407,7 @@ void Plane::geofence_check(bool altitude_check_only)
         Vector2l location;
         location.x = loc.lat;
         location.y = loc.lng;
-        outside = Polygon_outside(location, &geofence_state->boundary[1], geofence_state->num_points-1);
+        outside = geofence_outside(location);
         if (outside) {
             breach_type = FENCE_BREACH_BOUNDARY;
         }
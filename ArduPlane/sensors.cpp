@@ -68,6 +68,51 @@ void Plane::zero_airspeed(bool in_startup)
     gcs_send_text_P(SEVERITY_LOW,PSTR("zero airspeed calibrated"));
 }
 
+/*
+  report the progress and result of a compass calibration started by
+  the GCS, in steps of 10 percent of sphere coverage
+ */
+void Plane::report_compass_cal(void)
+{
+#if COMPASS_CAL_ENABLED
+    if (!compass_cal_state.active) {
+        return;
+    }
+    bool finished = true;
+    for (uint8_t i=0; i<compass.get_count(); i++) {
+        switch (compass.get_cal_status(i)) {
+        case CompassCalibrator::STATUS_COLLECTING: {
+            uint8_t completion = compass.get_cal_completion_percent(i);
+            if (completion / 10 != compass_cal_state.completion[i] / 10) {
+                gcs_send_text_fmt(PSTR("Compass%u calibration %u%%"), (unsigned)i+1, (unsigned)completion);
+            }
+            compass_cal_state.completion[i] = completion;
+            finished = false;
+            break;
+        }
+        case CompassCalibrator::STATUS_FITTING:
+            finished = false;
+            break;
+        case CompassCalibrator::STATUS_SUCCESS:
+            if (!(compass_cal_state.reported_mask & (1U<<i))) {
+                gcs_send_text_fmt(PSTR("Compass%u calibrated fitness %.1f"), (unsigned)i+1, compass.get_cal_fitness(i));
+                compass_cal_state.reported_mask |= (1U<<i);
+            }
+            break;
+        case CompassCalibrator::STATUS_FAILED:
+            if (!(compass_cal_state.reported_mask & (1U<<i))) {
+                gcs_send_text_fmt(PSTR("Compass%u calibration failed fitness %.1f"), (unsigned)i+1, compass.get_cal_fitness(i));
+                compass_cal_state.reported_mask |= (1U<<i);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    compass_cal_state.active = !finished;
+#endif
+}
+
 // read_battery - reads battery voltage and current and invokes failsafe
 // should be called at 10hz
 void Plane::read_battery(void)
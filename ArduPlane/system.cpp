@@ -95,6 +95,11 @@ void Plane::init_ardupilot()
     //
     load_parameters();
 
+    // initialise the main loop scheduler. This needs to be done
+    // before the INS is started, as it sets the loop rate
+    init_scheduler();
+    ins_sample_rate = (AP_InertialSensor::Sample_rate)scheduler.get_loop_rate_hz();
+
     if (g.hil_mode == 1) {
         // set sensors to HIL mode
         ins.set_hil_mode();
@@ -306,6 +311,10 @@ void Plane::startup_ground(void)
 
     ins.set_raw_logging(should_log(MASK_LOG_IMU_RAW));
     ins.set_dataflash(&DataFlash);    
+    barometer.set_dataflash(&DataFlash);
+    compass.set_dataflash(&DataFlash);
+    airspeed.set_dataflash(&DataFlash);
+    set_replay_logging();
 
     gcs_send_text_P(SEVERITY_LOW,PSTR("\n\n Ready to FLY."));
 }
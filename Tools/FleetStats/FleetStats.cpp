@@ -0,0 +1,486 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+  vibration, GPS glitch, EKF innovation and compass interference
+  statistics over many DataFlash logs
+
+  Each log is streamed once by one worker thread (see LogStats.h), the
+  logs being shared out between the threads as they finish. Per log
+  results go to CSV and/or JSON, and the fleet histograms, built from
+  the per log ones, to the console and the JSON file.
+
+    FleetStats -j 8 --csv logs.csv --json fleet.json *.BIN
+    find /logs -name '*.BIN' | FleetStats --list - --csv logs.csv
+ */
+
+#include <AP_Common.h>
+#include <AP_Progmem.h>
+#include <AP_Param.h>
+#include <StorageManager.h>
+#include <AP_Math.h>
+#include <AP_HAL.h>
+#include <AP_HAL_AVR.h>
+#include <AP_HAL_SITL.h>
+#include <AP_HAL_Linux.h>
+#include <AP_HAL_Empty.h>
+#include <AP_ADC.h>
+#include <AP_Declination.h>
+#include <AP_ADC_AnalogSource.h>
+#include <Filter.h>
+#include <AP_Buffer.h>
+#include <AP_Airspeed.h>
+#include <AP_Vehicle.h>
+#include <AP_Notify.h>
+#include <DataFlash.h>
+#include <GCS_MAVLink.h>
+#include <AP_GPS.h>
+#include <AP_AHRS.h>
+#include <SITL.h>
+#include <AP_Compass.h>
+#include <AP_Baro.h>
+#include <AP_InertialSensor.h>
+#include <AP_InertialNav.h>
+#include <AP_NavEKF.h>
+#include <AP_Mission.h>
+#include <AP_Rally.h>
+#include <AP_BattMonitor.h>
+#include <AP_Terrain.h>
+#include <AP_OpticalFlow.h>
+#include <AP_SerialManager.h>
+#include <RC_Channel.h>
+#include <AP_RangeFinder.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <getopt.h> // for optind only
+#include <utility/getopt_cpp.h>
+#include "LogStats.h"
+
+const AP_HAL::HAL& hal = AP_HAL_BOARD_DRIVER;
+
+#define FLEETSTATS_MAX_THREADS      64
+#define FLEETSTATS_INTERFERENCE_BINS 10  // 10% wide
+
+class FleetStats {
+public:
+    FleetStats() :
+        num_threads(0),
+        csv_file(NULL),
+        json_file(NULL),
+        num_jobs(0),
+        max_jobs(0),
+        jobs(NULL),
+        next_job(0)
+        {}
+
+    void setup();
+
+private:
+    struct job {
+        char *path;
+        bool ok;
+        LogStats::result res;
+    };
+
+    uint8_t num_threads;
+    const char *csv_file;
+    const char *json_file;
+
+    uint32_t num_jobs;
+    uint32_t max_jobs;
+    struct job *jobs;
+    uint32_t next_job;
+
+    void usage(void);
+    void parse_command_line(uint8_t argc, char * const argv[]);
+    void add_log(const char *path);
+    void add_log_list(const char *listfile);
+
+    static void *worker_thread(void *arg);
+    void worker(void);
+
+    void write_csv(void);
+    void write_json(void);
+    void print_summary(float elapsed_s);
+};
+
+static FleetStats fleetstats;
+
+void FleetStats::usage(void)
+{
+    ::printf("Usage: FleetStats [options] LOG...\n");
+    ::printf("Options:\n");
+    ::printf("\t--jobs N          number of worker threads, default one per core\n");
+    ::printf("\t--list FILE       read log names from FILE, one per line, - for stdin\n");
+    ::printf("\t--csv FILE        write per log results to FILE\n");
+    ::printf("\t--json FILE       write per log results and fleet histograms to FILE\n");
+}
+
+void FleetStats::add_log(const char *path)
+{
+    if (num_jobs == max_jobs) {
+        max_jobs = max_jobs ? max_jobs*2 : 256;
+        jobs = (struct job *)realloc(jobs, max_jobs * sizeof(struct job));
+        if (jobs == NULL) {
+            ::printf("Out of memory\n");
+            exit(1);
+        }
+    }
+    memset(&jobs[num_jobs], 0, sizeof(jobs[num_jobs]));
+    jobs[num_jobs].path = strdup(path);
+    num_jobs++;
+}
+
+// the command line is limited to 255 arguments, so large fleets are
+// given as a list
+void FleetStats::add_log_list(const char *listfile)
+{
+    FILE *f = streq(listfile, "-") ? stdin : fopen(listfile, "r");
+    if (f == NULL) {
+        perror(listfile);
+        exit(1);
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        size_t len = strlen(line);
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r')) {
+            line[--len] = 0;
+        }
+        if (len > 0) {
+            add_log(line);
+        }
+    }
+    if (f != stdin) {
+        fclose(f);
+    }
+}
+
+void FleetStats::parse_command_line(uint8_t argc, char * const argv[])
+{
+    const struct GetOptLong::option options[] = {
+        {"jobs",            true,   0, 'j'},
+        {"list",            true,   0, 'l'},
+        {"csv",             true,   0, 'c'},
+        {"json",            true,   0, 'J'},
+        {"help",            false,  0, 'h'},
+        {0, false, 0, 0}
+    };
+
+    GetOptLong gopt(argc, argv, "j:l:c:J:h", options);
+    gopt.optind = optind;
+
+    int opt;
+    while ((opt = gopt.getoption()) != -1) {
+        switch (opt) {
+        case 'j':
+            num_threads = constrain_int16(strtol(gopt.optarg, NULL, 0), 1, FLEETSTATS_MAX_THREADS);
+            break;
+
+        case 'l':
+            add_log_list(gopt.optarg);
+            break;
+
+        case 'c':
+            csv_file = gopt.optarg;
+            break;
+
+        case 'J':
+            json_file = gopt.optarg;
+            break;
+
+        case 'h':
+        default:
+            usage();
+            exit(opt == 'h' ? 0 : 1);
+        }
+    }
+
+    argv += gopt.optind;
+    argc -= gopt.optind;
+
+    for (uint8_t i=0; i<argc; i++) {
+        add_log(argv[i]);
+    }
+    if (num_jobs == 0) {
+        usage();
+        exit(1);
+    }
+}
+
+void *FleetStats::worker_thread(void *arg)
+{
+    ((FleetStats *)arg)->worker();
+    return NULL;
+}
+
+/*
+  take the next log until there are none left. The reader holds its
+  read buffer, so it is allocated rather than put on the stack
+ */
+void FleetStats::worker(void)
+{
+    uint32_t i;
+    while ((i = __atomic_fetch_add(&next_job, 1, __ATOMIC_RELAXED)) < num_jobs) {
+        LogStats *stats = new LogStats();
+        jobs[i].ok = stats->process(jobs[i].path, jobs[i].res);
+        delete stats;
+    }
+}
+
+void FleetStats::write_csv(void)
+{
+    FILE *f = fopen(csv_file, "w");
+    if (f == NULL) {
+        perror(csv_file);
+        return;
+    }
+    fprintf(f, "log,ok,complete,bytes,duration_s,"
+            "imu_samples,vibe_rms_x,vibe_rms_y,vibe_rms_z,vibe_max,clip0,clip1,clip2,"
+            "gps_samples,gps_min_sats,gps_max_hdop,glitch_count,glitch_samples,glitch_max_offset,"
+            "ekf_samples,vel_ratio_max,pos_ratio_max,hgt_ratio_max,mag_ratio_max,"
+            "vel_over_gate,pos_over_gate,hgt_over_gate,mag_over_gate,"
+            "mag_samples,mag_field_mean,mag_slope,mag_per_amp,mag_interference_pct\n");
+    for (uint32_t i=0; i<num_jobs; i++) {
+        const LogStats::result &r = jobs[i].res;
+        fprintf(f, "\"%s\",%u,%u,%llu,%.1f,", jobs[i].path, jobs[i].ok, r.complete,
+                (unsigned long long)r.bytes, r.duration_s);
+        fprintf(f, "%u,%.3f,%.3f,%.3f,%.3f,%u,%u,%u,",
+                r.imu_samples, r.vibe_rms[0], r.vibe_rms[1], r.vibe_rms[2], r.vibe_max,
+                r.clip_count[0], r.clip_count[1], r.clip_count[2]);
+        fprintf(f, "%u,%u,%.2f,%u,%u,%.1f,",
+                r.gps_samples, r.gps_min_sats, r.gps_max_hdop,
+                r.glitch_count, r.glitch_samples, r.glitch_max_offset);
+        fprintf(f, "%u,%.2f,%.2f,%.2f,%.2f,%u,%u,%u,%u,",
+                r.ekf_samples,
+                r.ratio_max[0], r.ratio_max[1], r.ratio_max[2], r.ratio_max[3],
+                r.ratio_over_gate[0], r.ratio_over_gate[1], r.ratio_over_gate[2], r.ratio_over_gate[3]);
+        fprintf(f, "%u,%.1f,%.3f,%u,%.1f\n",
+                r.mag_samples, r.mag_field_mean, r.mag_slope, r.mag_per_amp, r.mag_interference_pct);
+    }
+    fclose(f);
+}
+
+static void json_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', f);
+        }
+        if ((uint8_t)*s >= 0x20) {
+            fputc(*s, f);
+        }
+    }
+    fputc('"', f);
+}
+
+static void json_hist(FILE *f, const char *name, const uint64_t *hist, uint8_t bins, float width)
+{
+    fprintf(f, "    \"%s\": {\"bin_width\": %g, \"counts\": [", name, width);
+    for (uint8_t i=0; i<bins; i++) {
+        fprintf(f, "%s%llu", i ? ", " : "", (unsigned long long)hist[i]);
+    }
+    fprintf(f, "]}");
+}
+
+/*
+  fleet histograms: the per log sample histograms summed, and the
+  number of logs in each band of compass interference
+ */
+struct fleet_hist {
+    uint64_t vibe[LOGSTATS_VIBE_BINS];
+    uint64_t ratio[LOGSTATS_NUM_RATIOS][LOGSTATS_RATIO_BINS];
+    uint64_t interference[FLEETSTATS_INTERFERENCE_BINS];
+};
+
+static void fleet_histograms(const LogStats::result &r, struct fleet_hist &h)
+{
+    for (uint8_t i=0; i<LOGSTATS_VIBE_BINS; i++) {
+        h.vibe[i] += r.vibe_hist[i];
+    }
+    for (uint8_t i=0; i<LOGSTATS_NUM_RATIOS; i++) {
+        for (uint8_t j=0; j<LOGSTATS_RATIO_BINS; j++) {
+            h.ratio[i][j] += r.ratio_hist[i][j];
+        }
+    }
+    if (r.mag_samples > 0) {
+        uint8_t bin = min(r.mag_interference_pct / 10, FLEETSTATS_INTERFERENCE_BINS-1);
+        h.interference[bin]++;
+    }
+}
+
+void FleetStats::write_json(void)
+{
+    FILE *f = fopen(json_file, "w");
+    if (f == NULL) {
+        perror(json_file);
+        return;
+    }
+
+    struct fleet_hist h;
+    memset(&h, 0, sizeof(h));
+
+    fprintf(f, "{\n  \"logs\": [\n");
+    for (uint32_t i=0; i<num_jobs; i++) {
+        const LogStats::result &r = jobs[i].res;
+        if (jobs[i].ok) {
+            fleet_histograms(r, h);
+        }
+        fprintf(f, "    {\"log\": ");
+        json_string(f, jobs[i].path);
+        fprintf(f, ", \"ok\": %s, \"complete\": %s, \"bytes\": %llu, \"duration_s\": %.1f,\n",
+                jobs[i].ok ? "true" : "false", r.complete ? "true" : "false",
+                (unsigned long long)r.bytes, r.duration_s);
+        fprintf(f, "     \"vibration\": {\"samples\": %u, \"rms\": [%.3f, %.3f, %.3f], \"max\": %.3f, \"clip\": [%u, %u, %u]},\n",
+                r.imu_samples, r.vibe_rms[0], r.vibe_rms[1], r.vibe_rms[2], r.vibe_max,
+                r.clip_count[0], r.clip_count[1], r.clip_count[2]);
+        fprintf(f, "     \"gps\": {\"samples\": %u, \"min_sats\": %u, \"max_hdop\": %.2f, \"glitches\": %u, \"glitch_samples\": %u, \"glitch_max_offset\": %.1f},\n",
+                r.gps_samples, r.gps_min_sats, r.gps_max_hdop,
+                r.glitch_count, r.glitch_samples, r.glitch_max_offset);
+        fprintf(f, "     \"ekf\": {\"samples\": %u, \"ratio_max\": [%.2f, %.2f, %.2f, %.2f], \"over_gate\": [%u, %u, %u, %u]},\n",
+                r.ekf_samples,
+                r.ratio_max[0], r.ratio_max[1], r.ratio_max[2], r.ratio_max[3],
+                r.ratio_over_gate[0], r.ratio_over_gate[1], r.ratio_over_gate[2], r.ratio_over_gate[3]);
+        fprintf(f, "     \"compass\": {\"samples\": %u, \"field_mean\": %.1f, \"slope\": %.3f, \"per_amp\": %s, \"interference_pct\": %.1f}}%s\n",
+                r.mag_samples, r.mag_field_mean, r.mag_slope, r.mag_per_amp ? "true" : "false",
+                r.mag_interference_pct, i+1 < num_jobs ? "," : "");
+    }
+    fprintf(f, "  ],\n  \"fleet\": {\n");
+    json_hist(f, "vibration", h.vibe, LOGSTATS_VIBE_BINS, LOGSTATS_VIBE_BIN_WIDTH);
+    fprintf(f, ",\n");
+    json_hist(f, "vel_ratio", h.ratio[LOGSTATS_RATIO_VEL], LOGSTATS_RATIO_BINS, LOGSTATS_RATIO_BIN_WIDTH);
+    fprintf(f, ",\n");
+    json_hist(f, "pos_ratio", h.ratio[LOGSTATS_RATIO_POS], LOGSTATS_RATIO_BINS, LOGSTATS_RATIO_BIN_WIDTH);
+    fprintf(f, ",\n");
+    json_hist(f, "hgt_ratio", h.ratio[LOGSTATS_RATIO_HGT], LOGSTATS_RATIO_BINS, LOGSTATS_RATIO_BIN_WIDTH);
+    fprintf(f, ",\n");
+    json_hist(f, "mag_ratio", h.ratio[LOGSTATS_RATIO_MAG], LOGSTATS_RATIO_BINS, LOGSTATS_RATIO_BIN_WIDTH);
+    fprintf(f, ",\n");
+    json_hist(f, "compass_interference_pct", h.interference, FLEETSTATS_INTERFERENCE_BINS, 10);
+    fprintf(f, "\n  }\n}\n");
+    fclose(f);
+}
+
+static void print_hist(const char *name, const uint64_t *hist, uint8_t bins, float width)
+{
+    uint64_t total = 0;
+    for (uint8_t i=0; i<bins; i++) {
+        total += hist[i];
+    }
+    ::printf("%s\n", name);
+    if (total == 0) {
+        return;
+    }
+    for (uint8_t i=0; i<bins; i++) {
+        ::printf("  %6.2f%s %5.1f%%\n", i*width, i+1 < bins ? " " : "+", 100.0f*hist[i]/total);
+    }
+}
+
+void FleetStats::print_summary(float elapsed_s)
+{
+    struct fleet_hist h;
+    memset(&h, 0, sizeof(h));
+
+    uint32_t ok = 0, incomplete = 0, glitches = 0;
+    uint64_t bytes = 0;
+    double hours = 0;
+    for (uint32_t i=0; i<num_jobs; i++) {
+        if (!jobs[i].ok) {
+            ::printf("Failed to read %s\n", jobs[i].path);
+            continue;
+        }
+        const LogStats::result &r = jobs[i].res;
+        ok++;
+        if (!r.complete) {
+            incomplete++;
+        }
+        bytes += r.bytes;
+        hours += r.duration_s / 3600.0;
+        glitches += r.glitch_count;
+        fleet_histograms(r, h);
+    }
+
+    print_hist("IMU vibration (m/s/s)", h.vibe, LOGSTATS_VIBE_BINS, LOGSTATS_VIBE_BIN_WIDTH);
+    print_hist("EKF velocity test ratio", h.ratio[LOGSTATS_RATIO_VEL], LOGSTATS_RATIO_BINS, LOGSTATS_RATIO_BIN_WIDTH);
+    print_hist("EKF position test ratio", h.ratio[LOGSTATS_RATIO_POS], LOGSTATS_RATIO_BINS, LOGSTATS_RATIO_BIN_WIDTH);
+    print_hist("EKF height test ratio", h.ratio[LOGSTATS_RATIO_HGT], LOGSTATS_RATIO_BINS, LOGSTATS_RATIO_BIN_WIDTH);
+    print_hist("EKF magnetometer test ratio", h.ratio[LOGSTATS_RATIO_MAG], LOGSTATS_RATIO_BINS, LOGSTATS_RATIO_BIN_WIDTH);
+    print_hist("Compass interference (% of logs)", h.interference, FLEETSTATS_INTERFERENCE_BINS, 10);
+
+    ::printf("%u logs (%u incomplete, %u failed), %.1f flight hours, %u GPS glitches\n",
+             ok, incomplete, num_jobs - ok, hours, glitches);
+    ::printf("%.1f MB in %.2f s with %u threads: %.1f MB/s\n",
+             bytes / 1.0e6, elapsed_s, num_threads,
+             elapsed_s > 0 ? bytes / 1.0e6 / elapsed_s : 0);
+}
+
+void FleetStats::setup()
+{
+    uint8_t argc;
+    char * const *argv;
+
+    hal.util->commandline_arguments(argc, argv);
+
+    parse_command_line(argc, argv);
+
+    if (num_threads == 0) {
+        num_threads = constrain_int16(sysconf(_SC_NPROCESSORS_ONLN), 1, FLEETSTATS_MAX_THREADS);
+    }
+    if (num_threads > num_jobs) {
+        num_threads = num_jobs;
+    }
+
+    uint64_t start_us = hal.scheduler->micros64();
+
+    pthread_t threads[FLEETSTATS_MAX_THREADS];
+    for (uint8_t i=0; i<num_threads; i++) {
+        if (pthread_create(&threads[i], NULL, worker_thread, this) != 0) {
+            ::printf("Failed to start worker thread\n");
+            exit(1);
+        }
+    }
+    for (uint8_t i=0; i<num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    float elapsed_s = (hal.scheduler->micros64() - start_us) * 1.0e-6f;
+
+    if (csv_file != NULL) {
+        write_csv();
+    }
+    if (json_file != NULL) {
+        write_json();
+    }
+    print_summary(elapsed_s);
+    exit(0);
+}
+
+/*
+  compatibility with old pde style build
+ */
+void setup(void);
+void loop(void);
+
+void setup(void)
+{
+    fleetstats.setup();
+}
+void loop(void)
+{
+}
+
+AP_HAL_MAIN();
@@ -0,0 +1,353 @@
+#include "LogStats.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// cutoff of the low pass filter giving the vibration floor
+#define LOGSTATS_VIBE_FLOOR_HZ  5.0f
+
+// the first field of each message is its time, TimeMS in older logs
+const struct LogStats::msg_fields LogStats::used_fields[NUM_MSGS] = {
+    { "IMU",  { "TimeUS", "AccX", "AccY", "AccZ" } },
+    { "VIBE", { "TimeUS", "Clip0", "Clip1", "Clip2" } },
+    { "GPS",  { "TimeUS", "Status", "NSats", "HDop" } },
+    { "EKF4", { "TimeUS", "SV", "SP", "SH", "SMX", "SMY", "SMZ", "OFN", "EFE" } },
+    { "MAG",  { "TimeUS", "MagX", "MagY", "MagZ" } },
+    { "CURR", { "TimeUS", "Throttle", "Curr" } },
+};
+
+LogStats::LogStats() :
+    res(NULL),
+    bytes_read(0),
+    first_time_us(0),
+    last_time_us(0),
+    last_imu_time_us(0),
+    glitching(false),
+    last_current(0),
+    last_throttle(0),
+    mag_sum(0),
+    fit_n(0),
+    fit_sum_y(0)
+{
+    memset(handler, 0, sizeof(handler));
+    memset(type_id, 0, sizeof(type_id));
+    memset(field, -1, sizeof(field));
+    memset(accel_sum_sq, 0, sizeof(accel_sum_sq));
+    memset(fit_sum_x, 0, sizeof(fit_sum_x));
+    memset(fit_sum_xx, 0, sizeof(fit_sum_xx));
+    memset(fit_sum_xy, 0, sizeof(fit_sum_xy));
+    memset(fit_max_x, 0, sizeof(fit_max_x));
+    for (uint8_t i=0; i<NUM_MSGS; i++) {
+        time_scale[i] = 1;
+    }
+}
+
+LogStats::~LogStats()
+{
+    for (uint8_t i=0; i<NUM_MSGS; i++) {
+        delete handler[i];
+    }
+}
+
+bool LogStats::process(const char *logfile, struct result &_res)
+{
+    res = &_res;
+    memset(res, 0, sizeof(*res));
+    res->gps_min_sats = 255;
+    bytes_read = 0;
+
+    struct stat st;
+    if (!open_log(logfile)) {
+        return false;
+    }
+    if (fstat(fd, &st) == 0) {
+        res->bytes = st.st_size;
+    }
+
+    char type[5];
+    while (update(type)) {
+        // handle_msg does the work
+    }
+    ::close(fd);
+    fd = -1;
+    if (corrupt_log()) {
+        // the rest of the log can't be read, so skip it rather than
+        // count a part of it
+        return false;
+    }
+
+    // a log cut off mid message stops short of its end
+    res->complete = (bytes_read == res->bytes);
+    finish();
+    return true;
+}
+
+bool LogStats::handle_log_format_msg(const struct log_Format &f)
+{
+    bytes_read += sizeof(f);
+    for (uint8_t id=0; id<NUM_MSGS; id++) {
+        const char *name = used_fields[id].name;
+        if (handler[id] != NULL || strncmp(f.name, name, 4) != 0 ||
+            (strlen(name) < 4 && f.name[strlen(name)] != 0)) {
+            continue;
+        }
+        if (!MsgHandler::valid_format(f)) {
+            ::printf("Bad format for %s\n", used_fields[id].name);
+            continue;
+        }
+
+        MsgHandler *h = new MsgHandler(f);
+        bool have_all = true;
+        for (uint8_t i=0; i<LOGSTATS_MAX_USED_FIELDS && used_fields[id].labels[i] != NULL; i++) {
+            for (uint8_t j=0; j<h->num_fields(); j++) {
+                if (streq(h->field_label(j), used_fields[id].labels[i]) ||
+                    (i == 0 && streq(h->field_label(j), "TimeMS"))) {
+                    field[id][i] = j;
+                    if (i == 0 && streq(h->field_label(j), "TimeMS")) {
+                        time_scale[id] = 1000;
+                    }
+                }
+            }
+            if (field[id][i] < 0) {
+                have_all = false;
+            }
+        }
+        if (!have_all) {
+            // an older layout of the message
+            delete h;
+            memset(field[id], -1, sizeof(field[id]));
+            continue;
+        }
+        handler[id] = h;
+        type_id[id] = f.type;
+    }
+    return true;
+}
+
+float LogStats::value(uint8_t *msg, enum msg_id id, uint8_t i)
+{
+    float ret;
+    handler[id]->field_value_at(msg, field[id][i], ret);
+    return ret;
+}
+
+void LogStats::note_time(uint8_t *msg, enum msg_id id)
+{
+    uint64_t t;
+    handler[id]->field_value_at(msg, field[id][0], t);
+    t *= time_scale[id];
+    if (first_time_us == 0) {
+        first_time_us = t;
+    }
+    if (t > last_time_us) {
+        last_time_us = t;
+    }
+}
+
+bool LogStats::handle_msg(const struct log_Format &f, uint8_t *msg)
+{
+    bytes_read += f.length;
+    for (uint8_t id=0; id<NUM_MSGS; id++) {
+        if (handler[id] == NULL || type_id[id] != f.type) {
+            continue;
+        }
+        switch (id) {
+        case MSG_IMU:
+            handle_imu(msg);
+            break;
+        case MSG_VIBE:
+            handle_vibe(msg);
+            break;
+        case MSG_GPS:
+            handle_gps(msg);
+            break;
+        case MSG_EKF4:
+            handle_ekf4(msg);
+            break;
+        case MSG_MAG:
+            handle_mag(msg);
+            break;
+        case MSG_CURR:
+            handle_curr(msg);
+            break;
+        }
+        break;
+    }
+    return true;
+}
+
+/*
+  vibration is the deviation of the acceleration from its low passed
+  value
+ */
+void LogStats::handle_imu(uint8_t *msg)
+{
+    uint64_t time_us;
+    handler[MSG_IMU]->field_value_at(msg, field[MSG_IMU][0], time_us);
+    time_us *= time_scale[MSG_IMU];
+    note_time(msg, MSG_IMU);
+    Vector3f accel(value(msg, MSG_IMU, 1), value(msg, MSG_IMU, 2), value(msg, MSG_IMU, 3));
+
+    if (res->imu_samples == 0) {
+        accel_filt = accel;
+    } else {
+        float dt = (time_us - last_imu_time_us) * 1.0e-6f;
+        if (time_us <= last_imu_time_us || dt > 0.1f) {
+            dt = 0.0025f;
+        }
+        float rc = 1.0f/(2*M_PI_F*LOGSTATS_VIBE_FLOOR_HZ);
+        accel_filt += (accel - accel_filt) * (dt / (dt + rc));
+    }
+    res->imu_samples++;
+    last_imu_time_us = time_us;
+
+    Vector3f vibe = accel - accel_filt;
+    accel_sum_sq[0] += sq(vibe.x);
+    accel_sum_sq[1] += sq(vibe.y);
+    accel_sum_sq[2] += sq(vibe.z);
+
+    float vibe_length = vibe.length();
+    if (vibe_length > res->vibe_max) {
+        res->vibe_max = vibe_length;
+    }
+    uint8_t bin = min(vibe_length / LOGSTATS_VIBE_BIN_WIDTH, LOGSTATS_VIBE_BINS-1);
+    res->vibe_hist[bin]++;
+}
+
+void LogStats::handle_vibe(uint8_t *msg)
+{
+    note_time(msg, MSG_VIBE);
+
+    // the clip counts are totals since boot
+    for (uint8_t i=0; i<3; i++) {
+        uint32_t clip;
+        handler[MSG_VIBE]->field_value_at(msg, field[MSG_VIBE][1+i], clip);
+        if (clip > res->clip_count[i]) {
+            res->clip_count[i] = clip;
+        }
+    }
+}
+
+void LogStats::handle_gps(uint8_t *msg)
+{
+    note_time(msg, MSG_GPS);
+
+    // only 3D fixes
+    if (value(msg, MSG_GPS, 1) < 3) {
+        return;
+    }
+    res->gps_samples++;
+    uint8_t sats = value(msg, MSG_GPS, 2);
+    if (sats < res->gps_min_sats) {
+        res->gps_min_sats = sats;
+    }
+    float hdop = value(msg, MSG_GPS, 3) * 0.01f;
+    if (hdop > res->gps_max_hdop) {
+        res->gps_max_hdop = hdop;
+    }
+}
+
+/*
+  EKF4 has the square roots of the innovation test ratios, times 100,
+  and the offset the EKF applies to GPS positions during a glitch
+ */
+void LogStats::handle_ekf4(uint8_t *msg)
+{
+    note_time(msg, MSG_EKF4);
+    res->ekf_samples++;
+
+    float ratio[LOGSTATS_NUM_RATIOS];
+    ratio[LOGSTATS_RATIO_VEL] = value(msg, MSG_EKF4, 1) * 0.01f;
+    ratio[LOGSTATS_RATIO_POS] = value(msg, MSG_EKF4, 2) * 0.01f;
+    ratio[LOGSTATS_RATIO_HGT] = value(msg, MSG_EKF4, 3) * 0.01f;
+    ratio[LOGSTATS_RATIO_MAG] = max(value(msg, MSG_EKF4, 4),
+                                    max(value(msg, MSG_EKF4, 5), value(msg, MSG_EKF4, 6))) * 0.01f;
+    for (uint8_t i=0; i<LOGSTATS_NUM_RATIOS; i++) {
+        if (ratio[i] > res->ratio_max[i]) {
+            res->ratio_max[i] = ratio[i];
+        }
+        if (ratio[i] > 1.0f) {
+            res->ratio_over_gate[i]++;
+        }
+        uint8_t bin = min(max(ratio[i], 0) / LOGSTATS_RATIO_BIN_WIDTH, LOGSTATS_RATIO_BINS-1);
+        res->ratio_hist[i][bin]++;
+    }
+
+    float offset = pythagorous2(value(msg, MSG_EKF4, 7), value(msg, MSG_EKF4, 8));
+    if (offset > 0) {
+        res->glitch_samples++;
+        if (!glitching) {
+            res->glitch_count++;
+        }
+        if (offset > res->glitch_max_offset) {
+            res->glitch_max_offset = offset;
+        }
+    }
+    glitching = offset > 0;
+}
+
+/*
+  the field length is fitted against the last current and throttle
+  seen, as a straight line
+ */
+void LogStats::handle_mag(uint8_t *msg)
+{
+    note_time(msg, MSG_MAG);
+    res->mag_samples++;
+
+    float field_length = pythagorous3(value(msg, MSG_MAG, 1), value(msg, MSG_MAG, 2), value(msg, MSG_MAG, 3));
+    mag_sum += field_length;
+
+    if (handler[MSG_CURR] == NULL) {
+        return;
+    }
+    const float x[2] = { last_current, last_throttle };
+    fit_n++;
+    fit_sum_y += field_length;
+    for (uint8_t i=0; i<2; i++) {
+        fit_sum_x[i] += x[i];
+        fit_sum_xx[i] += x[i] * x[i];
+        fit_sum_xy[i] += x[i] * field_length;
+        if (x[i] > fit_max_x[i]) {
+            fit_max_x[i] = x[i];
+        }
+    }
+}
+
+void LogStats::handle_curr(uint8_t *msg)
+{
+    note_time(msg, MSG_CURR);
+    last_throttle = value(msg, MSG_CURR, 1) * 0.001f;
+    last_current = value(msg, MSG_CURR, 2) * 0.01f;
+}
+
+void LogStats::finish(void)
+{
+    if (last_time_us > first_time_us) {
+        res->duration_s = (last_time_us - first_time_us) * 1.0e-6f;
+    }
+
+    if (res->imu_samples > 0) {
+        for (uint8_t i=0; i<3; i++) {
+            res->vibe_rms[i] = sqrt(accel_sum_sq[i] / res->imu_samples);
+        }
+    }
+    if (res->gps_samples == 0) {
+        res->gps_min_sats = 0;
+    }
+
+    if (res->mag_samples > 0) {
+        res->mag_field_mean = mag_sum / res->mag_samples;
+    }
+
+    // with a current sensor fit against current, otherwise throttle
+    uint8_t i = fit_max_x[0] > 1.0f ? 0 : 1;
+    res->mag_per_amp = (i == 0);
+    double denom = fit_n * fit_sum_xx[i] - fit_sum_x[i] * fit_sum_x[i];
+    if (fit_n > 1 && denom > 0 && res->mag_field_mean > 0) {
+        res->mag_slope = (fit_n * fit_sum_xy[i] - fit_sum_x[i] * fit_sum_y) / denom;
+        res->mag_interference_pct = 100 * fabsf(res->mag_slope) * fit_max_x[i] / res->mag_field_mean;
+    }
+}
@@ -0,0 +1,145 @@
+#ifndef FLEETSTATS_LOGSTATS_H
+#define FLEETSTATS_LOGSTATS_H
+
+/*
+  statistics of one DataFlash log, gathered in a single pass
+
+  - vibration: deviation of the IMU accelerations from their low
+    passed value, and the clipping counts of VIBE where it is logged
+  - GPS glitches: the glitch offsets of EKF4, and GPS HDop/NSats
+  - EKF innovations: the velocity, position, height and magnetometer
+    test ratios of EKF4
+  - compass interference: change of the MAG field length per amp of
+    CURR current, or per unit of throttle without a current sensor
+
+  Only the message types used are decoded, so a damaged format of
+  another type does not stop the analysis.
+ */
+
+#include <DataFlashFileReader.h>
+#include <MsgHandler.h>
+
+// histograms shared by the per log and fleet results
+#define LOGSTATS_VIBE_BINS      20      // 0.5 m/s/s wide
+#define LOGSTATS_VIBE_BIN_WIDTH 0.5f
+#define LOGSTATS_RATIO_BINS     20      // 0.1 wide
+#define LOGSTATS_RATIO_BIN_WIDTH 0.1f
+
+// EKF4 test ratios
+enum logstats_ratio {
+    LOGSTATS_RATIO_VEL = 0,
+    LOGSTATS_RATIO_POS,
+    LOGSTATS_RATIO_HGT,
+    LOGSTATS_RATIO_MAG,
+    LOGSTATS_NUM_RATIOS
+};
+
+class LogStats : public DataFlashFileReader
+{
+public:
+    // the results, which are plain data so the fleet totals can be
+    // summed from them
+    struct result {
+        uint64_t bytes;
+        float duration_s;
+        bool complete;              // read to the end without error
+
+        // vibration
+        uint32_t imu_samples;
+        float vibe_rms[3];          // m/s/s
+        float vibe_max;
+        uint32_t clip_count[3];
+        uint32_t vibe_hist[LOGSTATS_VIBE_BINS];
+
+        // GPS
+        uint32_t gps_samples;
+        uint8_t gps_min_sats;
+        float gps_max_hdop;
+        uint32_t glitch_samples;
+        uint32_t glitch_count;
+        float glitch_max_offset;    // m
+
+        // EKF innovations
+        uint32_t ekf_samples;
+        float ratio_max[LOGSTATS_NUM_RATIOS];
+        uint32_t ratio_over_gate[LOGSTATS_NUM_RATIOS];
+        uint32_t ratio_hist[LOGSTATS_NUM_RATIOS][LOGSTATS_RATIO_BINS];
+
+        // compass interference
+        uint32_t mag_samples;
+        float mag_field_mean;       // milligauss
+        float mag_slope;            // milligauss per amp or per throttle
+        float mag_interference_pct; // at the highest current or full throttle
+        bool mag_per_amp;
+    };
+
+    LogStats();
+    ~LogStats();
+
+    // read the whole log. Returns false if it could not be opened, or
+    // holds a message of unknown format so it could not be read to the end
+    bool process(const char *logfile, struct result &res);
+
+    bool handle_log_format_msg(const struct log_Format &f);
+    bool handle_msg(const struct log_Format &f, uint8_t *msg);
+
+private:
+    enum msg_id {
+        MSG_IMU = 0,
+        MSG_VIBE,
+        MSG_GPS,
+        MSG_EKF4,
+        MSG_MAG,
+        MSG_CURR,
+        NUM_MSGS
+    };
+
+    // the fields used, by message
+#define LOGSTATS_MAX_USED_FIELDS 9
+    struct msg_fields {
+        const char *name;
+        const char *labels[LOGSTATS_MAX_USED_FIELDS];
+    };
+    static const struct msg_fields used_fields[NUM_MSGS];
+
+    MsgHandler *handler[NUM_MSGS];
+    uint8_t type_id[NUM_MSGS];
+    int8_t field[NUM_MSGS][LOGSTATS_MAX_USED_FIELDS];
+    uint32_t time_scale[NUM_MSGS];     // to microseconds, for TimeMS logs
+
+    struct result *res;
+    uint64_t bytes_read;        // in whole messages
+
+    uint64_t first_time_us;
+    uint64_t last_time_us;
+    uint64_t last_imu_time_us;
+
+    Vector3f accel_filt;
+    double accel_sum_sq[3];
+    bool glitching;
+
+    // linear fit of field length against current or throttle
+    float last_current;
+    float last_throttle;
+    double mag_sum;
+    double fit_n;
+    double fit_sum_y;
+    double fit_sum_x[2];
+    double fit_sum_xx[2];
+    double fit_sum_xy[2];
+    float fit_max_x[2];
+
+    float value(uint8_t *msg, enum msg_id id, uint8_t i);
+    void note_time(uint8_t *msg, enum msg_id id);
+
+    void handle_imu(uint8_t *msg);
+    void handle_vibe(uint8_t *msg);
+    void handle_gps(uint8_t *msg);
+    void handle_ekf4(uint8_t *msg);
+    void handle_mag(uint8_t *msg);
+    void handle_curr(uint8_t *msg);
+
+    void finish(void);
+};
+
+#endif
@@ -0,0 +1,3 @@
+// the sketch build only compiles sources in the sketch directory, so
+// the Replay sources LogStats is built on are included from here
+#include "../Replay/MsgHandler.cpp"
@@ -0,0 +1,476 @@
+#include "LogIndex.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define LOGINDEX_MAGIC   "LQIX"
+#define LOGINDEX_VERSION 1
+
+LogIndex::LogIndex() :
+    _last_time_us(0),
+    _build_error(false),
+    _strings(NULL),
+    _strings_length(0),
+    _strings_capacity(0),
+    _map(NULL),
+    _map_length(0),
+    _types(NULL),
+    _num_types(0),
+    _map_strings(NULL),
+    _map_strings_length(0)
+{
+    memset(_builders, 0, sizeof(_builders));
+}
+
+LogIndex::~LogIndex()
+{
+    close();
+}
+
+bool LogIndex::open(const char *logfile, bool rebuild)
+{
+    close();
+
+    struct stat st;
+    if (stat(logfile, &st) != 0) {
+        perror(logfile);
+        return false;
+    }
+
+    char cachefile[strlen(logfile) + strlen(LOGINDEX_CACHE_SUFFIX) + 1];
+    strcpy(cachefile, logfile);
+    strcat(cachefile, LOGINDEX_CACHE_SUFFIX);
+
+    if (!rebuild && map_cache(cachefile, st.st_size, st.st_mtime)) {
+        return true;
+    }
+    if (!build(logfile, cachefile)) {
+        return false;
+    }
+    return map_cache(cachefile, st.st_size, st.st_mtime);
+}
+
+void LogIndex::close(void)
+{
+    if (_map != NULL) {
+        munmap(_map, _map_length);
+        _map = NULL;
+    }
+    _map_length = 0;
+    _types = NULL;
+    _num_types = 0;
+    _map_strings = NULL;
+    _map_strings_length = 0;
+}
+
+/*
+  scan the log and write the cache file
+ */
+bool LogIndex::build(const char *logfile, const char *cachefile)
+{
+    struct stat st;
+
+    if (!open_log(logfile)) {
+        perror(logfile);
+        return false;
+    }
+    if (fstat(fd, &st) != 0) {
+        perror(logfile);
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    _last_time_us = 0;
+    _build_error = false;
+    memset(formats, 0, sizeof(formats));
+
+    char type[5];
+    while (update(type)) {
+        // nothing to do, the handlers store the rows
+    }
+    ::close(fd);
+    fd = -1;
+
+    // don't cache the index of a log that could only be part read
+    bool ret = !_build_error && !corrupt_log() && write_cache(cachefile, st.st_size, st.st_mtime);
+    free_builders();
+    return ret;
+}
+
+bool LogIndex::handle_log_format_msg(const struct log_Format &f)
+{
+    if (_builders[f.type] != NULL) {
+        // a repeated format, keep the first one
+        return true;
+    }
+
+    if (!MsgHandler::valid_format(f)) {
+        // e.g. a field type MsgHandler cannot decode. The messages
+        // are still skipped by their length, so the rest of the log
+        // is indexed
+        ::printf("Skipping %.4s: unsupported format (%.16s)\n", f.name, f.format);
+        return true;
+    }
+
+    struct builder *b = (struct builder *)calloc(1, sizeof(struct builder));
+    if (b == NULL) {
+        _build_error = true;
+        return false;
+    }
+    b->handler = new MsgHandler(f);
+    b->meta.type = f.type;
+    strncpy(b->meta.name, f.name, 4);
+    strncpy(b->meta.format, f.format, 16);
+    strncpy(b->meta.labels, f.labels, 64);
+    b->meta.num_fields = b->handler->num_fields();
+    b->meta.time_sorted = 1;
+
+    // the time base of the message, if it has one
+    b->time_field = -1;
+    for (uint8_t i=0; i<b->meta.num_fields; i++) {
+        if (streq(b->handler->field_label(i), "TimeUS")) {
+            b->time_field = i;
+            b->time_scale = 1;
+        } else if (streq(b->handler->field_label(i), "TimeMS")) {
+            b->time_field = i;
+            b->time_scale = 1000;
+        }
+    }
+
+    _builders[f.type] = b;
+    return true;
+}
+
+bool LogIndex::handle_msg(const struct log_Format &f, uint8_t *msg)
+{
+    struct builder *b = _builders[f.type];
+    if (b == NULL) {
+        return true;
+    }
+
+    if (b->meta.num_rows == b->capacity) {
+        uint64_t capacity = b->capacity ? b->capacity*2 : 1024;
+        uint64_t *time = (uint64_t *)realloc(b->time, capacity*sizeof(uint64_t));
+        if (time == NULL) {
+            ::printf("Out of memory indexing %s\n", b->meta.name);
+            _build_error = true;
+            return false;
+        }
+        b->time = time;
+        for (uint8_t i=0; i<b->meta.num_fields; i++) {
+            double *column = (double *)realloc(b->columns[i], capacity*sizeof(double));
+            if (column == NULL) {
+                ::printf("Out of memory indexing %s\n", b->meta.name);
+                _build_error = true;
+                return false;
+            }
+            b->columns[i] = column;
+        }
+        b->capacity = capacity;
+    }
+
+    uint64_t row = b->meta.num_rows;
+
+    if (b->time_field >= 0) {
+        uint64_t t;
+        b->handler->field_value_at(msg, b->time_field, t);
+        _last_time_us = t * b->time_scale;
+    }
+    if (row > 0 && _last_time_us < b->time[row-1]) {
+        b->meta.time_sorted = 0;
+    }
+    b->time[row] = _last_time_us;
+
+    for (uint8_t i=0; i<b->meta.num_fields; i++) {
+        switch (b->handler->field_type(i)) {
+        case 'n':
+        case 'N':
+        case 'Z': {
+            uint64_t ofs;
+            if (!add_string((const char *)&msg[b->handler->field_offset(i)],
+                            b->handler->field_length(i), ofs)) {
+                return false;
+            }
+            b->columns[i][row] = ofs;
+            break;
+        }
+        default:
+            b->handler->field_value_at(msg, i, b->columns[i][row]);
+            break;
+        }
+    }
+
+    b->meta.num_rows++;
+    return true;
+}
+
+/*
+  append a string field to the string table, which holds nul
+  terminated strings
+ */
+bool LogIndex::add_string(const char *s, uint8_t len, uint64_t &ofs)
+{
+    uint8_t n = strnlen(s, len);
+    if (_strings_length + n + 1 > _strings_capacity) {
+        uint64_t capacity = _strings_capacity ? _strings_capacity*2 : 65536;
+        char *strings = (char *)realloc(_strings, capacity);
+        if (strings == NULL) {
+            ::printf("Out of memory indexing strings\n");
+            _build_error = true;
+            return false;
+        }
+        _strings = strings;
+        _strings_capacity = capacity;
+    }
+    ofs = _strings_length;
+    memcpy(&_strings[_strings_length], s, n);
+    _strings[_strings_length + n] = 0;
+    _strings_length += n + 1;
+    return true;
+}
+
+/*
+  write the cache file: the header, the table of message types, the
+  columns of each type and the string table. It is written under a
+  temporary name and renamed, so concurrent queries of the same log
+  never see a partial file
+ */
+bool LogIndex::write_cache(const char *cachefile, uint64_t log_size, int64_t log_mtime)
+{
+    struct cache_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, LOGINDEX_MAGIC, 4);
+    hdr.version = LOGINDEX_VERSION;
+    hdr.log_size = log_size;
+    hdr.log_mtime = log_mtime;
+
+    for (uint16_t i=0; i<256; i++) {
+        if (_builders[i] != NULL && _builders[i]->meta.num_rows > 0) {
+            hdr.num_types++;
+        }
+    }
+
+    uint64_t ofs = sizeof(hdr) + hdr.num_types * sizeof(struct msg_type);
+    for (uint16_t i=0; i<256; i++) {
+        struct builder *b = _builders[i];
+        if (b == NULL || b->meta.num_rows == 0) {
+            continue;
+        }
+        b->meta.data_offset = ofs;
+        ofs += b->meta.num_rows * sizeof(uint64_t) * (1 + b->meta.num_fields);
+    }
+    hdr.strings_offset = ofs;
+    hdr.strings_length = _strings_length;
+
+    char tmpfile[strlen(cachefile) + 16];
+    snprintf(tmpfile, sizeof(tmpfile), "%s.%u", cachefile, (unsigned)getpid());
+
+    FILE *f = fopen(tmpfile, "w");
+    if (f == NULL) {
+        perror(tmpfile);
+        return false;
+    }
+
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    for (uint16_t i=0; ok && i<256; i++) {
+        struct builder *b = _builders[i];
+        if (b != NULL && b->meta.num_rows > 0) {
+            ok = fwrite(&b->meta, sizeof(b->meta), 1, f) == 1;
+        }
+    }
+    for (uint16_t i=0; ok && i<256; i++) {
+        struct builder *b = _builders[i];
+        if (b == NULL || b->meta.num_rows == 0) {
+            continue;
+        }
+        ok = fwrite(b->time, sizeof(uint64_t), b->meta.num_rows, f) == b->meta.num_rows;
+        for (uint8_t j=0; ok && j<b->meta.num_fields; j++) {
+            ok = fwrite(b->columns[j], sizeof(double), b->meta.num_rows, f) == b->meta.num_rows;
+        }
+    }
+    if (ok && _strings_length > 0) {
+        ok = fwrite(_strings, 1, _strings_length, f) == _strings_length;
+    }
+    if (fclose(f) != 0) {
+        ok = false;
+    }
+
+    if (!ok || rename(tmpfile, cachefile) != 0) {
+        perror(cachefile);
+        unlink(tmpfile);
+        return false;
+    }
+    return true;
+}
+
+/*
+  map a cache file, checking that it is for this version of the log
+ */
+bool LogIndex::map_cache(const char *cachefile, uint64_t log_size, int64_t log_mtime)
+{
+    int cfd = ::open(cachefile, O_RDONLY);
+    if (cfd == -1) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(cfd, &st) != 0 || (size_t)st.st_size < sizeof(struct cache_header)) {
+        ::close(cfd);
+        return false;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, cfd, 0);
+    ::close(cfd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    const struct cache_header *hdr = (const struct cache_header *)map;
+    if (memcmp(hdr->magic, LOGINDEX_MAGIC, 4) != 0 ||
+        hdr->version != LOGINDEX_VERSION ||
+        hdr->log_size != log_size ||
+        hdr->log_mtime != log_mtime ||
+        hdr->strings_offset + hdr->strings_length != (uint64_t)st.st_size) {
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    _map = (uint8_t *)map;
+    _map_length = st.st_size;
+    _num_types = hdr->num_types;
+    _types = (const struct msg_type *)&_map[sizeof(struct cache_header)];
+    _map_strings = (const char *)&_map[hdr->strings_offset];
+    _map_strings_length = hdr->strings_length;
+    return true;
+}
+
+void LogIndex::free_builders(void)
+{
+    for (uint16_t i=0; i<256; i++) {
+        struct builder *b = _builders[i];
+        if (b == NULL) {
+            continue;
+        }
+        delete b->handler;
+        free(b->time);
+        for (uint8_t j=0; j<LOGREADER_MAX_FIELDS; j++) {
+            free(b->columns[j]);
+        }
+        free(b);
+        _builders[i] = NULL;
+    }
+    free(_strings);
+    _strings = NULL;
+    _strings_length = 0;
+    _strings_capacity = 0;
+}
+
+const struct LogIndex::msg_type *LogIndex::find_type(const char *name) const
+{
+    for (uint32_t i=0; i<_num_types; i++) {
+        if (strncmp(_types[i].name, name, 4) == 0 && strlen(name) <= 4) {
+            return &_types[i];
+        }
+    }
+    return NULL;
+}
+
+int16_t LogIndex::find_field(const struct msg_type &t, const char *label) const
+{
+    char buf[32];
+    for (uint8_t i=0; i<t.num_fields; i++) {
+        field_label(t, i, buf, sizeof(buf));
+        if (streq(buf, label)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void LogIndex::field_label(const struct msg_type &t, uint8_t field, char *label, uint8_t len) const
+{
+    const char *p = t.labels;
+    for (uint8_t i=0; i<field && p != NULL; i++) {
+        p = strchr(p, ',');
+        if (p != NULL) {
+            p++;
+        }
+    }
+    if (p == NULL) {
+        label[0] = 0;
+        return;
+    }
+    uint8_t n = 0;
+    while (p[n] != 0 && p[n] != ',' && n < len-1) {
+        label[n] = p[n];
+        n++;
+    }
+    label[n] = 0;
+}
+
+const uint64_t *LogIndex::time_column(const struct msg_type &t) const
+{
+    return (const uint64_t *)&_map[t.data_offset];
+}
+
+const double *LogIndex::column(const struct msg_type &t, uint8_t field) const
+{
+    return (const double *)&_map[t.data_offset + (1 + field) * t.num_rows * sizeof(uint64_t)];
+}
+
+void LogIndex::time_range(const struct msg_type &t, uint64_t t0_us, uint64_t t1_us,
+                          uint64_t &first, uint64_t &last) const
+{
+    first = 0;
+    last = t.num_rows;
+    if (!t.time_sorted) {
+        return;
+    }
+
+    const uint64_t *time = time_column(t);
+
+    // first row with time >= t0_us
+    uint64_t lo = 0, hi = t.num_rows;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (time[mid] < t0_us) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    first = lo;
+
+    // first row with time > t1_us
+    hi = t.num_rows;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (time[mid] <= t1_us) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    last = lo;
+}
+
+bool LogIndex::is_string_field(const struct msg_type &t, uint8_t field) const
+{
+    char type = t.format[field];
+    return type == 'n' || type == 'N' || type == 'Z';
+}
+
+const char *LogIndex::string_value(double v) const
+{
+    uint64_t ofs = v;
+    if (ofs >= _map_strings_length) {
+        return "";
+    }
+    return &_map_strings[ofs];
+}
@@ -0,0 +1,121 @@
+#ifndef LOGQUERY_LOGINDEX_H
+#define LOGQUERY_LOGINDEX_H
+
+/*
+  columnar index of a DataFlash log
+
+  The log is scanned once with MsgHandler and every field of every
+  message type is stored as a column of doubles, next to a column of
+  timestamps in microseconds. Messages without a time field take the
+  time of the last message that had one. The columns are written to a
+  cache file beside the log, which later runs map into memory, so only
+  the first query of a log pays for parsing it.
+ */
+
+#include <DataFlashFileReader.h>
+#include <MsgHandler.h>
+
+#define LOGINDEX_CACHE_SUFFIX ".lqi"
+
+class LogIndex : public DataFlashFileReader
+{
+public:
+    LogIndex();
+    ~LogIndex();
+
+    // a message type in the index. The layout is that of the cache file
+    struct msg_type {
+        char name[8];
+        char format[24];
+        char labels[72];
+        uint64_t num_rows;
+        uint64_t data_offset;   // time column then field columns
+        uint8_t type;
+        uint8_t num_fields;
+        uint8_t time_sorted;    // time column never goes backwards
+        uint8_t pad[5];
+    };
+
+    // open the index of a log, building the cache file when it is
+    // missing, stale or rebuild is set
+    bool open(const char *logfile, bool rebuild);
+
+    // release the index
+    void close(void);
+
+    // message types in the log
+    uint32_t num_types(void) const { return _num_types; }
+    const struct msg_type &get_type(uint32_t i) const { return _types[i]; }
+
+    // find a message type by name, NULL if it is not in the log
+    const struct msg_type *find_type(const char *name) const;
+
+    // index of a field of a message type, -1 if there is no such field
+    int16_t find_field(const struct msg_type &t, const char *label) const;
+
+    // label of a field
+    void field_label(const struct msg_type &t, uint8_t field, char *label, uint8_t len) const;
+
+    // the columns of a message type
+    const uint64_t *time_column(const struct msg_type &t) const;
+    const double *column(const struct msg_type &t, uint8_t field) const;
+
+    // the rows with time_us within t0_us..t1_us are in [first, last).
+    // When the time column is not sorted the range covers all rows and
+    // each row has to be checked
+    void time_range(const struct msg_type &t, uint64_t t0_us, uint64_t t1_us,
+                    uint64_t &first, uint64_t &last) const;
+
+    // string fields hold an offset into the string table
+    bool is_string_field(const struct msg_type &t, uint8_t field) const;
+    const char *string_value(double v) const;
+
+    bool handle_log_format_msg(const struct log_Format &f);
+    bool handle_msg(const struct log_Format &f, uint8_t *msg);
+
+private:
+    struct cache_header {
+        char magic[4];
+        uint32_t version;
+        uint64_t log_size;
+        int64_t log_mtime;
+        uint32_t num_types;
+        uint32_t pad;
+        uint64_t strings_offset;
+        uint64_t strings_length;
+    };
+
+    // columns of a message type while the log is scanned
+    struct builder {
+        MsgHandler *handler;
+        struct msg_type meta;
+        int16_t time_field;
+        uint32_t time_scale;
+        uint64_t capacity;
+        uint64_t *time;
+        double *columns[LOGREADER_MAX_FIELDS];
+    };
+
+    bool build(const char *logfile, const char *cachefile);
+    bool write_cache(const char *cachefile, uint64_t log_size, int64_t log_mtime);
+    bool map_cache(const char *cachefile, uint64_t log_size, int64_t log_mtime);
+    void free_builders(void);
+    bool add_string(const char *s, uint8_t len, uint64_t &ofs);
+
+    struct builder *_builders[256];
+    uint64_t _last_time_us;
+    bool _build_error;
+    char *_strings;
+    uint64_t _strings_length;
+    uint64_t _strings_capacity;
+
+    // the mapped cache
+    uint8_t *_map;
+    size_t _map_length;
+    const struct msg_type *_types;
+    uint32_t _num_types;
+    const char *_map_strings;
+    uint64_t _map_strings_length;
+};
+
+#endif
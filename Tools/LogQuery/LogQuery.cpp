@@ -0,0 +1,297 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+  query DataFlash logs through a columnar index
+
+  The first query of a log builds LOG.lqi beside it (see LogIndex.h),
+  later queries of the same log only map that file. Examples:
+
+    LogQuery 00000012.BIN                       message types in the log
+    LogQuery -q ERR *.BIN                       all ERR messages
+    LogQuery -q IMU.AccX -s 120 -e 130 12.BIN   IMU.AccX from 120s to 130s
+ */
+
+#include <AP_Common.h>
+#include <AP_Progmem.h>
+#include <AP_Param.h>
+#include <StorageManager.h>
+#include <AP_Math.h>
+#include <AP_HAL.h>
+#include <AP_HAL_AVR.h>
+#include <AP_HAL_SITL.h>
+#include <AP_HAL_Linux.h>
+#include <AP_HAL_Empty.h>
+#include <AP_ADC.h>
+#include <AP_Declination.h>
+#include <AP_ADC_AnalogSource.h>
+#include <Filter.h>
+#include <AP_Buffer.h>
+#include <AP_Airspeed.h>
+#include <AP_Vehicle.h>
+#include <AP_Notify.h>
+#include <DataFlash.h>
+#include <GCS_MAVLink.h>
+#include <AP_GPS.h>
+#include <AP_AHRS.h>
+#include <SITL.h>
+#include <AP_Compass.h>
+#include <AP_Baro.h>
+#include <AP_InertialSensor.h>
+#include <AP_InertialNav.h>
+#include <AP_NavEKF.h>
+#include <AP_Mission.h>
+#include <AP_Rally.h>
+#include <AP_BattMonitor.h>
+#include <AP_Terrain.h>
+#include <AP_OpticalFlow.h>
+#include <AP_SerialManager.h>
+#include <RC_Channel.h>
+#include <AP_RangeFinder.h>
+#include <stdio.h>
+#include <getopt.h> // for optind only
+#include <utility/getopt_cpp.h>
+#include "LogIndex.h"
+
+const AP_HAL::HAL& hal = AP_HAL_BOARD_DRIVER;
+
+class LogQuery {
+public:
+    LogQuery() :
+        query(NULL),
+        start_us(0),
+        end_us(UINT64_MAX),
+        rebuild(false),
+        count_only(false),
+        num_logs(0),
+        logs(NULL)
+        {}
+
+    void setup();
+
+private:
+    LogIndex index;
+
+    const char *query;
+    uint64_t start_us;
+    uint64_t end_us;
+    bool rebuild;
+    bool count_only;
+    uint8_t num_logs;
+    char * const *logs;
+
+    void usage(void);
+    void parse_command_line(uint8_t argc, char * const argv[]);
+    void list_types(const char *prefix);
+    bool run_query(const char *prefix);
+    void print_row(const char *prefix, const LogIndex::msg_type &t, uint64_t row, int16_t field);
+};
+
+static LogQuery logquery;
+
+void LogQuery::usage(void)
+{
+    ::printf("Options:\n");
+    ::printf("\t--query TYPE[.FIELD] print a message type, or one field of it\n");
+    ::printf("\t--start SECONDS      only rows at or after this time since boot\n");
+    ::printf("\t--end SECONDS        only rows at or before this time since boot\n");
+    ::printf("\t--count              print the number of matching rows only\n");
+    ::printf("\t--rebuild            rebuild the index even if it is up to date\n");
+    ::printf("Without --query the message types in each log are listed\n");
+}
+
+void LogQuery::parse_command_line(uint8_t argc, char * const argv[])
+{
+    const struct GetOptLong::option options[] = {
+        {"query",           true,   0, 'q'},
+        {"start",           true,   0, 's'},
+        {"end",             true,   0, 'e'},
+        {"count",           false,  0, 'c'},
+        {"rebuild",         false,  0, 'r'},
+        {"help",            false,  0, 'h'},
+        {0, false, 0, 0}
+    };
+
+    GetOptLong gopt(argc, argv, "q:s:e:crh", options);
+    gopt.optind = optind;
+
+    int opt;
+    while ((opt = gopt.getoption()) != -1) {
+        switch (opt) {
+        case 'q':
+            query = gopt.optarg;
+            break;
+
+        case 's':
+            start_us = atof(gopt.optarg) * 1.0e6;
+            break;
+
+        case 'e':
+            end_us = atof(gopt.optarg) * 1.0e6;
+            break;
+
+        case 'c':
+            count_only = true;
+            break;
+
+        case 'r':
+            rebuild = true;
+            break;
+
+        case 'h':
+        default:
+            usage();
+            exit(opt == 'h' ? 0 : 1);
+        }
+    }
+
+    argv += gopt.optind;
+    argc -= gopt.optind;
+
+    if (argc == 0) {
+        usage();
+        exit(1);
+    }
+    num_logs = argc;
+    logs = argv;
+}
+
+void LogQuery::list_types(const char *prefix)
+{
+    for (uint32_t i=0; i<index.num_types(); i++) {
+        const LogIndex::msg_type &t = index.get_type(i);
+        ::printf("%s%-4s %8llu  %s%s\n",
+                 prefix, t.name, (unsigned long long)t.num_rows, t.labels,
+                 t.time_sorted ? "" : "  (time not monotonic)");
+    }
+}
+
+void LogQuery::print_row(const char *prefix, const LogIndex::msg_type &t, uint64_t row, int16_t field)
+{
+    ::printf("%s%llu", prefix, (unsigned long long)index.time_column(t)[row]);
+    for (uint8_t i=0; i<t.num_fields; i++) {
+        if (field >= 0 && i != field) {
+            continue;
+        }
+        double v = index.column(t, i)[row];
+        if (index.is_string_field(t, i)) {
+            ::printf(",%s", index.string_value(v));
+        } else {
+            ::printf(",%.9g", v);
+        }
+    }
+    ::printf("\n");
+}
+
+bool LogQuery::run_query(const char *prefix)
+{
+    char type_name[8];
+    const char *dot = strchr(query, '.');
+    size_t len = dot ? (size_t)(dot - query) : strlen(query);
+    if (len >= sizeof(type_name)) {
+        ::printf("Bad message type in (%s)\n", query);
+        return false;
+    }
+    memcpy(type_name, query, len);
+    type_name[len] = 0;
+
+    const LogIndex::msg_type *t = index.find_type(type_name);
+    if (t == NULL) {
+        // not in this log, which is not an error when querying many logs
+        if (count_only) {
+            ::printf("%s0\n", prefix);
+        }
+        return true;
+    }
+
+    int16_t field = -1;
+    if (dot != NULL) {
+        field = index.find_field(*t, dot+1);
+        if (field < 0) {
+            ::printf("No field (%s) in %s; options are (%s)\n", dot+1, t->name, t->labels);
+            return false;
+        }
+    }
+
+    uint64_t first, last;
+    index.time_range(*t, start_us, end_us, first, last);
+    const uint64_t *time = index.time_column(*t);
+    uint64_t count = 0;
+    for (uint64_t row=first; row<last; row++) {
+        if (time[row] < start_us || time[row] > end_us) {
+            continue;
+        }
+        count++;
+        if (!count_only) {
+            print_row(prefix, *t, row, field);
+        }
+    }
+    if (count_only) {
+        ::printf("%s%llu\n", prefix, (unsigned long long)count);
+    }
+    return true;
+}
+
+void LogQuery::setup()
+{
+    uint8_t argc;
+    char * const *argv;
+
+    hal.util->commandline_arguments(argc, argv);
+
+    parse_command_line(argc, argv);
+
+    bool ok = true;
+    for (uint8_t i=0; i<num_logs; i++) {
+        const char *filename = logs[i];
+        if (!index.open(filename, rebuild)) {
+            ::printf("Failed to index %s\n", filename);
+            ok = false;
+            continue;
+        }
+
+        // with more than one log each line starts with the log it is from
+        char prefix[strlen(filename) + 2];
+        prefix[0] = 0;
+        if (num_logs > 1) {
+            snprintf(prefix, sizeof(prefix), "%s,", filename);
+        }
+
+        if (query == NULL) {
+            list_types(prefix);
+        } else if (!run_query(prefix)) {
+            ok = false;
+        }
+        index.close();
+    }
+    exit(ok ? 0 : 1);
+}
+
+/*
+  compatibility with old pde style build
+ */
+void setup(void);
+void loop(void);
+
+void setup(void)
+{
+    logquery.setup();
+}
+void loop(void)
+{
+}
+
+AP_HAL_MAIN();
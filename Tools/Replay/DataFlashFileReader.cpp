@@ -6,7 +6,12 @@
 #include <stdio.h>
 #include <unistd.h>
 
-DataFlashFileReader::DataFlashFileReader() : fd(-1) {}
+DataFlashFileReader::DataFlashFileReader() :
+    fd(-1),
+    corrupt(false),
+    buffer_offset(0),
+    buffer_len(0)
+{}
 
 bool DataFlashFileReader::open_log(const char *logfile)
 {
@@ -14,13 +19,44 @@ bool DataFlashFileReader::open_log(const char *logfile)
     if (fd == -1) {
         return false;
     }
+    corrupt = false;
+    buffer_offset = 0;
+    buffer_len = 0;
+#ifdef POSIX_FADV_SEQUENTIAL
+    // logs are read start to end, so let the kernel read ahead further
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
     return true;
 }
 
+ssize_t DataFlashFileReader::read_input(void *buf, size_t count)
+{
+    uint8_t *dest = (uint8_t *)buf;
+    size_t done = 0;
+    while (done < count) {
+        if (buffer_offset == buffer_len) {
+            ssize_t n = ::read(fd, buffer, sizeof(buffer));
+            if (n <= 0) {
+                break;
+            }
+            buffer_offset = 0;
+            buffer_len = n;
+        }
+        size_t n = buffer_len - buffer_offset;
+        if (n > count - done) {
+            n = count - done;
+        }
+        memcpy(&dest[done], &buffer[buffer_offset], n);
+        buffer_offset += n;
+        done += n;
+    }
+    return done;
+}
+
 bool DataFlashFileReader::update(char type[5])
 {
     uint8_t hdr[3];
-    if (::read(fd, hdr, 3) != 3) {
+    if (read_input(hdr, 3) != 3) {
         return false;
     }
     if (hdr[0] != HEAD_BYTE1 || hdr[1] != HEAD_BYTE2) {
@@ -31,7 +67,7 @@ bool DataFlashFileReader::update(char type[5])
     if (hdr[2] == LOG_FORMAT_MSG) {
         struct log_Format f;
         memcpy(&f, hdr, 3);
-        if (::read(fd, &f.type, sizeof(f)-3) != sizeof(f)-3) {
+        if (read_input(&f.type, sizeof(f)-3) != sizeof(f)-3) {
             return false;
         }
         memcpy(&formats[f.type], &f, sizeof(formats[f.type]));
@@ -44,15 +80,17 @@ bool DataFlashFileReader::update(char type[5])
     const struct log_Format &f = formats[hdr[2]];
     if (f.length == 0) {
         // can't just throw these away as the format specifies the
-        // number of bytes in the message
+        // number of bytes in the message, so this is the end of what
+        // can be read
         ::printf("No format defined for type (%d)\n", hdr[2]);
-        exit(1);
+        corrupt = true;
+        return false;
     }
 
     uint8_t msg[f.length];
 
     memcpy(msg, hdr, 3);
-    if (::read(fd, &msg[3], f.length-3) != f.length-3) {
+    if (read_input(&msg[3], f.length-3) != f.length-3) {
         return false;
     }
 
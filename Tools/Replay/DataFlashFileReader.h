@@ -2,20 +2,36 @@
 #define REPLAY_DATAFLASHREADER_H
 
 #include <DataFlash.h>
+#include <sys/types.h>
 
 class DataFlashFileReader
 {
 public:
     DataFlashFileReader();
+    virtual ~DataFlashFileReader() {}
 
     bool open_log(const char *logfile);
     bool update(char type[5]);
 
+    // true if update() stopped at a message it could not read past,
+    // rather than at the end of the log
+    bool corrupt_log(void) const { return corrupt; }
+
     virtual bool handle_log_format_msg(const struct log_Format &f) = 0;
     virtual bool handle_msg(const struct log_Format &f, uint8_t *msg) = 0;
 
 protected:
     int fd;
+    bool corrupt;
+
+    // reads from the log go through a buffer, as there are several
+    // small reads per message
+    ssize_t read_input(void *buf, size_t count);
+
+#define LOGREADER_BUFFER_SIZE 65536
+    uint8_t buffer[LOGREADER_BUFFER_SIZE];
+    size_t buffer_offset;
+    size_t buffer_len;
 
 #define LOGREADER_MAX_FORMATS 255 // must be >= highest MESSAGE
     struct log_Format formats[LOGREADER_MAX_FORMATS];
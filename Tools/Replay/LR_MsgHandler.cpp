@@ -374,6 +374,138 @@ void LR_MsgHandler_PARM::process_message(uint8_t *msg)
 }
 
 
+/*
+  replay logging messages. These carry the samples the EKF used in
+  full precision, so replay sees exactly what the vehicle saw
+ */
+void LR_MsgHandler_RIMU::process_message(uint8_t *msg)
+{
+    wait_timestamp_from_msg(msg);
+
+    uint8_t flags = require_field_uint8_t(msg, "I");
+    uint8_t imu_offset = flags & 0x0F;
+    uint8_t this_imu_mask = 1 << imu_offset;
+
+    if ((gyro_mask & this_imu_mask) && (flags & LOG_REPLAY_IMU_GYRO_OK)) {
+        ins.set_gyro(imu_offset, Vector3f(require_field_float(msg, "GX"),
+                                          require_field_float(msg, "GY"),
+                                          require_field_float(msg, "GZ")));
+        if (flags & LOG_REPLAY_IMU_DELTA_ANGLE) {
+            ins.set_delta_angle(imu_offset, Vector3f(require_field_float(msg, "DAX"),
+                                                     require_field_float(msg, "DAY"),
+                                                     require_field_float(msg, "DAZ")));
+        }
+    }
+    if ((accel_mask & this_imu_mask) && (flags & LOG_REPLAY_IMU_ACCEL_OK)) {
+        ins.set_accel(imu_offset, Vector3f(require_field_float(msg, "AX"),
+                                           require_field_float(msg, "AY"),
+                                           require_field_float(msg, "AZ")));
+        if (flags & LOG_REPLAY_IMU_DELTA_VEL) {
+            ins.set_delta_velocity(imu_offset,
+                                   require_field_float(msg, "DelvT"),
+                                   Vector3f(require_field_float(msg, "DVX"),
+                                            require_field_float(msg, "DVY"),
+                                            require_field_float(msg, "DVZ")));
+        }
+    }
+}
+
+void LR_MsgHandler_RFRM::process_message(uint8_t *msg)
+{
+    wait_timestamp_from_msg(msg);
+
+    ins.set_delta_time(require_field_float(msg, "DelT"));
+
+    uint32_t drop = 0;
+    require_field(msg, "Drop", drop);
+    if (drop != dropped) {
+        ::printf("Replay logging dropped %u messages by %lu\n",
+                 (unsigned)(drop - dropped),
+                 (unsigned long)hal.scheduler->millis());
+        dropped = drop;
+    }
+}
+
+void LR_MsgHandler_RGPA::process_message(uint8_t *msg)
+{
+    wait_timestamp_from_msg(msg);
+
+    uint8_t i = require_field_uint8_t(msg, "I");
+    if (i >= GPS_MAX_INSTANCES) {
+        return;
+    }
+    AP_GPS::GPS_State &istate = gps_state[i];
+    istate.horizontal_accuracy = require_field_float(msg, "HAcc");
+    istate.vertical_accuracy = require_field_float(msg, "VAcc");
+    istate.speed_accuracy = require_field_float(msg, "SAcc");
+    istate.have_horizontal_accuracy = istate.horizontal_accuracy >= 0;
+    istate.have_vertical_accuracy = istate.vertical_accuracy >= 0;
+    istate.have_speed_accuracy = istate.speed_accuracy >= 0;
+    require_field(msg, "ArrMS", istate.last_gps_time_ms);
+}
+
+void LR_MsgHandler_RGPS::process_message(uint8_t *msg)
+{
+    wait_timestamp_from_msg(msg);
+
+    uint8_t i = require_field_uint8_t(msg, "I");
+    if (i >= GPS_MAX_INSTANCES) {
+        return;
+    }
+    AP_GPS::GPS_State &istate = gps_state[i];
+    istate.status = (AP_GPS::GPS_Status)require_field_uint8_t(msg, "Status");
+    istate.num_sats = require_field_uint8_t(msg, "NSats");
+    istate.hdop = require_field_uint16_t(msg, "HDop");
+    require_field(msg, "GMS", istate.time_week_ms);
+    istate.time_week = require_field_uint16_t(msg, "GWk");
+    memset(&istate.location, 0, sizeof(istate.location));
+    istate.location.lat = require_field_int32_t(msg, "Lat");
+    istate.location.lng = require_field_int32_t(msg, "Lng");
+    istate.location.alt = require_field_int32_t(msg, "Alt");
+    istate.velocity = Vector3f(require_field_float(msg, "VN"),
+                               require_field_float(msg, "VE"),
+                               require_field_float(msg, "VD"));
+    istate.ground_speed = pythagorous2(istate.velocity.x, istate.velocity.y);
+    istate.ground_course_cd = degrees(atan2f(istate.velocity.y, istate.velocity.x)) * 100UL;
+    istate.have_vertical_velocity = require_field_uint8_t(msg, "VV") != 0;
+
+    gps.setHIL_state(i, istate);
+}
+
+void LR_MsgHandler_RBAR::process_message(uint8_t *msg)
+{
+    wait_timestamp_from_msg(msg);
+
+    uint8_t i = require_field_uint8_t(msg, "I");
+    baro.setHIL(i,
+                require_field_float(msg, "Press"),
+                require_field_float(msg, "Temp"));
+    baro.setHIL_ground(i,
+                       require_field_float(msg, "GndPress"),
+                       require_field_float(msg, "GndTemp"));
+}
+
+void LR_MsgHandler_RMAG::process_message(uint8_t *msg)
+{
+    wait_timestamp_from_msg(msg);
+
+    compass.setHIL_field(require_field_uint8_t(msg, "I"),
+                         Vector3f(require_field_float(msg, "MagX"),
+                                  require_field_float(msg, "MagY"),
+                                  require_field_float(msg, "MagZ")));
+}
+
+void LR_MsgHandler_RASP::process_message(uint8_t *msg)
+{
+    wait_timestamp_from_msg(msg);
+
+    airspeed.setHIL(require_field_float(msg, "Airspeed"),
+                    require_field_float(msg, "DiffPress"),
+                    require_field_float(msg, "Temp"));
+    airspeed.set_EAS2TAS(require_field_float(msg, "EAS2TAS"));
+}
+
+
 void LR_MsgHandler_SIM::process_message(uint8_t *msg)
 {
     wait_timestamp_from_msg(msg);
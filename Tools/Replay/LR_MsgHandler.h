@@ -377,6 +377,114 @@ public:
 };
 
 
+/*
+  handlers for the replay logging messages, which carry every sensor
+  sample the EKF used in full precision
+ */
+class LR_MsgHandler_RIMU : public LR_MsgHandler
+{
+public:
+    LR_MsgHandler_RIMU(log_Format &_f, DataFlash_Class &_dataflash,
+                       uint64_t &_last_timestamp_usec,
+                       uint8_t &_accel_mask, uint8_t &_gyro_mask,
+                       AP_InertialSensor &_ins)
+        : LR_MsgHandler(_f, _dataflash, _last_timestamp_usec),
+          accel_mask(_accel_mask), gyro_mask(_gyro_mask), ins(_ins) { };
+
+    virtual void process_message(uint8_t *msg);
+
+private:
+    uint8_t &accel_mask;
+    uint8_t &gyro_mask;
+    AP_InertialSensor &ins;
+};
+
+class LR_MsgHandler_RFRM : public LR_MsgHandler
+{
+public:
+    LR_MsgHandler_RFRM(log_Format &_f, DataFlash_Class &_dataflash,
+                       uint64_t &_last_timestamp_usec, AP_InertialSensor &_ins)
+        : LR_MsgHandler(_f, _dataflash, _last_timestamp_usec),
+          ins(_ins), dropped(0) { };
+
+    virtual void process_message(uint8_t *msg);
+
+private:
+    AP_InertialSensor &ins;
+    uint32_t dropped;
+};
+
+class LR_MsgHandler_RGPA : public LR_MsgHandler
+{
+public:
+    LR_MsgHandler_RGPA(log_Format &_f, DataFlash_Class &_dataflash,
+                       uint64_t &_last_timestamp_usec,
+                       AP_GPS::GPS_State *_gps_state)
+        : LR_MsgHandler(_f, _dataflash, _last_timestamp_usec),
+          gps_state(_gps_state) { };
+
+    virtual void process_message(uint8_t *msg);
+
+private:
+    AP_GPS::GPS_State *gps_state;
+};
+
+class LR_MsgHandler_RGPS : public LR_MsgHandler
+{
+public:
+    LR_MsgHandler_RGPS(log_Format &_f, DataFlash_Class &_dataflash,
+                       uint64_t &_last_timestamp_usec, AP_GPS &_gps,
+                       AP_GPS::GPS_State *_gps_state)
+        : LR_MsgHandler(_f, _dataflash, _last_timestamp_usec),
+          gps(_gps), gps_state(_gps_state) { };
+
+    virtual void process_message(uint8_t *msg);
+
+private:
+    AP_GPS &gps;
+    AP_GPS::GPS_State *gps_state;
+};
+
+class LR_MsgHandler_RBAR : public LR_MsgHandler
+{
+public:
+    LR_MsgHandler_RBAR(log_Format &_f, DataFlash_Class &_dataflash,
+                       uint64_t &_last_timestamp_usec, AP_Baro &_baro)
+        : LR_MsgHandler(_f, _dataflash, _last_timestamp_usec), baro(_baro) { };
+
+    virtual void process_message(uint8_t *msg);
+
+private:
+    AP_Baro &baro;
+};
+
+class LR_MsgHandler_RMAG : public LR_MsgHandler
+{
+public:
+    LR_MsgHandler_RMAG(log_Format &_f, DataFlash_Class &_dataflash,
+                       uint64_t &_last_timestamp_usec, Compass &_compass)
+        : LR_MsgHandler(_f, _dataflash, _last_timestamp_usec), compass(_compass) { };
+
+    virtual void process_message(uint8_t *msg);
+
+private:
+    Compass &compass;
+};
+
+class LR_MsgHandler_RASP : public LR_MsgHandler
+{
+public:
+    LR_MsgHandler_RASP(log_Format &_f, DataFlash_Class &_dataflash,
+                       uint64_t &_last_timestamp_usec, AP_Airspeed &_airspeed)
+        : LR_MsgHandler(_f, _dataflash, _last_timestamp_usec), airspeed(_airspeed) { };
+
+    virtual void process_message(uint8_t *msg);
+
+private:
+    AP_Airspeed &airspeed;
+};
+
+
 class LR_MsgHandler_SIM : public LR_MsgHandler
 {
 public:
@@ -33,8 +33,11 @@ LogReader::LogReader(AP_AHRS &_ahrs, AP_InertialSensor &_ins, AP_Baro &_baro, Co
     accel_mask(7),
     gyro_mask(7),
     last_timestamp_usec(0),
+    replay_sensors(false),
     installed_vehicle_specific_parsers(false)
-{}
+{
+    memset(gps_state, 0, sizeof(gps_state));
+}
 
 struct log_Format deferred_formats[LOGREADER_MAX_FORMATS];
 
@@ -75,6 +78,14 @@ LR_MsgHandler_PARM *parameter_handler;
 static const char *generated_names[] = { "EKF1", "EKF2", "EKF3", "EKF4", "EKF5", 
                                          "AHR2", "POS", NULL };
 
+/*
+  sensor messages which are superseded by the replay logging messages
+  once those are present in the log
+ */
+static const char *replay_superseded_names[] = { "GPS", "GPS2", "IMU", "IMU2", "IMU3",
+                                                 "IMT", "IMT2", "IMT3", "BARO",
+                                                 "MAG", "MAG2", "ARSP", NULL };
+
 /*
   see if a type is in a list of types
  */
@@ -173,6 +184,29 @@ bool LogReader::handle_log_format_msg(const struct log_Format &f) {
 	} else if (streq(name, "MAG2")) {
 	  msgparser[f.type] = new LR_MsgHandler_MAG2(formats[f.type], dataflash,
 						 last_timestamp_usec, compass);
+	} else if (streq(name, "RIMU")) {
+	    msgparser[f.type] = new LR_MsgHandler_RIMU(formats[f.type], dataflash,
+                                                    last_timestamp_usec,
+                                                    accel_mask, gyro_mask, ins);
+	} else if (streq(name, "RFRM")) {
+	    msgparser[f.type] = new LR_MsgHandler_RFRM(formats[f.type], dataflash,
+                                                    last_timestamp_usec, ins);
+	} else if (streq(name, "RGPA")) {
+	    msgparser[f.type] = new LR_MsgHandler_RGPA(formats[f.type], dataflash,
+                                                    last_timestamp_usec, gps_state);
+	} else if (streq(name, "RGPS")) {
+	    msgparser[f.type] = new LR_MsgHandler_RGPS(formats[f.type], dataflash,
+                                                    last_timestamp_usec,
+                                                    gps, gps_state);
+	} else if (streq(name, "RBAR")) {
+	    msgparser[f.type] = new LR_MsgHandler_RBAR(formats[f.type], dataflash,
+                                                    last_timestamp_usec, baro);
+	} else if (streq(name, "RMAG")) {
+	    msgparser[f.type] = new LR_MsgHandler_RMAG(formats[f.type], dataflash,
+                                                    last_timestamp_usec, compass);
+	} else if (streq(name, "RASP")) {
+	    msgparser[f.type] = new LR_MsgHandler_RASP(formats[f.type], dataflash,
+                                                    last_timestamp_usec, airspeed);
 	} else if (streq(name, "NTUN")) {
 	    // the label "NTUN" is used by rover, copter and plane -
 	    // and they all look different!  creation of a parser is
@@ -212,6 +246,16 @@ bool LogReader::handle_msg(const struct log_Format &f, uint8_t *msg) {
 	return true;
     }
 
+    // the format of every message is in the log, so only switch to
+    // the replay logging sensors once the first frame turns up
+    if (!replay_sensors && streq(name, "RFRM")) {
+        replay_sensors = true;
+        ::printf("Using replay logging sensor data\n");
+    }
+    if (replay_sensors && in_list(name, replay_superseded_names)) {
+        return true;
+    }
+
     p->process_message(msg);
 
     maybe_install_vehicle_specific_parsers();
@@ -23,6 +23,9 @@ public:
     void set_use_imt(bool _use_imt) { use_imt = _use_imt; }
 
     uint64_t last_timestamp_us(void) const { return last_timestamp_usec; }
+
+    // true once the log has given us replay logging sensor data
+    bool have_replay_sensors(void) const { return replay_sensors; }
     virtual bool handle_log_format_msg(const struct log_Format &f);
     virtual bool handle_msg(const struct log_Format &f, uint8_t *msg);
 
@@ -41,6 +44,10 @@ private:
 
     uint32_t ground_alt_cm;
 
+    // GPS state built up from RGPA and RGPS messages
+    AP_GPS::GPS_State gps_state[GPS_MAX_INSTANCES];
+    bool replay_sensors;
+
     class LR_MsgHandler *msgparser[LOGREADER_MAX_FORMATS];
 
     Vector3f attitude;
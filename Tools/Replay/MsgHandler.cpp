@@ -64,6 +64,44 @@ MsgHandler::MsgHandler(const struct log_Format &_f) : next_field(0), f(_f)
     parse_format_fields();
 }
 
+bool MsgHandler::valid_format(const struct log_Format &f)
+{
+    uint8_t format_len = strnlen(f.format, sizeof(f.format));
+    uint16_t length = 3; // header
+    for (uint8_t i=0; i<format_len; i++) {
+        switch (f.format[i]) {
+        case 'b': case 'B': case 'M':
+            length += 1;
+            break;
+        case 'c': case 'C': case 'h': case 'H':
+            length += 2;
+            break;
+        case 'e': case 'E': case 'f': case 'i': case 'I': case 'L': case 'n':
+            length += 4;
+            break;
+        case 'q': case 'Q':
+            length += 8;
+            break;
+        case 'N':
+            length += 16;
+            break;
+        case 'Z':
+            length += 64;
+            break;
+        default:
+            return false;
+        }
+    }
+
+    uint8_t num_labels = 1;
+    for (uint8_t i=0; i<sizeof(f.labels) && f.labels[i] != 0; i++) {
+        if (f.labels[i] == ',') {
+            num_labels++;
+        }
+    }
+    return format_len <= LOGREADER_MAX_FIELDS && num_labels == format_len && length == f.length;
+}
+
 void MsgHandler::add_field(const char *_label, uint8_t _type, uint8_t _offset,
                           uint8_t _length)
 {
@@ -80,9 +118,11 @@ void MsgHandler::parse_format_fields()
     char * arg = labels;
     uint8_t label_offset = 0;
     char *next_label;
+    char *saveptr = NULL;
     uint8_t msg_offset = 3; // 3 bytes for the header
 
-    while ((next_label = strtok(arg, ",")) != NULL) {
+    // strtok_r() as handlers may be created on several threads
+    while ((next_label = strtok_r(arg, ",", &saveptr)) != NULL) {
 	if (label_offset > strlen(f.format)) {
 	    free(labels);
 	    printf("too few field times for labels %s (format=%s) (labels=%s)\n",
@@ -159,7 +199,7 @@ void MsgHandler::string_for_labels(char *buffer, uint bufferlen)
     bufferlen--;
 
     char *pos = buffer;
-    for (uint8_t k=0; k<LOGREADER_MAX_FIELDS; k++) {
+    for (uint8_t k=0; k<next_field; k++) {
         if (field_info[k].label != NULL) {
             uint8_t remaining = bufferlen - (pos - buffer);
             uint8_t label_length = strlen(field_info[k].label);
@@ -183,7 +223,7 @@ void MsgHandler::string_for_labels(char *buffer, uint bufferlen)
 
 MsgHandler::~MsgHandler()
 {
-    for (uint8_t k=0; k<LOGREADER_MAX_FIELDS; k++) {
+    for (uint8_t k=0; k<next_field; k++) {
         if (field_info[k].label != NULL) {
             free(field_info[k].label);
         }
@@ -14,6 +14,12 @@ class MsgHandler {
 public:
     // constructor - create a parser for a MavLink message format
     MsgHandler(const struct log_Format &f);
+    virtual ~MsgHandler();
+
+    // true if every field type of a format can be decoded and the
+    // fields add up to the message length. MsgHandler exits on formats
+    // it cannot parse, so formats from untrusted logs are checked first
+    static bool valid_format(const struct log_Format &f);
 
     // retrieve a comma-separated list of all labels
     void string_for_labels(char *buffer, uint bufferlen);
@@ -41,6 +47,20 @@ public:
     uint16_t require_field_uint16_t(uint8_t *msg, const char *label);
     int16_t require_field_int16_t(uint8_t *msg, const char *label);
 
+    // fields by index, for decoding every field of a message
+    uint8_t num_fields() const { return next_field; }
+    const char *field_label(uint8_t field) const { return field_info[field].label; }
+    char field_type(uint8_t field) const { return field_info[field].type; }
+    uint8_t field_length(uint8_t field) const { return field_info[field].length; }
+    uint8_t field_offset(uint8_t field) const { return field_info[field].offset; }
+
+    template<typename R>
+    void field_value_at(uint8_t *msg, uint8_t field, R &ret)
+        {
+            field_value_for_type_at_offset(msg, field_info[field].type,
+                                           field_info[field].offset, ret);
+        }
+
 private:
 
     void add_field(const char *_label, uint8_t _type, uint8_t _offset,
@@ -71,7 +91,6 @@ private:
 
 protected:
     struct log_Format f; // the format we are a parser for
-    ~MsgHandler();
 
     void location_from_msg(uint8_t *msg, Location &loc, const char *label_lat,
 			   const char *label_long, const char *label_alt);
@@ -117,7 +136,11 @@ inline void MsgHandler::field_value_for_type_at_offset(uint8_t *msg,
     /* we register the types - add_field_type - so can we do without
      * this switch statement somehow? */
     switch (type) {
+    case 'b':
+        ret = (R)(((int8_t*)&msg[offset])[0]);
+        break;
     case 'B':
+    case 'M':
         ret = (R)(((uint8_t*)&msg[offset])[0]);
         break;
     case 'c':
@@ -137,6 +160,7 @@ inline void MsgHandler::field_value_for_type_at_offset(uint8_t *msg,
     case 'E':
         ret = (R)(((uint32_t*)&msg[offset])[0]);
         break;
+    case 'i':
     case 'L':
     case 'e':
         ret = (R)(((int32_t*)&msg[offset])[0]);
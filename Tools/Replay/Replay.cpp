@@ -137,6 +137,8 @@ private:
     void usage(void);
     void set_user_parameters(void);
     void read_sensors(const char *type);
+    void read_replay_sensors(const char *type);
+    void update_ahrs(void);
     
 };
 
@@ -319,6 +321,9 @@ int find_update_rate(const char *filename) {
     while (samplecount < 10) {
         char type[5];
         if (!reader.update(type)) {
+            if (reader.corrupt_log()) {
+                exit(1);
+            }
             break;
         }
         if (streq(type, "IMU2")) {
@@ -441,10 +446,13 @@ void Replay::setup()
     while (!done_home_init) {
         char type[5];
         if (!logreader.update(type)) {
+            if (logreader.corrupt_log()) {
+                exit(1);
+            }
             break;
         }
         read_sensors(type);
-        if (streq(type, "GPS") &&
+        if ((streq(type, "GPS") || streq(type, "RGPS")) &&
             gps.status() >= AP_GPS::GPS_OK_FIX_3D && 
             done_baro_init && !done_home_init) {
             const Location &loc = gps.location();
@@ -490,6 +498,11 @@ void Replay::read_sensors(const char *type)
         have_imt2 = true;
     }
 
+    if (logreader.have_replay_sensors()) {
+        read_replay_sensors(type);
+        return;
+    }
+
     if (streq(type,"GPS")) {
         gps.update();
         if (gps.status() >= AP_GPS::GPS_OK_FIX_3D) {
@@ -531,19 +544,53 @@ void Replay::read_sensors(const char *type)
         run_ahrs = true;
     }
     if (run_ahrs) {
-        ahrs.update();
-        if (ahrs.get_home().lat != 0) {
-            inertial_nav.update(ins.get_delta_time());
+        update_ahrs();
+    }
+}
+
+/*
+  replay logging sensors. Each sample is the one the vehicle used, so
+  the EKF runs once per RFRM frame marker, at the time it ran in
+  flight
+ */
+void Replay::read_replay_sensors(const char *type)
+{
+    if (streq(type,"RGPS")) {
+        gps.update();
+        if (gps.status() >= AP_GPS::GPS_OK_FIX_3D) {
+            ahrs.estimate_wind();
         }
-        dataflash.Log_Write_EKF(ahrs,false);
-        dataflash.Log_Write_AHRS2(ahrs);
-        dataflash.Log_Write_POS(ahrs);
-        if (ahrs.healthy() != ahrs_healthy) {
-            ahrs_healthy = ahrs.healthy();
-            printf("AHRS health: %u at %lu\n", 
-                   (unsigned)ahrs_healthy,
-                   (unsigned long)hal.scheduler->millis());
+    } else if (streq(type,"RMAG")) {
+        compass.read();
+    } else if (streq(type,"RASP")) {
+        ahrs.set_airspeed(&airspeed);
+    } else if (streq(type,"RBAR")) {
+        // the logged ground calibration is used, so no
+        // update_calibration() here
+        barometer.update();
+        if (!done_baro_init) {
+            done_baro_init = true;
+            ::printf("Barometer initialised\n");
         }
+    } else if (streq(type,"RFRM")) {
+        update_ahrs();
+    }
+}
+
+void Replay::update_ahrs(void)
+{
+    ahrs.update();
+    if (ahrs.get_home().lat != 0) {
+        inertial_nav.update(ins.get_delta_time());
+    }
+    dataflash.Log_Write_EKF(ahrs,false);
+    dataflash.Log_Write_AHRS2(ahrs);
+    dataflash.Log_Write_POS(ahrs);
+    if (ahrs.healthy() != ahrs_healthy) {
+        ahrs_healthy = ahrs.healthy();
+        printf("AHRS health: %u at %lu\n", 
+               (unsigned)ahrs_healthy,
+               (unsigned long)hal.scheduler->millis());
     }
 }
 
@@ -560,6 +607,12 @@ void Replay::loop()
         }
 
         if (!logreader.update(type)) {
+            if (logreader.corrupt_log()) {
+                // only part of the log was replayed
+                ::printf("Corrupt log at %.1f seconds\n", hal.scheduler->millis()*0.001f);
+                fclose(plotf);
+                exit(1);
+            }
             ::printf("End of log at %.1f seconds\n", hal.scheduler->millis()*0.001f);
             fclose(plotf);
             exit(0);
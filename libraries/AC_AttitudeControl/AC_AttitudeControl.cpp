@@ -69,9 +69,7 @@ void AC_AttitudeControl::set_dt(float delta_sec)
     _dt = delta_sec;
 
     // set attitude controller's D term filters
-    _pid_rate_roll.set_dt(_dt);
-    _pid_rate_pitch.set_dt(_dt);
-    _pid_rate_yaw.set_dt(_dt);
+    _pid_rate.set_dt(_dt);
 }
 
 // relax_bf_rate_controller - ensure body-frame rate controller has zero errors to relax rate controller output
@@ -413,9 +411,10 @@ void AC_AttitudeControl::rate_controller_run()
     // call rate controllers and send output to motors object
     // To-Do: should the outputs from get_rate_roll, pitch, yaw be int16_t which is the input to the motors library?
     // To-Do: skip this step if the throttle out is zero?
-    _motors.set_roll(rate_bf_to_motor_roll(_rate_bf_target.x));
-    _motors.set_pitch(rate_bf_to_motor_pitch(_rate_bf_target.y));
-    _motors.set_yaw(rate_bf_to_motor_yaw(_rate_bf_target.z));
+    Vector3f motor_out = rate_bf_to_motor(_rate_bf_target);
+    _motors.set_roll(motor_out.x);
+    _motors.set_pitch(motor_out.y);
+    _motors.set_yaw(motor_out.z);
 }
 
 //
@@ -562,106 +561,29 @@ void AC_AttitudeControl::update_rate_bf_targets()
 // body-frame rate controller
 //
 
-// rate_bf_to_motor_roll - ask the rate controller to calculate the motor outputs to achieve the target rate in centi-degrees / second
-float AC_AttitudeControl::rate_bf_to_motor_roll(float rate_target_cds)
+// rate_bf_to_motor - ask the rate controllers to calculate the motor outputs to achieve the target rates in centi-degrees / second
+Vector3f AC_AttitudeControl::rate_bf_to_motor(const Vector3f &rate_target_cds)
 {
-    float p,i,d;            // used to capture pid values for logging
-    float current_rate;     // this iteration's rate
-    float rate_error;       // simply target_rate - current_rate
+    // get current rates
+    Vector3f current_rate = _ahrs.get_gyro() * AC_ATTITUDE_CONTROL_DEGX100;
 
-    // get current rate
-    // To-Do: make getting gyro rates more efficient?
-    current_rate = (_ahrs.get_gyro().x * AC_ATTITUDE_CONTROL_DEGX100);
-
-    // calculate error and call pid controller
-    rate_error = rate_target_cds - current_rate;
-    _pid_rate_roll.set_input_filter_d(rate_error);
-    _pid_rate_roll.set_desired_rate(rate_target_cds);
-
-    // get p value
-    p = _pid_rate_roll.get_p();
-
-    // get i term
-    i = _pid_rate_roll.get_integrator();
-
-    // update i term as long as we haven't breached the limits or the I term will certainly reduce
-    if (!_motors.limit.roll_pitch || ((i>0&&rate_error<0)||(i<0&&rate_error>0))) {
-        i = _pid_rate_roll.get_i();
+    // the integrators are only allowed to grow while the motors are not limited
+    uint8_t limit_mask = 0;
+    if (_motors.limit.roll_pitch) {
+        limit_mask |= AC_PID_VECTOR3_AXIS_X | AC_PID_VECTOR3_AXIS_Y;
     }
-
-    // get d term
-    d = _pid_rate_roll.get_d();
-
-    // constrain output and return
-    return constrain_float((p+i+d), -AC_ATTITUDE_RATE_RP_CONTROLLER_OUT_MAX, AC_ATTITUDE_RATE_RP_CONTROLLER_OUT_MAX);
-}
-
-// rate_bf_to_motor_pitch - ask the rate controller to calculate the motor outputs to achieve the target rate in centi-degrees / second
-float AC_AttitudeControl::rate_bf_to_motor_pitch(float rate_target_cds)
-{
-    float p,i,d;            // used to capture pid values for logging
-    float current_rate;     // this iteration's rate
-    float rate_error;       // simply target_rate - current_rate
-
-    // get current rate
-    // To-Do: make getting gyro rates more efficient?
-    current_rate = (_ahrs.get_gyro().y * AC_ATTITUDE_CONTROL_DEGX100);
-
-    // calculate error and call pid controller
-    rate_error = rate_target_cds - current_rate;
-    _pid_rate_pitch.set_input_filter_d(rate_error);
-    _pid_rate_pitch.set_desired_rate(rate_target_cds);
-
-    // get p value
-    p = _pid_rate_pitch.get_p();
-
-    // get i term
-    i = _pid_rate_pitch.get_integrator();
-
-    // update i term as long as we haven't breached the limits or the I term will certainly reduce
-    if (!_motors.limit.roll_pitch || ((i>0&&rate_error<0)||(i<0&&rate_error>0))) {
-        i = _pid_rate_pitch.get_i();
-    }
-
-    // get d term
-    d = _pid_rate_pitch.get_d();
-
-    // constrain output and return
-    return constrain_float((p+i+d), -AC_ATTITUDE_RATE_RP_CONTROLLER_OUT_MAX, AC_ATTITUDE_RATE_RP_CONTROLLER_OUT_MAX);
-}
-
-// rate_bf_to_motor_yaw - ask the rate controller to calculate the motor outputs to achieve the target rate in centi-degrees / second
-float AC_AttitudeControl::rate_bf_to_motor_yaw(float rate_target_cds)
-{
-    float p,i,d;            // used to capture pid values for logging
-    float current_rate;     // this iteration's rate
-    float rate_error;       // simply target_rate - current_rate
-
-    // get current rate
-    // To-Do: make getting gyro rates more efficient?
-    current_rate = (_ahrs.get_gyro().z * AC_ATTITUDE_CONTROL_DEGX100);
-
-    // calculate error and call pid controller
-    rate_error  = rate_target_cds - current_rate;
-    _pid_rate_yaw.set_input_filter_all(rate_error);
-    _pid_rate_yaw.set_desired_rate(rate_target_cds);
-
-    // get p value
-    p = _pid_rate_yaw.get_p();
-
-    // get i term
-    i = _pid_rate_yaw.get_integrator();
-
-    // update i term as long as we haven't breached the limits or the I term will certainly reduce
-    if (!_motors.limit.yaw || ((i>0&&rate_error<0)||(i<0&&rate_error>0))) {
-        i = _pid_rate_yaw.get_i();
+    if (_motors.limit.yaw) {
+        limit_mask |= AC_PID_VECTOR3_AXIS_Z;
     }
 
-    // get d value
-    d = _pid_rate_yaw.get_d();
+    // run roll, pitch and yaw rate controllers together, yaw filters its whole input
+    Vector3f out = _pid_rate.update(rate_target_cds, current_rate, limit_mask);
 
-    // constrain output and return
-    return constrain_float((p+i+d), -AC_ATTITUDE_RATE_YAW_CONTROLLER_OUT_MAX, AC_ATTITUDE_RATE_YAW_CONTROLLER_OUT_MAX);
+    // constrain outputs and return
+    out.x = constrain_float(out.x, -AC_ATTITUDE_RATE_RP_CONTROLLER_OUT_MAX, AC_ATTITUDE_RATE_RP_CONTROLLER_OUT_MAX);
+    out.y = constrain_float(out.y, -AC_ATTITUDE_RATE_RP_CONTROLLER_OUT_MAX, AC_ATTITUDE_RATE_RP_CONTROLLER_OUT_MAX);
+    out.z = constrain_float(out.z, -AC_ATTITUDE_RATE_YAW_CONTROLLER_OUT_MAX, AC_ATTITUDE_RATE_YAW_CONTROLLER_OUT_MAX);
+    return out;
 }
 
 // accel_limiting - enable or disable accel limiting
@@ -13,6 +13,7 @@
 #include <AP_AHRS.h>
 #include <AP_Motors.h>
 #include <AC_PID.h>
+#include <AC_PID_Vector3.h>
 #include <AC_P.h>
 
 // To-Do: change the name or move to AP_Math?
@@ -58,6 +59,7 @@ public:
         _pid_rate_roll(pid_rate_roll),
         _pid_rate_pitch(pid_rate_pitch),
         _pid_rate_yaw(pid_rate_yaw),
+        _pid_rate(pid_rate_roll, pid_rate_pitch, pid_rate_yaw, AC_PID_VECTOR3_AXIS_Z),
         _dt(AC_ATTITUDE_100HZ_DT),
         _angle_boost(0),
         _acro_angle_switch(0)
@@ -250,10 +252,8 @@ protected:
     //
     // body-frame rate controller
     //
-	// rate_bf_to_motor_roll - ask the rate controller to calculate the motor outputs to achieve the target body-frame rate (in centi-degrees/sec) for roll, pitch and yaw
-    float rate_bf_to_motor_roll(float rate_target_cds);
-    float rate_bf_to_motor_pitch(float rate_target_cds);
-    virtual float rate_bf_to_motor_yaw(float rate_target_cds);
+	// rate_bf_to_motor - ask the rate controllers to calculate the motor outputs to achieve the target body-frame rates (in centi-degrees/sec) for roll, pitch and yaw
+    Vector3f rate_bf_to_motor(const Vector3f &rate_target_cds);
 
     //
     // throttle methods
@@ -272,6 +272,7 @@ protected:
     AC_PID&             _pid_rate_roll;
     AC_PID&             _pid_rate_pitch;
     AC_PID&             _pid_rate_yaw;
+    AC_PID_Vector3      _pid_rate;              // runs the three rate controllers together
 
     // parameters
     AP_Float            _slew_yaw;              // maximum rate the yaw target can be updated in Loiter, RTL, Auto flight modes
@@ -66,6 +66,7 @@ void AC_PID::set_dt(float dt)
 {
     // set dt and calculate the input filter alpha
     _dt = dt;
+    calc_filt_alpha();
 }
 
 // filt_hz - set input filter hz
@@ -75,6 +76,9 @@ void AC_PID::filt_hz(float hz)
 
     // sanity check _filt_hz
     _filt_hz = max(_filt_hz, AC_PID_FILT_HZ_MIN);
+
+    // calculate the input filter alpha
+    calc_filt_alpha();
 }
 
 // set_input_filter_all - set input to PID controller
@@ -87,6 +91,8 @@ void AC_PID::set_input_filter_all(float input)
         return;
     }
 
+    update_filt_alpha();
+
     // reset input filter to value received
     if (_flags._reset_filter) {
         _flags._reset_filter = false;
@@ -95,7 +101,7 @@ void AC_PID::set_input_filter_all(float input)
     }
 
     // update filter and calculate derivative
-    float input_filt_change = get_filt_alpha() * (input - _input);
+    float input_filt_change = _filt_alpha * (input - _input);
     _input = _input + input_filt_change;
     if (_dt > 0.0f) {
         _derivative = input_filt_change / _dt;
@@ -112,6 +118,8 @@ void AC_PID::set_input_filter_d(float input)
         return;
     }
 
+    update_filt_alpha();
+
     // reset input filter to value received
     if (_flags._reset_filter) {
         _flags._reset_filter = false;
@@ -121,7 +129,7 @@ void AC_PID::set_input_filter_d(float input)
     // update filter and calculate derivative
     if (_dt > 0.0f) {
         float derivative = (input - _input) / _dt;
-        _derivative = _derivative + get_filt_alpha() * (derivative-_derivative);
+        _derivative = _derivative + _filt_alpha * (derivative-_derivative);
     }
 
     _input = input;
@@ -178,6 +186,7 @@ void AC_PID::load_gains()
     _imax.load();
     _imax = fabsf(_imax);
     _filt_hz.load();
+    calc_filt_alpha();
 }
 
 // save_gains - save gains to eeprom
@@ -199,16 +208,20 @@ void AC_PID::operator() (float p, float i, float d, float imaxval, float input_f
     _imax = fabsf(imaxval);
     _filt_hz = input_filt_hz;
     _dt = dt;
+    calc_filt_alpha();
 }
 
 // calc_filt_alpha - recalculate the input filter alpha
-float AC_PID::get_filt_alpha() const
+void AC_PID::calc_filt_alpha()
 {
+    _filt_alpha_hz = _filt_hz;
+
     if (is_zero(_filt_hz)) {
-        return 1.0f;
+        _filt_alpha = 1.0f;
+        return;
     }
 
     // calculate alpha
     float rc = 1/(M_2PI_F*_filt_hz);
-    return _dt / (_dt + rc);
+    _filt_alpha = _dt / (_dt + rc);
 }
@@ -64,7 +64,7 @@ public:
     float       kD() const { return _kd.get(); }
     float       imax() const { return _imax.get(); }
     float       filt_hz() const { return _filt_hz.get(); }
-    float       get_filt_alpha() const;
+    float       get_filt_alpha() const { return _filt_alpha; }
 
     // set accessors
     void        kP(const float v) { _kp.set(v); }
@@ -86,6 +86,15 @@ public:
 
 protected:
 
+    friend class AC_PID_Vector3;
+
+    // calc_filt_alpha - recalculate the input filter alpha
+    void        calc_filt_alpha();
+
+    // update_filt_alpha - recalculate the input filter alpha if the
+    //  filter frequency has been changed through the parameter
+    void        update_filt_alpha() { if (_filt_hz != _filt_alpha_hz) { calc_filt_alpha(); } }
+
     // parameters
     AP_Float        _kp;
     AP_Float        _ki;
@@ -103,6 +112,8 @@ protected:
     float           _integrator;            // integrator value
     float           _input;                 // last input for derivative
     float           _derivative;            // last derivative for low-pass filter
+    float           _filt_alpha;            // input filter alpha
+    float           _filt_alpha_hz;         // filter frequency _filt_alpha was calculated for
 
     DataFlash_Class::PID_Info        _pid_info;
 };
@@ -0,0 +1,104 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+
+/// @file	AC_PID_Vector3.cpp
+/// @brief	Three axis PID algorithm
+
+#include "AC_PID_Vector3.h"
+
+// Constructor
+AC_PID_Vector3::AC_PID_Vector3(AC_PID &pid_x, AC_PID &pid_y, AC_PID &pid_z, uint8_t filter_all_mask) :
+    _filter_all_mask(filter_all_mask)
+{
+    _pid[0] = &pid_x;
+    _pid[1] = &pid_y;
+    _pid[2] = &pid_z;
+}
+
+// set_dt - set time step in seconds of all three controllers
+void AC_PID_Vector3::set_dt(float dt)
+{
+    for (uint8_t i=0; i<3; i++) {
+        _pid[i]->set_dt(dt);
+    }
+}
+
+// update - run the controllers on the error between target and measurement
+//  and return the P+I+D output of each axis
+Vector3f AC_PID_Vector3::update(const Vector3f &target, const Vector3f &measurement, uint8_t limit_mask)
+{
+    const Vector3f error_v = target - measurement;
+    const float target_a[3] = { target.x, target.y, target.z };
+    const float error[3] = { error_v.x, error_v.y, error_v.z };
+    float out[3];
+
+    for (uint8_t i=0; i<3; i++) {
+        AC_PID &pid = *_pid[i];
+        const float dt = pid._dt;
+
+        // input filter, as set_input_filter_all() or set_input_filter_d().
+        // inf or NaN leaves the filter as it was
+        if (isfinite(error[i])) {
+            pid.update_filt_alpha();
+            const float alpha = pid._filt_alpha;
+            if (_filter_all_mask & (1<<i)) {
+                if (pid._flags._reset_filter) {
+                    pid._flags._reset_filter = false;
+                    pid._input = error[i];
+                    pid._derivative = 0.0f;
+                }
+                float input_filt_change = alpha * (error[i] - pid._input);
+                pid._input = pid._input + input_filt_change;
+                if (dt > 0.0f) {
+                    pid._derivative = input_filt_change / dt;
+                }
+            } else {
+                if (pid._flags._reset_filter) {
+                    pid._flags._reset_filter = false;
+                    pid._derivative = 0.0f;
+                }
+                if (dt > 0.0f) {
+                    float derivative = (error[i] - pid._input) / dt;
+                    pid._derivative = pid._derivative + alpha * (derivative - pid._derivative);
+                }
+                pid._input = error[i];
+            }
+        }
+        pid._pid_info.desired = target_a[i];
+
+        // p term
+        float p = pid._input * pid._kp;
+        pid._pid_info.P = p;
+
+        // update i term as long as we haven't breached the limits or the I term will certainly reduce
+        float integrator = pid._integrator;
+        if (!(limit_mask & (1<<i)) || ((integrator>0&&error[i]<0)||(integrator<0&&error[i]>0))) {
+            integrator = 0.0f;
+            if (!is_zero(pid._ki) && !is_zero(dt)) {
+                pid._integrator += (pid._input * pid._ki) * dt;
+                if (pid._integrator < -pid._imax) {
+                    pid._integrator = -pid._imax;
+                } else if (pid._integrator > pid._imax) {
+                    pid._integrator = pid._imax;
+                }
+                pid._pid_info.I = pid._integrator;
+                integrator = pid._integrator;
+            }
+        }
+
+        // d term
+        float d = pid._kd * pid._derivative;
+        pid._pid_info.D = d;
+
+        out[i] = p + integrator + d;
+    }
+
+    return Vector3f(out[0], out[1], out[2]);
+}
+
+// reset_I - reset the integrators
+void AC_PID_Vector3::reset_I()
+{
+    for (uint8_t i=0; i<3; i++) {
+        _pid[i]->reset_I();
+    }
+}
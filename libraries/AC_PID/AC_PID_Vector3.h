@@ -0,0 +1,48 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+
+/// @file	AC_PID_Vector3.h
+/// @brief	Runs three AC_PID controllers, one per axis, in a single update
+
+#ifndef __AC_PID_VECTOR3_H__
+#define __AC_PID_VECTOR3_H__
+
+#include <AP_Common.h>
+#include <AP_Math.h>
+#include "AC_PID.h"
+
+// axis masks
+#define AC_PID_VECTOR3_AXIS_X   (1<<0)
+#define AC_PID_VECTOR3_AXIS_Y   (1<<1)
+#define AC_PID_VECTOR3_AXIS_Z   (1<<2)
+
+/// @class	AC_PID_Vector3
+/// @brief	Copter three axis PID control class
+///
+/// The gains, filter state and integrators stay in the AC_PID objects
+/// so they are still tuned, logged and reset through them. The update
+/// shares the time step and error calculation between the axes and
+/// uses the filter alpha cached by each controller.
+class AC_PID_Vector3 {
+public:
+
+    // Constructor. The axes in filter_all_mask filter the whole input,
+    //  the others only filter the input to the D term
+    AC_PID_Vector3(AC_PID &pid_x, AC_PID &pid_y, AC_PID &pid_z, uint8_t filter_all_mask);
+
+    // set_dt - set time step in seconds of all three controllers
+    void        set_dt(float dt);
+
+    // update - run the controllers on the error between target and measurement
+    //  and return the P+I+D output of each axis. The integrator of the axes in
+    //  limit_mask is only updated when that makes it smaller
+    Vector3f    update(const Vector3f &target, const Vector3f &measurement, uint8_t limit_mask);
+
+    // reset_I - reset the integrators
+    void        reset_I();
+
+private:
+    AC_PID          *_pid[3];
+    uint8_t         _filter_all_mask;
+};
+
+#endif // __AC_PID_VECTOR3_H__
@@ -197,6 +197,14 @@ public:
     // Methods
     virtual void update(void) = 0;
 
+    // Vehicles with a fast rate loop may split update() in two:
+    // update_fast() on every loop, which reads the IMU and keeps the
+    // attitude current, and update_EKF() at the EKF rate, which is
+    // set_ekf_rate_div() loops. Without an EKF update_fast() is update()
+    virtual void update_fast(void) { update(); }
+    virtual void update_EKF(void) {}
+    virtual void set_ekf_rate_div(uint8_t) {}
+
     // Euler angles (radians)
     float roll;
     float pitch;
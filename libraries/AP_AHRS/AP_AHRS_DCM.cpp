@@ -49,6 +49,15 @@ AP_AHRS_DCM::reset_gyro_drift(void)
 // run a full DCM update round
 void
 AP_AHRS_DCM::update(void)
+{
+    // tell the IMU to grab some data
+    _ins.update();
+
+    update_DCM(0);
+}
+
+void
+AP_AHRS_DCM::update_DCM(float min_correction_dt)
 {
     float delta_t;
 
@@ -56,9 +65,6 @@ AP_AHRS_DCM::update(void)
         _last_startup_ms = hal.scheduler->millis();
     }
 
-    // tell the IMU to grab some data
-    _ins.update();
-
     // ask the IMU how much time this sensor reading represents
     delta_t = _ins.get_delta_time();
 
@@ -67,18 +73,42 @@ AP_AHRS_DCM::update(void)
     // in ArduCopter
     if (delta_t > 0.2f) {
         memset(&_ra_sum[0], 0, sizeof(_ra_sum));
+        memset(&_dvel_body[0], 0, sizeof(_dvel_body));
         _ra_deltat = 0;
+        _correction_dt = 0;
         return;
     }
 
     // Integrate the DCM matrix using gyro inputs
     matrix_update(delta_t);
 
+    // keep the velocity change in body frame until the next drift
+    // correction, which rotates it into earth frame
+    for (uint8_t i=0; i<_ins.get_accel_count(); i++) {
+        if (_ins.get_accel_health(i)) {
+            _dvel_body[i] += _ins.get_accel(i) * delta_t;
+        }
+    }
+    _correction_dt += delta_t;
+
+    if (_correction_dt < min_correction_dt) {
+        _correction_pending = true;
+        return;
+    }
+
+    correct_DCM();
+}
+
+void
+AP_AHRS_DCM::correct_DCM(void)
+{
     // Normalize the DCM matrix
     normalize();
 
     // Perform drift correction
-    drift_correction(delta_t);
+    drift_correction(_correction_dt);
+    _correction_dt = 0;
+    _correction_pending = false;
 
     // paranoid check for bad values in the DCM matrix
     check_matrix();
@@ -105,18 +135,26 @@ AP_AHRS_DCM::matrix_update(float _G_Dt)
     // systems with more than one gyro. We don't use the 3rd gyro
     // unless another is unhealthy as 3rd gyro on PH2 has a lot more
     // noise
+    //
+    // the rotation uses the delta angles from the IMU, which are
+    // coning corrected when the backend integrates every sample, and
+    // otherwise fall back to the gyro times the delta time
+    Vector3f delta_angle;
     uint8_t healthy_count = 0;    
     for (uint8_t i=0; i<_ins.get_gyro_count(); i++) {
-        if (_ins.get_gyro_health(i) && healthy_count < 2) {
+        Vector3f dangle;
+        if (_ins.get_gyro_health(i) && healthy_count < 2 && _ins.get_delta_angle(i, dangle)) {
             _omega += _ins.get_gyro(i);
+            delta_angle += dangle;
             healthy_count++;
         }
     }
     if (healthy_count > 1) {
         _omega /= healthy_count;
+        delta_angle /= healthy_count;
     }
     _omega += _omega_I;
-    _dcm_matrix.rotate((_omega + _omega_P + _omega_yaw_P) * _G_Dt);
+    _dcm_matrix.rotate(delta_angle + (_omega_I + _omega_P + _omega_yaw_P) * _G_Dt);
 }
 
 
@@ -245,21 +283,30 @@ void
 AP_AHRS_DCM::normalize(void)
 {
     float error;
-    Vector3f t0, t1, t2;
+    Vector3f t0, t1;
 
     error = _dcm_matrix.a * _dcm_matrix.b;                                              // eq.18
 
     t0 = _dcm_matrix.a - (_dcm_matrix.b * (0.5f * error));              // eq.19
     t1 = _dcm_matrix.b - (_dcm_matrix.a * (0.5f * error));              // eq.19
-    t2 = t0 % t1;                                                       // c= a x b // eq.20
 
     if (!renorm(t0, _dcm_matrix.a) ||
-        !renorm(t1, _dcm_matrix.b) ||
-        !renorm(t2, _dcm_matrix.c)) {
+        !renorm(t1, _dcm_matrix.b)) {
         // Our solution is blowing up and we will force back
         // to last euler angles
         _last_failure_ms = hal.scheduler->millis();
         AP_AHRS_DCM::reset(true);
+        return;
+    }
+
+    // a and b are now unit length and orthogonal to second order, so
+    // their cross product is unit length to fourth order and does not
+    // need its own renormalisation, which saves a sqrt(). It is only
+    // checked for a and b having collapsed onto each other
+    _dcm_matrix.c = _dcm_matrix.a % _dcm_matrix.b;                      // c= a x b // eq.20
+    if (!(_dcm_matrix.c.length_squared() > 1.0e-12f)) {
+        _last_failure_ms = hal.scheduler->millis();
+        AP_AHRS_DCM::reset(true);
     }
 }
 
@@ -546,10 +593,13 @@ AP_AHRS_DCM::drift_correction(float deltat)
     for (uint8_t i=0; i<_ins.get_accel_count(); i++) {
         if (_ins.get_accel_health(i)) {
             _accel_ef[i] = _dcm_matrix * _ins.get_accel(i);
-            // integrate the accel vector in the earth frame between GPS readings
-            _ra_sum[i] += _accel_ef[i] * deltat;
+            // integrate the accel vector in the earth frame between
+            // GPS readings, from the velocity change since the last
+            // drift correction
+            _ra_sum[i] += _dcm_matrix * _dvel_body[i];
         }
     }
+    memset(&_dvel_body[0], 0, sizeof(_dvel_body));
 
     //update _accel_ef_blended
 #if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
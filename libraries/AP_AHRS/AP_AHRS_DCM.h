@@ -50,7 +50,9 @@ public:
         _imu1_weight(0.5f),
 #endif
         _last_failure_ms(0),
-        _last_startup_ms(0)
+        _last_startup_ms(0),
+        _correction_dt(0.0f),
+        _correction_pending(false)
     {
         _dcm_matrix.identity();
 
@@ -113,6 +115,18 @@ public:
     // time that the AHRS has been up
     uint32_t uptime_ms(void) const;
 
+protected:
+    // run DCM on the IMU sample read by _ins.update(). The matrix is
+    // integrated on every call, but the normalisation, drift
+    // correction and euler angles are deferred until
+    // min_correction_dt seconds of samples have built up
+    void update_DCM(float min_correction_dt);
+
+    // run any deferred normalisation, drift correction and euler
+    // angles now
+    void correct_DCM(void);
+    bool correction_pending(void) const { return _correction_pending; }
+
 private:
     float _ki;
     float _ki_yaw;
@@ -204,6 +218,12 @@ private:
 
     // time when DCM was last reset
     uint32_t _last_startup_ms;
+
+    // samples integrated since the last drift correction, and the
+    // body frame velocity change over them
+    float _correction_dt;
+    bool _correction_pending;
+    Vector3f _dvel_body[INS_MAX_INSTANCES];
 };
 
 #endif // __AP_AHRS_DCM_H__
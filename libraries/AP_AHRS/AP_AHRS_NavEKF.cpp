@@ -59,10 +59,22 @@ void AP_AHRS_NavEKF::reset_gyro_drift(void)
     AP_AHRS_DCM::reset_gyro_drift();
 
     // reset the EKF gyro bias states
-    EKF.resetGyroBias();
+    for (uint8_t i=0; i<_lanes.num_lanes(); i++) {
+        _lanes.get_lane(i).resetGyroBias();
+    }
 }
 
 void AP_AHRS_NavEKF::update(void)
+{
+    update_DCM_fallback();
+    _lanes.AccumulateIMU();
+    update_EKF();
+}
+
+/*
+  read the IMU and run DCM. Both update() and update_fast() start here
+ */
+void AP_AHRS_NavEKF::update_DCM_fallback(void)
 {
     // we need to restore the old DCM attitude values as these are
     // used internally in DCM to calculate error values for gyro drift
@@ -72,26 +84,66 @@ void AP_AHRS_NavEKF::update(void)
     yaw = _dcm_attitude.z;
     update_cd_values();
 
-    AP_AHRS_DCM::update();
+    // tell the IMU to grab some data
+    _ins.update();
+
+    // while the EKF is in use DCM is only the fallback, so it is
+    // integrated every loop but only corrected at
+    // AP_AHRS_DCM_FALLBACK_DT intervals
+    update_DCM(using_EKF() ? AP_AHRS_DCM_FALLBACK_DT : 0);
 
     // keep DCM attitude available for get_secondary_attitude()
     _dcm_attitude(roll, pitch, yaw);
+}
+
+/*
+  the fast part of update(), for vehicles that run update_EKF() from
+  a slower task. Between filter updates the last EKF attitude is
+  carried forward with the bias corrected gyros, so the rate
+  controllers always see an attitude from the latest IMU sample
+ */
+void AP_AHRS_NavEKF::update_fast(void)
+{
+    update_DCM_fallback();
+
+    if (!ekf_started) {
+        return;
+    }
+    // always accumulate, so the samples of a tick where update_EKF()
+    // did not run are used by the next filter update
+    _lanes.AccumulateIMU();
+    if (using_EKF()) {
+        update_gyro_estimate(_lanes.active().getIMUIndex());
+        _dcm_matrix.rotate(_gyro_estimate * _ins.get_delta_time());
+        _dcm_matrix.normalize();
+        _dcm_matrix.to_euler(&roll, &pitch, &yaw);
+        update_cd_values();
+        update_trig();
+    }
+}
 
+/*
+  run the EKF on the IMU data since the last call. Called from
+  update(), or from a slower task than update_fast()
+ */
+void AP_AHRS_NavEKF::update_EKF(void)
+{
     if (!ekf_started) {
         // wait 1 second for DCM to output a valid tilt error estimate
         if (start_time_ms == 0) {
             start_time_ms = hal.scheduler->millis();
         }
         if (hal.scheduler->millis() - start_time_ms > startup_delay_ms) {
-            ekf_started = EKF.InitialiseFilterDynamic();
+            ekf_started = _lanes.InitialiseFilterDynamic();
         }
     }
     if (ekf_started) {
-        EKF.UpdateFilter();
-        EKF.getRotationBodyToNED(_dcm_matrix);
+        _lanes.UpdateFilter();
+        const NavEKF &ekf = _lanes.active();
+        _lanes.getRotationBodyToNED(_dcm_matrix);
         if (using_EKF()) {
             Vector3f eulers;
-            EKF.getEulerAngles(eulers);
+            _lanes.getEulerAngles(eulers);
             roll  = eulers.x;
             pitch = eulers.y;
             yaw   = eulers.z;
@@ -100,30 +152,27 @@ void AP_AHRS_NavEKF::update(void)
             update_trig();
 
             // keep _gyro_bias for get_gyro_drift()
-            EKF.getGyroBias(_gyro_bias);
+            ekf.getGyroBias(_gyro_bias);
             _gyro_bias = -_gyro_bias;
 
+            // a filter lane uses a single IMU
+            int8_t imu = ekf.getIMUIndex();
+
             // calculate corrected gryo estimate for get_gyro()
-            _gyro_estimate.zero();
-            uint8_t healthy_count = 0;    
-            for (uint8_t i=0; i<_ins.get_gyro_count(); i++) {
-                if (_ins.get_gyro_health(i) && healthy_count < 2) {
-                    _gyro_estimate += _ins.get_gyro(i);
-                    healthy_count++;
-                }
-            }
-            if (healthy_count > 1) {
-                _gyro_estimate /= healthy_count;
-            }
-            _gyro_estimate += _gyro_bias;
+            update_gyro_estimate(imu);
 
             float abias1, abias2;
-            EKF.getAccelZBias(abias1, abias2);
+            ekf.getAccelZBias(abias1, abias2);
 
             // update _accel_ef_ekf
             for (uint8_t i=0; i<_ins.get_accel_count(); i++) {
                 Vector3f accel = _ins.get_accel(i);
-                if (i==0) {
+                if (imu >= 0) {
+                    // a lane only estimates the bias of its own IMU
+                    if (i == imu) {
+                        accel.z -= abias1;
+                    }
+                } else if (i==0) {
                     accel.z -= abias1;
                 } else if (i==1) {
                     accel.z -= abias2;
@@ -133,15 +182,56 @@ void AP_AHRS_NavEKF::update(void)
                 }
             }
 
-            if(_ins.get_accel_health(0) && _ins.get_accel_health(1)) {
+            if (imu >= 0 && _ins.get_accel_health(imu)) {
+                _accel_ef_ekf_blended = _accel_ef_ekf[imu];
+            } else if(_ins.get_accel_health(0) && _ins.get_accel_health(1)) {
                 float IMU1_weighting;
-                EKF.getIMU1Weighting(IMU1_weighting);
+                ekf.getIMU1Weighting(IMU1_weighting);
                 _accel_ef_ekf_blended = _accel_ef_ekf[0] * IMU1_weighting + _accel_ef_ekf[1] * (1.0f-IMU1_weighting);
             } else {
                 _accel_ef_ekf_blended = _accel_ef_ekf[0];
             }
         }
     }
+
+    if (correction_pending() && !using_EKF()) {
+        // the EKF has stopped being used. Catch up on the deferred
+        // DCM corrections so the attitude falls back to is current
+        roll = _dcm_attitude.x;
+        pitch = _dcm_attitude.y;
+        yaw = _dcm_attitude.z;
+        correct_DCM();
+        _dcm_attitude(roll, pitch, yaw);
+    }
+}
+
+// set the gyro estimate for get_gyro() from the IMU used by the EKF
+// and the EKF gyro bias
+void AP_AHRS_NavEKF::update_gyro_estimate(int8_t imu)
+{
+    _gyro_estimate.zero();
+    if (imu >= 0 && _ins.get_gyro_health(imu)) {
+        _gyro_estimate = _ins.get_gyro(imu);
+    } else {
+        uint8_t healthy_count = 0;    
+        for (uint8_t i=0; i<_ins.get_gyro_count(); i++) {
+            if (_ins.get_gyro_health(i) && healthy_count < 2) {
+                _gyro_estimate += _ins.get_gyro(i);
+                healthy_count++;
+            }
+        }
+        if (healthy_count > 1) {
+            _gyro_estimate /= healthy_count;
+        }
+    }
+    _gyro_estimate += _gyro_bias;
+}
+
+// run the EKF once every div calls of update_fast()
+void AP_AHRS_NavEKF::set_ekf_rate_div(uint8_t div)
+{
+    _ekf_rate_div = max(div, 1);
+    _lanes.setIMURateDivider(_ekf_rate_div);
 }
 
 // accelerometer values in the earth frame in m/s/s
@@ -166,7 +256,7 @@ void AP_AHRS_NavEKF::reset(bool recover_eulers)
 {
     AP_AHRS_DCM::reset(recover_eulers);
     if (ekf_started) {
-        ekf_started = EKF.InitialiseFilterBootstrap();        
+        ekf_started = _lanes.InitialiseFilterBootstrap();        
     }
 }
 
@@ -175,7 +265,7 @@ void AP_AHRS_NavEKF::reset_attitude(const float &_roll, const float &_pitch, con
 {
     AP_AHRS_DCM::reset_attitude(_roll, _pitch, _yaw);
     if (ekf_started) {
-        ekf_started = EKF.InitialiseFilterBootstrap();        
+        ekf_started = _lanes.InitialiseFilterBootstrap();        
     }
 }
 
@@ -183,7 +273,7 @@ void AP_AHRS_NavEKF::reset_attitude(const float &_roll, const float &_pitch, con
 bool AP_AHRS_NavEKF::get_position(struct Location &loc) const
 {
     Vector3f ned_pos;
-    if (using_EKF() && EKF.getLLH(loc) && EKF.getPosNED(ned_pos)) {
+    if (using_EKF() && _lanes.getLLH(loc) && _lanes.getPosNED(ned_pos)) {
         // fixup altitude using relative position from AHRS home, not
         // EKF origin
         loc.alt = get_home().alt - ned_pos.z*100;
@@ -212,7 +302,7 @@ Vector3f AP_AHRS_NavEKF::wind_estimate(void)
         return AP_AHRS_DCM::wind_estimate();
     }
     Vector3f wind;
-    EKF.getWind(wind);
+    _lanes.active().getWind(wind);
     return wind;
 }
 
@@ -227,7 +317,7 @@ bool AP_AHRS_NavEKF::airspeed_estimate(float *airspeed_ret) const
 bool AP_AHRS_NavEKF::use_compass(void)
 {
     if (using_EKF()) {
-        return EKF.use_compass();
+        return _lanes.active().use_compass();
     }
     return AP_AHRS_DCM::use_compass();
 }
@@ -243,7 +333,7 @@ bool AP_AHRS_NavEKF::get_secondary_attitude(Vector3f &eulers)
     }
     if (ekf_started) {
         // EKF is secondary
-        EKF.getEulerAngles(eulers);
+        _lanes.active().getEulerAngles(eulers);
         return true;
     }
     // no secondary available
@@ -260,7 +350,7 @@ bool AP_AHRS_NavEKF::get_secondary_position(struct Location &loc)
     }    
     if (ekf_started) {
         // EKF is secondary
-        EKF.getLLH(loc);
+        _lanes.active().getLLH(loc);
         return true;
     }
     // no secondary available
@@ -274,7 +364,7 @@ Vector2f AP_AHRS_NavEKF::groundspeed_vector(void)
         return AP_AHRS_DCM::groundspeed_vector();
     }
     Vector3f vec;
-    EKF.getVelNED(vec);
+    _lanes.getVelNED(vec);
     return Vector2f(vec.x, vec.y);
 }
 
@@ -294,7 +384,7 @@ bool AP_AHRS_NavEKF::have_inertial_nav(void) const
 bool AP_AHRS_NavEKF::get_velocity_NED(Vector3f &vec) const
 {
     if (using_EKF()) {
-        EKF.getVelNED(vec);
+        _lanes.getVelNED(vec);
         return true;
     }
     return false;
@@ -305,7 +395,7 @@ bool AP_AHRS_NavEKF::get_velocity_NED(Vector3f &vec) const
 bool AP_AHRS_NavEKF::get_relative_position_NED(Vector3f &vec) const
 {
     if (using_EKF()) {
-        return EKF.getPosNED(vec);
+        return _lanes.getPosNED(vec);
     }
     return false;
 }
@@ -313,11 +403,11 @@ bool AP_AHRS_NavEKF::get_relative_position_NED(Vector3f &vec) const
 bool AP_AHRS_NavEKF::using_EKF(void) const
 {
     uint8_t ekf_faults;
-    EKF.getFilterFaults(ekf_faults);
+    _lanes.active().getFilterFaults(ekf_faults);
     // If EKF is started we switch away if it reports unhealthy. This could be due to bad
     // sensor data. If EKF reversion is inhibited, we only switch across if the EKF encounters
     // an internal processing error, but not for bad sensor data.
-    bool ret = ekf_started && ((_ekf_use == EKF_USE_WITH_FALLBACK && EKF.healthy()) || (_ekf_use == EKF_USE_WITHOUT_FALLBACK && ekf_faults == 0));
+    bool ret = ekf_started && ((_ekf_use == EKF_USE_WITH_FALLBACK && _lanes.active().healthy()) || (_ekf_use == EKF_USE_WITHOUT_FALLBACK && ekf_faults == 0));
     if (!ret) {
         return false;
     }
@@ -325,7 +415,7 @@ bool AP_AHRS_NavEKF::using_EKF(void) const
     if (_vehicle_class == AHRS_VEHICLE_FIXED_WING ||
         _vehicle_class == AHRS_VEHICLE_GROUND) {
         nav_filter_status filt_state;
-        EKF.getFilterStatus(filt_state);
+        _lanes.active().getFilterStatus(filt_state);
         if (hal.util->get_soft_armed() && !filt_state.flags.using_gps && _gps.status() >= AP_GPS::GPS_OK_FIX_3D) {
             // if the EKF is not fusing GPS and we have a 3D lock, then
             // plane and rover would prefer to use the GPS position from
@@ -356,7 +446,7 @@ bool AP_AHRS_NavEKF::healthy(void) const
     // sensor data. If EKF reversion is inhibited, we only switch across if the EKF encounters
     // an internal processing error, but not for bad sensor data.
     if (_ekf_use != EKF_DO_NOT_USE) {
-        bool ret = ekf_started && EKF.healthy();
+        bool ret = ekf_started && _lanes.active().healthy();
         if (!ret) {
             return false;
         }
@@ -389,26 +479,33 @@ bool AP_AHRS_NavEKF::initialised(void) const
 // write optical flow data to EKF
 void  AP_AHRS_NavEKF::writeOptFlowMeas(uint8_t &rawFlowQuality, Vector2f &rawFlowRates, Vector2f &rawGyroRates, uint32_t &msecFlowMeas)
 {
-    EKF.writeOptFlowMeas(rawFlowQuality, rawFlowRates, rawGyroRates, msecFlowMeas);
+    for (uint8_t i=0; i<_lanes.num_lanes(); i++) {
+        _lanes.get_lane(i).writeOptFlowMeas(rawFlowQuality, rawFlowRates, rawGyroRates, msecFlowMeas);
+    }
 }
 
 // inhibit GPS useage
 uint8_t AP_AHRS_NavEKF::setInhibitGPS(void)
 {
-    return EKF.setInhibitGPS();
+    for (uint8_t i=0; i<_lanes.num_lanes(); i++) {
+        if (i != _lanes.active_lane()) {
+            _lanes.get_lane(i).setInhibitGPS();
+        }
+    }
+    return _lanes.active().setInhibitGPS();
 }
 
 // get speed limit
 void AP_AHRS_NavEKF::getEkfControlLimits(float &ekfGndSpdLimit, float &ekfNavVelGainScaler)
 {
-    EKF.getEkfControlLimits(ekfGndSpdLimit,ekfNavVelGainScaler);
+    _lanes.active().getEkfControlLimits(ekfGndSpdLimit,ekfNavVelGainScaler);
 }
 
 // get compass offset estimates
 // true if offsets are valid
 bool AP_AHRS_NavEKF::getMagOffsets(Vector3f &magOffsets)
 {
-    bool status = EKF.getMagOffsets(magOffsets);
+    bool status = _lanes.active().getMagOffsets(magOffsets);
     return status;
 }
 
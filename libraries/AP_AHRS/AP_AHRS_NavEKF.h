@@ -26,9 +26,11 @@
 
 #if HAL_CPU_CLASS >= HAL_CPU_CLASS_150
 #include <AP_NavEKF.h>
+#include <AP_NavEKF_Lanes.h>
 
 #define AP_AHRS_NAVEKF_AVAILABLE 1
 #define AP_AHRS_NAVEKF_SETTLE_TIME_MS 20000     // time in milliseconds the ekf needs to settle after being started
+#define AP_AHRS_DCM_FALLBACK_DT 0.01f           // interval in seconds of DCM corrections while the ekf is in use
 
 class AP_AHRS_NavEKF : public AP_AHRS_DCM
 {
@@ -36,8 +38,9 @@ public:
     // Constructor
 AP_AHRS_NavEKF(AP_InertialSensor &ins, AP_Baro &baro, AP_GPS &gps, RangeFinder &rng, NavEKF &_EKF) :
     AP_AHRS_DCM(ins, baro, gps),
-        EKF(_EKF),
+        _lanes(this, baro, rng, _EKF),
         ekf_started(false),
+        _ekf_rate_div(1),
         startup_delay_ms(1000),
         start_time_ms(0)
         {
@@ -55,6 +58,9 @@ AP_AHRS_NavEKF(AP_InertialSensor &ins, AP_Baro &baro, AP_GPS &gps, RangeFinder &
     void reset_gyro_drift(void);
 
     void            update(void);
+    void            update_fast(void);
+    void            update_EKF(void);
+    void            set_ekf_rate_div(uint8_t div);
     void            reset(bool recover_eulers = false);
 
     // reset the current attitude, used on new IMU calibration
@@ -77,8 +83,13 @@ AP_AHRS_NavEKF(AP_InertialSensor &ins, AP_Baro &baro, AP_GPS &gps, RangeFinder &
     // true if compass is being used
     bool use_compass(void);
 
-    NavEKF &get_NavEKF(void) { return EKF; }
-    const NavEKF &get_NavEKF_const(void) const { return EKF; }
+    // the filter in use. This is the vehicle's NavEKF unless EKF
+    // lanes are enabled, when it is the selected lane
+    NavEKF &get_NavEKF(void) { return _lanes.active(); }
+    const NavEKF &get_NavEKF_const(void) const { return _lanes.active(); }
+
+    // all the filter lanes, for status reporting and logging
+    const NavEKF_Lanes &get_NavEKF_lanes(void) const { return _lanes; }
 
     // return secondary attitude solution if available, as eulers in radians
     bool get_secondary_attitude(Vector3f &eulers);
@@ -126,9 +137,12 @@ AP_AHRS_NavEKF(AP_InertialSensor &ins, AP_Baro &baro, AP_GPS &gps, RangeFinder &
 
 private:
     bool using_EKF(void) const;
+    void update_DCM_fallback(void);
+    void update_gyro_estimate(int8_t imu);
 
-    NavEKF &EKF;
+    NavEKF_Lanes _lanes;
     bool ekf_started;
+    uint8_t _ekf_rate_div;
     Matrix3f _dcm_matrix;
     Vector3f _dcm_attitude;
     Vector3f _gyro_bias;
@@ -23,6 +23,7 @@
 #include <AP_Common.h>
 #include <AP_ADC.h>
 #include <AP_Airspeed.h>
+#include <DataFlash.h>
 
 extern const AP_HAL::HAL& hal;
 
@@ -244,6 +245,10 @@ void AP_Airspeed::read(void)
     _raw_airspeed           = sqrtf(airspeed_pressure * _ratio);
     _airspeed               = 0.7f * _airspeed  +  0.3f * _raw_airspeed;
     _last_update_ms         = hal.scheduler->millis();
+
+    if (_dataflash != NULL) {
+        _dataflash->Log_Write_Replay_Airspeed(*this);
+    }
 }
 
 void AP_Airspeed::setHIL(float airspeed, float diff_pressure, float temperature)
@@ -13,6 +13,8 @@
 #include <AP_Airspeed_PX4.h>
 #include <AP_Airspeed_I2C.h>
 
+class DataFlash_Class;
+
 class Airspeed_Calibration {
 public:
     friend class AP_Airspeed;
@@ -49,6 +51,7 @@ public:
         _healthy(false),
         _hil_set(false),
         _last_update_ms(0),
+        _dataflash(NULL),
         _calibration(parms),
         _last_saved_ratio(0.0f),
         _counter(0),
@@ -156,6 +159,9 @@ public:
 
     void setHIL(float airspeed, float diff_pressure, float temperature);
 
+    // pass in a pointer to DataFlash for replay logging
+    void set_dataflash(DataFlash_Class *dataflash) { _dataflash = dataflash; }
+
     static const struct AP_Param::GroupInfo var_info[];
 
     enum pitot_tube_order { PITOT_TUBE_ORDER_POSITIVE =0, 
@@ -180,6 +186,7 @@ private:
     bool		    _hil_set:1;
     float           _hil_pressure;
     uint32_t        _last_update_ms;
+    DataFlash_Class *_dataflash;
 
     Airspeed_Calibration _calibration;
     float _last_saved_ratio;
@@ -23,6 +23,7 @@
 #include <AP_Common.h>
 #include <AP_Baro.h>
 #include <AP_HAL.h>
+#include <DataFlash.h>
 
 extern const AP_HAL::HAL& hal;
 
@@ -67,7 +68,8 @@ AP_Baro::AP_Baro() :
         _EAS2TAS(0.0f),
         _external_temperature(0.0f),
         _last_external_temperature_ms(0),
-        _hil_mode(false)
+        _hil_mode(false),
+        _dataflash(NULL)
 {
     memset(sensors, 0, sizeof(sensors));
 
@@ -332,6 +334,15 @@ void AP_Baro::update(void)
         }
     }
 
+    if (_dataflash != NULL && !_hil_mode) {
+        for (uint8_t i=0; i<_num_sensors; i++) {
+            if (sensors[i].last_update_ms != sensors[i].logged_ms) {
+                sensors[i].logged_ms = sensors[i].last_update_ms;
+                _dataflash->Log_Write_Replay_Baro(*this, i);
+            }
+        }
+    }
+
     // choose primary sensor
     _primary = 0;
     for (uint8_t i=0; i<_num_sensors; i++) {
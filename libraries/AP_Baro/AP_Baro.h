@@ -24,6 +24,7 @@
 #endif
 
 class AP_Baro_Backend;
+class DataFlash_Class;
 
 class AP_Baro
 {
@@ -103,7 +104,7 @@ public:
 
     // get last time sample was taken (in ms)
     uint32_t get_last_update(void) const { return get_last_update(_primary); }
-    uint32_t get_last_update(uint8_t instance) const { return sensors[_primary].last_update_ms; }
+    uint32_t get_last_update(uint8_t instance) const { return sensors[instance].last_update_ms; }
 
     // settable parameters
     static const struct AP_Param::GroupInfo var_info[];
@@ -117,6 +118,9 @@ public:
     // HIL (and SITL) interface, setting pressure and temperature
     void setHIL(uint8_t instance, float pressure, float temperature);
 
+    // HIL interface, setting the ground calibration. Used by Replay
+    void setHIL_ground(uint8_t instance, float pressure, float temperature);
+
     // register a new sensor, claiming a sensor slot. If we are out of
     // slots it will panic
     uint8_t register_sensor(void);
@@ -127,6 +131,9 @@ public:
     // enable HIL mode
     void set_hil_mode(void) { _hil_mode = true; }
 
+    // pass in a pointer to DataFlash for replay logging
+    void set_dataflash(DataFlash_Class *dataflash) { _dataflash = dataflash; }
+
 private:
     // how many drivers do we have?
     uint8_t _num_drivers;
@@ -146,6 +153,7 @@ private:
         float pressure;                 // pressure in Pascal
         float temperature;              // temperature in degrees C
         float altitude;                 // calculated altitude
+        uint32_t logged_ms;             // last_update_ms of the last replay log
         AP_Float ground_temperature;
         AP_Float ground_pressure;
     } sensors[BARO_MAX_INSTANCES];
@@ -157,6 +165,7 @@ private:
     uint32_t                            _last_external_temperature_ms;
     DerivativeFilterFloat_Size7         _climb_rate_filter;
     bool                                _hil_mode:1;
+    DataFlash_Class                     *_dataflash;
 
     void SimpleAtmosphere(const float alt, float &sigma, float &delta, float &theta);
 };
@@ -70,3 +70,16 @@ void AP_Baro::setHIL(uint8_t instance, float pressure, float temperature)
     sensors[instance].temperature = temperature;
     sensors[instance].last_update_ms = hal.scheduler->millis();
 }
+
+/*
+  set HIL ground pressure and temperature for an instance
+ */
+void AP_Baro::setHIL_ground(uint8_t instance, float pressure, float temperature)
+{
+    if (instance >= _num_sensors) {
+        // invalid
+        return;
+    }
+    sensors[instance].ground_pressure.set(pressure);
+    sensors[instance].ground_temperature.set(temperature);
+}
@@ -546,6 +546,7 @@ void AP_Compass_AK8963::_collect_samples()
         _mag_y_accum += _mag_y;
         _mag_z_accum += _mag_z;
         _accum_count++;
+        notify_new_sample();
         if (_accum_count == 10) {
              _mag_x_accum /= 2;
              _mag_y_accum /= 2;
@@ -31,10 +31,22 @@ void AP_Compass_Backend::publish_field(const Vector3f &mag, uint8_t instance)
         state.field.rotate((enum Rotation)state.orientation.get());
     }
 
+    state.uncorrected_field = state.field;
+
     apply_corrections(state.field, instance);
 
     state.last_update_ms = hal.scheduler->millis();
-    _compass._last_update_usec = hal.scheduler->micros();
+    state.last_update_usec = hal.scheduler->micros();
+    _compass._last_update_usec = state.last_update_usec;
+}
+
+/*
+  count a new raw sample, for drivers that accumulate samples
+  between calls to read()
+ */
+void AP_Compass_Backend::notify_new_sample(void)
+{
+    _compass._sample_count++;
 }
 
 /*
@@ -47,12 +59,14 @@ uint8_t AP_Compass_Backend::register_compass(void) const
 }    
 
 /*
-  apply offset and motor compensation corrections
+  apply offset, soft iron and motor compensation corrections
  */
 void AP_Compass_Backend::apply_corrections(Vector3f &mag, uint8_t i)
 {
     Compass::mag_state &state = _compass._state[i];
     const Vector3f &offsets = state.offset.get();
+    const Vector3f &diagonals = state.diagonals.get();
+    const Vector3f &offdiagonals = state.offdiagonals.get();
     const Vector3f &mot = state.motor_compensation.get();
 
     /*
@@ -60,6 +74,12 @@ void AP_Compass_Backend::apply_corrections(Vector3f &mag, uint8_t i)
       being applied so it can be logged correctly
      */
     mag += offsets;
+    if (!diagonals.is_zero()) {
+        Matrix3f mat(Vector3f(diagonals.x,    offdiagonals.x, offdiagonals.y),
+                     Vector3f(offdiagonals.x, diagonals.y,    offdiagonals.z),
+                     Vector3f(offdiagonals.y, offdiagonals.z, diagonals.z));
+        mag = mat * mag;
+    }
     if(_compass._motor_comp_type != AP_COMPASS_MOT_COMP_DISABLED && !is_zero(_compass._thr_or_curr)) {
         state.motor_offset = mot * _compass._thr_or_curr;
         mag += state.motor_offset;
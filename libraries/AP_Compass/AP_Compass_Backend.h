@@ -47,6 +47,9 @@ protected:
     // publish a magnetic field vector to the frontend
     void publish_field(const Vector3f &mag, uint8_t instance);
 
+    // tell the frontend a raw sample has been taken
+    void notify_new_sample(void);
+
     // register a new compass instance with the frontend
     uint8_t register_compass(void) const;
 
@@ -174,6 +174,7 @@ void AP_Compass_HMC5843::accumulate(void)
 	  _mag_y_accum += _mag_y;
 	  _mag_z_accum += _mag_z;
 	  _accum_count++;
+	  notify_new_sample();
 	  if (_accum_count == 14) {
 		 _mag_x_accum /= 2;
 		 _mag_y_accum /= 2;
@@ -135,6 +135,7 @@ void AP_Compass_PX4::accumulate(void)
             _sum[i] += Vector3f(mag_report.x, mag_report.y, mag_report.z);
             _count[i]++;
             _last_timestamp[i] = mag_report.timestamp;
+            notify_new_sample();
         }
     }
 }
@@ -3,6 +3,7 @@
 #include <AP_Progmem.h>
 #include "Compass.h"
 #include <AP_Vehicle.h>
+#include <DataFlash.h>
 
 extern AP_HAL::HAL& hal;
 
@@ -12,6 +13,18 @@ extern AP_HAL::HAL& hal;
 #define COMPASS_LEARN_DEFAULT 1
 #endif
 
+#if COMPASS_CAL_ENABLED
+// RMS residual in milligauss and time allowed for a calibration
+// started by the GCS, which fits an ellipsoid
+#define COMPASS_CAL_TOLERANCE       5.0f
+#define COMPASS_CAL_TIMEOUT_MS      180000
+
+// COMPASS_LEARN=2 fits only the offsets, with a looser tolerance as
+// the samples are taken in flight
+#define COMPASS_LEARN_TOLERANCE     10.0f
+#define COMPASS_LEARN_TIMEOUT_MS    600000
+#endif
+
 const AP_Param::GroupInfo Compass::var_info[] PROGMEM = {
     // index 0 was used for the old orientation matrix
 
@@ -45,8 +58,8 @@ const AP_Param::GroupInfo Compass::var_info[] PROGMEM = {
 
     // @Param: LEARN
     // @DisplayName: Learn compass offsets automatically
-    // @Description: Enable or disable the automatic learning of compass offsets
-    // @Values: 0:Disabled,1:Enabled
+    // @Description: Enable or disable the automatic learning of compass offsets. Batch learning fits the offsets to a sphere of samples in the background, and applies them without saving each time the fit succeeds
+    // @Values: 0:Disabled,1:Enabled,2:Batch learning
     // @User: Advanced
     AP_GROUPINFO("LEARN",  3, Compass, _learn, COMPASS_LEARN_DEFAULT),
 
@@ -267,6 +280,122 @@ const AP_Param::GroupInfo Compass::var_info[] PROGMEM = {
     AP_GROUPINFO("EXTERN3",23, Compass, _state[2].external, 0),
 #endif
 
+    // @Param: DIA_X
+    // @DisplayName: Compass soft iron diagonal X
+    // @Description: X element of the diagonal of the soft iron matrix applied to the field after the offsets. The matrix is not applied while all diagonals are zero
+    // @Range: 0.2 5
+    // @User: Advanced
+
+    // @Param: DIA_Y
+    // @DisplayName: Compass soft iron diagonal Y
+    // @Description: Y element of the diagonal of the soft iron matrix applied to the field after the offsets. The matrix is not applied while all diagonals are zero
+    // @Range: 0.2 5
+    // @User: Advanced
+
+    // @Param: DIA_Z
+    // @DisplayName: Compass soft iron diagonal Z
+    // @Description: Z element of the diagonal of the soft iron matrix applied to the field after the offsets. The matrix is not applied while all diagonals are zero
+    // @Range: 0.2 5
+    // @User: Advanced
+    AP_GROUPINFO("DIA",   24, Compass, _state[0].diagonals, 0),
+
+    // @Param: ODI_X
+    // @DisplayName: Compass soft iron off-diagonal XY
+    // @Description: XY element of the symmetric soft iron matrix applied to the field after the offsets
+    // @Range: -1 1
+    // @User: Advanced
+
+    // @Param: ODI_Y
+    // @DisplayName: Compass soft iron off-diagonal XZ
+    // @Description: XZ element of the symmetric soft iron matrix applied to the field after the offsets
+    // @Range: -1 1
+    // @User: Advanced
+
+    // @Param: ODI_Z
+    // @DisplayName: Compass soft iron off-diagonal YZ
+    // @Description: YZ element of the symmetric soft iron matrix applied to the field after the offsets
+    // @Range: -1 1
+    // @User: Advanced
+    AP_GROUPINFO("ODI",   25, Compass, _state[0].offdiagonals, 0),
+
+#if COMPASS_MAX_INSTANCES > 1
+    // @Param: DIA2_X
+    // @DisplayName: Compass2 soft iron diagonal X
+    // @Description: X element of the diagonal of the soft iron matrix applied to compass2's field after the offsets. The matrix is not applied while all diagonals are zero
+    // @Range: 0.2 5
+    // @User: Advanced
+
+    // @Param: DIA2_Y
+    // @DisplayName: Compass2 soft iron diagonal Y
+    // @Description: Y element of the diagonal of the soft iron matrix applied to compass2's field after the offsets. The matrix is not applied while all diagonals are zero
+    // @Range: 0.2 5
+    // @User: Advanced
+
+    // @Param: DIA2_Z
+    // @DisplayName: Compass2 soft iron diagonal Z
+    // @Description: Z element of the diagonal of the soft iron matrix applied to compass2's field after the offsets. The matrix is not applied while all diagonals are zero
+    // @Range: 0.2 5
+    // @User: Advanced
+    AP_GROUPINFO("DIA2",   26, Compass, _state[1].diagonals, 0),
+
+    // @Param: ODI2_X
+    // @DisplayName: Compass2 soft iron off-diagonal XY
+    // @Description: XY element of the symmetric soft iron matrix applied to compass2's field after the offsets
+    // @Range: -1 1
+    // @User: Advanced
+
+    // @Param: ODI2_Y
+    // @DisplayName: Compass2 soft iron off-diagonal XZ
+    // @Description: XZ element of the symmetric soft iron matrix applied to compass2's field after the offsets
+    // @Range: -1 1
+    // @User: Advanced
+
+    // @Param: ODI2_Z
+    // @DisplayName: Compass2 soft iron off-diagonal YZ
+    // @Description: YZ element of the symmetric soft iron matrix applied to compass2's field after the offsets
+    // @Range: -1 1
+    // @User: Advanced
+    AP_GROUPINFO("ODI2",   27, Compass, _state[1].offdiagonals, 0),
+
+    // @Param: DIA3_X
+    // @DisplayName: Compass3 soft iron diagonal X
+    // @Description: X element of the diagonal of the soft iron matrix applied to compass3's field after the offsets. The matrix is not applied while all diagonals are zero
+    // @Range: 0.2 5
+    // @User: Advanced
+
+    // @Param: DIA3_Y
+    // @DisplayName: Compass3 soft iron diagonal Y
+    // @Description: Y element of the diagonal of the soft iron matrix applied to compass3's field after the offsets. The matrix is not applied while all diagonals are zero
+    // @Range: 0.2 5
+    // @User: Advanced
+
+    // @Param: DIA3_Z
+    // @DisplayName: Compass3 soft iron diagonal Z
+    // @Description: Z element of the diagonal of the soft iron matrix applied to compass3's field after the offsets. The matrix is not applied while all diagonals are zero
+    // @Range: 0.2 5
+    // @User: Advanced
+    AP_GROUPINFO("DIA3",   28, Compass, _state[2].diagonals, 0),
+
+    // @Param: ODI3_X
+    // @DisplayName: Compass3 soft iron off-diagonal XY
+    // @Description: XY element of the symmetric soft iron matrix applied to compass3's field after the offsets
+    // @Range: -1 1
+    // @User: Advanced
+
+    // @Param: ODI3_Y
+    // @DisplayName: Compass3 soft iron off-diagonal XZ
+    // @Description: XZ element of the symmetric soft iron matrix applied to compass3's field after the offsets
+    // @Range: -1 1
+    // @User: Advanced
+
+    // @Param: ODI3_Z
+    // @DisplayName: Compass3 soft iron off-diagonal YZ
+    // @Description: YZ element of the symmetric soft iron matrix applied to compass3's field after the offsets
+    // @Range: -1 1
+    // @User: Advanced
+    AP_GROUPINFO("ODI3",   29, Compass, _state[2].offdiagonals, 0),
+#endif
+
     AP_GROUPEND
 };
 
@@ -276,12 +405,20 @@ const AP_Param::GroupInfo Compass::var_info[] PROGMEM = {
 //
 Compass::Compass(void) :
     _last_update_usec(0),
+    _sample_count(0),
     _backend_count(0),
     _compass_count(0),
     _board_orientation(ROTATION_NONE),
+    _have_earth_field(false),
     _null_init_done(false),
+#if COMPASS_CAL_ENABLED
+    _cal_autosave(false),
+    _cal_io_registered(false),
+    _cal_pending_mask(0),
+#endif
     _thr_or_curr(0.0f),
-    _hil_mode(false)
+    _hil_mode(false),
+    _dataflash(NULL)
 {
     AP_Param::setup_object_defaults(this, var_info);
     for (uint8_t i=0; i<COMPASS_MAX_BACKEND; i++) {
@@ -389,6 +526,19 @@ Compass::read(void)
     for (uint8_t i=0; i < COMPASS_MAX_INSTANCES; i++) {
         _state[i].healthy = (hal.scheduler->millis() - _state[i].last_update_ms < 500);
     }
+#if COMPASS_CAL_ENABLED
+    if (_cal_pending_mask != 0) {
+        _cal_update();
+    }
+#endif
+    if (_dataflash != NULL && !_hil_mode) {
+        for (uint8_t i=0; i < _compass_count; i++) {
+            if (_state[i].last_update_usec != _state[i].logged_usec) {
+                _state[i].logged_usec = _state[i].last_update_usec;
+                _dataflash->Log_Write_Replay_Compass(*this, i);
+            }
+        }
+    }
     return healthy();
 }
 
@@ -428,6 +578,119 @@ Compass::save_offsets(void)
     }
 }
 
+void
+Compass::set_and_save_soft_iron(uint8_t i, const Vector3f &diagonals, const Vector3f &offdiagonals)
+{
+    // sanity check compass instance provided
+    if (i < COMPASS_MAX_INSTANCES) {
+        _state[i].diagonals.set_and_save(diagonals);
+        _state[i].offdiagonals.set_and_save(offdiagonals);
+    }
+}
+
+#if COMPASS_CAL_ENABLED
+bool
+Compass::start_calibration_all(bool autosave)
+{
+    if (!_cal_io_registered) {
+        _cal_io_registered = true;
+        hal.scheduler->register_io_process(FUNCTOR_BIND_MEMBER(&Compass::_cal_io_timer, void));
+    }
+    cancel_calibration_all();
+    for (uint8_t i=0; i<_compass_count; i++) {
+        bool started;
+        if (autosave) {
+            started = _calibrator[i].start(false, COMPASS_CAL_TOLERANCE, COMPASS_CAL_TIMEOUT_MS);
+        } else {
+            started = _calibrator[i].start(true, COMPASS_LEARN_TOLERANCE, COMPASS_LEARN_TIMEOUT_MS);
+        }
+        if (!started) {
+            // a cancelled fit has not stopped yet, or there is no
+            // memory for the samples
+            cancel_calibration_all();
+            return false;
+        }
+        _cal_pending_mask |= (1U<<i);
+    }
+    _cal_autosave = autosave;
+    return _cal_pending_mask != 0;
+}
+
+void
+Compass::cancel_calibration_all(void)
+{
+    for (uint8_t i=0; i<_compass_count; i++) {
+        _calibrator[i].cancel();
+    }
+    _cal_pending_mask = 0;
+}
+
+bool
+Compass::is_calibrating(void) const
+{
+    for (uint8_t i=0; i<_compass_count; i++) {
+        CompassCalibrator::cal_status status = _calibrator[i].get_status();
+        if (status == CompassCalibrator::STATUS_COLLECTING ||
+            status == CompassCalibrator::STATUS_FITTING) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+  run the fits. Called on the IO thread
+ */
+void
+Compass::_cal_io_timer(void)
+{
+    for (uint8_t i=0; i<_compass_count; i++) {
+        _calibrator[i].update_fit();
+    }
+}
+
+/*
+  feed new samples to the calibrators and apply the results of the
+  ones that have finished
+ */
+void
+Compass::_cal_update(void)
+{
+    for (uint8_t i=0; i<_compass_count; i++) {
+        if (!(_cal_pending_mask & (1U<<i))) {
+            continue;
+        }
+        switch (_calibrator[i].get_status()) {
+        case CompassCalibrator::STATUS_COLLECTING:
+            if (_state[i].healthy) {
+                _calibrator[i].new_sample(_state[i].uncorrected_field);
+            }
+            break;
+
+        case CompassCalibrator::STATUS_SUCCESS: {
+            Vector3f offsets, diagonals, offdiagonals;
+            _calibrator[i].get_calibration(offsets, diagonals, offdiagonals);
+            if (_cal_autosave) {
+                set_and_save_offsets(i, offsets);
+                set_and_save_soft_iron(i, diagonals, offdiagonals);
+            } else {
+                set_offsets(i, offsets);
+            }
+            _cal_pending_mask &= ~(1U<<i);
+            break;
+        }
+
+        case CompassCalibrator::STATUS_FITTING:
+            break;
+
+        default:
+            _cal_pending_mask &= ~(1U<<i);
+            break;
+        }
+    }
+}
+#endif // COMPASS_CAL_ENABLED
+
 void
 Compass::set_motor_compensation(uint8_t i, const Vector3f &motor_comp_factor)
 {
@@ -446,17 +709,37 @@ Compass::save_motor_compensation()
 void
 Compass::set_initial_location(int32_t latitude, int32_t longitude)
 {
+    float intensity_gauss, declination_deg, inclination_deg;
+    _have_earth_field = AP_Declination::get_mag_field_ef((float)latitude / 10000000,
+                                                         (float)longitude / 10000000,
+                                                         intensity_gauss, declination_deg, inclination_deg);
+
     // if automatic declination is configured, then compute
     // the declination based on the initial GPS fix
     if (_auto_declination) {
         // Set the declination based on the lat/lng from GPS
-        _declination.set(radians(
-                AP_Declination::get_declination(
-                    (float)latitude / 10000000,
-                    (float)longitude / 10000000)));
+        _declination.set(radians(declination_deg));
+    }
+
+    if (_have_earth_field) {
+        float inclination = radians(inclination_deg);
+        float declination = radians(declination_deg);
+        _earth_field_ef = Vector3f(cosf(inclination) * cosf(declination),
+                                   cosf(inclination) * sinf(declination),
+                                   sinf(inclination)) * (intensity_gauss * 1000.0f);
     }
 }
 
+bool
+Compass::get_earth_field_ef(Vector3f &field) const
+{
+    if (!_have_earth_field) {
+        return false;
+    }
+    field = _earth_field_ef;
+    return true;
+}
+
 /// return true if the compass should be used for yaw calculations
 bool
 Compass::use_for_yaw(void) const
@@ -596,6 +879,7 @@ void Compass::setHIL(uint8_t instance, float roll, float pitch, float yaw)
         _hil.field[instance].rotate(_board_orientation);
     }
     _hil.healthy[instance] = true;
+    _sample_count++;
 }
 
 // Update raw magnetometer values from HIL mag vector
@@ -605,6 +889,24 @@ void Compass::setHIL(uint8_t instance, const Vector3f &mag)
     _hil.field[instance] = mag;
     _hil.healthy[instance] = true;
     _last_update_usec = hal.scheduler->micros();
+    _sample_count++;
+}
+
+/*
+  set the corrected field of an instance, bypassing the orientation,
+  offsets and motor compensation. Used by Replay
+ */
+void Compass::setHIL_field(uint8_t instance, const Vector3f &field)
+{
+    if (instance >= COMPASS_MAX_INSTANCES) {
+        return;
+    }
+    _hil.healthy[instance] = false;
+    _state[instance].field = field;
+    _state[instance].last_update_ms = hal.scheduler->millis();
+    _state[instance].last_update_usec = hal.scheduler->micros();
+    _last_update_usec = _state[instance].last_update_usec;
+    _sample_count++;
 }
 
 const Vector3f& Compass::getHIL(uint8_t instance) const 
@@ -615,13 +917,19 @@ const Vector3f& Compass::getHIL(uint8_t instance) const
 // setup _Bearth
 void Compass::_setup_earth_field(void)
 {
-    // assume a earth field strength of 400
-    _hil.Bearth(400, 0, 0);
+    // without the field at the initial location assume a strength
+    // of 400 and the inclination of -66 degrees in Canberra, Australia
+    float intensity = 400;
+    float inclination = ToRad(-66);
+    if (_have_earth_field) {
+        intensity = _earth_field_ef.length();
+        inclination = atan2f(_earth_field_ef.z, pythagorous2(_earth_field_ef.x, _earth_field_ef.y));
+    }
+    _hil.Bearth(intensity, 0, 0);
     
-    // rotate _Bearth for inclination and declination. -66 degrees
-    // is the inclination in Canberra, Australia
+    // rotate _Bearth for inclination and declination
     Matrix3f R;
-    R.from_euler(0, ToRad(66), get_declination());
+    R.from_euler(0, -inclination, get_declination());
     _hil.Bearth = R * _hil.Bearth;
 }
 
@@ -43,6 +43,19 @@
 #define COMPASS_MAX_BACKEND   1   
 #endif
 
+// batch calibration keeps a few KB of samples per compass
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+#define COMPASS_CAL_ENABLED 1
+#else
+#define COMPASS_CAL_ENABLED 0
+#endif
+
+#if COMPASS_CAL_ENABLED
+#include "CompassCalibrator.h"
+#endif
+
+class DataFlash_Class;
+
 class Compass
 {
 friend class AP_Compass_Backend;
@@ -141,6 +154,34 @@ public:
     ///
     void learn_offsets(void);
 
+#if COMPASS_CAL_ENABLED
+    /// Start a batch calibration of all compasses. The fitted offsets
+    /// and soft iron corrections are saved on success if autosave is set
+    ///
+    bool start_calibration_all(bool autosave);
+
+    /// Stop any running batch calibration
+    ///
+    void cancel_calibration_all(void);
+
+    /// true while any compass is collecting samples or being fitted
+    bool is_calibrating(void) const;
+
+    /// status, sphere coverage in percent and RMS residual in
+    /// milligauss of the calibration of one compass
+    CompassCalibrator::cal_status get_cal_status(uint8_t i) const { return _calibrator[i].get_status(); }
+    uint8_t get_cal_completion_percent(uint8_t i) const { return _calibrator[i].get_completion_percent(); }
+    float get_cal_fitness(uint8_t i) const { return _calibrator[i].get_fitness(); }
+#endif
+
+    /// Sets and saves the soft iron correction of one compass
+    ///
+    /// @param  i                   compass instance
+    /// @param  diagonals           diagonal of the soft iron matrix
+    /// @param  offdiagonals        xy, xz and yz elements of the soft iron matrix
+    ///
+    void set_and_save_soft_iron(uint8_t i, const Vector3f &diagonals, const Vector3f &offdiagonals);
+
     /// return true if the compass should be used for yaw calculations
     bool use_for_yaw(uint8_t i) const;
     bool use_for_yaw(void) const;
@@ -153,6 +194,14 @@ public:
     void set_declination(float radians, bool save_to_eeprom = true);
     float get_declination() const;
 
+    /// Returns the earth field at the initial location, north east
+    /// down in milligauss
+    ///
+    /// @returns                    false if it is not known, which is the
+    ///                             case without the fine declination grid
+    ///
+    bool get_earth_field_ef(Vector3f &field) const;
+
     // set overall board orientation
     void set_board_orientation(enum Rotation orientation) {
         _board_orientation = orientation;
@@ -225,14 +274,24 @@ public:
     // HIL methods
     void        setHIL(uint8_t instance, float roll, float pitch, float yaw);
     void        setHIL(uint8_t instance, const Vector3f &mag);
+    void        setHIL_field(uint8_t instance, const Vector3f &field);
     const Vector3f&   getHIL(uint8_t instance) const;
     void        _setup_earth_field();
 
     // enable HIL mode
     void        set_hil_mode(void) { _hil_mode = true; }
 
+    // pass in a pointer to DataFlash for replay logging
+    void        set_dataflash(DataFlash_Class *dataflash) { _dataflash = dataflash; }
+
     // return last update time in microseconds
     uint32_t last_update_usec(void) const { return _last_update_usec; }
+    uint32_t last_update_usec(uint8_t i) const { return _state[i].last_update_usec; }
+
+    // return a count of raw samples taken by the drivers. This
+    // changes whenever there is new data for read(), so it can be
+    // used to trigger a scheduler task
+    uint32_t sample_count(void) const { return _sample_count; }
 
     static const struct AP_Param::GroupInfo var_info[];
 
@@ -257,6 +316,9 @@ private:
     //< micros() time of last update
     uint32_t _last_update_usec;
 
+    // number of raw samples taken by the drivers
+    volatile uint32_t _sample_count;
+
     // backend objects
     AP_Compass_Backend *_backends[COMPASS_MAX_BACKEND];
     uint8_t     _backend_count;
@@ -279,9 +341,30 @@ private:
     // enable automatic declination code
     AP_Int8     _auto_declination;                  
 
+    // earth field from the declination tables at the initial location
+    Vector3f    _earth_field_ef;
+    bool        _have_earth_field;
+
     // first-time-around flag used by offset nulling
     bool        _null_init_done;                           
 
+#if COMPASS_CAL_ENABLED
+    CompassCalibrator _calibrator[COMPASS_MAX_INSTANCES];
+
+    // save the results of the running calibration, rather than only
+    // applying them as COMPASS_LEARN=2 does
+    bool        _cal_autosave;
+
+    // the fit runs on the IO thread, registered on first use
+    bool        _cal_io_registered;
+
+    // compasses whose calibration results have not been applied yet
+    uint8_t     _cal_pending_mask;
+
+    void        _cal_io_timer(void);
+    void        _cal_update(void);
+#endif
+
     // used by offset correction
     static const uint8_t _mag_history_size = 20;
 
@@ -312,6 +395,14 @@ private:
         // factors multiplied by throttle and added to compass outputs
         AP_Vector3f motor_compensation;
 
+        // symmetric soft iron matrix applied after the offsets. Not
+        // applied while the diagonals are zero
+        AP_Vector3f diagonals;
+        AP_Vector3f offdiagonals;
+
+        // rotated field before any corrections, for calibration
+        Vector3f    uncorrected_field;
+
         // latest compensation added to compass
         Vector3f    motor_offset;
 
@@ -320,10 +411,16 @@ private:
 
         // when we last got data
         uint32_t    last_update_ms;
+        uint32_t    last_update_usec;
+
+        // last_update_usec of the last replay log
+        uint32_t    logged_usec;
     } _state[COMPASS_MAX_INSTANCES];
 
     // if we want HIL only
     bool _hil_mode:1;
+
+    DataFlash_Class *_dataflash;
 };
 
 #include "AP_Compass_Backend.h"
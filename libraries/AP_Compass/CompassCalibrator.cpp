@@ -0,0 +1,454 @@
+/// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+
+#include <AP_HAL.h>
+#include "CompassCalibrator.h"
+
+extern const AP_HAL::HAL& hal;
+
+// samples needed before they are binned around their mean
+#define COMPASS_CAL_MIN_BINNED_SAMPLES  10
+
+// minimum distance in milligauss between the first samples
+#define COMPASS_CAL_MIN_SAMPLE_DIST     50.0f
+
+// minimum distance between samples in one bin, as a fraction of the radius
+#define COMPASS_CAL_MIN_BIN_SPREAD      0.1f
+
+// percentage of the bins that must hold a sample before fitting
+#define COMPASS_CAL_SPHERE_COVERAGE     50
+#define COMPASS_CAL_ELLIPSOID_COVERAGE  80
+
+// Levenberg-Marquardt iterations for each of the sphere and ellipsoid fits
+#define COMPASS_CAL_FIT_ITERATIONS      20
+
+// limits on the fitted corrections
+#define COMPASS_CAL_MIN_RADIUS          150.0f
+#define COMPASS_CAL_MAX_RADIUS          950.0f
+#define COMPASS_CAL_MAX_OFFSET          2000.0f
+#define COMPASS_CAL_MIN_DIAGONAL        0.2f
+#define COMPASS_CAL_MAX_DIAGONAL        5.0f
+#define COMPASS_CAL_MAX_OFFDIAGONAL     1.0f
+
+// indices into the fit parameters
+#define PARAM_RADIUS    0
+#define PARAM_OFFSET    1
+#define PARAM_DIAG      4
+#define PARAM_OFFDIAG   7
+
+CompassCalibrator::CompassCalibrator() :
+    _status(STATUS_NOT_STARTED),
+    _cancel_requested(false),
+    _sphere_only(false),
+    _tolerance(0),
+    _timeout_ms(0),
+    _start_ms(0),
+    _sample(NULL),
+    _sample_bin(NULL),
+    _num_samples(0),
+    _radius_est(0),
+    _completion(0),
+    _lambda(1),
+    _cost(0),
+    _iteration(0),
+    _ellipsoid_step(false),
+    _fitness(0)
+{
+    memset(_bin_count, 0, sizeof(_bin_count));
+    memset(_param, 0, sizeof(_param));
+}
+
+CompassCalibrator::~CompassCalibrator()
+{
+    free_samples();
+}
+
+CompassCalibrator::cal_status CompassCalibrator::get_status(void) const
+{
+    return (enum cal_status)__atomic_load_n(&_status, __ATOMIC_ACQUIRE);
+}
+
+void CompassCalibrator::set_status(enum cal_status status)
+{
+    __atomic_store_n(&_status, (uint8_t)status, __ATOMIC_RELEASE);
+}
+
+/*
+  the samples are only needed while collecting and fitting, so they
+  are allocated by start() and freed when the calibration ends,
+  rather than held for every compass for the life of the vehicle
+ */
+bool CompassCalibrator::alloc_samples(void)
+{
+    if (_sample == NULL) {
+        _sample = (Vector3f *)malloc(sizeof(Vector3f) * COMPASS_CAL_NUM_SAMPLES);
+    }
+    if (_sample_bin == NULL) {
+        _sample_bin = (uint8_t *)malloc(COMPASS_CAL_NUM_SAMPLES);
+    }
+    if (_sample == NULL || _sample_bin == NULL) {
+        free_samples();
+        return false;
+    }
+    return true;
+}
+
+void CompassCalibrator::free_samples(void)
+{
+    free(_sample);
+    _sample = NULL;
+    free(_sample_bin);
+    _sample_bin = NULL;
+}
+
+bool CompassCalibrator::start(bool sphere_only, float tolerance, uint32_t timeout_ms)
+{
+    if (get_status() == STATUS_FITTING) {
+        return false;
+    }
+    if (!alloc_samples()) {
+        set_status(STATUS_NOT_STARTED);
+        return false;
+    }
+    _sphere_only = sphere_only;
+    _tolerance = tolerance;
+    _timeout_ms = timeout_ms;
+    _start_ms = hal.scheduler->millis();
+    _num_samples = 0;
+    _sample_sum.zero();
+    _radius_est = 0;
+    _completion = 0;
+    _fitness = 0;
+    memset(_bin_count, 0, sizeof(_bin_count));
+    _cancel_requested = false;
+    set_status(STATUS_COLLECTING);
+    return true;
+}
+
+void CompassCalibrator::cancel(void)
+{
+    if (get_status() == STATUS_FITTING) {
+        // the IO thread owns the samples until it sees the request
+        __atomic_store_n(&_cancel_requested, true, __ATOMIC_RELEASE);
+        return;
+    }
+    free_samples();
+    set_status(STATUS_NOT_STARTED);
+}
+
+/*
+  the bin of a sample, by the direction of the sample from the centre
+ */
+uint8_t CompassCalibrator::bin_index(const Vector3f &v, const Vector3f &centre) const
+{
+    Vector3f d = v - centre;
+    float len = d.length();
+    if (is_zero(len)) {
+        return 0;
+    }
+    // bands of equal height have equal area on a sphere
+    int16_t band = (d.z / len + 1.0f) * 0.5f * COMPASS_CAL_NUM_BANDS;
+    int16_t sector = (atan2f(d.y, d.x) + PI) / (2*PI) * COMPASS_CAL_NUM_SECTORS;
+    band = constrain_int16(band, 0, COMPASS_CAL_NUM_BANDS-1);
+    sector = constrain_int16(sector, 0, COMPASS_CAL_NUM_SECTORS-1);
+    return band * COMPASS_CAL_NUM_SECTORS + sector;
+}
+
+/*
+  re-bin all samples around their mean, which moves towards the
+  centre of the sphere as the coverage grows
+ */
+void CompassCalibrator::update_bins(void)
+{
+    Vector3f centre = _sample_sum / _num_samples;
+    memset(_bin_count, 0, sizeof(_bin_count));
+    float radius_sum = 0;
+    uint8_t covered = 0;
+    for (uint16_t i=0; i<_num_samples; i++) {
+        uint8_t bin = bin_index(_sample[i], centre);
+        _sample_bin[i] = bin;
+        if (_bin_count[bin] == 0) {
+            covered++;
+        }
+        if (_bin_count[bin] < 255) {
+            _bin_count[bin]++;
+        }
+        radius_sum += (_sample[i] - centre).length();
+    }
+    _radius_est = radius_sum / _num_samples;
+    _completion = (uint16_t)covered * 100 / COMPASS_CAL_NUM_BINS;
+}
+
+void CompassCalibrator::new_sample(const Vector3f &field)
+{
+    if (get_status() != STATUS_COLLECTING) {
+        return;
+    }
+
+    if (hal.scheduler->millis() - _start_ms > _timeout_ms) {
+        _fitness = 0;
+        free_samples();
+        set_status(STATUS_FAILED);
+        return;
+    }
+
+    if (field.is_nan() || field.is_inf() || _num_samples >= COMPASS_CAL_NUM_SAMPLES) {
+        return;
+    }
+
+    if (_num_samples < COMPASS_CAL_MIN_BINNED_SAMPLES) {
+        // too few samples to estimate the centre, so only require
+        // them to be apart
+        for (uint16_t i=0; i<_num_samples; i++) {
+            if ((_sample[i] - field).length() < COMPASS_CAL_MIN_SAMPLE_DIST) {
+                return;
+            }
+        }
+    } else {
+        // the bin must have room, and the sample must be apart from the
+        // others in its bin
+        uint8_t bin = bin_index(field, _sample_sum / _num_samples);
+        if (_bin_count[bin] >= COMPASS_CAL_SAMPLES_PER_BIN) {
+            return;
+        }
+        float min_dist = _radius_est * COMPASS_CAL_MIN_BIN_SPREAD;
+        for (uint16_t i=0; i<_num_samples; i++) {
+            if (_sample_bin[i] == bin && (_sample[i] - field).length() < min_dist) {
+                return;
+            }
+        }
+    }
+
+    _sample[_num_samples++] = field;
+    _sample_sum += field;
+    update_bins();
+
+    uint8_t required = _sphere_only ? COMPASS_CAL_SPHERE_COVERAGE : COMPASS_CAL_ELLIPSOID_COVERAGE;
+    if (_num_samples >= COMPASS_CAL_MIN_BINNED_SAMPLES && _completion >= required) {
+        start_fit();
+        set_status(STATUS_FITTING);
+    }
+}
+
+/*
+  the residual of one sample and its derivatives with respect to the
+  parameters being fitted. The sphere fit varies the radius and
+  offsets, the ellipsoid fit the offsets and the soft iron matrix
+ */
+float CompassCalibrator::calc_residual(const Vector3f &sample, const float *param, float *jacobian) const
+{
+    Vector3f v = sample + Vector3f(param[PARAM_OFFSET], param[PARAM_OFFSET+1], param[PARAM_OFFSET+2]);
+
+    if (!_ellipsoid_step) {
+        float len = v.length();
+        if (jacobian != NULL) {
+            jacobian[0] = 1;
+            jacobian[1] = -v.x / len;
+            jacobian[2] = -v.y / len;
+            jacobian[3] = -v.z / len;
+        }
+        return param[PARAM_RADIUS] - len;
+    }
+
+    Matrix3f M(Vector3f(param[PARAM_DIAG],      param[PARAM_OFFDIAG],   param[PARAM_OFFDIAG+1]),
+               Vector3f(param[PARAM_OFFDIAG],   param[PARAM_DIAG+1],    param[PARAM_OFFDIAG+2]),
+               Vector3f(param[PARAM_OFFDIAG+1], param[PARAM_OFFDIAG+2], param[PARAM_DIAG+2]));
+    Vector3f w = M * v;
+    float len = w.length();
+    if (jacobian != NULL) {
+        // offsets
+        jacobian[0] = -(w.x*M.a.x + w.y*M.b.x + w.z*M.c.x) / len;
+        jacobian[1] = -(w.x*M.a.y + w.y*M.b.y + w.z*M.c.y) / len;
+        jacobian[2] = -(w.x*M.a.z + w.y*M.b.z + w.z*M.c.z) / len;
+        // diagonals
+        jacobian[3] = -(w.x*v.x) / len;
+        jacobian[4] = -(w.y*v.y) / len;
+        jacobian[5] = -(w.z*v.z) / len;
+        // off diagonals, each of which appears twice in the matrix
+        jacobian[6] = -(w.x*v.y + w.y*v.x) / len;
+        jacobian[7] = -(w.x*v.z + w.z*v.x) / len;
+        jacobian[8] = -(w.y*v.z + w.z*v.y) / len;
+    }
+    return param[PARAM_RADIUS] - len;
+}
+
+float CompassCalibrator::calc_cost(const float *param) const
+{
+    float cost = 0;
+    for (uint16_t i=0; i<_num_samples; i++) {
+        cost += sq(calc_residual(_sample[i], param, NULL));
+    }
+    return cost;
+}
+
+/*
+  initial estimate for the sphere fit: centred on the mean of the
+  samples, with their mean distance from it as the radius
+ */
+void CompassCalibrator::start_fit(void)
+{
+    Vector3f centre = _sample_sum / _num_samples;
+    _param[PARAM_RADIUS] = _radius_est;
+    _param[PARAM_OFFSET]   = -centre.x;
+    _param[PARAM_OFFSET+1] = -centre.y;
+    _param[PARAM_OFFSET+2] = -centre.z;
+    _param[PARAM_DIAG] = _param[PARAM_DIAG+1] = _param[PARAM_DIAG+2] = 1;
+    _param[PARAM_OFFDIAG] = _param[PARAM_OFFDIAG+1] = _param[PARAM_OFFDIAG+2] = 0;
+    _ellipsoid_step = false;
+    _iteration = 0;
+    _lambda = 1;
+    _cost = calc_cost(_param);
+}
+
+/*
+  solve A x = b for a symmetric positive definite n x n matrix A by
+  Gaussian elimination with partial pivoting. A and b are overwritten
+ */
+static bool solve_linear(float A[9][9], float b[9], float x[9], uint8_t n)
+{
+    for (uint8_t col=0; col<n; col++) {
+        uint8_t pivot = col;
+        for (uint8_t row=col+1; row<n; row++) {
+            if (fabsf(A[row][col]) > fabsf(A[pivot][col])) {
+                pivot = row;
+            }
+        }
+        if (fabsf(A[pivot][col]) < FLT_EPSILON) {
+            return false;
+        }
+        if (pivot != col) {
+            for (uint8_t k=0; k<n; k++) {
+                float tmp = A[col][k];
+                A[col][k] = A[pivot][k];
+                A[pivot][k] = tmp;
+            }
+            float tmp = b[col];
+            b[col] = b[pivot];
+            b[pivot] = tmp;
+        }
+        for (uint8_t row=col+1; row<n; row++) {
+            float f = A[row][col] / A[col][col];
+            for (uint8_t k=col; k<n; k++) {
+                A[row][k] -= f * A[col][k];
+            }
+            b[row] -= f * b[col];
+        }
+    }
+    for (int8_t row=n-1; row>=0; row--) {
+        float sum = b[row];
+        for (uint8_t k=row+1; k<n; k++) {
+            sum -= A[row][k] * x[k];
+        }
+        x[row] = sum / A[row][row];
+    }
+    return true;
+}
+
+/*
+  one Levenberg-Marquardt iteration. The step is kept if it lowers
+  the cost, and the damping is reduced, otherwise the damping is
+  increased for the next try
+ */
+void CompassCalibrator::update_fit(void)
+{
+    if (get_status() != STATUS_FITTING) {
+        return;
+    }
+    if (__atomic_load_n(&_cancel_requested, __ATOMIC_ACQUIRE)) {
+        free_samples();
+        set_status(STATUS_NOT_STARTED);
+        return;
+    }
+
+    const uint8_t n = _ellipsoid_step ? 9 : 4;
+    const uint8_t first = _ellipsoid_step ? PARAM_OFFSET : PARAM_RADIUS;
+
+    float JTJ[9][9];
+    float JTr[9];
+    memset(JTJ, 0, sizeof(JTJ));
+    memset(JTr, 0, sizeof(JTr));
+    for (uint16_t i=0; i<_num_samples; i++) {
+        float J[9];
+        float r = calc_residual(_sample[i], _param, J);
+        for (uint8_t j=0; j<n; j++) {
+            for (uint8_t k=j; k<n; k++) {
+                JTJ[j][k] += J[j] * J[k];
+            }
+            JTr[j] += J[j] * r;
+        }
+    }
+
+    float A[9][9];
+    float b[9];
+    float delta[9];
+    for (uint8_t j=0; j<n; j++) {
+        for (uint8_t k=0; k<n; k++) {
+            A[j][k] = (k >= j) ? JTJ[j][k] : JTJ[k][j];
+        }
+        A[j][j] += _lambda * JTJ[j][j];
+        b[j] = -JTr[j];
+    }
+
+    if (solve_linear(A, b, delta, n)) {
+        float trial[10];
+        memcpy(trial, _param, sizeof(trial));
+        for (uint8_t j=0; j<n; j++) {
+            trial[first+j] += delta[j];
+        }
+        float cost = calc_cost(trial);
+        if (!isnan(cost) && cost < _cost) {
+            memcpy(_param, trial, sizeof(_param));
+            _cost = cost;
+            _lambda = max(_lambda * 0.1f, 1.0e-6f);
+        } else {
+            _lambda = min(_lambda * 10.0f, 1.0e6f);
+        }
+    } else {
+        _lambda = min(_lambda * 10.0f, 1.0e6f);
+    }
+
+    if (++_iteration < COMPASS_CAL_FIT_ITERATIONS) {
+        return;
+    }
+    if (!_ellipsoid_step && !_sphere_only) {
+        // refine the sphere into an ellipsoid with the radius held
+        _ellipsoid_step = true;
+        _iteration = 0;
+        _lambda = 1;
+        _cost = calc_cost(_param);
+        return;
+    }
+    finish_fit();
+}
+
+bool CompassCalibrator::fit_acceptable(void) const
+{
+    if (isnan(_fitness) || _fitness > _tolerance) {
+        return false;
+    }
+    if (_param[PARAM_RADIUS] < COMPASS_CAL_MIN_RADIUS || _param[PARAM_RADIUS] > COMPASS_CAL_MAX_RADIUS) {
+        return false;
+    }
+    for (uint8_t i=0; i<3; i++) {
+        if (fabsf(_param[PARAM_OFFSET+i]) > COMPASS_CAL_MAX_OFFSET ||
+            _param[PARAM_DIAG+i] < COMPASS_CAL_MIN_DIAGONAL ||
+            _param[PARAM_DIAG+i] > COMPASS_CAL_MAX_DIAGONAL ||
+            fabsf(_param[PARAM_OFFDIAG+i]) > COMPASS_CAL_MAX_OFFDIAGONAL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CompassCalibrator::finish_fit(void)
+{
+    _fitness = sqrtf(_cost / _num_samples);
+    free_samples();
+    set_status(fit_acceptable() ? STATUS_SUCCESS : STATUS_FAILED);
+}
+
+void CompassCalibrator::get_calibration(Vector3f &offsets, Vector3f &diagonals, Vector3f &offdiagonals) const
+{
+    offsets = Vector3f(_param[PARAM_OFFSET], _param[PARAM_OFFSET+1], _param[PARAM_OFFSET+2]);
+    diagonals = Vector3f(_param[PARAM_DIAG], _param[PARAM_DIAG+1], _param[PARAM_DIAG+2]);
+    offdiagonals = Vector3f(_param[PARAM_OFFDIAG], _param[PARAM_OFFDIAG+1], _param[PARAM_OFFDIAG+2]);
+}
@@ -0,0 +1,124 @@
+/// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+  batch calibration of one compass
+
+  Samples of the uncorrected field are kept in bins of equal area on a
+  sphere around the mean of the samples, with a few samples per bin,
+  so the fit is not biased towards the orientations the vehicle spends
+  the most time in. Once enough of the sphere is covered the samples
+  are handed to the IO thread, which fits a sphere (radius and
+  offsets) and then an ellipsoid (offsets and a symmetric soft iron
+  matrix) with Levenberg-Marquardt, one iteration per call.
+ */
+
+#ifndef CompassCalibrator_H
+#define CompassCalibrator_H
+
+#include <AP_Math.h>
+
+// bins of equal area: bands of equal height along z, each divided
+// into sectors of equal azimuth
+#define COMPASS_CAL_NUM_BANDS       6
+#define COMPASS_CAL_NUM_SECTORS     12
+#define COMPASS_CAL_NUM_BINS        (COMPASS_CAL_NUM_BANDS*COMPASS_CAL_NUM_SECTORS)
+#define COMPASS_CAL_SAMPLES_PER_BIN 3
+#define COMPASS_CAL_NUM_SAMPLES     (COMPASS_CAL_NUM_BINS*COMPASS_CAL_SAMPLES_PER_BIN)
+
+class CompassCalibrator
+{
+public:
+    enum cal_status {
+        STATUS_NOT_STARTED = 0,
+        STATUS_COLLECTING  = 1,
+        STATUS_FITTING     = 2,
+        STATUS_SUCCESS     = 3,
+        STATUS_FAILED      = 4
+    };
+
+    CompassCalibrator();
+    ~CompassCalibrator();
+
+    // start collecting samples. With sphere_only only the offsets are
+    // fitted, which needs less of the sphere to be covered. Returns
+    // false while a fit is running or if the samples can't be allocated
+    bool start(bool sphere_only, float tolerance, uint32_t timeout_ms);
+
+    // stop a calibration. A running fit is stopped by the IO thread
+    void cancel(void);
+
+    // add a sample of the uncorrected field. Main thread only
+    void new_sample(const Vector3f &field);
+
+    // run the next step of the fit. IO thread only
+    void update_fit(void);
+
+    enum cal_status get_status(void) const;
+
+    // percentage of the bins that hold a sample
+    uint8_t get_completion_percent(void) const { return _completion; }
+
+    // RMS residual of the fit in milligauss. Valid after the fit
+    float get_fitness(void) const { return _fitness; }
+
+    // the fitted corrections, valid once the status is STATUS_SUCCESS.
+    // The corrected field is the soft iron matrix times (field + offsets)
+    void get_calibration(Vector3f &offsets, Vector3f &diagonals, Vector3f &offdiagonals) const;
+
+private:
+    // the status hands the samples from the main thread to the IO
+    // thread and the results back, so it is accessed with atomics
+    uint8_t _status;
+    bool _cancel_requested;
+
+    bool _sphere_only;
+    float _tolerance;
+    uint32_t _timeout_ms;
+    uint32_t _start_ms;
+
+    // collection. The samples are only allocated while calibrating,
+    // by start() and freed when the calibration ends
+    Vector3f *_sample;
+    uint8_t *_sample_bin;
+    uint16_t _num_samples;
+    Vector3f _sample_sum;
+    float _radius_est;
+    uint8_t _bin_count[COMPASS_CAL_NUM_BINS];
+    uint8_t _completion;
+
+    // fit parameters: radius, offsets, diagonals and off diagonals
+    float _param[10];
+    float _lambda;
+    float _cost;
+    uint8_t _iteration;
+    bool _ellipsoid_step;
+    float _fitness;
+
+    uint8_t bin_index(const Vector3f &v, const Vector3f &centre) const;
+    void update_bins(void);
+    void set_status(enum cal_status status);
+    bool alloc_samples(void);
+    void free_samples(void);
+
+    float calc_residual(const Vector3f &sample, const float *param, float *jacobian) const;
+    float calc_cost(const float *param) const;
+    void start_fit(void);
+    void finish_fit(void);
+    bool fit_acceptable(void) const;
+};
+
+#endif // CompassCalibrator_H
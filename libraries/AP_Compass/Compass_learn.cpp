@@ -32,6 +32,17 @@ Compass::learn_offsets(void)
         return;
     }
 
+    if (_learn == 2) {
+#if COMPASS_CAL_ENABLED
+        // batch learning, restarted each time a fit finishes. A
+        // calibration started by the GCS runs to completion first
+        if (_cal_pending_mask == 0 && !is_calibrating()) {
+            start_calibration_all(false);
+        }
+#endif
+        return;
+    }
+
     // this gain is set so we converge on the offsets in about 5
     // minutes with a 10Hz compass
     const float gain = 0.01f;
@@ -117,8 +117,83 @@ static const row_value declination_values[] PROGMEM = \
 
 #define PGM_UINT8(p) pgm_read_byte_far(p)
 
+#if AP_DECLINATION_HIRES
+#include "AP_Declination_tables.h"
+
+static float interpolate(float u, float v, float SW, float SE, float NW, float NE)
+{
+    float south = SW + v * (SE - SW);
+    float north = NW + v * (NE - NW);
+    return south + u * (north - south);
+}
+
+/*
+  bilinear interpolation in the fine grid, which takes the same few
+  table reads anywhere, unlike decoding the rows of the coarse table
+ */
+bool
+AP_Declination::get_mag_field_ef(float lat, float lon, float &intensity_gauss, float &declination_deg, float &inclination_deg)
+{
+    lat = constrain_float(lat, AP_DECLINATION_SAMPLING_MIN_LAT, AP_DECLINATION_SAMPLING_MAX_LAT);
+    lon = constrain_float(lon, AP_DECLINATION_SAMPLING_MIN_LON, AP_DECLINATION_SAMPLING_MAX_LON);
+
+    float lat_pos = (lat - AP_DECLINATION_SAMPLING_MIN_LAT) / AP_DECLINATION_SAMPLING_RES;
+    float lon_pos = (lon - AP_DECLINATION_SAMPLING_MIN_LON) / AP_DECLINATION_SAMPLING_RES;
+    uint16_t i = lat_pos;
+    uint16_t j = lon_pos;
+    if (i > AP_DECLINATION_NUM_LAT-2) {
+        i = AP_DECLINATION_NUM_LAT-2;
+    }
+    if (j > AP_DECLINATION_NUM_LON-2) {
+        j = AP_DECLINATION_NUM_LON-2;
+    }
+    float u = lat_pos - i;
+    float v = lon_pos - j;
+
+    // the declination wraps around near the poles, so the corners are
+    // taken relative to the south west one
+    float decSW = declination_table[i][j];
+    float decSE = decSW + wrap_180_cd_float(declination_table[i][j+1] - decSW);
+    float decNW = decSW + wrap_180_cd_float(declination_table[i+1][j] - decSW);
+    float decNE = decSW + wrap_180_cd_float(declination_table[i+1][j+1] - decSW);
+    declination_deg = wrap_180_cd_float(interpolate(u, v, decSW, decSE, decNW, decNE)) * 0.01f;
+
+    inclination_deg = interpolate(u, v,
+                                  inclination_table[i][j], inclination_table[i][j+1],
+                                  inclination_table[i+1][j], inclination_table[i+1][j+1]) * 0.01f;
+
+    intensity_gauss = interpolate(u, v,
+                                  intensity_table[i][j], intensity_table[i][j+1],
+                                  intensity_table[i+1][j], intensity_table[i+1][j+1]) * 1.0e-4f;
+    return true;
+}
+
 float
 AP_Declination::get_declination(float lat, float lon)
+{
+    float intensity_gauss, declination_deg, inclination_deg;
+    get_mag_field_ef(lat, lon, intensity_gauss, declination_deg, inclination_deg);
+    return declination_deg;
+}
+#else
+bool
+AP_Declination::get_mag_field_ef(float lat, float lon, float &intensity_gauss, float &declination_deg, float &inclination_deg)
+{
+    declination_deg = get_declination_coarse(lat, lon);
+    inclination_deg = 0;
+    intensity_gauss = 0;
+    return false;
+}
+
+float
+AP_Declination::get_declination(float lat, float lon)
+{
+    return get_declination_coarse(lat, lon);
+}
+#endif // AP_DECLINATION_HIRES
+
+float
+AP_Declination::get_declination_coarse(float lat, float lon)
 {
     int16_t decSW, decSE, decNW, decNE, lonmin, latmin;
     uint8_t latmin_index,lonmin_index;
@@ -3,6 +3,25 @@
 #ifndef AP_Declination_h
 #define AP_Declination_h
 
+#include <AP_HAL_Boards.h>
+
+/*
+  Linux class boards look the field up in a fine grid, generated into
+  AP_Declination_tables.h from the World Magnetic Model coefficients
+  by generate/generate.py. Other boards use the compressed 5 degree
+  declination table
+ */
+#ifndef AP_DECLINATION_HIRES
+# if HAL_CPU_CLASS >= HAL_CPU_CLASS_1000 && defined(__has_include)
+#  if __has_include("AP_Declination_tables.h")
+#   define AP_DECLINATION_HIRES 1
+#  endif
+# endif
+#endif
+#ifndef AP_DECLINATION_HIRES
+# define AP_DECLINATION_HIRES 0
+#endif
+
 /*
  *	Adam M Rivera
  *	With direction from: Andrew Tridgell, Jason Short, Justin Beech
@@ -15,7 +34,16 @@
 class AP_Declination
 {
 public:
+    // declination in degrees
     static float            get_declination(float lat, float lon);
+
+    // earth field at sea level, with the intensity in gauss and the
+    // angles in degrees. Returns false, with only the declination
+    // set, on boards without the fine grid
+    static bool             get_mag_field_ef(float lat, float lon, float &intensity_gauss, float &declination_deg, float &inclination_deg);
+
+    // declination in degrees from the compressed 5 degree table
+    static float            get_declination_coarse(float lat, float lon);
 private:
     static int16_t          get_lookup_value(uint8_t x, uint8_t y);
 };
@@ -11,6 +11,7 @@
 #include <Filter.h>
 
 #include <AP_HAL_AVR.h>
+#include <AP_HAL_Linux.h>
 
 const AP_HAL::HAL& hal = AP_HAL_BOARD_DRIVER;
 
@@ -81,6 +82,39 @@ static float get_declination(float lat, float lon)
     return (lat - latmin) / 5 * (decmax - decmin) + decmin;
 }
 
+#if AP_DECLINATION_HIRES
+/*
+  field at reference points, evaluated directly from the WMM2015
+  coefficients at the date the fine grid was generated for
+ */
+static const struct {
+    float lat, lon;
+    float declination, inclination;
+    float intensity;
+} field_ref[] = {
+    {  40.015f, -105.270f,   8.44f,  66.45f, 0.5217f },
+    {  51.480f,   -0.002f,  -0.47f,  66.44f, 0.4875f },
+    { -35.280f,  149.130f,  12.36f, -65.90f, 0.5813f },
+    { -33.870f,  151.210f,  12.57f, -64.30f, 0.5707f },
+    {  37.620f, -122.380f,  13.51f,  61.09f, 0.4820f },
+    {  48.850f,    2.350f,   0.53f,  64.29f, 0.4806f },
+    {  35.680f,  139.690f,  -7.46f,  49.55f, 0.4662f },
+    { -22.910f,  -43.170f, -22.74f, -40.00f, 0.2320f },
+    {   1.350f,  103.820f,   0.22f, -13.79f, 0.4206f },
+    {  64.140f,  -21.940f, -13.90f,  75.50f, 0.5239f },
+    { -54.800f,  -68.300f,  12.42f, -50.83f, 0.3175f },
+    {  55.750f,   37.620f,  11.06f,  71.42f, 0.5247f },
+    {  28.610f,   77.210f,   1.19f,  44.90f, 0.4813f },
+    {  -1.290f,   36.820f,   0.59f, -23.56f, 0.3349f },
+    {  61.220f, -149.900f,  16.42f,  74.25f, 0.5558f },
+    { -41.290f,  174.780f,  22.53f, -66.42f, 0.5594f },
+    {  19.430f,  -99.130f,   4.73f,  47.17f, 0.4042f },
+    {  30.040f,   31.240f,   4.35f,  44.50f, 0.4354f },
+    { -26.200f,   28.050f, -18.79f, -62.83f, 0.2829f },
+    {  45.500f,  -73.570f, -14.45f,  70.05f, 0.5382f },
+};
+#endif
+
 void setup(void)
 {
     float declination, declination_test;
@@ -94,7 +128,7 @@ void setup(void)
         for(int16_t j = -180; j <= 180; j+=5)
         {
             uint32_t t1 = hal.scheduler->micros();
-            declination = AP_Declination::get_declination(i, j);
+            declination = AP_Declination::get_declination_coarse(i, j);
             total_time += hal.scheduler->micros() - t1;
             declination_test = get_declination(i, j);
             if(declination == declination_test)
@@ -114,6 +148,75 @@ void setup(void)
     hal.console->printf("Total Fail: %i\n", fail);
     hal.console->printf("Average time per call: %.1f usec\n",
                   total_time/(float)(pass+fail));
+
+#if AP_DECLINATION_HIRES
+    /*
+      the fine grid comes from a newer field model, so it is compared
+      with the 5 degree table between the grid points as well, away
+      from the poles where the declination is not meaningful
+     */
+    float max_error = 0, sum_error = 0;
+    uint16_t count = 0;
+    uint32_t coarse_time = 0, fine_time = 0;
+
+    /*
+      interpolating the 1 degree grid should be within 0.2 degrees and
+      0.002 gauss of the model at the reference points
+     */
+    pass = 0;
+    fail = 0;
+    hal.console->print("\nChecking fine grid against reference points...\n");
+    for (uint8_t i=0; i<sizeof(field_ref)/sizeof(field_ref[0]); i++) {
+        float intensity, inclination;
+        if (!AP_Declination::get_mag_field_ef(field_ref[i].lat, field_ref[i].lon,
+                                              intensity, declination, inclination)) {
+            hal.console->printf("FAIL: %.2f, %.2f : no field\n",
+                                field_ref[i].lat, field_ref[i].lon);
+            fail++;
+            continue;
+        }
+        if (fabsf(declination - field_ref[i].declination) > 0.2f ||
+            fabsf(inclination - field_ref[i].inclination) > 0.2f ||
+            fabsf(intensity - field_ref[i].intensity) > 0.002f) {
+            hal.console->printf("FAIL: %.2f, %.2f : %.2f %.2f %.4f, %.2f %.2f %.4f\n",
+                                field_ref[i].lat, field_ref[i].lon,
+                                declination, inclination, intensity,
+                                field_ref[i].declination, field_ref[i].inclination,
+                                field_ref[i].intensity);
+            fail++;
+        } else {
+            pass++;
+        }
+    }
+    hal.console->printf("Total Pass: %i\n", pass);
+    hal.console->printf("Total Fail: %i\n", fail);
+
+    hal.console->print("\nComparing fine grid with 5 degree table...\n");
+
+    for(float lat = -60; lat <= 60; lat += 0.7f)
+    {
+        for(float lon = -180; lon <= 180; lon += 0.7f)
+        {
+            float intensity, inclination;
+            uint32_t t1 = hal.scheduler->micros();
+            float coarse = AP_Declination::get_declination_coarse(lat, lon);
+            uint32_t t2 = hal.scheduler->micros();
+            AP_Declination::get_mag_field_ef(lat, lon, intensity, declination, inclination);
+            uint32_t t3 = hal.scheduler->micros();
+            coarse_time += t2 - t1;
+            fine_time += t3 - t2;
+
+            float error = fabsf(wrap_180_cd_float((declination - coarse)*100)) * 0.01f;
+            max_error = max(max_error, error);
+            sum_error += error;
+            count++;
+        }
+    }
+    hal.console->printf("Declination difference: mean %.2f max %.2f degrees\n",
+                        sum_error/count, max_error);
+    hal.console->printf("Average time per call: coarse %.2f usec fine %.2f usec\n",
+                        coarse_time/(float)count, fine_time/(float)count);
+#endif
 }
 
 void loop(void)
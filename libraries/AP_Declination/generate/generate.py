@@ -0,0 +1,209 @@
+#!/usr/bin/env python
+'''
+generate the fine grid of the earth magnetic field used by
+AP_Declination on boards with AP_DECLINATION_HIRES
+
+The field is evaluated from the spherical harmonic coefficients of the
+World Magnetic Model, read from the WMM.COF file distributed by NOAA,
+at sea level on a regular latitude/longitude grid. Declination and
+inclination are stored in centidegrees and intensity in units of
+0.1 milligauss, so the tables are plain int16 arrays.
+
+usage: generate.py WMM.COF [--resolution DEG] [--date YEAR] [--output FILE]
+'''
+
+import sys, math, datetime
+from argparse import ArgumentParser
+
+parser = ArgumentParser(description=__doc__)
+parser.add_argument("coffile", help="WMM coefficient file")
+parser.add_argument("--resolution", type=float, default=1.0, help="grid spacing in degrees")
+parser.add_argument("--date", type=float, default=None, help="decimal year to evaluate the model at, defaults to today")
+parser.add_argument("--output", default="../AP_Declination_tables.h", help="output header")
+args = parser.parse_args()
+
+# WGS84 ellipsoid and the WMM reference radius, in km
+WGS84_A = 6378.137
+WGS84_F = 1/298.257223563
+WGS84_E2 = WGS84_F*(2-WGS84_F)
+WMM_RE = 6371.2
+
+def load_cof(filename):
+    '''load a WMM.COF file, returning the epoch, model name and
+    coefficients, which are indexed by [n][m]'''
+    f = open(filename)
+    header = f.readline().split()
+    epoch = float(header[0])
+    model = header[1]
+    g = {}
+    h = {}
+    gdot = {}
+    hdot = {}
+    nmax = 0
+    for line in f:
+        if line.startswith('9999'):
+            break
+        v = line.split()
+        if len(v) < 6:
+            continue
+        n, m = int(v[0]), int(v[1])
+        g[(n,m)], h[(n,m)], gdot[(n,m)], hdot[(n,m)] = [float(x) for x in v[2:6]]
+        nmax = max(nmax, n)
+    f.close()
+    return epoch, model, nmax, g, h, gdot, hdot
+
+def decimal_year(d):
+    '''decimal year of a date'''
+    start = datetime.date(d.year, 1, 1)
+    end = datetime.date(d.year+1, 1, 1)
+    return d.year + float((d - start).days) / (end - start).days
+
+class WMM(object):
+    def __init__(self, filename, date):
+        epoch, self.model, self.nmax, g, h, gdot, hdot = load_cof(filename)
+        self.epoch = epoch
+        if date < epoch or date > epoch + 5:
+            sys.stderr.write("warning: %.2f is outside the 5 year validity of %s\n" % (date, self.model))
+        dt = date - epoch
+
+        # Schmidt semi-normalisation factors, folded into the
+        # coefficients so the Legendre functions can be computed with
+        # the simpler Gauss normalised recursion
+        nmax = self.nmax
+        S = [[0.0]*(nmax+1) for n in range(nmax+1)]
+        S[0][0] = 1.0
+        for n in range(1, nmax+1):
+            S[n][0] = S[n-1][0] * (2*n-1) / float(n)
+            for m in range(1, n+1):
+                j = 2 if m == 1 else 1
+                S[n][m] = S[n][m-1] * math.sqrt(float((n-m+1)*j) / (n+m))
+
+        self.g = [[0.0]*(nmax+1) for n in range(nmax+1)]
+        self.h = [[0.0]*(nmax+1) for n in range(nmax+1)]
+        for (n,m) in g:
+            self.g[n][m] = S[n][m] * (g[(n,m)] + dt*gdot[(n,m)])
+            self.h[n][m] = S[n][m] * (h[(n,m)] + dt*hdot[(n,m)])
+
+        # recursion factors for the Gauss normalised functions
+        self.K = [[0.0]*(nmax+1) for n in range(nmax+1)]
+        for n in range(2, nmax+1):
+            for m in range(0, n+1):
+                self.K[n][m] = float((n-1)**2 - m**2) / ((2*n-1)*(2*n-3))
+
+    def field(self, lat_deg, lon_deg):
+        '''return the north, east and down field in nT at sea level'''
+        nmax = self.nmax
+
+        # geodetic to geocentric
+        lat = math.radians(lat_deg)
+        lon = math.radians(lon_deg)
+        rc = WGS84_A / math.sqrt(1 - WGS84_E2*math.sin(lat)**2)
+        xp = rc * math.cos(lat)
+        zp = rc * (1 - WGS84_E2) * math.sin(lat)
+        r = math.sqrt(xp**2 + zp**2)
+        lat_gc = math.asin(zp / r)
+
+        # Legendre functions of the geocentric colatitude and their
+        # derivatives with respect to it
+        ct = math.sin(lat_gc)
+        st = math.cos(lat_gc)
+        P = [[0.0]*(nmax+1) for n in range(nmax+1)]
+        dP = [[0.0]*(nmax+1) for n in range(nmax+1)]
+        P[0][0] = 1.0
+        for n in range(1, nmax+1):
+            for m in range(0, n+1):
+                if n == m:
+                    P[n][m] = st * P[n-1][m-1]
+                    dP[n][m] = st * dP[n-1][m-1] + ct * P[n-1][m-1]
+                elif n == 1:
+                    P[n][m] = ct * P[n-1][m]
+                    dP[n][m] = ct * dP[n-1][m] - st * P[n-1][m]
+                else:
+                    p2 = P[n-2][m] if m <= n-2 else 0.0
+                    dp2 = dP[n-2][m] if m <= n-2 else 0.0
+                    P[n][m] = ct * P[n-1][m] - self.K[n][m] * p2
+                    dP[n][m] = ct * dP[n-1][m] - st * P[n-1][m] - self.K[n][m] * dp2
+
+        # field in the geocentric frame
+        X = Y = Z = 0.0
+        for n in range(1, nmax+1):
+            aor = (WMM_RE / r) ** (n+2)
+            for m in range(0, n+1):
+                cm = math.cos(m*lon)
+                sm = math.sin(m*lon)
+                t1 = self.g[n][m]*cm + self.h[n][m]*sm
+                t2 = self.g[n][m]*sm - self.h[n][m]*cm
+                X += aor * t1 * dP[n][m]
+                Y += aor * m * t2 * P[n][m]
+                Z -= aor * (n+1) * t1 * P[n][m]
+        Y /= st
+
+        # rotate back to the geodetic frame
+        psi = lat_gc - lat
+        north = X*math.cos(psi) - Z*math.sin(psi)
+        down = X*math.sin(psi) + Z*math.cos(psi)
+        return north, Y, down
+
+if args.date is None:
+    args.date = decimal_year(datetime.date.today())
+
+wmm = WMM(args.coffile, args.date)
+
+res = args.resolution
+num_lat = int(round(180.0/res)) + 1
+num_lon = int(round(360.0/res)) + 1
+if abs((num_lat-1)*res - 180) > 1.0e-6 or abs((num_lon-1)*res - 360) > 1.0e-6:
+    sys.stderr.write("resolution must divide 180 degrees\n")
+    sys.exit(1)
+
+declination = []
+inclination = []
+intensity = []
+for i in range(num_lat):
+    # the field is not defined in azimuth at the poles, so sample
+    # just short of them
+    lat = max(min(-90 + i*res, 89.99), -89.99)
+    drow = []
+    irow = []
+    frow = []
+    for j in range(num_lon):
+        lon = -180 + j*res
+        north, east, down = wmm.field(lat, lon)
+        horizontal = math.sqrt(north**2 + east**2)
+        drow.append(int(round(math.degrees(math.atan2(east, north))*100)))
+        irow.append(int(round(math.degrees(math.atan2(down, horizontal))*100)))
+        # 1 nT is 0.01 milligauss
+        frow.append(int(round(math.sqrt(horizontal**2 + down**2) * 0.1)))
+    declination.append(drow)
+    inclination.append(irow)
+    intensity.append(frow)
+
+def write_table(f, ctype, name, table):
+    f.write("static const %s %s[AP_DECLINATION_NUM_LAT][AP_DECLINATION_NUM_LON] = {\n" % (ctype, name))
+    for row in table:
+        f.write("    {" + ",".join([str(v) for v in row]) + "},\n")
+    f.write("};\n\n")
+
+f = open(args.output, "w")
+f.write('''// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+  earth magnetic field at sea level from %s (epoch %.1f) for %.2f,
+  on a %g degree grid. Generated by generate/generate.py, do not edit
+ */
+
+#define AP_DECLINATION_SAMPLING_RES     %.2ff
+#define AP_DECLINATION_SAMPLING_MIN_LAT -90.0f
+#define AP_DECLINATION_SAMPLING_MAX_LAT 90.0f
+#define AP_DECLINATION_SAMPLING_MIN_LON -180.0f
+#define AP_DECLINATION_SAMPLING_MAX_LON 180.0f
+#define AP_DECLINATION_NUM_LAT          %u
+#define AP_DECLINATION_NUM_LON          %u
+
+// declination and inclination in centidegrees, intensity in 0.1 milligauss
+
+''' % (wmm.model, wmm.epoch, args.date, res, res, num_lat, num_lon))
+write_table(f, "int16_t", "declination_table", declination)
+write_table(f, "int16_t", "inclination_table", inclination)
+write_table(f, "uint16_t", "intensity_table", intensity)
+f.close()
+print("Wrote %s: %u x %u grid from %s for %.2f" % (args.output, num_lat, num_lon, wmm.model, args.date))
@@ -19,6 +19,7 @@
 #include <AP_HAL.h>
 #include <AP_Notify.h>
 #include <AP_GPS.h>
+#include <DataFlash.h>
 
 extern const AP_HAL::HAL& hal;
 
@@ -49,8 +50,8 @@ const AP_Param::GroupInfo AP_GPS::var_info[] PROGMEM = {
 #if GPS_MAX_INSTANCES > 1
     // @Param: AUTO_SWITCH
     // @DisplayName: Automatic Switchover Setting
-    // @Description: Automatic switchover to GPS reporting best lock
-    // @Values: 0:Disabled,1:Enabled
+    // @Description: Automatic switchover to GPS reporting best lock. When set to blend the receivers reporting their accuracy are combined into one solution, weighted by their accuracy, and the primary GPS only switches if none can be blended
+    // @Values: 0:Disabled,1:Enabled,2:Blend
     // @User: Advanced
     AP_GROUPINFO("AUTO_SWITCH", 3, AP_GPS, _auto_switch, 1),
 #endif
@@ -84,7 +85,7 @@ const AP_Param::GroupInfo AP_GPS::var_info[] PROGMEM = {
     // @Param: INJECT_TO
     // @DisplayName: Destination for GPS_INJECT_DATA MAVLink packets
     // @Description: The GGS can send raw serial packets to inject data to multiple GPSes.
-    // @Values: 0,1: send to specified instance. 127: broadcast
+    // @Values: 0,1,2: send to specified instance. 127: broadcast
     AP_GROUPINFO("INJECT_TO",   7, AP_GPS, _inject_to, 127),
 
 #endif
@@ -106,6 +107,48 @@ const AP_Param::GroupInfo AP_GPS::var_info[] PROGMEM = {
     AP_GROUPINFO("RAW_DATA", 9, AP_GPS, _raw_data, 0),
 #endif
 
+#if GPS_MAX_INSTANCES > 2
+    // @Param: TYPE3
+    // @DisplayName: 3rd GPS type
+    // @Description: GPS type of 3rd GPS
+    // @Values: 0:None,1:AUTO,2:uBlox,3:MTK,4:MTK19,5:NMEA,6:SiRF,7:HIL,8:SwiftNav,9:PX4-UAVCAN
+    AP_GROUPINFO("TYPE3",   10, AP_GPS, _type[2], 0),
+#endif
+
+#if GPS_BLENDING_AVAILABLE
+    // @Param: DELAY_MS
+    // @DisplayName: GPS delay
+    // @Description: Delay from the time of a fix of the 1st GPS to when it is received. If zero the delay is estimated as 200ms plus any extra delay seen relative to the other receivers. Used to align the receivers when blending
+    // @Units: milliseconds
+    // @Range: 0 250
+    // @User: Advanced
+    AP_GROUPINFO("DELAY_MS", 11, AP_GPS, _delay_ms[0], 0),
+
+    // @Param: DELAY_MS2
+    // @DisplayName: 2nd GPS delay
+    // @Description: Delay from the time of a fix of the 2nd GPS to when it is received. If zero the delay is estimated as 200ms plus any extra delay seen relative to the other receivers. Used to align the receivers when blending
+    // @Units: milliseconds
+    // @Range: 0 250
+    // @User: Advanced
+    AP_GROUPINFO("DELAY_MS2", 12, AP_GPS, _delay_ms[1], 0),
+
+    // @Param: DELAY_MS3
+    // @DisplayName: 3rd GPS delay
+    // @Description: Delay from the time of a fix of the 3rd GPS to when it is received. If zero the delay is estimated as 200ms plus any extra delay seen relative to the other receivers. Used to align the receivers when blending
+    // @Units: milliseconds
+    // @Range: 0 250
+    // @User: Advanced
+    AP_GROUPINFO("DELAY_MS3", 13, AP_GPS, _delay_ms[2], 0),
+
+    // @Param: BLEND_TC
+    // @DisplayName: Blending time constant
+    // @Description: Time constant over which a change in the blended position caused by a receiver joining or leaving the blend, or by a change of weights, is removed. Zero applies the change at once
+    // @Units: seconds
+    // @Range: 0 30
+    // @User: Advanced
+    AP_GROUPINFO("BLEND_TC", 14, AP_GPS, _blend_tc, 10.0f),
+#endif
+
     AP_GROUPEND
 };
 
@@ -122,6 +165,12 @@ void AP_GPS::init(DataFlash_Class *dataflash, const AP_SerialManager& serial_man
     _port[1] = serial_manager.find_serial(AP_SerialManager::SerialProtocol_GPS, 1);
     _last_instance_swap_ms = 0;
 #endif
+#if GPS_MAX_INSTANCES > 2
+    _port[2] = serial_manager.find_serial(AP_SerialManager::SerialProtocol_GPS, 2);
+#endif
+#if GPS_BLENDING_AVAILABLE
+    _blend = blend_state();
+#endif
 }
 
 // baudrates to try to detect GPSes with
@@ -282,6 +331,18 @@ found_gps:
 AP_GPS::GPS_Status 
 AP_GPS::highest_supported_status(uint8_t instance) const
 {
+#if GPS_BLENDING_AVAILABLE
+    if (instance == GPS_BLENDED_INSTANCE) {
+        // the best of the receivers in the blend
+        GPS_Status highest = AP_GPS::GPS_OK_FIX_3D;
+        for (uint8_t i=0; i<GPS_MAX_INSTANCES; i++) {
+            if ((_blend.mask & (1U<<i)) && highest_supported_status(i) > highest) {
+                highest = highest_supported_status(i);
+            }
+        }
+        return highest;
+    }
+#endif
 #if GPS_RTK_AVAILABLE
     if (drivers[instance] != NULL)
         return drivers[instance]->highest_supported_status();
@@ -292,12 +353,7 @@ AP_GPS::highest_supported_status(uint8_t instance) const
 AP_GPS::GPS_Status 
 AP_GPS::highest_supported_status(void) const
 {
-#if GPS_RTK_AVAILABLE
-
-    if (drivers[primary_instance] != NULL)
-        return drivers[primary_instance]->highest_supported_status();
-#endif
-    return AP_GPS::GPS_OK_FIX_3D;
+    return highest_supported_status(primary_instance);
 }
 
 
@@ -347,12 +403,21 @@ AP_GPS::update_instance(uint8_t instance)
             state[instance].instance = instance;
             state[instance].status = NO_GPS;
             timing[instance].last_message_time_ms = tnow;
+#if GPS_BLENDING_AVAILABLE
+            timing[instance].last_gps_time_ms = 0;
+#endif
         }
     } else {
         timing[instance].last_message_time_ms = tnow;
         if (state[instance].status >= GPS_OK_FIX_2D) {
             timing[instance].last_fix_time_ms = tnow;
         }
+#if GPS_BLENDING_AVAILABLE
+        update_lag_estimate(instance);
+#endif
+        if (_DataFlash != NULL) {
+            _DataFlash->Log_Write_Replay_GPS(*this, instance);
+        }
     }
 }
 
@@ -366,49 +431,96 @@ AP_GPS::update(void)
         update_instance(i);
     }
 
+    update_primary();
+
+	// update notify with gps status. We always base this on the primary_instance
+    AP_Notify::flags.gps_status = state[primary_instance].status;
+}
+
+/*
+  work out which GPS is the primary, and how many sensors we have
+ */
+void
+AP_GPS::update_primary(void)
+{
 #if GPS_MAX_INSTANCES > 1
-    // work out which GPS is the primary, and how many sensors we have
     for (uint8_t i=0; i<GPS_MAX_INSTANCES; i++) {
         if (state[i].status != NO_GPS) {
             num_instances = i+1;
         }
-        if (_auto_switch) {            
-            if (i == primary_instance) {
-                continue;
-            }
-            if (state[i].status > state[primary_instance].status) {
-                // we have a higher status lock, change GPS
-                primary_instance = i;
-                continue;
-            }
+    }
 
-            bool another_gps_has_1_or_more_sats = (state[i].num_sats >= state[primary_instance].num_sats + 1);
+#if GPS_BLENDING_AVAILABLE
+    if (_auto_switch == 2 && update_blend()) {
+        primary_instance = GPS_BLENDED_INSTANCE;
+        return;
+    }
+    if (primary_instance == GPS_BLENDED_INSTANCE) {
+        // nothing to blend. Fall back to the receiver that carried
+        // the most weight
+        primary_instance = _blend.heaviest;
+        _last_instance_swap_ms = hal.scheduler->millis();
+    }
+#endif
+
+    if (!_auto_switch) {
+        primary_instance = 0;
+        return;
+    }
+
+    for (uint8_t i=0; i<GPS_MAX_INSTANCES; i++) {
+        if (i == primary_instance) {
+            continue;
+        }
+        if (state[i].status > state[primary_instance].status) {
+            // we have a higher status lock, change GPS
+            primary_instance = i;
+            continue;
+        }
 
-            if (state[i].status == state[primary_instance].status && another_gps_has_1_or_more_sats) {
+        bool another_gps_has_1_or_more_sats = (state[i].num_sats >= state[primary_instance].num_sats + 1);
 
-                uint32_t now = hal.scheduler->millis();
-                bool another_gps_has_2_or_more_sats = (state[i].num_sats >= state[primary_instance].num_sats + 2);
+        if (state[i].status == state[primary_instance].status && another_gps_has_1_or_more_sats) {
 
-                if ( (another_gps_has_1_or_more_sats && (now - _last_instance_swap_ms) >= 20000) ||
-                     (another_gps_has_2_or_more_sats && (now - _last_instance_swap_ms) >= 5000 ) ) {
-                // this GPS has more satellites than the
-                // current primary, switch primary. Once we switch we will
-                // then tend to stick to the new GPS as primary. We don't
-                // want to switch too often as it will look like a
-                // position shift to the controllers.
-                primary_instance = i;
-                _last_instance_swap_ms = now;
-                }
+            uint32_t now = hal.scheduler->millis();
+            bool another_gps_has_2_or_more_sats = (state[i].num_sats >= state[primary_instance].num_sats + 2);
+
+            if ( (another_gps_has_1_or_more_sats && (now - _last_instance_swap_ms) >= 20000) ||
+                 (another_gps_has_2_or_more_sats && (now - _last_instance_swap_ms) >= 5000 ) ) {
+            // this GPS has more satellites than the
+            // current primary, switch primary. Once we switch we will
+            // then tend to stick to the new GPS as primary. We don't
+            // want to switch too often as it will look like a
+            // position shift to the controllers.
+            primary_instance = i;
+            _last_instance_swap_ms = now;
             }
-        } else {
-            primary_instance = 0;
         }
     }
 #else
     num_instances = 1;
 #endif // GPS_MAX_INSTANCES
-	// update notify with gps status. We always base this on the primary_instance
-    AP_Notify::flags.gps_status = state[primary_instance].status;
+}
+
+/*
+  drivers stamp the fixes they take GPS time from with the arrival of
+  the message. Fall back to the time the fix was processed for
+  drivers that do not stamp every fix
+ */
+uint32_t
+AP_GPS::fix_arrival_ms(uint8_t instance) const
+{
+#if GPS_BLENDING_AVAILABLE
+    if (instance == GPS_BLENDED_INSTANCE) {
+        return state[instance].last_gps_time_ms;
+    }
+#endif
+    uint32_t arrival_ms = _GPS_STATE(instance).last_gps_time_ms;
+    uint32_t processed_ms = _GPS_TIMING(instance).last_message_time_ms;
+    if (processed_ms - arrival_ms > 100) {
+        return processed_ms;
+    }
+    return arrival_ms;
 }
 
 /*
@@ -440,6 +552,50 @@ AP_GPS::setHIL(uint8_t instance, GPS_Status _status, uint64_t time_epoch_ms,
     timing[instance].last_message_time_ms = tnow;
     timing[instance].last_fix_time_ms = tnow;
     _type[instance].set(GPS_TYPE_HIL);
+#if GPS_BLENDING_AVAILABLE
+    update_lag_estimate(instance);
+#endif
+}
+
+/*
+  set HIL (hardware in the loop) accuracies for a GPS instance
+ */
+void
+AP_GPS::setHIL_accuracy(uint8_t instance, float hacc, float vacc, float sacc)
+{
+    if (instance >= GPS_MAX_INSTANCES) {
+        return;
+    }
+    GPS_State &istate = state[instance];
+    istate.horizontal_accuracy = hacc;
+    istate.vertical_accuracy = vacc;
+    istate.speed_accuracy = sacc;
+    istate.have_horizontal_accuracy = (hacc >= 0);
+    istate.have_vertical_accuracy = (vacc >= 0);
+    istate.have_speed_accuracy = (sacc >= 0);
+}
+
+/*
+  set the state of a GPS instance from replay logging. The fix is
+  taken to have been processed now
+ */
+void
+AP_GPS::setHIL_state(uint8_t instance, const GPS_State &istate)
+{
+    if (instance >= GPS_MAX_INSTANCES) {
+        return;
+    }
+    uint32_t tnow = hal.scheduler->millis();
+    state[instance] = istate;
+    state[instance].instance = instance;
+    timing[instance].last_message_time_ms = tnow;
+    if (istate.status >= GPS_OK_FIX_2D) {
+        timing[instance].last_fix_time_ms = tnow;
+    }
+    _type[instance].set(GPS_TYPE_HIL);
+#if GPS_BLENDING_AVAILABLE
+    update_lag_estimate(instance);
+#endif
 }
 
 /**
@@ -574,3 +730,275 @@ AP_GPS::send_mavlink_gps2_rtk(mavlink_channel_t chan)
 }
 #endif
 #endif
+
+#if GPS_BLENDING_AVAILABLE
+/*
+  default lag of the receiver with the least lag, and the longest a
+  receiver can go without a message and stay in the blend
+ */
+#define GPS_DEFAULT_LAG_MS 200
+#define GPS_MAX_EXTRA_LAG_MS 500
+#define GPS_BLEND_TIMEOUT_MS 1500
+
+/*
+  track the difference between the system time a fix arrives and its
+  GPS time. All receivers share GPS time, so the difference between
+  two receivers is the difference in their lags. Messages can be held
+  up but never arrive early, so track the smallest difference, creeping
+  up slowly to follow drift between the clocks
+ */
+void
+AP_GPS::update_lag_estimate(uint8_t instance)
+{
+    const GPS_State &istate = state[instance];
+    GPS_timing &itiming = timing[instance];
+    if (istate.last_gps_time_ms == itiming.last_gps_time_ms ||
+        istate.status < GPS_OK_FIX_2D) {
+        // no new GPS time
+        return;
+    }
+    int32_t offset = (int32_t)(istate.last_gps_time_ms - istate.time_week_ms);
+    int32_t change = offset - itiming.arrival_offset_ms;
+    if (itiming.last_gps_time_ms == 0 || change < 0 || change > 1000) {
+        // a big change is a week rollover or a restarted receiver
+        itiming.arrival_offset_ms = offset;
+    } else {
+        itiming.arrival_offset_ms += (change + 31) / 32;
+    }
+    itiming.last_gps_time_ms = istate.last_gps_time_ms;
+}
+
+/*
+  lag in milliseconds of a receiver, either as set by the user or
+  estimated from its lag relative to the other receivers
+ */
+uint16_t
+AP_GPS::lag_ms(uint8_t instance) const
+{
+    if (_delay_ms[instance] > 0) {
+        return _delay_ms[instance];
+    }
+    if (timing[instance].last_gps_time_ms == 0) {
+        return GPS_DEFAULT_LAG_MS;
+    }
+    int32_t least = timing[instance].arrival_offset_ms;
+    for (uint8_t i=0; i<GPS_MAX_INSTANCES; i++) {
+        if (timing[i].last_gps_time_ms != 0 &&
+            state[i].status >= GPS_OK_FIX_2D &&
+            timing[i].arrival_offset_ms < least) {
+            least = timing[i].arrival_offset_ms;
+        }
+    }
+    int32_t extra = timing[instance].arrival_offset_ms - least;
+    return GPS_DEFAULT_LAG_MS + constrain_int32(extra, 0, GPS_MAX_EXTRA_LAG_MS);
+}
+
+/*
+  the expected lag in seconds of an instance
+ */
+float
+AP_GPS::get_lag(uint8_t instance) const
+{
+    if (instance == GPS_BLENDED_INSTANCE) {
+        return _blend.lag_ms * 0.001f;
+    }
+    if (instance >= GPS_MAX_INSTANCES) {
+        return GPS_DEFAULT_LAG_MS * 0.001f;
+    }
+    return lag_ms(instance) * 0.001f;
+}
+
+/*
+  blend the receivers with a 3D fix and a horizontal accuracy into
+  the blended instance. Each receiver is weighted by the inverse
+  variance of its position, and of its height and velocity when all
+  the receivers report those. Each fix is moved along its velocity to
+  the time of the most recent fix, allowing for the arrival time and
+  lag of each receiver.
+
+  Changes to the blend that are not movement of the vehicle, from a
+  receiver joining or leaving or from a change of weights, are taken
+  into an offset that decays over GPS_BLEND_TC, so the output has no
+  steps.
+
+  Returns false if there is nothing to blend
+ */
+bool
+AP_GPS::update_blend(void)
+{
+    uint32_t now = hal.scheduler->millis();
+    float hweight[GPS_MAX_INSTANCES];
+    float vweight[GPS_MAX_INSTANCES];
+    float sweight[GPS_MAX_INSTANCES];
+    uint32_t fix_ms[GPS_MAX_INSTANCES];
+    float hsum = 0, vsum = 0, ssum = 0;
+    bool all_vacc = true, all_sacc = true;
+    bool new_data = false;
+    uint8_t mask = 0;
+    uint8_t latest = 0;
+    uint8_t heaviest = 0;
+
+    for (uint8_t i=0; i<GPS_MAX_INSTANCES; i++) {
+        const GPS_State &istate = state[i];
+        hweight[i] = vweight[i] = sweight[i] = 0;
+        if (istate.status < GPS_OK_FIX_3D ||
+            !istate.have_horizontal_accuracy ||
+            now - timing[i].last_message_time_ms > GPS_BLEND_TIMEOUT_MS) {
+            continue;
+        }
+        hweight[i] = 1.0f / sq(max(istate.horizontal_accuracy, 0.01f));
+        hsum += hweight[i];
+        if (istate.have_vertical_accuracy) {
+            vweight[i] = 1.0f / sq(max(istate.vertical_accuracy, 0.01f));
+            vsum += vweight[i];
+        } else {
+            all_vacc = false;
+        }
+        if (istate.have_speed_accuracy) {
+            sweight[i] = 1.0f / sq(max(istate.speed_accuracy, 0.01f));
+            ssum += sweight[i];
+        } else {
+            all_sacc = false;
+        }
+        if (timing[i].last_message_time_ms != _blend.message_ms[i]) {
+            new_data = true;
+        }
+        fix_ms[i] = fix_arrival_ms(i) - lag_ms(i);
+        if (mask == 0 || (int32_t)(fix_ms[i] - fix_ms[latest]) > 0) {
+            latest = i;
+        }
+        if (mask == 0 || hweight[i] > hweight[heaviest]) {
+            heaviest = i;
+        }
+        mask |= 1U<<i;
+    }
+
+    if (mask == 0) {
+        _blend.mask = 0;
+        return false;
+    }
+    if (!new_data && mask == _blend.mask) {
+        // the last blend still stands
+        return true;
+    }
+
+    // normalise the weights, falling back to the horizontal weights
+    // where not every receiver reports an accuracy
+    for (uint8_t i=0; i<GPS_MAX_INSTANCES; i++) {
+        if (!all_vacc) {
+            vweight[i] = hweight[i] / hsum;
+        } else {
+            vweight[i] /= vsum;
+        }
+        if (!all_sacc) {
+            sweight[i] = hweight[i] / hsum;
+        } else {
+            sweight[i] /= ssum;
+        }
+        hweight[i] /= hsum;
+    }
+
+    // blend the positions as NED offsets from the heaviest receiver,
+    // both with the new weights and with the weights of the last blend
+    const Location &ref = state[heaviest].location;
+    const uint32_t fix_time_ms = fix_ms[latest];
+    Vector3f pos, pos_last_weights, vel;
+    float vz_weight = 0;
+    for (uint8_t i=0; i<GPS_MAX_INSTANCES; i++) {
+        if (!(mask & (1U<<i))) {
+            continue;
+        }
+        const GPS_State &istate = state[i];
+        float dt = (int32_t)(fix_time_ms - fix_ms[i]) * 0.001f;
+        Vector2f ne = location_diff(ref, istate.location);
+        Vector3f ipos(ne.x + istate.velocity.x * dt,
+                      ne.y + istate.velocity.y * dt,
+                      (ref.alt - istate.location.alt) * 0.01f);
+        if (istate.have_vertical_velocity) {
+            ipos.z += istate.velocity.z * dt;
+            vel.z += sweight[i] * istate.velocity.z;
+            vz_weight += sweight[i];
+        }
+        pos.x += hweight[i] * ipos.x;
+        pos.y += hweight[i] * ipos.y;
+        pos.z += vweight[i] * ipos.z;
+        pos_last_weights.x += _blend.hweight[i] * ipos.x;
+        pos_last_weights.y += _blend.hweight[i] * ipos.y;
+        pos_last_weights.z += _blend.vweight[i] * ipos.z;
+        vel.x += sweight[i] * istate.velocity.x;
+        vel.y += sweight[i] * istate.velocity.y;
+    }
+    if (vz_weight > 0) {
+        vel.z /= vz_weight;
+    }
+
+    GPS_State &blended = state[GPS_BLENDED_INSTANCE];
+    float dt = (int32_t)(fix_time_ms - _blend.time_ms) * 0.001f;
+    if (_blend.mask == 0 || blended.status < GPS_OK_FIX_3D || fabsf(dt) > 5) {
+        // a fresh start
+        _blend.offset.zero();
+    } else {
+        if (_blend_tc > 0) {
+            _blend.offset *= expf(-max(dt, 0.0f) / _blend_tc);
+        } else {
+            _blend.offset.zero();
+        }
+        if (mask != _blend.mask) {
+            // a receiver joined or left. Carry on from where the last
+            // blend would be by now
+            Vector2f ne = location_diff(ref, blended.location);
+            Vector3f last_pos(ne.x + blended.velocity.x * dt,
+                              ne.y + blended.velocity.y * dt,
+                              (ref.alt - blended.location.alt) * 0.01f + blended.velocity.z * dt);
+            _blend.offset = last_pos - pos;
+        } else if (_blend_tc > 0) {
+            _blend.offset += pos_last_weights - pos;
+        }
+    }
+    pos += _blend.offset;
+
+    // fill in the blended state, taking the time of the latest fix
+    const GPS_State &latest_state = state[latest];
+    blended.instance = GPS_BLENDED_INSTANCE;
+    blended.status = NO_FIX;
+    blended.num_sats = 0;
+    blended.hdop = 9999;
+    for (uint8_t i=0; i<GPS_MAX_INSTANCES; i++) {
+        if (mask & (1U<<i)) {
+            blended.status = max(blended.status, state[i].status);
+            blended.num_sats = max(blended.num_sats, state[i].num_sats);
+            blended.hdop = min(blended.hdop, state[i].hdop);
+        }
+    }
+    blended.time_week_ms = latest_state.time_week_ms;
+    blended.time_week = latest_state.time_week;
+    blended.last_gps_time_ms = fix_arrival_ms(latest);
+    blended.location = ref;
+    location_offset(blended.location, pos.x, pos.y);
+    blended.location.alt = ref.alt - (int32_t)(pos.z * 100);
+    blended.velocity = vel;
+    blended.ground_speed = pythagorous2(vel.x, vel.y);
+    blended.ground_course_cd = wrap_360_cd(degrees(atan2f(vel.y, vel.x)) * 100);
+    blended.have_vertical_velocity = (vz_weight > 0);
+    blended.horizontal_accuracy = 1.0f / sqrtf(hsum);
+    blended.have_horizontal_accuracy = true;
+    blended.vertical_accuracy = all_vacc ? 1.0f / sqrtf(vsum) : 0;
+    blended.have_vertical_accuracy = all_vacc;
+    blended.speed_accuracy = all_sacc ? 1.0f / sqrtf(ssum) : 0;
+    blended.have_speed_accuracy = all_sacc;
+
+    timing[GPS_BLENDED_INSTANCE].last_message_time_ms = now;
+    timing[GPS_BLENDED_INSTANCE].last_fix_time_ms = now;
+
+    _blend.mask = mask;
+    _blend.heaviest = heaviest;
+    _blend.time_ms = fix_time_ms;
+    _blend.lag_ms = lag_ms(latest);
+    for (uint8_t i=0; i<GPS_MAX_INSTANCES; i++) {
+        _blend.hweight[i] = hweight[i];
+        _blend.vweight[i] = vweight[i];
+        _blend.message_ms[i] = timing[i].last_message_time_ms;
+    }
+    return true;
+}
+#endif // GPS_BLENDING_AVAILABLE
@@ -32,12 +32,25 @@
    maximum number of GPS instances available on this platform. If more
    than 1 then redundent sensors may be available
  */
-#if HAL_CPU_CLASS > HAL_CPU_CLASS_16
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+#define GPS_MAX_INSTANCES 3
+#elif HAL_CPU_CLASS > HAL_CPU_CLASS_16
 #define GPS_MAX_INSTANCES 2
 #else
 #define GPS_MAX_INSTANCES 1
 #endif
 
+/**
+   blending of the receivers into a single solution. The blended
+   solution is kept as an extra instance after the receivers
+ */
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+#define GPS_BLENDING_AVAILABLE 1
+#define GPS_BLENDED_INSTANCE GPS_MAX_INSTANCES
+#else
+#define GPS_BLENDING_AVAILABLE 0
+#endif
+
 #if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
 #define GPS_RTK_AVAILABLE 1
 #else
@@ -152,6 +165,15 @@ public:
         return primary_instance;
     }
 
+    // true if the primary solution is a blend of the receivers
+    bool blending(void) const {
+#if GPS_BLENDING_AVAILABLE
+        return primary_instance == GPS_BLENDED_INSTANCE;
+#else
+        return false;
+#endif
+    }
+
     // using these macros saves some code space on APM2
 #if GPS_MAX_INSTANCES == 1
 #	define _GPS_STATE(instance) state[0]
@@ -296,6 +318,14 @@ public:
         return last_message_time_ms(primary_instance);
     }
 
+    // the system time in milliseconds that the message carrying the
+    // last fix started to arrive. The lag of the fix is relative to
+    // this
+    uint32_t fix_arrival_ms(uint8_t instance) const;
+    uint32_t fix_arrival_ms(void) const {
+        return fix_arrival_ms(primary_instance);
+    }
+
     // return last fix time since the 1/1/1970 in microseconds
     uint64_t time_epoch_usec(uint8_t instance);
     uint64_t time_epoch_usec(void) { 
@@ -311,13 +341,27 @@ public:
     }
 
     // the expected lag (in seconds) in the position and velocity readings from the gps
-    float get_lag() const { return 0.2f; }
+#if GPS_BLENDING_AVAILABLE
+    float get_lag(uint8_t instance) const;
+#else
+    float get_lag(uint8_t instance) const { return 0.2f; }
+#endif
+    float get_lag(void) const {
+        return get_lag(primary_instance);
+    }
 
     // set position for HIL
     void setHIL(uint8_t instance, GPS_Status status, uint64_t time_epoch_ms, 
                 const Location &location, const Vector3f &velocity, uint8_t num_sats,
                 uint16_t hdop, bool _have_vertical_velocity);
 
+    // set the reported accuracies for HIL. A negative value means
+    // the accuracy is not available
+    void setHIL_accuracy(uint8_t instance, float hacc, float vacc, float sacc);
+
+    // set the whole state of an instance, as recorded by replay logging
+    void setHIL_state(uint8_t instance, const GPS_State &istate);
+
     static const struct AP_Param::GroupInfo var_info[];
 
     // dataflash for logging, if available
@@ -332,6 +376,10 @@ public:
     AP_Int16 _sbp_logmask;
     AP_Int8 _inject_to;
     uint32_t _last_instance_swap_ms;
+#endif
+#if GPS_BLENDING_AVAILABLE
+    AP_Int16 _delay_ms[GPS_MAX_INSTANCES];
+    AP_Float _blend_tc;
 #endif
     AP_Int8 _sbas_mode;
     AP_Int8 _min_elevation;
@@ -368,9 +416,17 @@ private:
 
         // the time we got our last fix in system milliseconds
         uint32_t last_message_time_ms;
+
+#if GPS_BLENDING_AVAILABLE
+        // smallest seen difference between the system time a fix
+        // arrived and its GPS time. Differences between receivers
+        // give their relative lag
+        int32_t arrival_offset_ms;
+        uint32_t last_gps_time_ms;
+#endif
     };
-    GPS_timing timing[GPS_MAX_INSTANCES];
-    GPS_State state[GPS_MAX_INSTANCES];
+    GPS_timing timing[GPS_MAX_INSTANCES+GPS_BLENDING_AVAILABLE];
+    GPS_State state[GPS_MAX_INSTANCES+GPS_BLENDING_AVAILABLE];
     AP_GPS_Backend *drivers[GPS_MAX_INSTANCES];
     AP_HAL::UARTDriver *_port[GPS_MAX_INSTANCES];
 
@@ -381,7 +437,7 @@ private:
     uint8_t num_instances:2;
 
     // which ports are locked
-    uint8_t locked_ports:2;
+    uint8_t locked_ports:GPS_MAX_INSTANCES;
 
     // state of auto-detection process, per instance
     struct detect_state {
@@ -408,6 +464,25 @@ private:
 
     void detect_instance(uint8_t instance);
     void update_instance(uint8_t instance);
+    void update_primary(void);
+
+#if GPS_BLENDING_AVAILABLE
+    // state of the blended solution
+    struct blend_state {
+        uint8_t mask;                   // receivers in the last blend
+        uint8_t heaviest;               // receiver with the largest position weight
+        float hweight[GPS_MAX_INSTANCES];   // horizontal position weights of the last blend
+        float vweight[GPS_MAX_INSTANCES];   // height weights of the last blend
+        uint32_t message_ms[GPS_MAX_INSTANCES]; // message times used in the last blend
+        uint32_t time_ms;               // system time the blend is aligned to
+        uint16_t lag_ms;                // lag of the blended solution
+        Vector3f offset;                // NED offset hiding changes in the blend
+    } _blend;
+
+    void update_lag_estimate(uint8_t instance);
+    uint16_t lag_ms(uint8_t instance) const;
+    bool update_blend(void);
+#endif
 };
 
 #include <GPS_Backend.h>
@@ -59,106 +59,117 @@ void AP_GPS_MTK::send_init_blob(uint8_t instance, AP_GPS &gps)
 bool
 AP_GPS_MTK::read(void)
 {
+    uint8_t buf[GPS_READ_CHUNK_SIZE];
     uint8_t data;
-    int16_t numc;
+    uint16_t numc;
     bool parsed = false;
 
-    numc = port->available();
-    for (int16_t i = 0; i < numc; i++) {        // Process bytes received
+    while ((numc = port->read_bytes(buf, sizeof(buf))) > 0) {
+        for (uint16_t i = 0; i < numc; i++) {        // Process bytes received
 
-        // read the next byte
-        data = port->read();
+            if (_step == 0) {
+                // skip to the next preamble
+                const uint8_t *p = (const uint8_t *)memchr(&buf[i], PREAMBLE1, numc - i);
+                if (p == NULL) {
+                    break;
+                }
+                i = p - buf;
+            }
+
+            // read the next byte
+            data = buf[i];
 
 restart:
-        switch(_step) {
-
-        // Message preamble, class, ID detection
-        //
-        // If we fail to match any of the expected bytes, we
-        // reset the state machine and re-consider the failed
-        // byte as the first byte of the preamble.  This
-        // improves our chances of recovering from a mismatch
-        // and makes it less likely that we will be fooled by
-        // the preamble appearing as data in some other message.
-        //
-        case 0:
-            if(PREAMBLE1 == data)
-                _step++;
-            break;
-        case 1:
-            if (PREAMBLE2 == data) {
-                _step++;
+            switch(_step) {
+
+            // Message preamble, class, ID detection
+            //
+            // If we fail to match any of the expected bytes, we
+            // reset the state machine and re-consider the failed
+            // byte as the first byte of the preamble.  This
+            // improves our chances of recovering from a mismatch
+            // and makes it less likely that we will be fooled by
+            // the preamble appearing as data in some other message.
+            //
+            case 0:
+                if(PREAMBLE1 == data)
+                    _step++;
                 break;
-            }
-            _step = 0;
-            goto restart;
-        case 2:
-            if (MESSAGE_CLASS == data) {
-                _step++;
-                _ck_b = _ck_a = data;                                   // reset the checksum accumulators
-            } else {
-                _step = 0;                                                      // reset and wait for a message of the right class
-                goto restart;
-            }
-            break;
-        case 3:
-            if (MESSAGE_ID == data) {
-                _step++;
-                _ck_b += (_ck_a += data);
-                _payload_counter = 0;
-            } else {
+            case 1:
+                if (PREAMBLE2 == data) {
+                    _step++;
+                    break;
+                }
                 _step = 0;
                 goto restart;
-            }
-            break;
-
-        // Receive message data
-        //
-        case 4:
-            _buffer.bytes[_payload_counter++] = data;
-            _ck_b += (_ck_a += data);
-            if (_payload_counter == sizeof(_buffer))
-                _step++;
-            break;
+            case 2:
+                if (MESSAGE_CLASS == data) {
+                    _step++;
+                    _ck_b = _ck_a = data;                                   // reset the checksum accumulators
+                } else {
+                    _step = 0;                                                      // reset and wait for a message of the right class
+                    goto restart;
+                }
+                break;
+            case 3:
+                if (MESSAGE_ID == data) {
+                    _step++;
+                    _ck_b += (_ck_a += data);
+                    _payload_counter = 0;
+                } else {
+                    _step = 0;
+                    goto restart;
+                }
+                break;
 
-        // Checksum and message processing
-        //
-        case 5:
-            _step++;
-            if (_ck_a != data) {
-                _step = 0;
-            }
-            break;
-        case 6:
-            _step = 0;
-            if (_ck_b != data) {
+            // Receive message data
+            //
+            case 4:
+                _buffer.bytes[_payload_counter++] = data;
+                _ck_b += (_ck_a += data);
+                if (_payload_counter == sizeof(_buffer))
+                    _step++;
                 break;
-            }
 
-            // set fix type
-            if (_buffer.msg.fix_type == FIX_3D) {
-                state.status = AP_GPS::GPS_OK_FIX_3D;
-            }else if (_buffer.msg.fix_type == FIX_2D) {
-                state.status = AP_GPS::GPS_OK_FIX_2D;
-            }else{
-                state.status = AP_GPS::NO_FIX;
-            }
-            state.location.lat  = swap_int32(_buffer.msg.latitude)  * 10;
-            state.location.lng  = swap_int32(_buffer.msg.longitude) * 10;
-            state.location.alt  = swap_int32(_buffer.msg.altitude);
-            state.ground_speed      = swap_int32(_buffer.msg.ground_speed) * 0.01f;
-            state.ground_course_cd  = swap_int32(_buffer.msg.ground_course) / 10000;
-            state.num_sats          = _buffer.msg.satellites;
-
-            if (state.status >= AP_GPS::GPS_OK_FIX_2D) {
-                make_gps_time(0, swap_int32(_buffer.msg.utc_time)*10);
+            // Checksum and message processing
+            //
+            case 5:
+                _step++;
+                if (_ck_a != data) {
+                    _step = 0;
+                }
+                break;
+            case 6:
+                _step = 0;
+                if (_ck_b != data) {
+                    break;
+                }
+
+                // set fix type
+                if (_buffer.msg.fix_type == FIX_3D) {
+                    state.status = AP_GPS::GPS_OK_FIX_3D;
+                }else if (_buffer.msg.fix_type == FIX_2D) {
+                    state.status = AP_GPS::GPS_OK_FIX_2D;
+                }else{
+                    state.status = AP_GPS::NO_FIX;
+                }
+                state.location.lat  = swap_int32(_buffer.msg.latitude)  * 10;
+                state.location.lng  = swap_int32(_buffer.msg.longitude) * 10;
+                state.location.alt  = swap_int32(_buffer.msg.altitude);
+                state.ground_speed      = swap_int32(_buffer.msg.ground_speed) * 0.01f;
+                state.ground_course_cd  = swap_int32(_buffer.msg.ground_course) / 10000;
+                state.num_sats          = _buffer.msg.satellites;
+
+                if (state.status >= AP_GPS::GPS_OK_FIX_2D) {
+                    make_gps_time(0, swap_int32(_buffer.msg.utc_time)*10);
+                }
+                // we don't change _last_gps_time as we don't know the
+                // full date
+
+                fill_3d_velocity();
+
+                parsed = true;
             }
-            // we don't change _last_gps_time as we don't know the
-            // full date
-
-            fill_3d_velocity();
-
-            parsed = true;
         }
     }
     return parsed;
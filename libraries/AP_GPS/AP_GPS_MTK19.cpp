@@ -51,129 +51,134 @@ AP_GPS_MTK19::AP_GPS_MTK19(AP_GPS &_gps, AP_GPS::GPS_State &_state, AP_HAL::UART
 bool
 AP_GPS_MTK19::read(void)
 {
+    uint8_t buf[GPS_READ_CHUNK_SIZE];
     uint8_t data;
-    int16_t numc;
+    uint16_t numc;
     bool parsed = false;
 
-    numc = port->available();
-    for (int16_t i = 0; i < numc; i++) {        // Process bytes received
+    while ((numc = port->read_bytes(buf, sizeof(buf))) > 0) {
+        for (uint16_t i = 0; i < numc; i++) {        // Process bytes received
 
-        // read the next byte
-        data = port->read();
+            // read the next byte
+            data = buf[i];
 
 restart:
-        switch(_step) {
-
-        // Message preamble, class, ID detection
-        //
-        // If we fail to match any of the expected bytes, we
-        // reset the state machine and re-consider the failed
-        // byte as the first byte of the preamble.  This
-        // improves our chances of recovering from a mismatch
-        // and makes it less likely that we will be fooled by
-        // the preamble appearing as data in some other message.
-        //
-        case 0:
-            if (data == PREAMBLE1_V16) {
-                _mtk_revision     = MTK_GPS_REVISION_V16;
-                _step++;
-            } else if (data == PREAMBLE1_V19) {
-                _mtk_revision     = MTK_GPS_REVISION_V19;
-                _step++;
-            }    
-            break;
-        case 1:
-            if (data == PREAMBLE2) {
-                _step++;
-            } else {
-				_step = 0;
-				goto restart;
-			}
-			break;
-        case 2:
-            if (sizeof(_buffer) == data) {
-                _step++;
-                _ck_b = _ck_a       = data;                    // reset the checksum accumulators
-                _payload_counter    = 0;
-            } else {
-                _step               = 0;                       // reset and wait for a message of the right class
-                goto restart;
-            }
-            break;
+            switch(_step) {
+
+            // Message preamble, class, ID detection
+            //
+            // If we fail to match any of the expected bytes, we
+            // reset the state machine and re-consider the failed
+            // byte as the first byte of the preamble.  This
+            // improves our chances of recovering from a mismatch
+            // and makes it less likely that we will be fooled by
+            // the preamble appearing as data in some other message.
+            //
+            case 0:
+                if (data == PREAMBLE1_V16) {
+                    _mtk_revision     = MTK_GPS_REVISION_V16;
+                    _step++;
+                } else if (data == PREAMBLE1_V19) {
+                    _mtk_revision     = MTK_GPS_REVISION_V19;
+                    _step++;
+                }    
+                if (_step != 0) {
+                    _msg_arrival_ms = arrival_ms(numc - i);
+                }
+                break;
+            case 1:
+                if (data == PREAMBLE2) {
+                    _step++;
+                } else {
+                    _step = 0;
+                    goto restart;
+                }
+                break;
+            case 2:
+                if (sizeof(_buffer) == data) {
+                    _step++;
+                    _ck_b = _ck_a       = data;                    // reset the checksum accumulators
+                    _payload_counter    = 0;
+                } else {
+                    _step               = 0;                       // reset and wait for a message of the right class
+                    goto restart;
+                }
+                break;
+
+            // Receive message data
+            //
+            case 3:
+                _buffer.bytes[_payload_counter++] = data;
+                _ck_b += (_ck_a += data);
+                if (_payload_counter == sizeof(_buffer)) {
+                    _step++;
+                }
+                break;
 
-        // Receive message data
-        //
-        case 3:
-            _buffer.bytes[_payload_counter++] = data;
-            _ck_b += (_ck_a += data);
-            if (_payload_counter == sizeof(_buffer)) {
+            // Checksum and message processing
+            //
+            case 4:
                 _step++;
-			}
-            break;
-
-        // Checksum and message processing
-        //
-        case 4:
-            _step++;
-            if (_ck_a != data) {
-                _step               = 0;
-				goto restart;
-            }
-            break;
-        case 5:
-            _step                   = 0;
-            if (_ck_b != data) {
-				goto restart;
-            }
+                if (_ck_a != data) {
+                    _step               = 0;
+                    goto restart;
+                }
+                break;
+            case 5:
+                _step                   = 0;
+                if (_ck_b != data) {
+                    goto restart;
+                }
 
-            // parse fix
-            if (_buffer.msg.fix_type == FIX_3D || _buffer.msg.fix_type == FIX_3D_SBAS) {
-                state.status = AP_GPS::GPS_OK_FIX_3D;
-            }else if (_buffer.msg.fix_type == FIX_2D || _buffer.msg.fix_type == FIX_2D_SBAS) {
-                state.status = AP_GPS::GPS_OK_FIX_2D;
-            }else{
-                state.status = AP_GPS::NO_FIX;
-            }
+                // parse fix
+                if (_buffer.msg.fix_type == FIX_3D || _buffer.msg.fix_type == FIX_3D_SBAS) {
+                    state.status = AP_GPS::GPS_OK_FIX_3D;
+                }else if (_buffer.msg.fix_type == FIX_2D || _buffer.msg.fix_type == FIX_2D_SBAS) {
+                    state.status = AP_GPS::GPS_OK_FIX_2D;
+                }else{
+                    state.status = AP_GPS::NO_FIX;
+                }
 
-            if (_mtk_revision == MTK_GPS_REVISION_V16) {
-                state.location.lat  = _buffer.msg.latitude  * 10;  // V16, V17,V18 doc says *10e7 but device says otherwise
-                state.location.lng  = _buffer.msg.longitude * 10;  // V16, V17,V18 doc says *10e7 but device says otherwise
-            } else {
-				state.location.lat  = _buffer.msg.latitude;
-				state.location.lng  = _buffer.msg.longitude;
-			}
-            state.location.alt      = _buffer.msg.altitude;
-            state.ground_speed      = _buffer.msg.ground_speed*0.01f;
-            state.ground_course_cd  = _buffer.msg.ground_course;
-            state.num_sats          = _buffer.msg.satellites;
-            state.hdop              = _buffer.msg.hdop;
-            
-            if (state.status >= AP_GPS::GPS_OK_FIX_2D) {
-                if (_fix_counter == 0) {
-                    uint32_t bcd_time_ms;
-                    bcd_time_ms = _buffer.msg.utc_time;
-#if 0
-                    hal.console->printf("utc_date=%lu utc_time=%lu rev=%u\n", 
-                                        (unsigned long)_buffer.msg.utc_date,
-                                        (unsigned long)_buffer.msg.utc_time,
-                                        (unsigned)_mtk_revision);                                        
-#endif
-                    make_gps_time(_buffer.msg.utc_date, bcd_time_ms);
-                    state.last_gps_time_ms = hal.scheduler->millis();
+                if (_mtk_revision == MTK_GPS_REVISION_V16) {
+                    state.location.lat  = _buffer.msg.latitude  * 10;  // V16, V17,V18 doc says *10e7 but device says otherwise
+                    state.location.lng  = _buffer.msg.longitude * 10;  // V16, V17,V18 doc says *10e7 but device says otherwise
+                } else {
+                    state.location.lat  = _buffer.msg.latitude;
+                    state.location.lng  = _buffer.msg.longitude;
                 }
-                // the _fix_counter is to reduce the cost of the GPS
-                // BCD time conversion by only doing it every 10s
-                // between those times we use the HAL system clock as
-                // an offset from the last fix
-                _fix_counter++;
-                if (_fix_counter == 50) {
-                    _fix_counter = 0;
+                state.location.alt      = _buffer.msg.altitude;
+                state.ground_speed      = _buffer.msg.ground_speed*0.01f;
+                state.ground_course_cd  = _buffer.msg.ground_course;
+                state.num_sats          = _buffer.msg.satellites;
+                state.hdop              = _buffer.msg.hdop;
+            
+                if (state.status >= AP_GPS::GPS_OK_FIX_2D) {
+                    if (_fix_counter == 0) {
+                        uint32_t bcd_time_ms;
+                        bcd_time_ms = _buffer.msg.utc_time;
+    #if 0
+                        hal.console->printf("utc_date=%lu utc_time=%lu rev=%u\n", 
+                                            (unsigned long)_buffer.msg.utc_date,
+                                            (unsigned long)_buffer.msg.utc_time,
+                                            (unsigned)_mtk_revision);                                        
+    #endif
+                        make_gps_time(_buffer.msg.utc_date, bcd_time_ms);
+                        state.last_gps_time_ms = _msg_arrival_ms;
+                    }
+                    // the _fix_counter is to reduce the cost of the GPS
+                    // BCD time conversion by only doing it every 10s
+                    // between those times we use the HAL system clock as
+                    // an offset from the last fix
+                    _fix_counter++;
+                    if (_fix_counter == 50) {
+                        _fix_counter = 0;
+                    }
                 }
-            }
 
-            fill_3d_velocity();
+                fill_3d_velocity();
 
-            parsed                  = true;
+                parsed                  = true;
+            }
         }
     }
     return parsed;
@@ -72,6 +72,7 @@ private:
     uint8_t         _step;
     uint8_t         _payload_counter;
 	uint8_t			_mtk_revision;
+    uint32_t        _msg_arrival_ms;    // system time the first byte of the message arrived
 
     uint8_t         _fix_counter;
 
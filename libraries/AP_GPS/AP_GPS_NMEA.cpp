@@ -112,13 +112,18 @@ AP_GPS_NMEA::AP_GPS_NMEA(AP_GPS &_gps, AP_GPS::GPS_State &_state, AP_HAL::UARTDr
 
 bool AP_GPS_NMEA::read(void)
 {
-    int16_t numc;
+    uint8_t buf[GPS_READ_CHUNK_SIZE];
+    uint16_t numc;
     bool parsed = false;
 
-    numc = port->available();
-    while (numc--) {
-        if (_decode(port->read())) {
-            parsed = true;
+    while ((numc = port->read_bytes(buf, sizeof(buf))) > 0) {
+        for (uint16_t i = 0; i < numc; i++) {
+            if (buf[i] == '$') {
+                _sentence_arrival_ms = arrival_ms(numc - i);
+            }
+            if (_decode(buf[i])) {
+                parsed = true;
+            }
         }
     }
     return parsed;
@@ -253,7 +258,7 @@ bool AP_GPS_NMEA::_term_complete()
                     state.ground_speed     = _new_speed*0.01f;
                     state.ground_course_cd = _new_course;
                     make_gps_time(_new_date, _new_time * 10);
-                    state.last_gps_time_ms = hal.scheduler->millis();
+                    state.last_gps_time_ms = _sentence_arrival_ms;
                     // To-Do: add support for proper reporting of 2D and 3D fix
                     state.status           = AP_GPS::GPS_OK_FIX_3D;
                     fill_3d_velocity();
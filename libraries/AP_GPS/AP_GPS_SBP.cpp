@@ -108,79 +108,94 @@ void
 AP_GPS_SBP::_sbp_process() 
 {
 
-    while (port->available() > 0) {
-        uint8_t temp = port->read();
-        uint16_t crc;
-
-
-        //This switch reads one character at a time,
-        //parsing it into buffers until a full message is dispatched
-        switch(parser_state.state) {
-            case sbp_parser_state_t::WAITING:
-                if (temp == SBP_PREAMBLE) {
-                    parser_state.n_read = 0;
-                    parser_state.state = sbp_parser_state_t::GET_TYPE;
+    uint8_t buf[GPS_READ_CHUNK_SIZE];
+    uint16_t numc;
+
+    while ((numc = port->read_bytes(buf, sizeof(buf))) > 0) {
+        for (uint16_t i = 0; i < numc; i++) {
+            if (parser_state.state == sbp_parser_state_t::WAITING) {
+                // skip to the next preamble
+                const uint8_t *p = (const uint8_t *)memchr(&buf[i], SBP_PREAMBLE, numc - i);
+                if (p == NULL) {
+                    break;
                 }
-                break;
+                i = p - buf;
+            }
 
-            case sbp_parser_state_t::GET_TYPE:
-                *((uint8_t*)&(parser_state.msg_type) + parser_state.n_read) = temp;
-                parser_state.n_read += 1;
-                if (parser_state.n_read >= 2) {
-                    parser_state.n_read = 0;
-                    parser_state.state = sbp_parser_state_t::GET_SENDER;
-                }
-                break;
+            uint8_t temp = buf[i];
+            uint16_t crc;
 
-            case sbp_parser_state_t::GET_SENDER:
-                *((uint8_t*)&(parser_state.sender_id) + parser_state.n_read) = temp;
-                parser_state.n_read += 1;
-                if (parser_state.n_read >= 2) {
-                    parser_state.n_read = 0;
-                    parser_state.state = sbp_parser_state_t::GET_LEN;
-                }
-                break;
-
-            case sbp_parser_state_t::GET_LEN:
-                parser_state.msg_len = temp;
-                parser_state.n_read = 0;
-                parser_state.state = sbp_parser_state_t::GET_MSG;
-                break;
-
-            case sbp_parser_state_t::GET_MSG:
-                *((uint8_t*)&(parser_state.msg_buff) + parser_state.n_read) = temp;
-                parser_state.n_read += 1;
-                if (parser_state.n_read >= parser_state.msg_len) {
-                    parser_state.n_read = 0;
-                    parser_state.state = sbp_parser_state_t::GET_CRC;
-                }
-                break;
 
-            case sbp_parser_state_t::GET_CRC:
-                *((uint8_t*)&(parser_state.crc) + parser_state.n_read) = temp;
-                parser_state.n_read += 1;
-                if (parser_state.n_read >= 2) {
-                    parser_state.state = sbp_parser_state_t::WAITING;
+            //This switch reads one character at a time,
+            //parsing it into buffers until a full message is dispatched
+            switch(parser_state.state) {
+                case sbp_parser_state_t::WAITING:
+                    if (temp == SBP_PREAMBLE) {
+                        parser_state.n_read = 0;
+                        parser_state.state = sbp_parser_state_t::GET_TYPE;
+                        parser_state.msg_arrival_ms = arrival_ms(numc - i);
+                    }
+                    break;
+
+                case sbp_parser_state_t::GET_TYPE:
+                    *((uint8_t*)&(parser_state.msg_type) + parser_state.n_read) = temp;
+                    parser_state.n_read += 1;
+                    if (parser_state.n_read >= 2) {
+                        parser_state.n_read = 0;
+                        parser_state.state = sbp_parser_state_t::GET_SENDER;
+                    }
+                    break;
+
+                case sbp_parser_state_t::GET_SENDER:
+                    *((uint8_t*)&(parser_state.sender_id) + parser_state.n_read) = temp;
+                    parser_state.n_read += 1;
+                    if (parser_state.n_read >= 2) {
+                        parser_state.n_read = 0;
+                        parser_state.state = sbp_parser_state_t::GET_LEN;
+                    }
+                    break;
 
-                    crc = crc16_ccitt((uint8_t*)&(parser_state.msg_type), 2, 0);
-                    crc = crc16_ccitt((uint8_t*)&(parser_state.sender_id), 2, crc);
-                    crc = crc16_ccitt(&(parser_state.msg_len), 1, crc);
-                    crc = crc16_ccitt(parser_state.msg_buff, parser_state.msg_len, crc);
-                    if (parser_state.crc == crc) {
-                        _sbp_process_message();
-                    } else {
-                        Debug("CRC Error Occurred!");
-                        crc_error_counter += 1;
+                case sbp_parser_state_t::GET_LEN:
+                    parser_state.msg_len = temp;
+                    parser_state.n_read = 0;
+                    parser_state.state = sbp_parser_state_t::GET_MSG;
+                    break;
+
+                case sbp_parser_state_t::GET_MSG:
+                    *((uint8_t*)&(parser_state.msg_buff) + parser_state.n_read) = temp;
+                    parser_state.n_read += 1;
+                    if (parser_state.n_read >= parser_state.msg_len) {
+                        parser_state.n_read = 0;
+                        parser_state.state = sbp_parser_state_t::GET_CRC;
                     }
+                    break;
+
+                case sbp_parser_state_t::GET_CRC:
+                    *((uint8_t*)&(parser_state.crc) + parser_state.n_read) = temp;
+                    parser_state.n_read += 1;
+                    if (parser_state.n_read >= 2) {
+                        parser_state.state = sbp_parser_state_t::WAITING;
+
+                        crc = crc16_ccitt((uint8_t*)&(parser_state.msg_type), 2, 0);
+                        crc = crc16_ccitt((uint8_t*)&(parser_state.sender_id), 2, crc);
+                        crc = crc16_ccitt(&(parser_state.msg_len), 1, crc);
+                        crc = crc16_ccitt(parser_state.msg_buff, parser_state.msg_len, crc);
+                        if (parser_state.crc == crc) {
+                            _sbp_process_message();
+                        } else {
+                            Debug("CRC Error Occurred!");
+                            crc_error_counter += 1;
+                        }
+
+                        parser_state.state = sbp_parser_state_t::WAITING;                
+                    }
+                    break;
 
-                    parser_state.state = sbp_parser_state_t::WAITING;                
+                default:
+                    parser_state.state = sbp_parser_state_t::WAITING;
+                    break;
                 }
-                break;
-
-            default:
-                parser_state.state = sbp_parser_state_t::WAITING;
-                break;
-            }
+        }
     }
 }
 
@@ -199,6 +214,7 @@ AP_GPS_SBP::_sbp_process_message() {
 
         case SBP_VEL_NED_MSGTYPE:
             memcpy(&last_vel_ned, parser_state.msg_buff, sizeof(last_vel_ned));
+            last_vel_ned_arrival_ms = parser_state.msg_arrival_ms;
             break;
 
         case SBP_POS_LLH_MSGTYPE: {
@@ -265,6 +281,7 @@ AP_GPS_SBP::_attempt_state_update()
         // Update time state
         state.time_week         = last_gps_time.wn;
         state.time_week_ms      = last_vel_ned.tow;
+        state.last_gps_time_ms  = last_vel_ned_arrival_ms;
 
         state.hdop              = last_dops.hdop;
 
@@ -60,6 +60,7 @@ private:
       uint16_t crc;
       uint8_t msg_len;
       uint8_t n_read;
+      uint32_t msg_arrival_ms;
       uint8_t msg_buff[256];
     } parser_state;
 
@@ -149,6 +150,7 @@ private:
     struct sbp_pos_llh_t  last_pos_llh_spp;
     struct sbp_pos_llh_t  last_pos_llh_rtk;
     struct sbp_vel_ned_t  last_vel_ned;
+    uint32_t              last_vel_ned_arrival_ms;
     uint32_t              last_iar_num_hypotheses;
 
     uint32_t              last_full_update_tow;
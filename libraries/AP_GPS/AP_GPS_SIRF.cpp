@@ -57,111 +57,122 @@ AP_GPS_SIRF::AP_GPS_SIRF(AP_GPS &_gps, AP_GPS::GPS_State &_state, AP_HAL::UARTDr
 bool
 AP_GPS_SIRF::read(void)
 {
+    uint8_t buf[GPS_READ_CHUNK_SIZE];
     uint8_t data;
-    int16_t numc;
+    uint16_t numc;
     bool parsed = false;
 
-    numc = port->available();
-    while(numc--) {
-
-        // read the next byte
-        data = port->read();
-
-        switch(_step) {
-
-        // Message preamble detection
-        //
-        // If we fail to match any of the expected bytes, we reset
-        // the state machine and re-consider the failed byte as
-        // the first byte of the preamble.  This improves our
-        // chances of recovering from a mismatch and makes it less
-        // likely that we will be fooled by the preamble appearing
-        // as data in some other message.
-        //
-        case 1:
-            if (PREAMBLE2 == data) {
+    while ((numc = port->read_bytes(buf, sizeof(buf))) > 0) {
+        for (uint16_t i = 0; i < numc; i++) {        // Process bytes received
+
+            if (_step == 0) {
+                // skip to the next preamble
+                const uint8_t *p = (const uint8_t *)memchr(&buf[i], PREAMBLE1, numc - i);
+                if (p == NULL) {
+                    break;
+                }
+                i = p - buf;
+            }
+
+            // read the next byte
+            data = buf[i];
+
+            switch(_step) {
+
+            // Message preamble detection
+            //
+            // If we fail to match any of the expected bytes, we reset
+            // the state machine and re-consider the failed byte as
+            // the first byte of the preamble.  This improves our
+            // chances of recovering from a mismatch and makes it less
+            // likely that we will be fooled by the preamble appearing
+            // as data in some other message.
+            //
+            case 1:
+                if (PREAMBLE2 == data) {
+                    _step++;
+                    break;
+                }
+                _step = 0;
+            // FALLTHROUGH
+            case 0:
+                if(PREAMBLE1 == data)
+                    _step++;
+                break;
+
+            // Message length
+            //
+            // We always collect the length so that we can avoid being
+            // fooled by preamble bytes in messages.
+            //
+            case 2:
                 _step++;
+                _payload_length = (uint16_t)data << 8;
                 break;
-            }
-            _step = 0;
-        // FALLTHROUGH
-        case 0:
-            if(PREAMBLE1 == data)
+            case 3:
                 _step++;
-            break;
-
-        // Message length
-        //
-        // We always collect the length so that we can avoid being
-        // fooled by preamble bytes in messages.
-        //
-        case 2:
-            _step++;
-            _payload_length = (uint16_t)data << 8;
-            break;
-        case 3:
-            _step++;
-            _payload_length |= data;
-            _payload_counter = 0;
-            _checksum = 0;
-            break;
-
-        // Message header processing
-        //
-        // We sniff the message ID to determine whether we are going
-        // to gather the message bytes or just discard them.
-        //
-        case 4:
-            _step++;
-            _accumulate(data);
-            _payload_length--;
-            _gather = false;
-            switch(data) {
-            case MSG_GEONAV:
-                if (_payload_length == sizeof(sirf_geonav)) {
-                    _gather = true;
-                    _msg_id = data;
-                }
+                _payload_length |= data;
+                _payload_counter = 0;
+                _checksum = 0;
                 break;
-            }
-            break;
-
-        // Receive message data
-        //
-        // Note that we are effectively guaranteed by the protocol
-        // that the checksum and postamble cannot be mistaken for
-        // the preamble, so if we are discarding bytes in this
-        // message when the payload is done we return directly
-        // to the preamble detector rather than bothering with
-        // the checksum logic.
-        //
-        case 5:
-            if (_gather) {                                              // gather data if requested
+
+            // Message header processing
+            //
+            // We sniff the message ID to determine whether we are going
+            // to gather the message bytes or just discard them.
+            //
+            case 4:
+                _step++;
                 _accumulate(data);
-                _buffer.bytes[_payload_counter] = data;
-                if (++_payload_counter == _payload_length)
-                    _step++;
-            } else {
-                if (++_payload_counter == _payload_length)
-                    _step = 0;
-            }
-            break;
+                _payload_length--;
+                _gather = false;
+                switch(data) {
+                case MSG_GEONAV:
+                    if (_payload_length == sizeof(sirf_geonav)) {
+                        _gather = true;
+                        _msg_id = data;
+                    }
+                    break;
+                }
+                break;
 
-        // Checksum and message processing
-        //
-        case 6:
-            _step++;
-            if ((_checksum >> 8) != data) {
-                _step = 0;
-            }
-            break;
-        case 7:
-            _step = 0;
-            if ((_checksum & 0xff) != data) {
+            // Receive message data
+            //
+            // Note that we are effectively guaranteed by the protocol
+            // that the checksum and postamble cannot be mistaken for
+            // the preamble, so if we are discarding bytes in this
+            // message when the payload is done we return directly
+            // to the preamble detector rather than bothering with
+            // the checksum logic.
+            //
+            case 5:
+                if (_gather) {                                              // gather data if requested
+                    _accumulate(data);
+                    _buffer.bytes[_payload_counter] = data;
+                    if (++_payload_counter == _payload_length)
+                        _step++;
+                } else {
+                    if (++_payload_counter == _payload_length)
+                        _step = 0;
+                }
                 break;
-            }
-            if (_gather) {
-                parsed = _parse_gps();                                   // Parse the new GPS packet
+
+            // Checksum and message processing
+            //
+            case 6:
+                _step++;
+                if ((_checksum >> 8) != data) {
+                    _step = 0;
+                }
+                break;
+            case 7:
+                _step = 0;
+                if ((_checksum & 0xff) != data) {
+                    break;
+                }
+                if (_gather) {
+                    parsed = _parse_gps();                                   // Parse the new GPS packet
+                }
             }
         }
     }
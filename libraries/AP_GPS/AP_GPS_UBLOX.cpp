@@ -149,114 +149,127 @@ AP_GPS_UBLOX::send_next_rate_update(void)
 bool
 AP_GPS_UBLOX::read(void)
 {
+    uint8_t buf[GPS_READ_CHUNK_SIZE];
     uint8_t data;
-    int16_t numc;
+    uint16_t numc;
     bool parsed = false;
 
     if (need_rate_update) {
         send_next_rate_update();
     }
 
-    numc = port->available();
-    for (int16_t i = 0; i < numc; i++) {        // Process bytes received
+    while ((numc = port->read_bytes(buf, sizeof(buf))) > 0) {
+        for (uint16_t i = 0; i < numc; i++) {        // Process bytes received
 
-        // read the next byte
-        data = port->read();
+            if (_step == 0) {
+                // skip to the next preamble
+                const uint8_t *p = (const uint8_t *)memchr(&buf[i], PREAMBLE1, numc - i);
+                if (p == NULL) {
+                    break;
+                }
+                i = p - buf;
+            }
+
+            // read the next byte
+            data = buf[i];
 
 	reset:
-        switch(_step) {
-
-        // Message preamble detection
-        //
-        // If we fail to match any of the expected bytes, we reset
-        // the state machine and re-consider the failed byte as
-        // the first byte of the preamble.  This improves our
-        // chances of recovering from a mismatch and makes it less
-        // likely that we will be fooled by the preamble appearing
-        // as data in some other message.
-        //
-        case 1:
-            if (PREAMBLE2 == data) {
+            switch(_step) {
+
+            // Message preamble detection
+            //
+            // If we fail to match any of the expected bytes, we reset
+            // the state machine and re-consider the failed byte as
+            // the first byte of the preamble.  This improves our
+            // chances of recovering from a mismatch and makes it less
+            // likely that we will be fooled by the preamble appearing
+            // as data in some other message.
+            //
+            case 1:
+                if (PREAMBLE2 == data) {
+                    _step++;
+                    break;
+                }
+                _step = 0;
+                Debug("reset %u", __LINE__);
+            // FALLTHROUGH
+            case 0:
+                if(PREAMBLE1 == data) {
+                    _step++;
+                    _msg_arrival_ms = arrival_ms(numc - i);
+                }
+                break;
+
+            // Message header processing
+            //
+            // We sniff the class and message ID to decide whether we
+            // are going to gather the message bytes or just discard
+            // them.
+            //
+            // We always collect the length so that we can avoid being
+            // fooled by preamble bytes in messages.
+            //
+            case 2:
                 _step++;
+                _class = data;
+                _ck_b = _ck_a = data;                               // reset the checksum accumulators
                 break;
-            }
-            _step = 0;
-            Debug("reset %u", __LINE__);
-        // FALLTHROUGH
-        case 0:
-            if(PREAMBLE1 == data)
+            case 3:
                 _step++;
-            break;
+                _ck_b += (_ck_a += data);                   // checksum byte
+                _msg_id = data;
+                break;
+            case 4:
+                _step++;
+                _ck_b += (_ck_a += data);                   // checksum byte
+                _payload_length = data;                             // payload length low byte
+                break;
+            case 5:
+                _step++;
+                _ck_b += (_ck_a += data);                   // checksum byte
+
+                _payload_length += (uint16_t)(data<<8);
+                if (_payload_length > 512) {
+                    Debug("large payload %u", (unsigned)_payload_length);
+                    // assume very large payloads are line noise
+                    _payload_length = 0;
+                    _step = 0;
+                    goto reset;
+                }
+                _payload_counter = 0;                               // prepare to receive payload
+                break;
 
-        // Message header processing
-        //
-        // We sniff the class and message ID to decide whether we
-        // are going to gather the message bytes or just discard
-        // them.
-        //
-        // We always collect the length so that we can avoid being
-        // fooled by preamble bytes in messages.
-        //
-        case 2:
-            _step++;
-            _class = data;
-            _ck_b = _ck_a = data;                               // reset the checksum accumulators
-            break;
-        case 3:
-            _step++;
-            _ck_b += (_ck_a += data);                   // checksum byte
-            _msg_id = data;
-            break;
-        case 4:
-            _step++;
-            _ck_b += (_ck_a += data);                   // checksum byte
-            _payload_length = data;                             // payload length low byte
-            break;
-        case 5:
-            _step++;
-            _ck_b += (_ck_a += data);                   // checksum byte
-
-            _payload_length += (uint16_t)(data<<8);
-            if (_payload_length > 512) {
-                Debug("large payload %u", (unsigned)_payload_length);
-                // assume very large payloads are line noise
-                _payload_length = 0;
-                _step = 0;
-				goto reset;
-            }
-            _payload_counter = 0;                               // prepare to receive payload
-            break;
+            // Receive message data
+            //
+            case 6:
+                _ck_b += (_ck_a += data);                   // checksum byte
+                if (_payload_counter < sizeof(_buffer)) {
+                    _buffer.bytes[_payload_counter] = data;
+                }
+                if (++_payload_counter == _payload_length)
+                    _step++;
+                break;
 
-        // Receive message data
-        //
-        case 6:
-            _ck_b += (_ck_a += data);                   // checksum byte
-            if (_payload_counter < sizeof(_buffer)) {
-                _buffer.bytes[_payload_counter] = data;
-            }
-            if (++_payload_counter == _payload_length)
+            // Checksum and message processing
+            //
+            case 7:
                 _step++;
-            break;
-
-        // Checksum and message processing
-        //
-        case 7:
-            _step++;
-            if (_ck_a != data) {
-                Debug("bad cka %x should be %x", data, _ck_a);
+                if (_ck_a != data) {
+                    Debug("bad cka %x should be %x", data, _ck_a);
+                    _step = 0;
+                    goto reset;
+                }
+                break;
+            case 8:
                 _step = 0;
-				goto reset;
-            }
-            break;
-        case 8:
-            _step = 0;
-            if (_ck_b != data) {
-                Debug("bad ckb %x should be %x", data, _ck_b);
-                break;                                                  // bad checksum
-            }
-
-            if (_parse_gps()) {
-                parsed = true;
+                if (_ck_b != data) {
+                    Debug("bad ckb %x should be %x", data, _ck_b);
+                    break;                                                  // bad checksum
+                }
+
+                if (_parse_gps()) {
+                    parsed = true;
+                }
             }
         }
     }
@@ -505,7 +518,7 @@ AP_GPS_UBLOX::_parse_gps(void)
         state.num_sats    = _buffer.solution.satellites;
         state.hdop        = _buffer.solution.position_DOP;
         if (next_fix >= AP_GPS::GPS_OK_FIX_2D) {
-            state.last_gps_time_ms = hal.scheduler->millis();
+            state.last_gps_time_ms = _msg_arrival_ms;
             if (state.time_week == _buffer.solution.week &&
                 state.time_week_ms + 200 == _buffer.solution.time) {
                 // we got a 5Hz update. This relies on the way
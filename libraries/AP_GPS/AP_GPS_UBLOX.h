@@ -293,6 +293,7 @@ private:
     // State machine state
     uint8_t         _step;
     uint8_t         _msg_id;
+    uint32_t        _msg_arrival_ms;    // system time the first byte of the message arrived
     uint16_t        _payload_length;
     uint16_t        _payload_counter;
 
@@ -58,6 +58,19 @@ int16_t AP_GPS_Backend::swap_int16(int16_t v) const
     return u.v;
 }
 
+/*
+  fall back to the current time if the port does not track when data
+  arrives
+ */
+uint32_t AP_GPS_Backend::arrival_ms(uint16_t nbytes) const
+{
+    uint64_t receive_us = port != NULL ? port->receive_time_constraint_us(nbytes) : 0;
+    if (receive_us == 0) {
+        return hal.scheduler->millis();
+    }
+    return receive_us / 1000;
+}
+
 /**
    calculate current time since the unix epoch in microseconds
 
@@ -23,6 +23,9 @@
 #include <GCS_MAVLink.h>
 #include <AP_GPS.h>
 
+// number of bytes the parsers take from the port at a time
+#define GPS_READ_CHUNK_SIZE 64
+
 class AP_GPS_Backend
 {
 public:
@@ -72,6 +75,13 @@ protected:
        assumes MTK19 millisecond form of bcd_time
     */
     void make_gps_time(uint32_t bcd_date, uint32_t bcd_milliseconds);
+
+    /*
+      system time in milliseconds that the first of the last nbytes
+      bytes read from the port arrived. Parsers use this to stamp each
+      message with the arrival of its first byte
+     */
+    uint32_t arrival_ms(uint16_t nbytes) const;
 };
 
 #endif // __AP_GPS_BACKEND_H__
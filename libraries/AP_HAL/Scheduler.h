@@ -42,6 +42,26 @@ public:
     // register a low priority IO task
     virtual void     register_io_process(AP_HAL::MemberProc) = 0;
 
+    /*
+      register a task that samples a high rate sensor such as an
+      IMU. Boards with a dedicated sensor thread run it there, so it
+      is not delayed by other timer tasks. Elsewhere it is a normal
+      timer task
+     */
+    virtual void     register_sensor_process(AP_HAL::MemberProc proc) { register_timer_process(proc); }
+
+    /*
+      run a set of independent tasks and return once all of them have
+      finished. Boards with spare CPU cores run them in parallel on
+      worker threads. Elsewhere they run one after another on the
+      calling thread
+     */
+    virtual void     run_parallel(const AP_HAL::MemberProc *procs, uint8_t count) {
+        for (uint8_t i = 0; i < count; i++) {
+            procs[i]();
+        }
+    }
+
     // suspend and resume both timer and IO processes
     virtual void     suspend_timer_procs() = 0;
     virtual void     resume_timer_procs() = 0;
@@ -63,3 +63,19 @@ void AP_HAL::UARTDriver::vprintf_P(const prog_char *fmt, va_list ap)
 {
     print_vprintf((AP_HAL::Print*)this, 1, fmt, ap);
 }
+
+/*
+  read up to count bytes, one at a time
+ */
+uint16_t AP_HAL::UARTDriver::read_bytes(uint8_t *buffer, uint16_t count)
+{
+    uint16_t n = 0;
+    while (n < count) {
+        int16_t c = read();
+        if (c < 0) {
+            break;
+        }
+        buffer[n++] = c;
+    }
+    return n;
+}
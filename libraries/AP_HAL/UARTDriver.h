@@ -45,6 +45,21 @@ public:
     virtual void set_flow_control(enum flow_control flow_control_setting) {};
     virtual enum flow_control get_flow_control(void) { return FLOW_CONTROL_DISABLE; };
 
+    /*
+      read up to count bytes into buffer, returning the number of
+      bytes read. The default reads one byte at a time
+     */
+    virtual uint16_t read_bytes(uint8_t *buffer, uint16_t count);
+
+    /*
+      estimate of the system time in microseconds at which the first
+      of the last nbytes bytes read from the port arrived. The packet
+      did not start arriving later than this, but could have waited in
+      a system buffer before it. Returns zero if the port does not
+      track when data arrives
+     */
+    virtual uint64_t receive_time_constraint_us(uint16_t nbytes) { return 0; }
+
     /* Implementations of BetterStream virtual methods. These are
      * provided by AP_HAL to ensure consistency between ports to
      * different boards
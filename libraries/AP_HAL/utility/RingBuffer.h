@@ -11,7 +11,8 @@
     volatile uint16_t _buf_head;
     volatile uint16_t _buf_tail;
 
-  These should be converted to a class in future
+  New code should use the RingBuffer class below, which also orders
+  its memory accesses for SMP boards
  */
 #define BUF_AVAILABLE(buf) ((buf##_head > (_tail=buf##_tail))? (buf##_size - buf##_head) + _tail: _tail - buf##_head)
 #define BUF_SPACE(buf) (((_head=buf##_head) > buf##_tail)?(_head - buf##_tail) - 1:((buf##_size - buf##_tail) + _head) - 1)
@@ -19,4 +20,227 @@
 #define BUF_ADVANCETAIL(buf, n) buf##_tail = (buf##_tail + n) % buf##_size
 #define BUF_ADVANCEHEAD(buf, n) buf##_head = (buf##_head + n) % buf##_size
 
+#include <stdint.h>
+#include <string.h>
+
+/*
+  single producer, single consumer lock-free ring buffer
+
+  One thread may write while another thread reads without any
+  locking. The tail is only written by the producer and the head only
+  by the consumer. Each index is stored with release ordering and read
+  with acquire ordering, so data is fully written before the index
+  that hands it over becomes visible. That matters on SMP ARM boards,
+  where volatile alone does not order the stores.
+
+  Besides copying in and out, the producer can reserve() the next
+  contiguous free region, fill it in place (for example with
+  ::read()) and commit() it, and the consumer can peek() at the next
+  contiguous run of data, use it in place (for example with
+  ::write()) and advance() past it. The bulk calls use memcpy, so T
+  must be a plain data type for them.
+ */
+template <class T>
+class RingBuffer {
+public:
+    RingBuffer(uint32_t size = 0) :
+        _buf(NULL),
+        _size(0),
+        _head(0),
+        _tail(0)
+    {
+        set_size(size);
+    }
+    ~RingBuffer(void) {
+        delete[] _buf;
+    }
+
+    // change the capacity, discarding the contents. Neither side may
+    // use the buffer while this runs. Returns false if there is not
+    // enough memory, leaving the buffer with no capacity
+    bool set_size(uint32_t size) {
+        delete[] _buf;
+        _buf = NULL;
+        _size = 0;
+        _head = _tail = 0;
+        if (size == 0) {
+            return true;
+        }
+        // one slot is always left free to tell full from empty
+        _buf = new T[size+1];
+        if (_buf == NULL) {
+            return false;
+        }
+        _size = size+1;
+        return true;
+    }
+
+    // the capacity in objects
+    uint32_t get_size(void) const {
+        return _size == 0 ? 0 : _size - 1;
+    }
+
+    // number of objects available to read
+    uint32_t available(void) const {
+        uint32_t head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+        uint32_t tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+        return (tail >= head) ? tail - head : _size - head + tail;
+    }
+
+    // number of objects that can be written
+    uint32_t space(void) const {
+        return get_size() - available();
+    }
+
+    bool empty(void) const {
+        return available() == 0;
+    }
+
+    /*
+      producer side
+     */
+
+    // the next contiguous free region. len is set to its length,
+    // which is less than space() when the free space wraps. Fill in
+    // up to len objects and then commit() them
+    T *reserve(uint32_t &len) {
+        uint32_t head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+        uint32_t tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+        if (_size == 0) {
+            len = 0;
+        } else if (tail >= head) {
+            // up to the end of the buffer, keeping the slot before
+            // the head free
+            len = (head == 0) ? _size - 1 - tail : _size - tail;
+        } else {
+            len = head - 1 - tail;
+        }
+        return &_buf[tail];
+    }
+
+    // hand over n objects filled in after reserve()
+    void commit(uint32_t n) {
+        if (n == 0) {
+            return;
+        }
+        uint32_t tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+        __atomic_store_n(&_tail, (tail + n) % _size, __ATOMIC_RELEASE);
+    }
+
+    // copy in up to n objects, returning the number written
+    uint32_t write(const T *data, uint32_t n) {
+        uint32_t written = 0;
+        // at most two regions, before and after the wrap
+        for (uint8_t i=0; i<2 && written < n; i++) {
+            uint32_t len;
+            T *region = reserve(len);
+            if (len == 0) {
+                break;
+            }
+            if (len > n - written) {
+                len = n - written;
+            }
+            memcpy(region, &data[written], len * sizeof(T));
+            commit(len);
+            written += len;
+        }
+        return written;
+    }
+
+    // add one object. Returns false if full
+    bool push(const T &object) {
+        uint32_t len;
+        T *region = reserve(len);
+        if (len == 0) {
+            return false;
+        }
+        *region = object;
+        commit(1);
+        return true;
+    }
+
+    /*
+      consumer side
+     */
+
+    // the next contiguous run of data. len is set to its length,
+    // which is less than available() when the data wraps. Use up to
+    // len objects in place and then advance() past them
+    const T *peek(uint32_t &len) const {
+        uint32_t head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+        uint32_t tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+        len = (tail >= head) ? tail - head : _size - head;
+        return &_buf[head];
+    }
+
+    // copy out up to n objects without removing them, returning the
+    // number copied
+    uint32_t peek(T *data, uint32_t n) const {
+        uint32_t head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+        uint32_t tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+        uint32_t copied = 0;
+        while (copied < n && head != tail) {
+            uint32_t len = (tail >= head) ? tail - head : _size - head;
+            if (len > n - copied) {
+                len = n - copied;
+            }
+            memcpy(&data[copied], &_buf[head], len * sizeof(T));
+            copied += len;
+            head = (head + len) % _size;
+        }
+        return copied;
+    }
+
+    // remove n objects, which must be no more than available()
+    void advance(uint32_t n) {
+        if (n == 0) {
+            return;
+        }
+        uint32_t head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+        __atomic_store_n(&_head, (head + n) % _size, __ATOMIC_RELEASE);
+    }
+
+    // copy out and remove up to n objects, returning the number read
+    uint32_t read(T *data, uint32_t n) {
+        uint32_t copied = peek(data, n);
+        advance(copied);
+        return copied;
+    }
+
+    // remove the oldest object. Returns false if empty
+    bool pop(T &object) {
+        uint32_t len;
+        const T *region = peek(len);
+        if (len == 0) {
+            return false;
+        }
+        object = *region;
+        advance(1);
+        return true;
+    }
+
+    // discard all queued objects, called by the consumer
+    void clear(void) {
+        __atomic_store_n(&_head, __atomic_load_n(&_tail, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    }
+
+private:
+    T *_buf;
+    uint32_t _size;
+    uint32_t _head;
+    uint32_t _tail;
+};
+
+// a ring buffer of bytes, as used for UART and log buffers
+typedef RingBuffer<uint8_t> ByteBuffer;
+
+// a ring buffer with a fixed capacity of objects
+template <class T>
+class ObjectBuffer : public RingBuffer<T> {
+public:
+    ObjectBuffer(uint16_t size) :
+        RingBuffer<T>(size)
+    {}
+};
+
 #endif // __AP_HAL_UTILITY_RINGBUFFER_H__
@@ -20,6 +20,8 @@ using namespace Linux;
 
 extern const AP_HAL::HAL& hal;
 
+#define APM_LINUX_SENSOR_PRIORITY       16
+#define APM_LINUX_WORKER_PRIORITY       12
 #define APM_LINUX_TIMER_PRIORITY        15
 #define APM_LINUX_UART_PRIORITY         14
 #define APM_LINUX_RCIN_PRIORITY         13
@@ -28,7 +30,11 @@ extern const AP_HAL::HAL& hal;
 #define APM_LINUX_IO_PRIORITY           10
 
 LinuxScheduler::LinuxScheduler()
-{}
+{
+    pthread_mutex_init(&_worker_mutex, NULL);
+    pthread_cond_init(&_worker_start_cond, NULL);
+    pthread_cond_init(&_worker_done_cond, NULL);
+}
 
 void LinuxScheduler::_create_realtime_thread(pthread_t *ctx, int rtprio,
                                              const char *name,
@@ -77,6 +83,11 @@ void LinuxScheduler::init(void* machtnichts)
         const char *name;
         pthread_startroutine_t start_routine;
     } *iter, table[] = {
+        { .ctx = &_sensor_thread_ctx,
+          .rtprio = APM_LINUX_SENSOR_PRIORITY,
+          .name = "sched-sensor",
+          .start_routine = &Linux::LinuxScheduler::_sensor_thread,
+        },
         { .ctx = &_timer_thread_ctx,
           .rtprio = APM_LINUX_TIMER_PRIORITY,
           .name = "sched-timer",
@@ -221,6 +232,83 @@ void LinuxScheduler::register_io_process(AP_HAL::MemberProc proc)
     }
 }
 
+/*
+  sensor processes run on their own thread, so that IMU sampling is
+  not delayed by the other timer processes
+ */
+void LinuxScheduler::register_sensor_process(AP_HAL::MemberProc proc)
+{
+    for (uint8_t i = 0; i < _num_sensor_procs; i++) {
+        if (_sensor_proc[i] == proc) {
+            return;
+        }
+    }
+
+    if (_num_sensor_procs < LINUX_SCHEDULER_MAX_SENSOR_PROCS) {
+        _sensor_proc[_num_sensor_procs] = proc;
+        _num_sensor_procs++;
+    } else {
+        hal.console->printf("Out of sensor processes\n");
+    }
+}
+
+/*
+  start worker threads for run_parallel(). Workers run at the priority
+  of the main thread, as they do its work, and are spread over the
+  CPUs other than the first where there is more than one
+ */
+void LinuxScheduler::_start_workers(uint8_t count)
+{
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    while (_num_workers < count) {
+        _create_realtime_thread(&_worker[_num_workers].ctx, APM_LINUX_WORKER_PRIORITY,
+                                "sched-worker", &Linux::LinuxScheduler::_worker_thread);
+        if (ncpus > 1) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(1 + _num_workers % (ncpus - 1), &cpus);
+            pthread_setaffinity_np(_worker[_num_workers].ctx, sizeof(cpus), &cpus);
+        }
+        _num_workers++;
+    }
+}
+
+/*
+  run the tasks on the calling thread and the worker threads, and wait
+  for all of them to finish
+ */
+void LinuxScheduler::run_parallel(const AP_HAL::MemberProc *procs, uint8_t count)
+{
+    if (count == 0) {
+        return;
+    }
+    uint8_t nworkers = count - 1;
+    if (nworkers > LINUX_SCHEDULER_MAX_WORKERS) {
+        nworkers = LINUX_SCHEDULER_MAX_WORKERS;
+    }
+    _start_workers(nworkers);
+
+    pthread_mutex_lock(&_worker_mutex);
+    for (uint8_t i = 0; i < nworkers; i++) {
+        _worker[i].proc = procs[i+1];
+        _worker[i].pending = true;
+    }
+    _workers_busy = nworkers;
+    pthread_cond_broadcast(&_worker_start_cond);
+    pthread_mutex_unlock(&_worker_mutex);
+
+    procs[0]();
+    for (uint8_t i = nworkers+1; i < count; i++) {
+        procs[i]();
+    }
+
+    pthread_mutex_lock(&_worker_mutex);
+    while (_workers_busy > 0) {
+        pthread_cond_wait(&_worker_done_cond, &_worker_mutex);
+    }
+    pthread_mutex_unlock(&_worker_mutex);
+}
+
 void LinuxScheduler::register_timer_failsafe(AP_HAL::Proc failsafe, uint32_t period_us)
 {
     _failsafe = failsafe;
@@ -291,6 +379,60 @@ void *LinuxScheduler::_timer_thread(void* arg)
     return NULL;
 }
 
+void *LinuxScheduler::_sensor_thread(void* arg)
+{
+    LinuxScheduler* sched = (LinuxScheduler *)arg;
+
+    while (sched->system_initializing()) {
+        poll(NULL, 0, 1);
+    }
+    /*
+      run at an average of 1kHz like the timer thread, but without
+      waiting on the timer semaphore or the other timer processes
+     */
+    uint64_t next_run_usec = sched->micros64() + 1000;
+    while (true) {
+        uint64_t dt = next_run_usec - sched->micros64();
+        if (dt > 2000) {
+            // we've lost sync - restart
+            next_run_usec = sched->micros64();
+        } else {
+            sched->_microsleep(dt);
+        }
+        next_run_usec += 1000;
+        for (uint8_t i = 0; i < sched->_num_sensor_procs; i++) {
+            if (sched->_sensor_proc[i]) {
+                sched->_sensor_proc[i]();
+            }
+        }
+    }
+    return NULL;
+}
+
+void *LinuxScheduler::_worker_thread(void* arg)
+{
+    LinuxScheduler* sched = (LinuxScheduler *)arg;
+
+    pthread_mutex_lock(&sched->_worker_mutex);
+    uint8_t idx = sched->_workers_started++;
+    while (true) {
+        while (!sched->_worker[idx].pending) {
+            pthread_cond_wait(&sched->_worker_start_cond, &sched->_worker_mutex);
+        }
+        AP_HAL::MemberProc proc = sched->_worker[idx].proc;
+        pthread_mutex_unlock(&sched->_worker_mutex);
+
+        proc();
+
+        pthread_mutex_lock(&sched->_worker_mutex);
+        sched->_worker[idx].pending = false;
+        if (--sched->_workers_busy == 0) {
+            pthread_cond_signal(&sched->_worker_done_cond);
+        }
+    }
+    return NULL;
+}
+
 void LinuxScheduler::_run_io(void)
 {
     if (!_io_semaphore.take(0)) {
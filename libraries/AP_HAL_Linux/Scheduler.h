@@ -11,6 +11,8 @@
 
 #define LINUX_SCHEDULER_MAX_TIMER_PROCS 10
 #define LINUX_SCHEDULER_MAX_IO_PROCS 10
+#define LINUX_SCHEDULER_MAX_SENSOR_PROCS 4
+#define LINUX_SCHEDULER_MAX_WORKERS 3
 
 class Linux::LinuxScheduler : public AP_HAL::Scheduler {
 
@@ -30,6 +32,8 @@ public:
 
     void     register_timer_process(AP_HAL::MemberProc);
     void     register_io_process(AP_HAL::MemberProc);
+    void     register_sensor_process(AP_HAL::MemberProc);
+    void     run_parallel(const AP_HAL::MemberProc *procs, uint8_t count);
     void     suspend_timer_procs();
     void     resume_timer_procs();
 
@@ -69,6 +73,9 @@ private:
     uint8_t _num_io_procs;
     volatile bool _in_io_proc;
 
+    AP_HAL::MemberProc _sensor_proc[LINUX_SCHEDULER_MAX_SENSOR_PROCS];
+    volatile uint8_t _num_sensor_procs;
+
     volatile bool _timer_event_missed;
 
     pthread_t _timer_thread_ctx;
@@ -76,15 +83,32 @@ private:
     pthread_t _rcin_thread_ctx;
     pthread_t _uart_thread_ctx;
     pthread_t _tonealarm_thread_ctx;
+    pthread_t _sensor_thread_ctx;
+
+    // worker threads for run_parallel(), started on first use
+    struct {
+        pthread_t ctx;
+        AP_HAL::MemberProc proc;
+        bool pending;
+    } _worker[LINUX_SCHEDULER_MAX_WORKERS];
+    uint8_t _num_workers;
+    uint8_t _workers_started;
+    uint8_t _workers_busy;
+    pthread_mutex_t _worker_mutex;
+    pthread_cond_t _worker_start_cond;
+    pthread_cond_t _worker_done_cond;
 
     static void *_timer_thread(void* arg);
     static void *_io_thread(void* arg);
     static void *_rcin_thread(void* arg);
     static void *_uart_thread(void* arg);
     static void *_tonealarm_thread(void* arg);
+    static void *_sensor_thread(void* arg);
+    static void *_worker_thread(void* arg);
 
     void _run_timers(bool called_from_timer_thread);
     void _run_io(void);
+    void _start_workers(uint8_t count);
     void _create_realtime_thread(pthread_t *ctx, int rtprio, const char *name,
                                  pthread_startroutine_t start_routine);
 
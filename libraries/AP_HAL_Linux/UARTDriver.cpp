@@ -33,7 +33,9 @@ LinuxUARTDriver::LinuxUARTDriver(bool default_console) :
     _rd_fd(-1),
     _wr_fd(-1),
     _packetise(false),
-    _flow_control(FLOW_CONTROL_DISABLE)
+    _flow_control(FLOW_CONTROL_DISABLE),
+    _baudrate(0),
+    _receive_timestamp_us(0)
 {
     if (default_console) {
         _rd_fd = 0;
@@ -156,35 +158,26 @@ void LinuxUARTDriver::begin(uint32_t b, uint16_t rxS, uint16_t txS)
         t.c_lflag &= ~(ISIG | ICANON | IEXTEN | ECHO | ECHOE | ECHOK | ECHOCTL | ECHOKE);
         t.c_cc[VMIN] = 0;
         tcsetattr(_rd_fd, TCSANOW, &t);
+        if (isatty(_rd_fd)) {
+            _baudrate = b;
+        }
     }
 
     /*
       allocate the read buffer
     */
-    if (rxS != 0 && rxS != _readbuf_size) {
-        _readbuf_size = rxS;
-        if (_readbuf != NULL) {
-            free(_readbuf);
-        }
-        _readbuf = (uint8_t *)malloc(_readbuf_size);
-        _readbuf_head = 0;
-        _readbuf_tail = 0;
+    if (rxS != 0 && rxS != _readbuf.get_size()) {
+        _readbuf.set_size(rxS);
     }
 
     /*
       allocate the write buffer
     */
-    if (txS != 0 && txS != _writebuf_size) {
-        _writebuf_size = txS;
-        if (_writebuf != NULL) {
-            free(_writebuf);
-        }
-        _writebuf = (uint8_t *)malloc(_writebuf_size);
-        _writebuf_head = 0;
-        _writebuf_tail = 0;
+    if (txS != 0 && txS != _writebuf.get_size()) {
+        _writebuf.set_size(txS);
     }
 
-    if (_writebuf_size != 0 && _readbuf_size != 0) {
+    if (_writebuf.get_size() != 0 && _readbuf.get_size() != 0) {
         _initialised = true;
     }
 }
@@ -399,19 +392,8 @@ void LinuxUARTDriver::end()
     }
     _rd_fd = -1;
     _wr_fd = -1;
-    if (_readbuf) {
-        free(_readbuf);
-        _readbuf = NULL;
-    }
-    if (_writebuf) {
-        free(_writebuf);
-        _writebuf = NULL;
-    }
-    _readbuf_size = _writebuf_size = 0;
-    _writebuf_head = 0;
-    _writebuf_tail = 0;
-    _readbuf_head = 0;
-    _readbuf_tail = 0;
+    _readbuf.set_size(0);
+    _writebuf.set_size(0);
 }
 
 
@@ -444,7 +426,7 @@ void LinuxUARTDriver::set_blocking_writes(bool blocking)
  */
 bool LinuxUARTDriver::tx_pending() 
 { 
-    return !BUF_EMPTY(_writebuf);
+    return !_writebuf.empty();
 }
 
 /*
@@ -455,8 +437,7 @@ int16_t LinuxUARTDriver::available()
     if (!_initialised) {
         return 0;
     }
-    uint16_t _tail;
-    return BUF_AVAILABLE(_readbuf);
+    return _readbuf.available();
 }
 
 /*
@@ -467,40 +448,60 @@ int16_t LinuxUARTDriver::txspace()
     if (!_initialised) {
         return 0;
     }
-    uint16_t _head;
-    return BUF_SPACE(_writebuf);
+    return _writebuf.space();
 }
 
 int16_t LinuxUARTDriver::read() 
 { 
     uint8_t c;
-    if (!_initialised || _readbuf == NULL) {
+    if (!_initialised) {
         return -1;
     }
-    if (BUF_EMPTY(_readbuf)) {
+    if (!_readbuf.pop(c)) {
         return -1;
     }
-    c = _readbuf[_readbuf_head];
-    BUF_ADVANCEHEAD(_readbuf, 1);
     return c;
 }
 
+/*
+  read up to count bytes from the read buffer
+ */
+uint16_t LinuxUARTDriver::read_bytes(uint8_t *buffer, uint16_t count)
+{
+    if (!_initialised) {
+        return 0;
+    }
+    return _readbuf.read(buffer, count);
+}
+
+/*
+  work back from the time of the last read from the device over the
+  nbytes asked for and the bytes still waiting, assuming 10 bits
+  per byte on a serial device
+ */
+uint64_t LinuxUARTDriver::receive_time_constraint_us(uint16_t nbytes)
+{
+    uint64_t last_receive_us = __atomic_load_n(&_receive_timestamp_us, __ATOMIC_ACQUIRE);
+    if (_baudrate > 0) {
+        uint32_t transport_time_us = (10000000ULL * (nbytes + available())) / _baudrate;
+        last_receive_us -= transport_time_us;
+    }
+    return last_receive_us;
+}
+
 /* Linux implementations of Print virtual methods */
 size_t LinuxUARTDriver::write(uint8_t c) 
 { 
     if (!_initialised) {
         return 0;
     }
-    uint16_t _head;
 
-    while (BUF_SPACE(_writebuf) == 0) {
+    while (!_writebuf.push(c)) {
         if (_nonblocking_writes) {
             return 0;
         }
         hal.scheduler->delay(1);
     }
-    _writebuf[_writebuf_tail] = c;
-    BUF_ADVANCETAIL(_writebuf, 1);
     return 1;
 }
 
@@ -524,36 +525,7 @@ size_t LinuxUARTDriver::write(const uint8_t *buffer, size_t size)
         return ret;
     }
 
-    uint16_t _head, space;
-    space = BUF_SPACE(_writebuf);
-    if (space == 0) {
-        return 0;
-    }
-    if (size > space) {
-        size = space;
-    }
-    if (_writebuf_tail < _head) {
-        // perform as single memcpy
-        assert(_writebuf_tail+size <= _writebuf_size);
-        memcpy(&_writebuf[_writebuf_tail], buffer, size);
-        BUF_ADVANCETAIL(_writebuf, size);
-        return size;
-    }
-
-    // perform as two memcpy calls
-    uint16_t n = _writebuf_size - _writebuf_tail;
-    if (n > size) n = size;
-    assert(_writebuf_tail+n <= _writebuf_size);
-    memcpy(&_writebuf[_writebuf_tail], buffer, n);
-    BUF_ADVANCETAIL(_writebuf, n);
-    buffer += n;
-    n = size - n;
-    if (n > 0) {
-        assert(_writebuf_tail+n <= _writebuf_size);
-        memcpy(&_writebuf[_writebuf_tail], buffer, n);
-        BUF_ADVANCETAIL(_writebuf, n);
-    }        
-    return size;
+    return _writebuf.write(buffer, size);
 }
 
 /*
@@ -572,11 +544,6 @@ int LinuxUARTDriver::_write_fd(const uint8_t *buf, uint16_t n)
         ret = ::write(_wr_fd, buf, n);
     }
 
-    if (ret > 0) {
-        BUF_ADVANCEHEAD(_writebuf, ret);
-        return ret;
-    }
-
     return ret;
 }
 
@@ -587,9 +554,7 @@ int LinuxUARTDriver::_read_fd(uint8_t *buf, uint16_t n)
 {
     int ret;
     ret = ::read(_rd_fd, buf, n);
-    if (ret > 0) {
-        BUF_ADVANCETAIL(_readbuf, ret);
-    } else {
+    if (ret <= 0) {
         switch (errno) {
             case EAGAIN: 
                 /* Ignore EAGAIN that resulted from non-blocking read */
@@ -621,9 +586,9 @@ void LinuxUARTDriver::_timer_tick(void)
     _in_timer = true;
 
     // write any pending bytes
-    uint16_t _tail;
-    n = BUF_AVAILABLE(_writebuf);
-    if (_packetise && n > 0 && _writebuf[_writebuf_head] == 254) {
+    uint8_t header[2];
+    n = _writebuf.available();
+    if (_packetise && _writebuf.peek(header, sizeof(header)) > 0 && header[0] == 254) {
         // this looks like a MAVLink packet - try to write on
         // packet boundaries when possible
         if (n < 8) {
@@ -632,8 +597,7 @@ void LinuxUARTDriver::_timer_tick(void)
             // the length of the packet is the 2nd byte, and mavlink
             // packets have a 6 byte header plus 2 byte checksum,
             // giving len+8 bytes
-            uint16_t ofs = (_writebuf_head + 1) % _writebuf_size;
-            uint8_t len = _writebuf[ofs];
+            uint8_t len = header[1];
             if (n < len+8) {
                 // we don't have a full packet yet
                 n = 0;
@@ -646,46 +610,63 @@ void LinuxUARTDriver::_timer_tick(void)
     }
 
     if (n > 0) {
-        uint16_t n1 = _writebuf_size - _writebuf_head;
+        uint32_t n1;
+        const uint8_t *data = _writebuf.peek(n1);
         if (n1 >= n) {
             // do as a single write
-            _write_fd(&_writebuf[_writebuf_head], n);
+            int ret = _write_fd(data, n);
+            if (ret > 0) {
+                _writebuf.advance(ret);
+            }
+        } else if (_packetise) {
+            // keep as a single UDP packet
+            uint8_t tmpbuf[n];
+            _writebuf.peek(tmpbuf, n);
+            int ret = _write_fd(tmpbuf, n);
+            if (ret > 0) {
+                _writebuf.advance(ret);
+            }
         } else {
             // split into two writes
-            if (_packetise) {
-                // keep as a single UDP packet
-                uint8_t tmpbuf[n];
-                memcpy(tmpbuf, &_writebuf[_writebuf_head], n1);
-                if (n > n1) {
-                    memcpy(&tmpbuf[n1], &_writebuf[0], n-n1);
+            int ret = _write_fd(data, n1);
+            if (ret > 0) {
+                _writebuf.advance(ret);
+            }
+            if (ret == (int)n1) {
+                uint32_t remaining = n - n1;
+                data = _writebuf.peek(n1);
+                if (n1 > remaining) {
+                    n1 = remaining;
                 }
-                _write_fd(tmpbuf, n);
-            } else {
-                int ret = _write_fd(&_writebuf[_writebuf_head], n1);
-                if (ret == n1 && n > n1) {
-                    _write_fd(&_writebuf[_writebuf_head], n - n1);                
+                ret = _write_fd(data, n1);
+                if (ret > 0) {
+                    _writebuf.advance(ret);
                 }
             }
         }
     }
 
-    // try to fill the read buffer
-    uint16_t _head;
-    n = BUF_SPACE(_readbuf);
-    if (n > 0) {
-        uint16_t n1 = _readbuf_size - _readbuf_tail;
-        if (n1 >= n) {
-            // one read will do
-            assert(_readbuf_tail+n <= _readbuf_size);
-            _read_fd(&_readbuf[_readbuf_tail], n);
-        } else {
-            assert(_readbuf_tail+n1 <= _readbuf_size);
-            int ret = _read_fd(&_readbuf[_readbuf_tail], n1);
-            if (ret == n1 && n > n1) {
-                assert(_readbuf_tail+(n-n1) <= _readbuf_size);
-                _read_fd(&_readbuf[_readbuf_tail], n - n1);                
-            }
+    // try to fill the read buffer, reading directly into the free
+    // space which may be in two parts
+    bool received = false;
+    for (uint8_t i=0; i<2; i++) {
+        uint32_t space;
+        uint8_t *region = _readbuf.reserve(space);
+        if (space == 0) {
+            break;
         }
+        int ret = _read_fd(region, space);
+        if (ret <= 0) {
+            break;
+        }
+        _readbuf.commit(ret);
+        received = true;
+        if (ret < (int)space) {
+            break;
+        }
+    }
+    if (received) {
+        __atomic_store_n(&_receive_timestamp_us, hal.scheduler->micros64(), __ATOMIC_RELEASE);
     }
 
     _in_timer = false;
@@ -3,6 +3,7 @@
 #define __AP_HAL_LINUX_UARTDRIVER_H__
 
 #include <AP_HAL_Linux.h>
+#include "../AP_HAL/utility/RingBuffer.h"
 
 class Linux::LinuxUARTDriver : public AP_HAL::UARTDriver {
 public:
@@ -20,6 +21,8 @@ public:
     int16_t available();
     int16_t txspace();
     int16_t read();
+    uint16_t read_bytes(uint8_t *buffer, uint16_t count);
+    uint64_t receive_time_constraint_us(uint16_t nbytes);
 
     /* Linux implementations of Print virtual methods */
     size_t write(uint8_t c);
@@ -57,24 +60,23 @@ private:
     enum device_type _parseDevicePath(const char *arg);
     uint64_t _last_write_time;    
 
+    // baudrate of a serial device, zero for sockets and the console
+    uint32_t _baudrate;
+
+    // system time of the last read that added to _readbuf
+    volatile uint64_t _receive_timestamp_us;
+
 protected:
     char *device_path;
     volatile bool _initialised;
     // we use in-task ring buffers to reduce the system call cost
-    // of ::read() and ::write() in the main loop
-    uint8_t *_readbuf;
-    uint16_t _readbuf_size;
-
-    // _head is where the next available data is. _tail is where new
-    // data is put
-    volatile uint16_t _readbuf_head;
-    volatile uint16_t _readbuf_tail;
-
-    uint8_t *_writebuf;
-    uint16_t _writebuf_size;
-    volatile uint16_t _writebuf_head;
-    volatile uint16_t _writebuf_tail;
+    // of ::read() and ::write() in the main loop. The timer thread
+    // fills _readbuf and drains _writebuf
+    ByteBuffer _readbuf;
+    ByteBuffer _writebuf;
 
+    // read or write directly on the device, returning the number of
+    // bytes transferred. The caller updates the ring buffers
     virtual int _write_fd(const uint8_t *buf, uint16_t n);
     virtual int _read_fd(uint8_t *buf, uint16_t n);
 
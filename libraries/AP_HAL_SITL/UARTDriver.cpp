@@ -161,6 +161,28 @@ int16_t SITLUARTDriver::read(void)
     return -1;
 }
 
+/*
+  read the simulated GPS ports in one go
+ */
+uint16_t SITLUARTDriver::read_bytes(uint8_t *buffer, uint16_t count)
+{
+    if (_portNumber != 1 && _portNumber != 4) {
+        return AP_HAL::UARTDriver::read_bytes(buffer, count);
+    }
+    int16_t n = available();
+    if (n <= 0) {
+        return 0;
+    }
+    if (n > count) {
+        n = count;
+    }
+    ssize_t ret = _sitlState->gps_read(_fd, buffer, n);
+    if (ret <= 0) {
+        return 0;
+    }
+    return ret;
+}
+
 void SITLUARTDriver::flush(void)
 {
 }
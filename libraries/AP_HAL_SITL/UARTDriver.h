@@ -47,6 +47,7 @@ public:
     int16_t available();
     int16_t txspace();
     int16_t read();
+    uint16_t read_bytes(uint8_t *buffer, uint16_t count);
 
     /* Implementations of Print virtual methods */
     size_t write(uint8_t c);
@@ -16,12 +16,12 @@
 */
 void AP_InertialNav_NavEKF::update(float dt)
 {
-    _ahrs_ekf.get_NavEKF().getPosNED(_relpos_cm);
+    _ahrs_ekf.get_NavEKF_lanes().getPosNED(_relpos_cm);
     _relpos_cm *= 100; // convert to cm
 
     _haveabspos = _ahrs_ekf.get_position(_abspos);
 
-    _ahrs_ekf.get_NavEKF().getVelNED(_velocity_cm);
+    _ahrs_ekf.get_NavEKF_lanes().getVelNED(_velocity_cm);
     _velocity_cm *= 100; // convert to cm/s
 
     // InertialNav is NEU
@@ -68,7 +68,7 @@ const Vector3f &AP_InertialNav_NavEKF::get_position(void) const
  */
 bool AP_InertialNav_NavEKF::get_location(struct Location &loc) const
 {
-    return _ahrs_ekf.get_NavEKF().getLLH(loc);
+    return _ahrs_ekf.get_NavEKF_lanes().getLLH(loc);
 }
 
 /**
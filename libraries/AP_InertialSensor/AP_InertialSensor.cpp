@@ -8,6 +8,7 @@
 #include <AP_Notify.h>
 #include <AP_Vehicle.h>
 #include <AP_Math.h>
+#include <DataFlash.h>
 
 /*
   enable TIMING_DEBUG to track down scheduling issues with the main
@@ -1192,6 +1193,10 @@ void AP_InertialSensor::update(void)
                 break;
             }
         }
+
+        if (_dataflash != NULL) {
+            _dataflash->Log_Write_Replay_IMU(*this);
+        }
     }
 
     _have_sample = false;
@@ -44,6 +44,71 @@ void AP_InertialSensor_Backend::_publish_delta_angle(uint8_t instance, const Vec
     _imu._delta_angle_valid[instance] = true;
 }
 
+AP_InertialSensor_Backend::DeltaIntegrator::DeltaIntegrator(void) :
+    _dt(0)
+{}
+
+/*
+  integrate one sample. The coning and sculling corrections follow
+  Savage (1998), Strapdown Inertial Navigation Integration Algorithm
+  Design, with the same second order terms used for coning by the PX4
+  backend (see examples/coning.py)
+ */
+void AP_InertialSensor_Backend::DeltaIntegrator::add_sample(const Vector3f &gyro, const Vector3f &accel, float dt)
+{
+    // trapezoidal delta angle and rectangular delta velocity
+    Vector3f delAng = (gyro + _last_gyro) * 0.5f * dt;
+    Vector3f delVel = accel * dt;
+
+    // coning correction
+    Vector3f delConing = ((_delta_angle + _last_delta_angle*(1.0f/6.0f)) % delAng) * 0.5f;
+
+    // sculling correction
+    Vector3f delSculling = ((_delta_angle + _last_delta_angle*(1.0f/6.0f)) % delVel +
+                            (_delta_velocity + _last_delta_velocity*(1.0f/6.0f)) % delAng) * 0.5f;
+
+    _delta_angle += delAng + delConing;
+    _delta_velocity += delVel;
+    _sculling += delSculling;
+    _dt += dt;
+
+    _last_gyro = gyro;
+    _last_delta_angle = delAng;
+    _last_delta_velocity = delVel;
+}
+
+/*
+  the delta velocity is expressed in the body frame at the start of
+  the period, so add the rotation compensation to the sculling term
+ */
+void AP_InertialSensor_Backend::DeltaIntegrator::get(Vector3f &delta_angle, Vector3f &delta_velocity, float &dt) const
+{
+    delta_angle = _delta_angle;
+    delta_velocity = _delta_velocity + (_delta_angle % _delta_velocity) * 0.5f + _sculling;
+    dt = _dt;
+}
+
+void AP_InertialSensor_Backend::DeltaIntegrator::reset(void)
+{
+    _delta_angle.zero();
+    _delta_velocity.zero();
+    _sculling.zero();
+    _dt = 0;
+}
+
+void AP_InertialSensor_Backend::_publish_delta_integral(uint8_t gyro_instance, uint8_t accel_instance, DeltaIntegrator &integrator)
+{
+    if (!integrator.have_samples()) {
+        return;
+    }
+    Vector3f delta_angle, delta_velocity;
+    float dt;
+    integrator.get(delta_angle, delta_velocity, dt);
+    _publish_delta_angle(gyro_instance, delta_angle);
+    _publish_delta_velocity(accel_instance, delta_velocity, dt);
+    integrator.reset();
+}
+
 /*
   rotate gyro vector and add the gyro offset
  */
@@ -67,6 +67,41 @@ protected:
     void _publish_delta_velocity(uint8_t instance, const Vector3f &delta_velocity, float dt);
     void _publish_delta_angle(uint8_t instance, const Vector3f &delta_angle);
 
+    /*
+      integrator of every raw sample from a sensor into a coning
+      corrected delta angle and a sculling corrected delta velocity,
+      for backends that collect samples at the full sensor rate
+     */
+    class DeltaIntegrator {
+    public:
+        DeltaIntegrator(void);
+
+        // add a body frame gyro (rad/s) and accel (m/s/s) sample
+        // covering dt seconds
+        void add_sample(const Vector3f &gyro, const Vector3f &accel, float dt);
+
+        // true if samples have been added since the last reset()
+        bool have_samples(void) const { return _dt > 0; }
+
+        // get the delta angle, delta velocity and time since the last reset()
+        void get(Vector3f &delta_angle, Vector3f &delta_velocity, float &dt) const;
+
+        // start a new integration period
+        void reset(void);
+
+    private:
+        Vector3f _delta_angle;          // coning corrected delta angle
+        Vector3f _delta_velocity;       // sum of delta velocities
+        Vector3f _sculling;             // sculling correction
+        float _dt;
+        Vector3f _last_gyro;
+        Vector3f _last_delta_angle;
+        Vector3f _last_delta_velocity;
+    };
+
+    // publish the integrated delta angle and velocity and start a new integration period
+    void _publish_delta_integral(uint8_t gyro_instance, uint8_t accel_instance, DeltaIntegrator &integrator);
+
     // rotate gyro vector, offset and publish
     void _publish_gyro(uint8_t instance, const Vector3f &gyro, bool rotate_and_correct = true);
 
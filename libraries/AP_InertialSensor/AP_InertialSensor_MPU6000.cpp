@@ -182,8 +182,7 @@ AP_InertialSensor_MPU6000::AP_InertialSensor_MPU6000(AP_InertialSensor &imu) :
     _last_gyro_filter_hz(-1),
     _error_count(0),
 #if MPU6000_FAST_SAMPLING
-    _accel_filter(1000, 15),
-    _gyro_filter(1000, 15),
+    _filter_bank(1000, 15),
 #else
     _sample_count(0),
     _accel_sum(),
@@ -308,12 +307,12 @@ bool AP_InertialSensor_MPU6000::update( void )
 
 #if MPU6000_FAST_SAMPLING
     if (_last_accel_filter_hz != _accel_filter_cutoff()) {
-        _accel_filter.set_cutoff_frequency(1000, _accel_filter_cutoff());
+        _filter_bank.set_cutoff_frequency(0, 3, 1000, _accel_filter_cutoff());
         _last_accel_filter_hz = _accel_filter_cutoff();
     }
 
     if (_last_gyro_filter_hz != _gyro_filter_cutoff()) {
-        _gyro_filter.set_cutoff_frequency(1000, _gyro_filter_cutoff());
+        _filter_bank.set_cutoff_frequency(3, 3, 1000, _gyro_filter_cutoff());
         _last_gyro_filter_hz = _gyro_filter_cutoff();
     }
 #else
@@ -391,13 +390,16 @@ void AP_InertialSensor_MPU6000::_read_data_transaction() {
 
 #define int16_val(v, idx) ((int16_t)(((uint16_t)v[2*idx] << 8) | v[2*idx+1]))
 #if MPU6000_FAST_SAMPLING
-    _accel_filtered = _accel_filter.apply(Vector3f(int16_val(rx.v, 1),
-                                                   int16_val(rx.v, 0),
-                                                   -int16_val(rx.v, 2)));
-
-    _gyro_filtered = _gyro_filter.apply(Vector3f(int16_val(rx.v, 5),
-                                                 int16_val(rx.v, 4),
-                                                 -int16_val(rx.v, 6)));
+    const float sample[6] = { (float)int16_val(rx.v, 1),
+                              (float)int16_val(rx.v, 0),
+                              -(float)int16_val(rx.v, 2),
+                              (float)int16_val(rx.v, 5),
+                              (float)int16_val(rx.v, 4),
+                              -(float)int16_val(rx.v, 6) };
+    float filtered[6];
+    _filter_bank.apply(sample, filtered);
+    _accel_filtered = Vector3f(filtered[0], filtered[1], filtered[2]);
+    _gyro_filtered = Vector3f(filtered[3], filtered[4], filtered[5]);
 #else
     _accel_sum.x += int16_val(rx.v, 1);
     _accel_sum.y += int16_val(rx.v, 0);
@@ -21,7 +21,7 @@
 
 #if MPU6000_FAST_SAMPLING
 #include <Filter.h>
-#include <LowPassFilter2p.h>
+#include <LowPassFilter2pBank.h>
 #endif
 
 class AP_InertialSensor_MPU6000 : public AP_InertialSensor_Backend
@@ -80,9 +80,8 @@ private:
     Vector3f _accel_filtered;
     Vector3f _gyro_filtered;
 
-    // Low Pass filters for gyro and accel 
-    LowPassFilter2pVector3f _accel_filter;
-    LowPassFilter2pVector3f _gyro_filter;
+    // Low Pass filters for accel (channels 0-2) and gyro (channels 3-5)
+    LowPassFilter2pBank<6> _filter_bank;
 #else
     // accumulation in timer - must be read with timer disabled
     // the sum of the values since last read
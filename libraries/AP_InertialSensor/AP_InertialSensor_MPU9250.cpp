@@ -178,8 +178,9 @@ AP_InertialSensor_MPU9250::AP_InertialSensor_MPU9250(AP_InertialSensor &imu) :
     _last_accel_filter_hz(-1),
     _last_gyro_filter_hz(-1),
     _shared_data_idx(0),
-    _accel_filter(1000, 15),
-    _gyro_filter(1000, 15),
+    _filter_bank(1000, 15),
+    _raw_samples(MPU9250_RAW_QUEUE_SIZE),
+    _last_raw_sample_us(0),
     _have_sample_available(false)
 {
 }
@@ -248,8 +249,8 @@ bool AP_InertialSensor_MPU9250::_init_sensor(void)
 
     _product_id = AP_PRODUCT_ID_MPU9250;
 
-    // start the timer process to read samples
-    hal.scheduler->register_timer_process(FUNCTOR_BIND_MEMBER(&AP_InertialSensor_MPU9250::_poll_data, void));
+    // start the sensor process to read samples
+    hal.scheduler->register_sensor_process(FUNCTOR_BIND_MEMBER(&AP_InertialSensor_MPU9250::_poll_data, void));
 
 #if MPU9250_DEBUG
     _dump_registers();
@@ -271,7 +272,50 @@ bool AP_InertialSensor_MPU9250::update( void )
 
     accel *= MPU9250_ACCEL_SCALE_1G;
     gyro *= GYRO_SCALE;
+    _rotate_to_board(accel, gyro);
+
+    // integrate every raw sample queued by the sensor thread
+    struct raw_sample sample;
+    while (_raw_samples.pop(sample)) {
+        Vector3f raw_accel = sample.accel * MPU9250_ACCEL_SCALE_1G;
+        Vector3f raw_gyro = sample.gyro * GYRO_SCALE;
+        _rotate_to_board(raw_accel, raw_gyro);
+        _rotate_and_correct_accel(_accel_instance, raw_accel);
+        _rotate_and_correct_gyro(_gyro_instance, raw_gyro);
+
+        // use the nominal 1kHz sample period on the first sample or
+        // after a gap
+        float dt = (sample.timestamp_us - _last_raw_sample_us) * 1.0e-6f;
+        if (_last_raw_sample_us == 0 || dt <= 0 || dt > 0.01f) {
+            dt = 0.001f;
+        }
+        _last_raw_sample_us = sample.timestamp_us;
+
+        _delta_integrator.add_sample(raw_gyro, raw_accel, dt);
+    }
+    _publish_delta_integral(_gyro_instance, _accel_instance, _delta_integrator);
+
+    _publish_gyro(_gyro_instance, gyro);
+    _publish_accel(_accel_instance, accel);
+
+    if (_last_accel_filter_hz != _accel_filter_cutoff()) {
+        _set_accel_filter(_accel_filter_cutoff());
+        _last_accel_filter_hz = _accel_filter_cutoff();
+    }
+
+    if (_last_gyro_filter_hz != _gyro_filter_cutoff()) {
+        _set_gyro_filter(_gyro_filter_cutoff());
+        _last_gyro_filter_hz = _gyro_filter_cutoff();
+    }
+
+    return true;
+}
 
+/*
+  rotate a scaled sample from the sensor frame to the board frame
+ */
+void AP_InertialSensor_MPU9250::_rotate_to_board(Vector3f &accel, Vector3f &gyro) const
+{
     // rotate for bbone default
     accel.rotate(ROTATION_ROLL_180_YAW_90);
     gyro.rotate(ROTATION_ROLL_180_YAW_90);
@@ -289,21 +333,6 @@ bool AP_InertialSensor_MPU9250::update( void )
     accel.rotate(ROTATION_ROLL_180);
     gyro.rotate(ROTATION_ROLL_180);
 #endif
-
-    _publish_gyro(_gyro_instance, gyro);
-    _publish_accel(_accel_instance, accel);
-
-    if (_last_accel_filter_hz != _accel_filter_cutoff()) {
-        _set_accel_filter(_accel_filter_cutoff());
-        _last_accel_filter_hz = _accel_filter_cutoff();
-    }
-
-    if (_last_gyro_filter_hz != _gyro_filter_cutoff()) {
-        _set_gyro_filter(_gyro_filter_cutoff());
-        _last_gyro_filter_hz = _gyro_filter_cutoff();
-    }
-
-    return true;
 }
 
 /*================ HARDWARE FUNCTIONS ==================== */
@@ -343,17 +372,28 @@ void AP_InertialSensor_MPU9250::_read_data_transaction()
 
 #define int16_val(v, idx) ((int16_t)(((uint16_t)v[2*idx] << 8) | v[2*idx+1]))
 
-    Vector3f _accel_filtered = _accel_filter.apply(Vector3f(int16_val(rx.v, 1),
-                                                   int16_val(rx.v, 0),
-                                                   -int16_val(rx.v, 2)));
+    const float sample[6] = { (float)int16_val(rx.v, 1),
+                              (float)int16_val(rx.v, 0),
+                              -(float)int16_val(rx.v, 2),
+                              (float)int16_val(rx.v, 5),
+                              (float)int16_val(rx.v, 4),
+                              -(float)int16_val(rx.v, 6) };
+    float filtered[6];
+    _filter_bank.apply(sample, filtered);
+
+    // queue the unfiltered sample for delta angle and velocity
+    // integration. If update() falls behind the sample is dropped
+    struct raw_sample raw = {
+        Vector3f(sample[0], sample[1], sample[2]),
+        Vector3f(sample[3], sample[4], sample[5]),
+        hal.scheduler->micros()
+    };
+    _raw_samples.push(raw);
 
-    Vector3f _gyro_filtered = _gyro_filter.apply(Vector3f(int16_val(rx.v, 5),
-                                                 int16_val(rx.v, 4),
-                                                 -int16_val(rx.v, 6)));
     // update the shared buffer
     uint8_t idx = _shared_data_idx ^ 1;
-    _shared_data[idx]._accel_filtered = _accel_filtered;
-    _shared_data[idx]._gyro_filtered = _gyro_filtered;
+    _shared_data[idx]._accel_filtered = Vector3f(filtered[0], filtered[1], filtered[2]);
+    _shared_data[idx]._gyro_filtered = Vector3f(filtered[3], filtered[4], filtered[5]);
     _shared_data_idx = idx;
 
     _have_sample_available = true;
@@ -393,7 +433,7 @@ void AP_InertialSensor_MPU9250::_register_write(uint8_t reg, uint8_t val)
  */
 void AP_InertialSensor_MPU9250::_set_accel_filter(uint8_t filter_hz)
 {
-    _accel_filter.set_cutoff_frequency(1000, filter_hz);
+    _filter_bank.set_cutoff_frequency(0, 3, 1000, filter_hz);
 }
 
 /*
@@ -401,7 +441,7 @@ void AP_InertialSensor_MPU9250::_set_accel_filter(uint8_t filter_hz)
  */
 void AP_InertialSensor_MPU9250::_set_gyro_filter(uint8_t filter_hz)
 {
-    _gyro_filter.set_cutoff_frequency(1000, filter_hz);
+    _filter_bank.set_cutoff_frequency(3, 3, 1000, filter_hz);
 }
 
 
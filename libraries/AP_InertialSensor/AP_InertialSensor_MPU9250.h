@@ -8,12 +8,16 @@
 #include <AP_Math.h>
 #include <AP_Progmem.h>
 #include <Filter.h>
-#include <LowPassFilter2p.h>
+#include <LowPassFilter2pBank.h>
+#include <utility/RingBuffer.h>
 #include "AP_InertialSensor.h"
 
 // enable debug to see a register dump on startup
 #define MPU9250_DEBUG 0
 
+// number of raw samples queued between the sensor thread and update()
+#define MPU9250_RAW_QUEUE_SIZE 64
+
 class AP_InertialSensor_MPU9250 : public AP_InertialSensor_Backend
 {
 public:
@@ -51,6 +55,9 @@ private:
     void _set_accel_filter(uint8_t filter_hz);
     void _set_gyro_filter(uint8_t filter_hz);
 
+    // rotate from sensor to board frame
+    void _rotate_to_board(Vector3f &accel, Vector3f &gyro) const;
+
     // This structure is used to pass data from the timer which reads
     // the sensor to the main thread. The _shared_data_idx is used to
     // prevent race conditions by ensuring the data is fully updated
@@ -61,9 +68,19 @@ private:
     } _shared_data[2];
     volatile uint8_t _shared_data_idx;
 
-    // Low Pass filters for gyro and accel 
-    LowPassFilter2pVector3f _accel_filter;
-    LowPassFilter2pVector3f _gyro_filter;
+    // Low Pass filters for accel (channels 0-2) and gyro (channels 3-5)
+    LowPassFilter2pBank<6> _filter_bank;
+
+    // every unfiltered sample, passed from the sensor thread to
+    // update() for delta angle and delta velocity integration
+    struct raw_sample {
+        Vector3f accel;
+        Vector3f gyro;
+        uint32_t timestamp_us;
+    };
+    ObjectBuffer<struct raw_sample> _raw_samples;
+    uint32_t _last_raw_sample_us;
+    DeltaIntegrator _delta_integrator;
 
     // do we currently have a sample pending?
     bool _have_sample_available;
@@ -19,6 +19,8 @@
 #include "quaternion.h"
 #include "polygon.h"
 #include "edc.h"
+#include "ltp.h"
+#include "polygon_fence.h"
 #include "float.h"
 #include "AP_Param.h"
 
@@ -267,6 +267,84 @@ static void test_wrap_cd(void)
     hal.console->printf("wrap_cd tests done\n");
 }
 
+/*
+  test the local tangent plane against location_diff() and the
+  WGS84 conversions
+ */
+static void test_ltp(void)
+{
+    struct Location origin = {0};
+    origin.lat = -35.3632621e7;
+    origin.lng = 149.1652374e7;
+    origin.alt = 58400;
+
+    LocalTangentPlane ltp;
+    ltp.set_origin(origin);
+
+    struct Location locs[ARRAY_LENGTH(test_points)];
+    Vector3f ned[ARRAY_LENGTH(test_points)];
+    for (uint8_t i=0; i<ARRAY_LENGTH(test_points); i++) {
+        locs[i] = origin;
+        location_offset(locs[i], test_points[i].location.x*1000, test_points[i].location.y*1000);
+        locs[i].alt += i*100;
+    }
+    ltp.locations_to_ned(locs, ned, ARRAY_LENGTH(locs));
+    for (uint8_t i=0; i<ARRAY_LENGTH(locs); i++) {
+        Vector2f diff = location_diff(origin, locs[i]);
+        if ((Vector2f(ned[i].x, ned[i].y) - diff).length() > 0.01f ||
+            fabsf(ned[i].z + i) > 0.01f) {
+            hal.console->printf("Failed ltp test %u\n", (unsigned)i);
+        }
+        struct Location loc2 = origin;
+        ltp.ned_to_location(ned[i], loc2);
+        if (get_distance(loc2, locs[i]) > 0.02f) {
+            hal.console->printf("Failed ltp round trip %u\n", (unsigned)i);
+        }
+    }
+
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+    // a point 300km east should be within 1cm in double precision
+    struct Location far = origin;
+    far.lng += 30000000;
+    double north, east;
+    ltp.location_to_ne(far, north, east);
+    double expected = 30000000 * 0.011131884502145034 * cos(origin.lat * 1.0e-7 * DEG_TO_RAD_DOUBLE);
+    if (fabs(north) > 0.01 || fabs(east - expected) > 0.01) {
+        hal.console->printf("Failed ltp double test %f %f\n", north, east - expected);
+    }
+
+    // NED -> ECEF -> NED should round trip
+    Vector3f ned_in(1234.5f, -678.25f, -50.0f), ned_out;
+    Vector3d ecef, llh;
+    ltp.ned_to_ecef(ned_in, ecef);
+    ltp.ecef_to_ned(&ecef, &ned_out, 1);
+    if ((ned_out - ned_in).length() > 0.001f) {
+        hal.console->printf("Failed ltp ecef round trip\n");
+    }
+    wgsecef2llh(ecef, llh);
+    if (fabs(llh[2] - (origin.alt*0.01 + 50)) > 0.5) {
+        hal.console->printf("Failed ltp ecef height %f\n", llh[2]);
+    }
+#endif
+
+    uint32_t t1 = hal.scheduler->micros();
+    for (uint16_t n=0; n<1000; n++) {
+        ltp.locations_to_ned(locs, ned, ARRAY_LENGTH(locs));
+    }
+    uint32_t t2 = hal.scheduler->micros();
+    for (uint16_t n=0; n<1000; n++) {
+        for (uint8_t i=0; i<ARRAY_LENGTH(locs); i++) {
+            Vector2f diff = location_diff(origin, locs[i]);
+            ned[i].x = diff.x;
+        }
+    }
+    uint32_t t3 = hal.scheduler->micros();
+    hal.console->printf("ltp: %u usec, location_diff: %u usec for %u conversions\n",
+                        (unsigned)(t2 - t1), (unsigned)(t3 - t2),
+                        (unsigned)(1000*ARRAY_LENGTH(locs)));
+    hal.console->printf("ltp tests done\n");
+}
+
 #if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
 static void test_wgs_conversion_functions(void)
 {
@@ -363,6 +441,7 @@ void setup(void)
     test_offset();
     test_accuracy();
     test_wrap_cd();
+    test_ltp();
 #if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
     test_wgs_conversion_functions();
 #endif
@@ -63,6 +63,102 @@ static const struct {
 
 #define ARRAY_LENGTH(x) (sizeof((x))/sizeof((x)[0]))
 
+static uint32_t rand_state = 1;
+
+static int32_t rand_range(int32_t low, int32_t high)
+{
+    rand_state = rand_state * 1103515245UL + 12345;
+    return low + (int32_t)((rand_state >> 8) % (uint32_t)(high - low));
+}
+
+/*
+  test the grid indexed PolygonFence against a copy without an index,
+  which tests every zone with Polygon_outside() and every edge for
+  distances
+ */
+static bool test_polygon_fence(void)
+{
+    PolygonFence fence, linear;
+    bool all_passed = true;
+
+    hal.console->println("PolygonFence tests");
+
+    fence.add_zone(OBC_boundary, ARRAY_LENGTH(OBC_boundary), true);
+    linear.add_zone(OBC_boundary, ARRAY_LENGTH(OBC_boundary), true);
+
+    // exclusion zones inside the boundary, each a star with 24 points
+    for (uint8_t z=0; z<30; z++) {
+        Vector2l star[24];
+        Vector2l centre(rand_range(-266300000, -265900000), rand_range(1518350000, 1518700000));
+        for (uint8_t i=0; i<ARRAY_LENGTH(star); i++) {
+            float angle = i * 2 * PI / ARRAY_LENGTH(star);
+            int32_t radius = (i & 1) ? 20000 : rand_range(40000, 80000);
+            star[i] = Vector2l(centre.x + radius*cosf(angle), centre.y + radius*sinf(angle));
+        }
+        fence.add_zone(star, ARRAY_LENGTH(star), false);
+        linear.add_zone(star, ARRAY_LENGTH(star), false);
+    }
+    if (!fence.build()) {
+        hal.console->println("PolygonFence build failed");
+        return false;
+    }
+
+    for (uint8_t i=0; i<ARRAY_LENGTH(test_points); i++) {
+        if (fence.outside(test_points[i].point) != linear.outside(test_points[i].point)) {
+            hal.console->printf("PolygonFence failed test point %u\n", (unsigned)i);
+            all_passed = false;
+        }
+    }
+
+    const uint16_t num_points = 5000;
+    Vector2l *points = new Vector2l[num_points];
+    for (uint16_t i=0; i<num_points; i++) {
+        points[i] = Vector2l(rand_range(-266500000, -265650000), rand_range(1518250000, 1518850000));
+    }
+    // include some vertices, which are on the boundary of their zone
+    points[0] = OBC_boundary[3];
+    points[1] = OBC_boundary[7];
+
+    uint16_t errors = 0;
+    for (uint16_t i=2; i<num_points; i++) {
+        if (fence.outside(points[i]) != linear.outside(points[i])) {
+            errors++;
+        }
+        if (fabsf(fence.distance_to_edge(points[i]) - linear.distance_to_edge(points[i])) > 0.01f) {
+            errors++;
+        }
+    }
+    hal.console->printf("%u errors in %u random points\n", (unsigned)errors, (unsigned)num_points);
+    if (errors != 0) {
+        all_passed = false;
+    }
+
+    uint32_t t0 = hal.scheduler->micros();
+    uint16_t count = 0;
+    for (uint16_t i=0; i<num_points; i++) {
+        count += fence.outside(points[i]);
+    }
+    uint32_t t1 = hal.scheduler->micros();
+    for (uint16_t i=0; i<num_points; i++) {
+        count += linear.outside(points[i]);
+    }
+    uint32_t t2 = hal.scheduler->micros();
+    for (uint16_t i=0; i<num_points; i++) {
+        fence.distance_to_edge(points[i]);
+    }
+    uint32_t t3 = hal.scheduler->micros();
+    for (uint16_t i=0; i<num_points; i++) {
+        linear.distance_to_edge(points[i]);
+    }
+    uint32_t t4 = hal.scheduler->micros();
+    hal.console->printf("outside: %u usec indexed, %u usec linear for %u points (%u outside)\n",
+                        (unsigned)(t1-t0), (unsigned)(t2-t1), (unsigned)num_points, (unsigned)count/2);
+    hal.console->printf("distance: %u usec indexed, %u usec linear\n",
+                        (unsigned)(t3-t2), (unsigned)(t4-t3));
+    delete[] points;
+    return all_passed;
+}
+
 /*
  *  polygon tests
  */
@@ -113,6 +209,9 @@ void setup(void)
     }
     hal.console->printf("%u usec/call\n", (unsigned)((hal.scheduler->micros() 
                     - start_time)/(count*ARRAY_LENGTH(test_points))));
+    if (!test_polygon_fence()) {
+        all_passed = false;
+    }
     hal.console->println(all_passed ? "ALL TESTS PASSED" : "TEST FAILED");
 }
 
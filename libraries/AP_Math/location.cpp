@@ -35,6 +35,11 @@
 
 float longitude_scale(const struct Location &loc)
 {
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+    // no cached value, so this can be called from any thread
+    float scale = cosf(loc.lat * 1.0e-7f * DEG_TO_RAD);
+    return constrain_float(scale, 0.01f, 1.0f);
+#else
     static int32_t last_lat;
     static float scale = 1.0;
     if (labs(last_lat - loc.lat) < 100000) {
@@ -47,6 +52,7 @@ float longitude_scale(const struct Location &loc)
     scale = constrain_float(scale, 0.01f, 1.0f);
     last_lat = loc.lat;
     return scale;
+#endif
 }
 
 
@@ -0,0 +1,152 @@
+/// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+ * ltp.cpp
+ *
+ * This file is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ *  local tangent plane conversions about a fixed origin
+ */
+#include <AP_HAL.h>
+#include "AP_Math.h"
+
+// scaling factor from 1e-7 degrees to meters at equator
+// == 1.0e-7 * DEG_TO_RAD * RADIUS_OF_EARTH
+#define LOCATION_SCALING_FACTOR 0.011131884502145034f
+// inverse of LOCATION_SCALING_FACTOR
+#define LOCATION_SCALING_FACTOR_INV 89.83204953368922f
+#define LOCATION_SCALING_FACTOR_DOUBLE 0.011131884502145034
+
+LocalTangentPlane::LocalTangentPlane() :
+    _have_origin(false),
+    _lng_to_m(LOCATION_SCALING_FACTOR),
+    _m_to_lng(LOCATION_SCALING_FACTOR_INV)
+{
+    memset(&_origin, 0, sizeof(_origin));
+}
+
+/*
+  set the origin and work out the scale factors for it
+ */
+void LocalTangentPlane::set_origin(const struct Location &origin)
+{
+    _origin = origin;
+    float scale = longitude_scale(origin);
+    _lng_to_m = LOCATION_SCALING_FACTOR * scale;
+    _m_to_lng = LOCATION_SCALING_FACTOR_INV / scale;
+
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+    double lat = origin.lat * 1.0e-7 * DEG_TO_RAD_DOUBLE;
+    double lng = origin.lng * 1.0e-7 * DEG_TO_RAD_DOUBLE;
+    _sin_lat = sin(lat);
+    _cos_lat = cos(lat);
+    _sin_lng = sin(lng);
+    _cos_lng = cos(lng);
+    _lng_to_m_double = LOCATION_SCALING_FACTOR_DOUBLE * constrain_float(_cos_lat, 0.01f, 1.0f);
+    wgsllh2ecef(Vector3d(lat, lng, origin.alt * 0.01), _origin_ecef);
+#endif
+
+    _have_origin = true;
+}
+
+/*
+  return the North/East offset in meters of a location from the origin
+ */
+Vector2f LocalTangentPlane::location_to_ne(const struct Location &loc) const
+{
+    return Vector2f((loc.lat - _origin.lat) * LOCATION_SCALING_FACTOR,
+                    (loc.lng - _origin.lng) * _lng_to_m);
+}
+
+/*
+  return the North/East/Down offset in meters of a location from the origin
+ */
+Vector3f LocalTangentPlane::location_to_ned(const struct Location &loc) const
+{
+    return Vector3f((loc.lat - _origin.lat) * LOCATION_SCALING_FACTOR,
+                    (loc.lng - _origin.lng) * _lng_to_m,
+                    (_origin.alt - loc.alt) * 0.01f);
+}
+
+/*
+  convert an array of locations to North/East/Down offsets
+ */
+void LocalTangentPlane::locations_to_ned(const struct Location *locs, Vector3f *ned, uint16_t count) const
+{
+    for (uint16_t i=0; i<count; i++) {
+        ned[i].x = (locs[i].lat - _origin.lat) * LOCATION_SCALING_FACTOR;
+        ned[i].y = (locs[i].lng - _origin.lng) * _lng_to_m;
+        ned[i].z = (_origin.alt - locs[i].alt) * 0.01f;
+    }
+}
+
+/*
+  set a location to a North/East/Down offset from the origin
+ */
+void LocalTangentPlane::ned_to_location(const Vector3f &ned, struct Location &loc) const
+{
+    loc.lat = _origin.lat + (int32_t)(ned.x * LOCATION_SCALING_FACTOR_INV);
+    loc.lng = _origin.lng + (int32_t)(ned.y * _m_to_lng);
+    loc.alt = _origin.alt - (int32_t)(ned.z * 100);
+}
+
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+/*
+  double precision North/East offset of a location from the origin
+ */
+void LocalTangentPlane::location_to_ne(const struct Location &loc, double &north, double &east) const
+{
+    int64_t dlng = (int64_t)loc.lng - _origin.lng;
+    if (dlng > 1800000000LL) {
+        dlng -= 3600000000LL;
+    } else if (dlng < -1800000000LL) {
+        dlng += 3600000000LL;
+    }
+    north = ((int64_t)loc.lat - _origin.lat) * LOCATION_SCALING_FACTOR_DOUBLE;
+    east = dlng * _lng_to_m_double;
+}
+
+/*
+  convert an array of WGS84 ECEF positions to North/East/Down offsets
+  from the origin
+ */
+void LocalTangentPlane::ecef_to_ned(const Vector3d *ecef, Vector3f *ned, uint16_t count) const
+{
+    // the rotation is the same for every point
+    const double sl_cg = _sin_lat * _cos_lng;
+    const double sl_sg = _sin_lat * _sin_lng;
+    const double cl_cg = _cos_lat * _cos_lng;
+    const double cl_sg = _cos_lat * _sin_lng;
+    for (uint16_t i=0; i<count; i++) {
+        double dx = ecef[i].x - _origin_ecef.x;
+        double dy = ecef[i].y - _origin_ecef.y;
+        double dz = ecef[i].z - _origin_ecef.z;
+        ned[i].x = -sl_cg*dx - sl_sg*dy + _cos_lat*dz;
+        ned[i].y = -_sin_lng*dx + _cos_lng*dy;
+        ned[i].z = -cl_cg*dx - cl_sg*dy - _sin_lat*dz;
+    }
+}
+
+/*
+  WGS84 ECEF position of a North/East/Down offset from the origin
+ */
+void LocalTangentPlane::ned_to_ecef(const Vector3f &ned, Vector3d &ecef) const
+{
+    double n = ned.x, e = ned.y, d = ned.z;
+    ecef.x = _origin_ecef.x - _sin_lat*_cos_lng*n - _sin_lng*e - _cos_lat*_cos_lng*d;
+    ecef.y = _origin_ecef.y - _sin_lat*_sin_lng*n + _cos_lng*e - _cos_lat*_sin_lng*d;
+    ecef.z = _origin_ecef.z + _cos_lat*n - _sin_lat*d;
+}
+#endif // HAL_CPU_CLASS
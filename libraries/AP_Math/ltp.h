@@ -0,0 +1,93 @@
+/// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+ * ltp.h
+ *
+ * This file is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LTP_H
+#define LTP_H
+
+/*
+  a local tangent plane, with its origin at a fixed location.
+
+  The scale factors for the origin are worked out once in
+  set_origin(), so converting locations to and from North/East/Down
+  offsets needs no trigonometry. All conversions are const and keep
+  no static state, so one object can be shared by several threads
+  once its origin is set.
+
+  The float conversions use the same spherical earth approximation as
+  location_diff() and location_offset(). The double precision ones
+  keep centimetre accuracy at long range, and the ECEF conversions
+  use the WGS84 ellipsoid
+ */
+class LocalTangentPlane
+{
+public:
+    LocalTangentPlane();
+
+    // set the origin, working out its scale factors
+    void set_origin(const struct Location &origin);
+
+    bool have_origin(void) const { return _have_origin; }
+    const struct Location &get_origin(void) const { return _origin; }
+
+    // North/East offset in meters of a location from the origin
+    Vector2f location_to_ne(const struct Location &loc) const;
+
+    // North/East/Down offset in meters of a location from the
+    // origin. The altitudes must be in the same frame
+    Vector3f location_to_ned(const struct Location &loc) const;
+
+    // convert an array of locations to North/East/Down offsets
+    void locations_to_ned(const struct Location *locs, Vector3f *ned, uint16_t count) const;
+
+    // set the lat/lng/alt of loc to a North/East/Down offset from
+    // the origin. Other fields are left alone
+    void ned_to_location(const Vector3f &ned, struct Location &loc) const;
+
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+    // double precision North/East offset in meters of a location
+    // from the origin, allowing for crossing the date line
+    void location_to_ne(const struct Location &loc, double &north, double &east) const;
+
+    // convert an array of WGS84 ECEF positions to North/East/Down
+    // offsets from the origin
+    void ecef_to_ned(const Vector3d *ecef, Vector3f *ned, uint16_t count) const;
+
+    // WGS84 ECEF position of a North/East/Down offset from the origin
+    void ned_to_ecef(const Vector3f &ned, Vector3d &ecef) const;
+#endif
+
+private:
+    struct Location _origin;
+    bool _have_origin;
+
+    // meters per 1e-7 degree of longitude at the origin latitude,
+    // and the inverse
+    float _lng_to_m;
+    float _m_to_lng;
+
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+    double _lng_to_m_double;
+
+    // ECEF position of the origin and its rotation to NED
+    Vector3d _origin_ecef;
+    double _sin_lat, _cos_lat;
+    double _sin_lng, _cos_lng;
+#endif
+};
+
+#endif // LTP_H
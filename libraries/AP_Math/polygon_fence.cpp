@@ -0,0 +1,463 @@
+/// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+ * polygon_fence.cpp
+ *
+ * This file is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ *  a grid indexed fence of inclusion and exclusion polygons
+ */
+#include <AP_HAL.h>
+#include <stdlib.h>
+#include <string.h>
+#include "AP_Math.h"
+
+#define NO_CELL 0xFFFF
+
+// smallest cell size in 1e-7 degrees, so cell reference points can
+// be moved off edges without leaving the cell
+#define MIN_CELL_SIZE 16
+
+/*
+  orientation of r relative to the line p->q. Positive to the left
+ */
+static int64_t orient(const Vector2l &p, const Vector2l &q, const Vector2l &r)
+{
+    return ((int64_t)q.x - p.x) * ((int64_t)r.y - p.y) - ((int64_t)q.y - p.y) * ((int64_t)r.x - p.x);
+}
+
+/*
+  true if the edge a->b crosses the segment P->R. A vertex on the
+  line through P and R counts as being on its right, so a polygon
+  passing through a vertex on the line is counted once or not at all
+  as it should be. R must not be on the edge
+ */
+static bool segment_crosses(const Vector2l &P, const Vector2l &R, const Vector2l &a, const Vector2l &b)
+{
+    if ((orient(P, R, a) > 0) == (orient(P, R, b) > 0)) {
+        return false;
+    }
+    return (orient(a, b, P) > 0) != (orient(a, b, R) > 0);
+}
+
+/*
+  true if R is on the edge a->b
+ */
+static bool on_edge(const Vector2l &R, const Vector2l &a, const Vector2l &b)
+{
+    return orient(a, b, R) == 0 &&
+        R.x >= min(a.x, b.x) && R.x <= max(a.x, b.x) &&
+        R.y >= min(a.y, b.y) && R.y <= max(a.y, b.y);
+}
+
+PolygonFence::PolygonFence() :
+    _points(NULL),
+    _point_zone(NULL),
+    _num_points(0),
+    _zone_start(),
+    _num_zones(0),
+    _inclusion_mask(0),
+    _cell_size_x(0),
+    _cell_size_y(0),
+    _grid_nx(0),
+    _grid_ny(0),
+    _cell_start(NULL),
+    _cell_edges(NULL),
+    _cell_mask(NULL),
+    _scale_x(0),
+    _scale_y(0)
+{
+}
+
+PolygonFence::~PolygonFence()
+{
+    clear();
+}
+
+void PolygonFence::_free_index(void)
+{
+    free(_cell_start);
+    free(_cell_edges);
+    free(_cell_mask);
+    _cell_start = NULL;
+    _cell_edges = NULL;
+    _cell_mask = NULL;
+}
+
+/*
+  remove all zones
+ */
+void PolygonFence::clear(void)
+{
+    _free_index();
+    free(_points);
+    free(_point_zone);
+    _points = NULL;
+    _point_zone = NULL;
+    _num_points = 0;
+    _num_zones = 0;
+    _inclusion_mask = 0;
+}
+
+/*
+  add an inclusion or exclusion zone
+ */
+bool PolygonFence::add_zone(const Vector2l *points, uint16_t n, bool inclusion)
+{
+    if (n > 1 && points[n-1].x == points[0].x && points[n-1].y == points[0].y) {
+        // the zone is closed implicitly
+        n--;
+    }
+    if (n < 3 || _num_zones >= POLYGON_FENCE_MAX_ZONES || n > 0xFFFEU - _num_points) {
+        return false;
+    }
+    Vector2l *new_points = (Vector2l *)realloc(_points, (_num_points + n) * sizeof(Vector2l));
+    if (new_points == NULL) {
+        return false;
+    }
+    _points = new_points;
+    uint8_t *new_point_zone = (uint8_t *)realloc(_point_zone, _num_points + n);
+    if (new_point_zone == NULL) {
+        return false;
+    }
+    _point_zone = new_point_zone;
+
+    // the index is out of date
+    _free_index();
+
+    if (_num_zones == 0) {
+        _origin = points[0];
+        _scale_x = LATLON_TO_M;
+        _scale_y = LATLON_TO_M * constrain_float(cosf(_origin.x * 1.0e-7f * DEG_TO_RAD), 0.01f, 1.0f);
+    }
+    memcpy(&_points[_num_points], points, n * sizeof(Vector2l));
+    memset(&_point_zone[_num_points], _num_zones, n);
+    _zone_start[_num_zones] = _num_points;
+    _num_points += n;
+    if (inclusion) {
+        _inclusion_mask |= 1UL << _num_zones;
+    }
+    _num_zones++;
+    _zone_start[_num_zones] = _num_points;
+    return true;
+}
+
+/*
+  return the vertex at the end of edge e
+ */
+uint16_t PolygonFence::_edge_end(uint16_t e) const
+{
+    uint8_t zone = _point_zone[e];
+    if (e + 1U == _zone_start[zone+1]) {
+        return _zone_start[zone];
+    }
+    return e + 1;
+}
+
+/*
+  build the grid index over the zones
+ */
+bool PolygonFence::build(void)
+{
+    _free_index();
+    if (_num_zones == 0) {
+        return false;
+    }
+
+    Vector2l pmin = _points[0], pmax = _points[0];
+    for (uint16_t i=1; i<_num_points; i++) {
+        pmin.x = min(pmin.x, _points[i].x);
+        pmin.y = min(pmin.y, _points[i].y);
+        pmax.x = max(pmax.x, _points[i].x);
+        pmax.y = max(pmax.y, _points[i].y);
+    }
+
+    // aim for about one edge per cell
+    uint16_t grid = 1;
+    while (grid < POLYGON_FENCE_MAX_GRID && grid*(uint32_t)grid < _num_points) {
+        grid++;
+    }
+    _grid_min = pmin;
+    _cell_size_x = max((pmax.x - pmin.x) / grid + 1, MIN_CELL_SIZE);
+    _cell_size_y = max((pmax.y - pmin.y) / grid + 1, MIN_CELL_SIZE);
+    _grid_nx = (pmax.x - pmin.x) / _cell_size_x + 1;
+    _grid_ny = (pmax.y - pmin.y) / _cell_size_y + 1;
+    uint16_t num_cells = _grid_nx * (uint16_t)_grid_ny;
+
+    _cell_start = (uint16_t *)calloc(num_cells+1, sizeof(uint16_t));
+    _cell_mask = (uint32_t *)calloc(num_cells, sizeof(uint32_t));
+    if (_cell_start == NULL || _cell_mask == NULL) {
+        _free_index();
+        return false;
+    }
+
+    // count the edges overlapping each cell, then fill in the lists.
+    // The edges are added in order so each list is sorted
+    for (uint8_t pass=0; pass<2; pass++) {
+        for (uint16_t e=0; e<_num_points; e++) {
+            const Vector2l &a = _points[e];
+            const Vector2l &b = _points[_edge_end(e)];
+            uint8_t ix0 = (min(a.x, b.x) - pmin.x) / _cell_size_x;
+            uint8_t ix1 = (max(a.x, b.x) - pmin.x) / _cell_size_x;
+            uint8_t iy0 = (min(a.y, b.y) - pmin.y) / _cell_size_y;
+            uint8_t iy1 = (max(a.y, b.y) - pmin.y) / _cell_size_y;
+            for (uint8_t ix=ix0; ix<=ix1; ix++) {
+                for (uint8_t iy=iy0; iy<=iy1; iy++) {
+                    uint16_t cell = ix*(uint16_t)_grid_ny + iy;
+                    if (pass == 0) {
+                        _cell_start[cell+1]++;
+                    } else {
+                        _cell_edges[_cell_start[cell+1]++] = e;
+                    }
+                }
+            }
+        }
+        if (pass == 0) {
+            uint32_t total = 0;
+            for (uint16_t c=0; c<num_cells; c++) {
+                total += _cell_start[c+1];
+                if (total > 0xFFFFU) {
+                    _free_index();
+                    return false;
+                }
+                _cell_start[c+1] = total - _cell_start[c+1];
+            }
+            _cell_edges = (uint16_t *)malloc(max(total, 1U) * sizeof(uint16_t));
+            if (_cell_edges == NULL) {
+                _free_index();
+                return false;
+            }
+        }
+    }
+    // the fill pass has moved each start on to the end of the
+    // previous cell, which is where the next cell starts
+
+    // work out which zones contain each reference point, walking
+    // from cell to cell so only the edges of two cells are tested
+    // for each one after the first
+    for (uint8_t ix=0; ix<_grid_nx; ix++) {
+        for (uint8_t iy=0; iy<_grid_ny; iy++) {
+            uint16_t cell = ix*(uint16_t)_grid_ny + iy;
+            Vector2l R;
+            _cell_reference(cell, R);
+            if (cell == 0) {
+                _cell_mask[0] = _zone_mask(R);
+                continue;
+            }
+            uint16_t prev = (iy == 0) ? cell - _grid_ny : cell - 1;
+            Vector2l R_prev;
+            _cell_reference(prev, R_prev);
+            _cell_mask[cell] = _cell_mask[prev] ^ _crossings(R_prev, R, prev, cell);
+        }
+    }
+    return true;
+}
+
+/*
+  find the cell holding a point, returning false if it is outside the grid
+ */
+bool PolygonFence::_cell_of(const Vector2l &P, uint16_t &cell) const
+{
+    if (P.x < _grid_min.x || P.y < _grid_min.y) {
+        return false;
+    }
+    int32_t ix = (P.x - _grid_min.x) / _cell_size_x;
+    int32_t iy = (P.y - _grid_min.y) / _cell_size_y;
+    if (ix >= _grid_nx || iy >= _grid_ny) {
+        return false;
+    }
+    cell = ix*(uint16_t)_grid_ny + iy;
+    return true;
+}
+
+/*
+  the reference point of a cell, which is near its centre but not on
+  any edge
+ */
+void PolygonFence::_cell_reference(uint16_t cell, Vector2l &R) const
+{
+    uint8_t ix = cell / _grid_ny;
+    uint8_t iy = cell % _grid_ny;
+    R.x = _grid_min.x + ix*_cell_size_x + _cell_size_x/2;
+    R.y = _grid_min.y + iy*_cell_size_y + _cell_size_y/2;
+    for (uint8_t tries=0; tries<3; tries++) {
+        bool moved = false;
+        for (uint16_t i=_cell_start[cell]; i<_cell_start[cell+1]; i++) {
+            uint16_t e = _cell_edges[i];
+            if (on_edge(R, _points[e], _points[_edge_end(e)])) {
+                R.x += 1;
+                R.y += 2;
+                moved = true;
+                break;
+            }
+        }
+        if (!moved) {
+            break;
+        }
+    }
+}
+
+/*
+  return the mask of zones whose edges cross the segment P->R an odd
+  number of times, using the edges of one or two cells which must
+  hold the whole segment
+ */
+uint32_t PolygonFence::_crossings(const Vector2l &P, const Vector2l &R, uint16_t cell1, uint16_t cell2) const
+{
+    uint32_t mask = 0;
+    uint16_t i = _cell_start[cell1], i_end = _cell_start[cell1+1];
+    uint16_t j = 0, j_end = 0;
+    if (cell2 != NO_CELL) {
+        j = _cell_start[cell2];
+        j_end = _cell_start[cell2+1];
+    }
+    // merge the two sorted lists so edges in both cells count once
+    while (i < i_end || j < j_end) {
+        uint16_t e;
+        if (j >= j_end || (i < i_end && _cell_edges[i] < _cell_edges[j])) {
+            e = _cell_edges[i++];
+        } else if (i >= i_end || _cell_edges[j] < _cell_edges[i]) {
+            e = _cell_edges[j++];
+        } else {
+            e = _cell_edges[i++];
+            j++;
+        }
+        if (segment_crosses(P, R, _points[e], _points[_edge_end(e)])) {
+            mask ^= 1UL << _point_zone[e];
+        }
+    }
+    return mask;
+}
+
+/*
+  return the mask of zones containing a point, testing every zone
+ */
+uint32_t PolygonFence::_zone_mask(const Vector2l &P) const
+{
+    uint32_t mask = 0;
+    for (uint8_t z=0; z<_num_zones; z++) {
+        if (!Polygon_outside(P, &_points[_zone_start[z]], _zone_start[z+1] - _zone_start[z])) {
+            mask |= 1UL << z;
+        }
+    }
+    return mask;
+}
+
+/*
+  true if a point in the given zones is outside the fence
+ */
+bool PolygonFence::_outside(uint32_t mask) const
+{
+    if (_inclusion_mask != 0 && (mask & _inclusion_mask) == 0) {
+        return true;
+    }
+    return (mask & ~_inclusion_mask) != 0;
+}
+
+/*
+  true if the point is outside the fence
+ */
+bool PolygonFence::outside(const Vector2l &P) const
+{
+    if (!ready()) {
+        return _outside(_zone_mask(P));
+    }
+    uint16_t cell;
+    if (!_cell_of(P, cell)) {
+        // outside the bounding box of every zone
+        return _outside(0);
+    }
+    Vector2l R;
+    _cell_reference(cell, R);
+    return _outside(_cell_mask[cell] ^ _crossings(P, R, cell, NO_CELL));
+}
+
+/*
+  distance in meters from a point to an edge, with the point in
+  meters from the origin
+ */
+float PolygonFence::_edge_distance(float px, float py, uint16_t e) const
+{
+    const Vector2l &a = _points[e];
+    const Vector2l &b = _points[_edge_end(e)];
+    float ax = (a.x - _origin.x) * _scale_x;
+    float ay = (a.y - _origin.y) * _scale_y;
+    float dx = (b.x - _origin.x) * _scale_x - ax;
+    float dy = (b.y - _origin.y) * _scale_y - ay;
+    float len2 = dx*dx + dy*dy;
+    float t = 0;
+    if (len2 > 0) {
+        t = constrain_float(((px - ax)*dx + (py - ay)*dy) / len2, 0, 1);
+    }
+    return pythagorous2(px - (ax + t*dx), py - (ay + t*dy));
+}
+
+/*
+  distance in meters to the nearest zone edge. The search works
+  outwards from the point's cell in rings of cells, and stops when
+  the rest of the grid must be further away than the nearest edge
+  found so far
+ */
+float PolygonFence::distance_to_edge(const Vector2l &P) const
+{
+    if (_num_zones == 0) {
+        return -1;
+    }
+    float px = (P.x - _origin.x) * _scale_x;
+    float py = (P.y - _origin.y) * _scale_y;
+    float best = -1;
+
+    if (!ready()) {
+        for (uint16_t e=0; e<_num_points; e++) {
+            float d = _edge_distance(px, py, e);
+            if (best < 0 || d < best) {
+                best = d;
+            }
+        }
+        return best;
+    }
+
+    // start at the nearest cell to the point
+    int16_t cx = constrain_int32((P.x - _grid_min.x) / _cell_size_x, 0, _grid_nx-1);
+    int16_t cy = constrain_int32((P.y - _grid_min.y) / _cell_size_y, 0, _grid_ny-1);
+    float ring_width = min(_cell_size_x * _scale_x, _cell_size_y * _scale_y);
+    int16_t max_ring = max(_grid_nx, _grid_ny);
+
+    for (int16_t r=0; r<max_ring; r++) {
+        for (int16_t ix=cx-r; ix<=cx+r; ix++) {
+            if (ix < 0 || ix >= _grid_nx) {
+                continue;
+            }
+            // only the cells on the edge of the ring
+            int16_t step = (ix == cx-r || ix == cx+r) ? 1 : 2*r;
+            for (int16_t iy=cy-r; iy<=cy+r; iy+=step) {
+                if (iy < 0 || iy >= _grid_ny) {
+                    continue;
+                }
+                uint16_t cell = ix*(uint16_t)_grid_ny + iy;
+                for (uint16_t i=_cell_start[cell]; i<_cell_start[cell+1]; i++) {
+                    float d = _edge_distance(px, py, _cell_edges[i]);
+                    if (best < 0 || d < best) {
+                        best = d;
+                    }
+                }
+            }
+        }
+        if (best >= 0 && best <= r * ring_width) {
+            break;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,104 @@
+/// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+ * polygon_fence.h
+ *
+ * This file is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POLYGON_FENCE_H
+#define POLYGON_FENCE_H
+
+#define POLYGON_FENCE_MAX_ZONES 32
+#define POLYGON_FENCE_MAX_GRID  32
+
+/*
+  a fence made of inclusion and exclusion polygons. A point is inside
+  the fence if it is inside any inclusion zone (or there are none)
+  and outside all exclusion zones.
+
+  Points are lat/lng in 1e-7 degrees, as for Polygon_outside(). The
+  edges are put in a uniform grid over the bounding box of the
+  zones. Each grid cell records which zones contain a reference point
+  in the cell, so a point in polygon test only has to count crossings
+  between the point and the reference point with the few edges in its
+  cell. The crossing tests use exact integer arithmetic, so the
+  answers match Polygon_outside() away from the boundary.
+
+  An all zero object is a valid empty fence, so it can live in
+  calloc'ed memory
+ */
+class PolygonFence
+{
+public:
+    PolygonFence();
+    ~PolygonFence();
+
+    // remove all zones and free the index
+    void clear(void);
+
+    // add a zone. The last point may repeat the first. Returns false
+    // if the zone is invalid or there is no room for it
+    bool add_zone(const Vector2l *points, uint16_t n, bool inclusion);
+
+    // build the index. Call after adding zones. Queries still work
+    // if it fails, but take time proportional to the number of edges
+    bool build(void);
+
+    bool ready(void) const { return _cell_start != NULL; }
+    uint8_t num_zones(void) const { return _num_zones; }
+
+    // true if the point is outside the fence
+    bool outside(const Vector2l &P) const;
+
+    // distance in meters from the point to the nearest zone edge, or
+    // -1 if there are no zones
+    float distance_to_edge(const Vector2l &P) const;
+
+private:
+    // vertices of all zones, one zone after another. Zones are closed
+    // implicitly, so edge i runs from vertex i to the next vertex of
+    // the same zone
+    Vector2l *_points;
+    uint8_t *_point_zone;
+    uint16_t _num_points;
+    uint16_t _zone_start[POLYGON_FENCE_MAX_ZONES+1];
+    uint8_t _num_zones;
+    uint32_t _inclusion_mask;
+
+    // the grid index
+    Vector2l _grid_min;
+    int32_t _cell_size_x;
+    int32_t _cell_size_y;
+    uint8_t _grid_nx;
+    uint8_t _grid_ny;
+    uint16_t *_cell_start;      // first entry in _cell_edges for each cell, plus an end marker
+    uint16_t *_cell_edges;      // edges overlapping each cell, in increasing order
+    uint32_t *_cell_mask;       // zones containing the reference point of each cell
+
+    // meters per unit of lat and lng about the first point, for distances
+    Vector2l _origin;
+    float _scale_x;
+    float _scale_y;
+
+    uint16_t _edge_end(uint16_t e) const;
+    bool _cell_of(const Vector2l &P, uint16_t &cell) const;
+    void _cell_reference(uint16_t cell, Vector2l &R) const;
+    uint32_t _crossings(const Vector2l &P, const Vector2l &R, uint16_t cell1, uint16_t cell2) const;
+    uint32_t _zone_mask(const Vector2l &P) const;
+    bool _outside(uint32_t mask) const;
+    float _edge_distance(float px, float py, uint16_t e) const;
+    void _free_index(void);
+};
+
+#endif // POLYGON_FENCE_H
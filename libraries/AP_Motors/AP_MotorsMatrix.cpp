@@ -98,10 +98,8 @@ void AP_MotorsMatrix::output_min()
     limit.throttle_upper = false;
 
     // fill the motor_out[] array for HIL use and send minimum value to each motor
-    for( i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++ ) {
-        if( motor_enabled[i] ) {
-            hal.rcout->write(pgm_read_byte(&_motor_to_channel_map[i]), _throttle_radio_min);
-        }
+    for( i=0; i<_num_mix_motors; i++ ) {
+        hal.rcout->write(_mix_channel[i], _throttle_radio_min);
     }
 }
 
@@ -147,26 +145,20 @@ void AP_MotorsMatrix::output_armed_not_stabilizing()
     throttle_radio_output = calc_throttle_radio_output();
 
     // set output throttle
-    for (i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++) {
-        if (motor_enabled[i]) {
-            motor_out[i] = throttle_radio_output;
-        }
+    for (i=0; i<_num_mix_motors; i++) {
+        motor_out[i] = throttle_radio_output;
     }
 
     if(throttle_radio_output >= out_min_pwm) {
         // apply thrust curve and voltage scaling
-        for (i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++) {
-            if (motor_enabled[i]) {
-                motor_out[i] = apply_thrust_curve_and_volt_scaling(motor_out[i], out_min_pwm, out_max_pwm);
-            }
+        for (i=0; i<_num_mix_motors; i++) {
+            motor_out[i] = apply_thrust_curve_and_volt_scaling(motor_out[i], out_min_pwm, out_max_pwm);
         }
     }
 
     // send output to each motor
-    for( i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++ ) {
-        if( motor_enabled[i] ) {
-            hal.rcout->write(pgm_read_byte(&_motor_to_channel_map[i]), motor_out[i]);
-        }
+    for( i=0; i<_num_mix_motors; i++ ) {
+        hal.rcout->write(_mix_channel[i], motor_out[i]);
     }
 }
 
@@ -185,6 +177,7 @@ void AP_MotorsMatrix::output_armed_stabilizing()
     int16_t out_mid_pwm = (out_min_pwm+out_max_pwm)/2;              // mid pwm value we can send to the motors
     int16_t out_best_thr_pwm;                                       // the is the best throttle we can come up which provides good control without climbing
     float rpy_scale = 1.0;                                          // this is used to scale the roll, pitch and yaw to fit within the motor limits
+    float compensation_gain = get_compensation_gain();              // lift and air density compensation, the same for every motor
 
     int16_t rpy_out[AP_MOTORS_MAX_NUM_MOTORS]; // buffer so we don't have to multiply coefficients multiple times.
     int16_t motor_out[AP_MOTORS_MAX_NUM_MOTORS];    // final outputs sent to the motors
@@ -217,19 +210,17 @@ void AP_MotorsMatrix::output_armed_stabilizing()
 
     // calculate roll and pitch for each motor
     // set rpy_low and rpy_high to the lowest and highest values of the motors
-    for (i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++) {
-        if (motor_enabled[i]) {
-            rpy_out[i] = roll_pwm * _roll_factor[i] * get_compensation_gain() +
-                            pitch_pwm * _pitch_factor[i] * get_compensation_gain();
-
-            // record lowest roll pitch command
-            if (rpy_out[i] < rpy_low) {
-                rpy_low = rpy_out[i];
-            }
-            // record highest roll pich command
-            if (rpy_out[i] > rpy_high) {
-                rpy_high = rpy_out[i];
-            }
+    for (i=0; i<_num_mix_motors; i++) {
+        rpy_out[i] = roll_pwm * _mix_roll[i] * compensation_gain +
+                        pitch_pwm * _mix_pitch[i] * compensation_gain;
+
+        // record lowest roll pitch command
+        if (rpy_out[i] < rpy_low) {
+            rpy_low = rpy_out[i];
+        }
+        // record highest roll pich command
+        if (rpy_out[i] > rpy_high) {
+            rpy_high = rpy_out[i];
         }
     }
 
@@ -252,16 +243,16 @@ void AP_MotorsMatrix::output_armed_stabilizing()
 
     if (yaw_pwm >= 0) {
         // if yawing right
-        if (yaw_allowed > yaw_pwm * get_compensation_gain()) {
-            yaw_allowed = yaw_pwm * get_compensation_gain(); // to-do: this is bad form for yaw_allows to change meaning to become the amount that we are going to output
+        if (yaw_allowed > yaw_pwm * compensation_gain) {
+            yaw_allowed = yaw_pwm * compensation_gain; // to-do: this is bad form for yaw_allows to change meaning to become the amount that we are going to output
         }else{
             limit.yaw = true;
         }
     }else{
         // if yawing left
         yaw_allowed = -yaw_allowed;
-        if (yaw_allowed < yaw_pwm * get_compensation_gain()) {
-            yaw_allowed = yaw_pwm * get_compensation_gain(); // to-do: this is bad form for yaw_allows to change meaning to become the amount that we are going to output
+        if (yaw_allowed < yaw_pwm * compensation_gain) {
+            yaw_allowed = yaw_pwm * compensation_gain; // to-do: this is bad form for yaw_allows to change meaning to become the amount that we are going to output
         }else{
             limit.yaw = true;
         }
@@ -270,19 +261,17 @@ void AP_MotorsMatrix::output_armed_stabilizing()
     // add yaw to intermediate numbers for each motor
     rpy_low = 0;
     rpy_high = 0;
-    for (i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++) {
-        if (motor_enabled[i]) {
-            rpy_out[i] =    rpy_out[i] +
-                            yaw_allowed * _yaw_factor[i];
-
-            // record lowest roll+pitch+yaw command
-            if( rpy_out[i] < rpy_low ) {
-                rpy_low = rpy_out[i];
-            }
-            // record highest roll+pitch+yaw command
-            if( rpy_out[i] > rpy_high) {
-                rpy_high = rpy_out[i];
-            }
+    for (i=0; i<_num_mix_motors; i++) {
+        rpy_out[i] =    rpy_out[i] +
+                        yaw_allowed * _mix_yaw[i];
+
+        // record lowest roll+pitch+yaw command
+        if( rpy_out[i] < rpy_low ) {
+            rpy_low = rpy_out[i];
+        }
+        // record highest roll+pitch+yaw command
+        if( rpy_out[i] > rpy_high) {
+            rpy_high = rpy_out[i];
         }
     }
 
@@ -330,32 +319,17 @@ void AP_MotorsMatrix::output_armed_stabilizing()
     }
 
     // add scaled roll, pitch, constrained yaw and throttle for each motor
-    for (i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++) {
-        if (motor_enabled[i]) {
-            motor_out[i] = out_best_thr_pwm+thr_adj +
-                            rpy_scale*rpy_out[i];
-        }
+    for (i=0; i<_num_mix_motors; i++) {
+        motor_out[i] = out_best_thr_pwm+thr_adj +
+                        rpy_scale*rpy_out[i];
     }
 
-    // apply thrust curve and voltage scaling
-    for (i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++) {
-        if (motor_enabled[i]) {
-            motor_out[i] = apply_thrust_curve_and_volt_scaling(motor_out[i], out_min_pwm, out_max_pwm);
-        }
-    }
-
-    // clip motor output if required (shouldn't be)
-    for (i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++) {
-        if (motor_enabled[i]) {
-            motor_out[i] = constrain_int16(motor_out[i], out_min_pwm, out_max_pwm);
-        }
-    }
-
-    // send output to each motor
-    for( i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++ ) {
-        if( motor_enabled[i] ) {
-            hal.rcout->write(pgm_read_byte(&_motor_to_channel_map[i]), motor_out[i]);
-        }
+    // apply thrust curve and voltage scaling, clip motor output if
+    // required (shouldn't be) and send output to each motor
+    for (i=0; i<_num_mix_motors; i++) {
+        motor_out[i] = apply_thrust_curve_and_volt_scaling(motor_out[i], out_min_pwm, out_max_pwm);
+        motor_out[i] = constrain_int16(motor_out[i], out_min_pwm, out_max_pwm);
+        hal.rcout->write(_mix_channel[i], motor_out[i]);
     }
 }
 
@@ -406,6 +380,8 @@ void AP_MotorsMatrix::add_motor_raw(int8_t motor_num, float roll_fac, float pitc
 
         // disable this channel from being used by RC_Channel_aux
         RC_Channel_aux::disable_aux_channel(_motor_to_channel_map[motor_num]);
+
+        update_mix();
     }
 }
 
@@ -436,6 +412,8 @@ void AP_MotorsMatrix::remove_motor(int8_t motor_num)
         _roll_factor[motor_num] = 0;
         _pitch_factor[motor_num] = 0;
         _yaw_factor[motor_num] = 0;
+
+        update_mix();
     }
 }
 
@@ -446,3 +424,18 @@ void AP_MotorsMatrix::remove_all_motors()
         remove_motor(i);
     }
 }
+
+// update_mix - rebuilds the mixing matrix from the factors of the enabled motors
+void AP_MotorsMatrix::update_mix()
+{
+    _num_mix_motors = 0;
+    for (uint8_t i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++) {
+        if (motor_enabled[i]) {
+            _mix_channel[_num_mix_motors] = pgm_read_byte(&_motor_to_channel_map[i]);
+            _mix_roll[_num_mix_motors] = _roll_factor[i];
+            _mix_pitch[_num_mix_motors] = _pitch_factor[i];
+            _mix_yaw[_num_mix_motors] = _yaw_factor[i];
+            _num_mix_motors++;
+        }
+    }
+}
@@ -20,7 +20,8 @@ public:
 
     /// Constructor
     AP_MotorsMatrix(uint16_t loop_rate, uint16_t speed_hz = AP_MOTORS_SPEED_DEFAULT) :
-        AP_Motors(loop_rate, speed_hz)
+        AP_Motors(loop_rate, speed_hz),
+        _num_mix_motors(0)
     {};
 
     // init
@@ -74,10 +75,21 @@ protected:
     // add_motor using raw roll, pitch, throttle and yaw factors
     void                add_motor_raw(int8_t motor_num, float roll_fac, float pitch_fac, float yaw_fac, uint8_t testing_order);
 
+    // update_mix - rebuilds the mixing matrix from the factors of the enabled motors
+    void                update_mix();
+
     float               _roll_factor[AP_MOTORS_MAX_NUM_MOTORS]; // each motors contribution to roll
     float               _pitch_factor[AP_MOTORS_MAX_NUM_MOTORS]; // each motors contribution to pitch
     float               _yaw_factor[AP_MOTORS_MAX_NUM_MOTORS];  // each motors contribution to yaw (normally 1 or -1)
     uint8_t             _test_order[AP_MOTORS_MAX_NUM_MOTORS];  // order of the motors in the test sequence
+
+    // mixing matrix with a row for each enabled motor, in motor order, so
+    // the mixer loops run over consecutive rows without checking motor_enabled
+    uint8_t             _num_mix_motors;                            // number of rows in the mixing matrix
+    uint8_t             _mix_channel[AP_MOTORS_MAX_NUM_MOTORS];     // output channel of each row
+    float               _mix_roll[AP_MOTORS_MAX_NUM_MOTORS];        // roll factor of each row
+    float               _mix_pitch[AP_MOTORS_MAX_NUM_MOTORS];       // pitch factor of each row
+    float               _mix_yaw[AP_MOTORS_MAX_NUM_MOTORS];         // yaw factor of each row
 };
 
 #endif  // AP_MOTORSMATRIX
@@ -1,14 +1,16 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+
 /*
- *  Example of AP_Motors library.
- *  Code by Randy Mackay. DIYDrones.com
+ *       Benchmark of the AP_MotorsMatrix mixer on octa and coaxial
+ *       frames, against the per motor loops it replaced
  */
 
-// Libraries
 #include <AP_Common.h>
 #include <AP_Progmem.h>
 #include <AP_Param.h>
 #include <AP_HAL.h>
 #include <AP_HAL_AVR.h>
+#include <AP_HAL_SITL.h>
 #include <AP_HAL_PX4.h>
 #include <AP_HAL_Linux.h>
 #include <AP_HAL_Empty.h>
@@ -36,83 +38,253 @@
 #include <AP_NavEKF.h>
 #include <AP_BattMonitor.h>
 #include <AP_RangeFinder.h>
+#include <AP_Buffer.h>
+#include <AP_Rally.h>
+#include <AP_Scheduler.h>
+#include <AP_SerialManager.h>
+#include <AP_OpticalFlow.h>
+#include <SITL.h>
 
 const AP_HAL::HAL& hal = AP_HAL_BOARD_DRIVER;
 
-RC_Channel rc1(0), rc2(1), rc3(2), rc4(3);
+#define NUM_OUTPUTS 2000
 
-// uncomment the row below depending upon what frame you are using
-//AP_MotorsTri	motors(rc1, rc2, rc3, rc4, 400);
-AP_MotorsQuad   motors(rc1, rc2, rc3, rc4, 400);
-//AP_MotorsHexa	motors(rc1, rc2, rc3, rc4, 400);
-//AP_MotorsY6	motors(rc1, rc2, rc3, rc4, 400);
-//AP_MotorsOcta	motors(rc1, rc2, rc3, rc4, 400);
-//AP_MotorsOctaQuad	motors(rc1, rc2, rc3, rc4, 400);
-//AP_MotorsHeli	motors(rc1, rc2, rc3, rc4, 400);
+/*
+  gives the benchmark access to the mixer of a frame, and keeps a copy
+  of the mixer from before the mixing matrix as the reference
+ */
+template <class Frame>
+class AP_Motors_Time_Test : public Frame {
+public:
+    AP_Motors_Time_Test(uint16_t loop_rate) : Frame(loop_rate) {}
 
+    void set_inputs(int16_t roll, int16_t pitch, int16_t yaw, int16_t throttle) {
+        this->set_roll(roll);
+        this->set_pitch(pitch);
+        this->set_yaw(yaw);
+        this->_throttle_control_input = throttle;
+    }
 
-// setup
-void setup()
+    void output_new() { this->output_armed_stabilizing(); }
+
+    void output_reference();
+};
+
+template <class Frame>
+void AP_Motors_Time_Test<Frame>::output_reference()
 {
-    hal.console->println("AP_Motors_Time test");
+    int8_t i;
+    int16_t roll_pwm, pitch_pwm, yaw_pwm, throttle_radio_output;
+    int16_t out_min_pwm = this->_throttle_radio_min + this->_min_throttle;
+    int16_t out_max_pwm = this->_throttle_radio_max;
+    int16_t out_mid_pwm = (out_min_pwm+out_max_pwm)/2;
+    int16_t out_best_thr_pwm;
+    float rpy_scale = 1.0;
+    int16_t rpy_out[AP_MOTORS_MAX_NUM_MOTORS];
+    int16_t motor_out[AP_MOTORS_MAX_NUM_MOTORS];
+    int16_t rpy_low = 0;
+    int16_t rpy_high = 0;
+    int16_t yaw_allowed;
+    int16_t thr_adj;
 
-    // motor initialisation
-    motors.set_update_rate(490);
-    // motors.set_frame_orientation(AP_MOTORS_X_FRAME);
-    motors.set_frame_orientation(AP_MOTORS_PLUS_FRAME);
-    motors.set_min_throttle(130);
-    motors.set_hover_throttle(500);
-    motors.Init();      // initialise motors
+    this->limit.roll_pitch = false;
+    this->limit.yaw = false;
+    this->limit.throttle_lower = false;
+    this->limit.throttle_upper = false;
 
-    // setup radio
-    if (rc3.radio_min == 0) {
-	    // cope with AP_Param not being loaded
-	    rc3.radio_min = 1000;
+    if (this->_throttle_control_input <= this->_min_throttle) {
+        this->_throttle_control_input = this->_min_throttle;
+        this->limit.throttle_lower = true;
     }
-    if (rc3.radio_max == 0) {
-	    // cope with AP_Param not being loaded
-	    rc3.radio_max = 2000;
+    if (this->_throttle_control_input >= this->_max_throttle) {
+        this->_throttle_control_input = this->_max_throttle;
+        this->limit.throttle_upper = true;
     }
-    // set rc channel ranges
-    rc1.set_angle(4500);
-    rc2.set_angle(4500);
-    rc3.set_range(130, 1000);
-    rc4.set_angle(4500);
 
-    motors.enable();
-    motors.output_min();
+    roll_pwm = this->calc_roll_pwm();
+    pitch_pwm = this->calc_pitch_pwm();
+    yaw_pwm = this->calc_yaw_pwm();
+    throttle_radio_output = this->calc_throttle_radio_output();
+
+    for (i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++) {
+        if (this->motor_enabled[i]) {
+            rpy_out[i] = roll_pwm * this->_roll_factor[i] * this->get_compensation_gain() +
+                            pitch_pwm * this->_pitch_factor[i] * this->get_compensation_gain();
+            if (rpy_out[i] < rpy_low) {
+                rpy_low = rpy_out[i];
+            }
+            if (rpy_out[i] > rpy_high) {
+                rpy_high = rpy_out[i];
+            }
+        }
+    }
 
-    hal.scheduler->delay(1000);
+    int16_t motor_mid = (rpy_low+rpy_high)/2;
+    out_best_thr_pwm = min(out_mid_pwm - motor_mid, max(throttle_radio_output, throttle_radio_output*max(0,1.0f-this->_throttle_thr_mix)+this->get_hover_throttle_as_pwm()*this->_throttle_thr_mix));
+
+    yaw_allowed = min(out_max_pwm - out_best_thr_pwm, out_best_thr_pwm - out_min_pwm) - (rpy_high-rpy_low)/2;
+    yaw_allowed = max(yaw_allowed, this->_yaw_headroom);
+
+    if (yaw_pwm >= 0) {
+        if (yaw_allowed > yaw_pwm * this->get_compensation_gain()) {
+            yaw_allowed = yaw_pwm * this->get_compensation_gain();
+        }else{
+            this->limit.yaw = true;
+        }
+    }else{
+        yaw_allowed = -yaw_allowed;
+        if (yaw_allowed < yaw_pwm * this->get_compensation_gain()) {
+            yaw_allowed = yaw_pwm * this->get_compensation_gain();
+        }else{
+            this->limit.yaw = true;
+        }
+    }
+
+    rpy_low = 0;
+    rpy_high = 0;
+    for (i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++) {
+        if (this->motor_enabled[i]) {
+            rpy_out[i] =    rpy_out[i] +
+                            yaw_allowed * this->_yaw_factor[i];
+            if( rpy_out[i] < rpy_low ) {
+                rpy_low = rpy_out[i];
+            }
+            if( rpy_out[i] > rpy_high) {
+                rpy_high = rpy_out[i];
+            }
+        }
+    }
+
+    thr_adj = throttle_radio_output - out_best_thr_pwm;
+    int16_t thr_adj_max = max(out_max_pwm-(out_best_thr_pwm+rpy_high),0);
+    if (thr_adj > 0) {
+        if (thr_adj > thr_adj_max){
+            thr_adj = thr_adj_max;
+            this->limit.throttle_upper = true;
+        }
+    }else if(thr_adj < 0){
+        int16_t thr_adj_min = min(out_min_pwm-(out_best_thr_pwm+rpy_low),0);
+        if (thr_adj > thr_adj_max) {
+            thr_adj = thr_adj_max;
+            this->limit.throttle_upper = true;
+        }
+        if (thr_adj < thr_adj_min) {
+            thr_adj = thr_adj_min;
+        }
+    }
+
+    if ((rpy_low+out_best_thr_pwm)+thr_adj < out_min_pwm){
+        rpy_scale = (float)(out_min_pwm-thr_adj-out_best_thr_pwm)/rpy_low;
+        this->limit.roll_pitch = true;
+        this->limit.yaw = true;
+    }else if((rpy_high+out_best_thr_pwm)+thr_adj > out_max_pwm){
+        rpy_scale = (float)(out_max_pwm-thr_adj-out_best_thr_pwm)/rpy_high;
+        this->limit.roll_pitch = true;
+        this->limit.yaw = true;
+    }
+
+    for (i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++) {
+        if (this->motor_enabled[i]) {
+            motor_out[i] = out_best_thr_pwm+thr_adj +
+                            rpy_scale*rpy_out[i];
+        }
+    }
+    for (i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++) {
+        if (this->motor_enabled[i]) {
+            motor_out[i] = this->apply_thrust_curve_and_volt_scaling(motor_out[i], out_min_pwm, out_max_pwm);
+        }
+    }
+    for (i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++) {
+        if (this->motor_enabled[i]) {
+            motor_out[i] = constrain_int16(motor_out[i], out_min_pwm, out_max_pwm);
+        }
+    }
+    for( i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++ ) {
+        if( this->motor_enabled[i] ) {
+            hal.rcout->write(pgm_read_byte(&this->_motor_to_channel_map[i]), motor_out[i]);
+        }
+    }
 }
 
-// loop
-void loop()
+static AP_Motors_Time_Test<AP_MotorsOcta> octa(400);
+static AP_Motors_Time_Test<AP_MotorsY6> y6(400);
+
+// inputs covering saturation of roll/pitch, yaw and throttle
+static int16_t test_input(uint16_t n, uint8_t axis, int16_t range)
 {
-    int16_t value;
+    return range * sinf(n * (0.37f + 0.11f*axis) + axis);
+}
 
-    motor_order_test();
+template <class Frame>
+static void init_motors(AP_Motors_Time_Test<Frame> &motors)
+{
+    motors.set_update_rate(490);
+    motors.set_frame_orientation(AP_MOTORS_X_FRAME);
+    motors.set_throttle_range(130, 1000, 2000);
+    motors.set_hover_throttle(500);
+    motors.Init();
+    motors.enable();
+    motors.armed(true);
 }
 
-// stability_test
-void motor_order_test()
+template <class Frame>
+static void run_test(const char *name, AP_Motors_Time_Test<Frame> &motors)
 {
+    uint16_t mismatches = 0;
+    uint32_t ref_time = 0, new_time = 0;
 
-    motors.armed(true);
-    for (int8_t i=1; i <= 4; i++) {
-		hal.console->printf_P(PSTR("Motor %d\n"),(int)i);
-        int elapsed =0,stop;
-		int start = hal.scheduler->micros();                                                   //Time Test
-        motors.output_test(i, 1150);
-        stop = hal.scheduler->micros();
-        elapsed = stop - start;
-        hal.console->printf_P(PSTR("  Elapsed Time: %dus\n"),elapsed);
-        hal.scheduler->delay(300);
-        motors.output_test(i, 1000);
-        hal.scheduler->delay(2000);
+    for (uint16_t n = 0; n < NUM_OUTPUTS; n++) {
+        int16_t roll = test_input(n, 0, 4500);
+        int16_t pitch = test_input(n, 1, 4500);
+        int16_t yaw = test_input(n, 2, 4500);
+        int16_t throttle = 500 + test_input(n, 3, 500);
+        uint16_t out_ref[AP_MOTORS_MAX_NUM_MOTORS];
+
+        motors.set_inputs(roll, pitch, yaw, throttle);
+        uint32_t start_time = hal.scheduler->micros();
+        motors.output_reference();
+        ref_time += hal.scheduler->micros() - start_time;
+        for (uint8_t i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++) {
+            out_ref[i] = hal.rcout->read(i);
+        }
+
+        motors.set_inputs(roll, pitch, yaw, throttle);
+        start_time = hal.scheduler->micros();
+        motors.output_new();
+        new_time += hal.scheduler->micros() - start_time;
+        for (uint8_t i=0; i<AP_MOTORS_MAX_NUM_MOTORS; i++) {
+            if (hal.rcout->read(i) != out_ref[i]) {
+                mismatches++;
+                break;
+            }
+        }
     }
-    motors.armed(false);
-   
-   hal.console->printf("\n\n");
+
+    hal.console->printf("%-5s loops %6.2f usec  matrix %6.2f usec  speedup %.2f  mismatches %u\n",
+                        name,
+                        ref_time / (float)NUM_OUTPUTS,
+                        new_time / (float)NUM_OUTPUTS,
+                        ref_time / (float)max(new_time, (uint32_t)1),
+                        (unsigned)mismatches);
+}
+
+// setup
+void setup()
+{
+    hal.console->println("AP_Motors_Time test");
+
+    init_motors(octa);
+    init_motors(y6);
+}
+
+// loop
+void loop()
+{
+    run_test("octa", octa);
+    run_test("y6", y6);
+    hal.console->printf("\n");
+
+    hal.scheduler->delay(5000);
 }
 
 AP_HAL_MAIN();
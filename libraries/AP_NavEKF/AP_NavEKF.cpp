@@ -370,6 +370,13 @@ const AP_Param::GroupInfo NavEKF::var_info[] PROGMEM = {
     // @User: Advanced
     AP_GROUPINFO("ALT_SOURCE",    32, NavEKF, _altSource, 1),
 
+    // @Param: LANES
+    // @DisplayName: Number of filter lanes
+    // @Description: With 0 or 1 a single filter blends the first two IMUs. With 2 or more one filter is run per IMU, up to this number of IMUs, and the AHRS uses the filter with the most consistent innovations. The filters run in parallel on boards with spare CPU cores. A reboot is needed for a change to take effect.
+    // @Range: 0 3
+    // @User: Advanced
+    AP_GROUPINFO("LANES",    33, NavEKF, _laneCount, 0),
+
     AP_GROUPEND
 };
 
@@ -410,7 +417,15 @@ NavEKF::NavEKF(const AP_AHRS *ahrs, AP_Baro &baro, const RangeFinder &rng) :
     flowTimeDeltaAvg_ms(100),       // average interval between optical flow measurements (msec)
     flowIntervalMax_ms(100),        // maximum allowable time between flow fusion events
     gndEffectTimeout_ms(1000),          // time in msec that baro ground effect compensation will timeout after initiation
-    gndEffectBaroScaler(4.0f)      // scaler applied to the barometer observation variance when operating in ground effect
+    gndEffectBaroScaler(4.0f),     // scaler applied to the barometer observation variance when operating in ground effect
+    imuIndex(-1),
+    imuRateDivider(1),
+    prevUpdateArmed(false),
+    tasFuseDeferred(false),
+    fusionSteps(0),
+    frameTimeAvg_us(0),
+    lastRngMeasTime_ms(0),
+    rngMeasIndex(0)
 
 #if CONFIG_HAL_BOARD == HAL_BOARD_PX4 || CONFIG_HAL_BOARD == HAL_BOARD_VRBRAIN
     ,_perf_UpdateFilter(perf_alloc(PC_ELAPSED, "EKF_UpdateFilter")),
@@ -423,6 +438,9 @@ NavEKF::NavEKF(const AP_AHRS *ahrs, AP_Baro &baro, const RangeFinder &rng) :
 {
     AP_Param::setup_object_defaults(this, var_info);
 
+    memset(storedRngMeas, 0, sizeof(storedRngMeas));
+    memset(storedRngMeasTime_ms, 0, sizeof(storedRngMeasTime_ms));
+    memset(&frameTiming, 0, sizeof(frameTiming));
 }
 
 // Check basic filter health metrics and return a consolidated health status
@@ -536,7 +554,7 @@ bool NavEKF::InitialiseFilterDynamic(void)
     InitialiseVariables();
 
     // get initial time deltat between IMU measurements (sec)
-    dtIMUactual = dtIMUavg = 1.0f/_ahrs->get_ins().get_sample_rate();
+    dtIMUactual = dtIMUavg = float(imuRateDivider)/_ahrs->get_ins().get_sample_rate();
 
     // set number of updates over which gps and baro measurements are applied to the velocity and position states
     gpsUpdateCountMaxInv = (dtIMUavg * 1000.0f)/float(msecGpsAvg);
@@ -598,7 +616,7 @@ bool NavEKF::InitialiseFilterBootstrap(void)
     InitialiseVariables();
 
     // get initial time deltat between IMU measurements (sec)
-    dtIMUactual = dtIMUavg = 1.0f/_ahrs->get_ins().get_sample_rate();
+    dtIMUactual = dtIMUavg = float(imuRateDivider)/_ahrs->get_ins().get_sample_rate();
 
     // set number of updates over which gps and baro measurements are applied to the velocity and position states
     gpsUpdateCountMaxInv = (dtIMUavg * 1000.0f)/float(msecGpsAvg);
@@ -683,8 +701,14 @@ void NavEKF::UpdateFilter()
         return;
     }
 
+    // nothing to do until an IMU sample has been accumulated
+    if (imuAccum.count == 0) {
+        return;
+    }
+
     // start the timer used for load measurement
     perf_begin(_perf_UpdateFilter);
+    uint32_t frameStart_us = hal.scheduler->micros();
 
     //get starting time for update step
     imuSampleTime_ms = hal.scheduler->millis();
@@ -692,18 +716,17 @@ void NavEKF::UpdateFilter()
     // read IMU data and convert to delta angles and velocities
     readIMUData();
 
-    static bool prev_armed = false;
     bool armed = getVehicleArmStatus();
 
     // the vehicle was previously disarmed and time has slipped
     // gyro auto-zero has likely just been done - skip this timestep
-    if (!prev_armed && dtIMUactual > dtIMUavg*5.0f) {
+    if (!prevUpdateArmed && dtIMUactual > dtIMUavg*5.0f) {
         // stop the timer used for load measurement
         perf_end(_perf_UpdateFilter);
-        prev_armed = armed;
+        prevUpdateArmed = armed;
         return;
     }
-    prev_armed = armed;
+    prevUpdateArmed = armed;
 
     // detect if the filter update has been delayed for too long
     if (dtIMUactual > 0.2f) {
@@ -725,6 +748,14 @@ void NavEKF::UpdateFilter()
     // Check arm status and perform required checks and mode changes
     performArmingChecks();
 
+    // clear the record of the expensive fusion steps performed in this time step
+    // the fusion processes use it to avoid running on the same frame as each other
+    fusionSteps = 0;
+    posVelFuseStep = false;
+    magFusePerformed = false;
+    flowFusePerformed = false;
+    tasFuseStep = false;
+
     // run the strapdown INS equations every IMU update
     UpdateStrapdownEquationsNED();
 
@@ -754,6 +785,15 @@ void NavEKF::UpdateFilter()
     SelectTasFusion();
     SelectBetaFusion();
 
+    // record the execution time and the number of fusion steps for this frame
+    uint32_t elapsed_us = hal.scheduler->micros() - frameStart_us;
+    frameTiming.last_us = elapsed_us;
+    frameTiming.max_us = max(frameTiming.max_us, elapsed_us);
+    frameTimeAvg_us = 0.98f * frameTimeAvg_us + 0.02f * elapsed_us;
+    frameTiming.avg_us = frameTimeAvg_us;
+    frameTiming.last_steps = fusionSteps;
+    frameTiming.max_steps = max(frameTiming.max_steps, fusionSteps);
+
     // stop the timer used for load measurement
     perf_end(_perf_UpdateFilter);
 }
@@ -898,6 +938,7 @@ void NavEKF::SelectVelPosFusion()
         // ensure that the covariance prediction is up to date before fusing data
         if (!covPredStep) CovariancePrediction();
         FuseVelPosNED();
+        posVelFuseStep = true;
     }
 
     // Fuse corrections to quaternion, position and velocity states across several time steps to reduce 5 and 10Hz pulsing in the output
@@ -937,7 +978,12 @@ void NavEKF::SelectMagFusion()
     perf_begin(_perf_FuseMagnetometer);
 
     // check for and read new magnetometer measurements
-    readMagData();
+    // this waits until a fusion cycle in progress has been completed, because the
+    // Y and Z components are fused using values calculated when the X component was fused
+    bool cycleActive = (mag_state.obsIndex <= 2);
+    if (!cycleActive) {
+        readMagData();
+    }
 
     // If we are using the compass and the magnetometer has been unhealthy for too long we declare a timeout
     if (magHealth) {
@@ -948,15 +994,23 @@ void NavEKF::SelectMagFusion()
     }
 
     // determine if conditions are right to start a new fusion cycle
-    bool dataReady = statesInitialised && use_compass() && newDataMag;
+    bool dataReady = statesInitialised && use_compass() && newDataMag && !cycleActive;
     if (dataReady) {
         // reset state updates and counter used to spread fusion updates across several frames to reduce 10Hz pulsing
         memset(&magIncrStateDelta[0], 0, sizeof(magIncrStateDelta));
         magUpdateCount = 0;
         // ensure that the covariance prediction is up to date before fusing data
         if (!covPredStep) CovariancePrediction();
-        // fuse the three magnetometer componenents sequentially
-        for (mag_state.obsIndex = 0; mag_state.obsIndex <= 2; mag_state.obsIndex++) FuseMagnetometer();
+        // start with the X component
+        mag_state.obsIndex = 0;
+        cycleActive = true;
+    }
+
+    // fuse the three magnetometer components sequentially, one per time step
+    // the Y and Z components don't wait for a covariance prediction as little time has passed since the X component
+    if (cycleActive) {
+        FuseMagnetometer();
+        mag_state.obsIndex++;
     }
 
     // Fuse corrections to quaternion, position and velocity states across several time steps to reduce 10Hz pulsing in the output
@@ -1061,8 +1115,10 @@ void NavEKF::SelectFlowFusion()
 // select fusion of true airspeed measurements
 void NavEKF::SelectTasFusion()
 {
-    // get true airspeed measurement
-    readAirSpdData();
+    // get true airspeed measurement, unless a measurement deferred from the last time step is waiting
+    if (!tasFuseDeferred) {
+        readAirSpdData();
+    }
 
     // If we haven't received airspeed data for a while, then declare the airspeed data as being timed out
     if (imuSampleTime_ms - lastAirspeedUpdate > tasRetryTime) {
@@ -1073,13 +1129,22 @@ void NavEKF::SelectTasFusion()
     tasDataWaiting = (statesInitialised && !inhibitWindStates && newDataTas);
     if (tasDataWaiting)
     {
+        // if another expensive fusion step has been performed on this time step, then fuse on the next one
+        // the measurement is only deferred once, so it is never more than one time step late
+        if (!tasFuseDeferred && (posVelFuseStep || magFusePerformed || flowFusePerformed)) {
+            tasFuseDeferred = true;
+            frameTiming.deferrals++;
+            return;
+        }
         // ensure that the covariance prediction is up to date before fusing data
         if (!covPredStep) CovariancePrediction();
         FuseAirspeed();
         TASmsecPrev = imuSampleTime_ms;
         tasDataWaiting = false;
         newDataTas = false;
+        tasFuseStep = true;
     }
+    tasFuseDeferred = false;
 }
 
 // select fusion of synthetic sideslip measurements
@@ -1095,6 +1160,13 @@ void NavEKF::SelectBetaFusion()
     bool f_feasible = (assume_zero_sideslip() && !inhibitWindStates);
     // use synthetic sideslip fusion if feasible, required and enough time has lapsed since the last fusion
     if (f_feasible && f_required && f_timeTrigger) {
+        // if another expensive fusion step has been performed on this time step, then wait for the next one
+        // unless the fusion is already overdue
+        bool f_busy = (posVelFuseStep || magFusePerformed || flowFusePerformed || tasFuseStep);
+        if (f_busy && (imuSampleTime_ms - BETAmsecPrev) < 2*msecBetaAvg) {
+            frameTiming.deferrals++;
+            return;
+        }
         // ensure that the covariance prediction is up to date before fusing data
         if (!covPredStep) CovariancePrediction();
         FuseSideslip();
@@ -1201,6 +1273,7 @@ void NavEKF::UpdateStrapdownEquationsNED()
 void NavEKF::CovariancePrediction()
 {
     perf_begin(_perf_CovariancePrediction);
+    fusionSteps++;
     float windVelSigma; // wind velocity 1-sigma process noise - m/s
     float dAngBiasSigma;// delta angle bias 1-sigma process noise - rad/s
     float dVelBiasSigma;// delta velocity bias 1-sigma process noise - m/s
@@ -1877,6 +1950,7 @@ void NavEKF::FuseVelPosNED()
 {
     // start performance timer
     perf_begin(_perf_FuseVelPosNED);
+    fusionSteps++;
 
     // health is set bad until test passed
     velHealth = false;
@@ -2277,17 +2351,8 @@ void NavEKF::FuseVelPosNED()
 
                 // update the covariance - take advantage of direct observation of a single state at index = stateIndex to reduce computations
                 // this is a numerically optimised implementation of standard equation P = (I - K*H)*P;
-                for (uint8_t i= 0; i<=21; i++) {
-                    for (uint8_t j= 0; j<=21; j++)
-                    {
-                        KHP[i][j] = Kfusion[i] * P[stateIndex][j];
-                    }
-                }
-                for (uint8_t i= 0; i<=21; i++) {
-                    for (uint8_t j= 0; j<=21; j++) {
-                        P[i][j] = P[i][j] - KHP[i][j];
-                    }
-                }
+                const ftype H_nz = 1.0f;
+                CovarianceUpdate(P, Kfusion, &H_nz, &stateIndex, 1);
             }
         }
     }
@@ -2325,6 +2390,8 @@ void NavEKF::FuseMagnetometer()
     Vector6 SK_MY;
     Vector6 SK_MZ;
 
+    fusionSteps++;
+
     // perform sequential fusion of magnetometer measurements.
     // this assumes that the errors in the different components are
     // uncorrelated which is not true, however in the absence of covariance
@@ -2640,43 +2707,15 @@ void NavEKF::FuseMagnetometer()
         // normalise the quaternion states
         state.quat.normalize();
         // correct the covariance P = (I - K*H)*P
-        // take advantage of the empty columns in KH to reduce the
-        // number of operations
-        for (uint8_t i = 0; i<=21; i++) {
-            for (uint8_t j = 0; j<=3; j++) {
-                KH[i][j] = Kfusion[i] * H_MAG[j];
-            }
-            for (uint8_t j = 4; j<=15; j++) {
-                KH[i][j] = 0.0f;
-            }
-            if (!inhibitMagStates) {
-                for (uint8_t j = 16; j<=21; j++) {
-                    KH[i][j] = Kfusion[i] * H_MAG[j];
-                }
-            } else {
-                for (uint8_t j = 16; j<=21; j++) {
-                    KH[i][j] = 0.0f;
-                }
-            }
-        }
-        for (uint8_t i = 0; i<=21; i++) {
-            for (uint8_t j = 0; j<=21; j++) {
-                KHP[i][j] = 0;
-                for (uint8_t k = 0; k<=3; k++) {
-                    KHP[i][j] = KHP[i][j] + KH[i][k] * P[k][j];
-                }
-                if (!inhibitMagStates) {
-                    for (uint8_t k = 16; k<=21; k++) {
-                        KHP[i][j] = KHP[i][j] + KH[i][k] * P[k][j];
-                    }
-                }
-            }
-        }
-        for (uint8_t i = 0; i<=21; i++) {
-            for (uint8_t j = 0; j<=21; j++) {
-                P[i][j] = P[i][j] - KHP[i][j];
-            }
+        // H_MAG is only non-zero for the quaternion and magnetic field
+        // states, and the field states are not used when inhibited
+        static const uint8_t magIndex[10] = {0, 1, 2, 3, 16, 17, 18, 19, 20, 21};
+        uint8_t nnz = inhibitMagStates ? 4 : 10;
+        ftype H_nz[10];
+        for (uint8_t k = 0; k<nnz; k++) {
+            H_nz[k] = H_MAG[magIndex[k]];
         }
+        CovarianceUpdate(P, Kfusion, H_nz, magIndex, nnz);
     }
 
     // force the covariance matrix to be symmetrical and limit the variances to prevent
@@ -2888,6 +2927,8 @@ void NavEKF::FuseOptFlow()
     ftype &pd = flow_state.pd;
     ftype *losPred = &flow_state.losPred[0];
 
+    fusionSteps++;
+
     // Copy required states to local variable names
     q0       = statesAtFlowTime.quat[0];
     q1       = statesAtFlowTime.quat[1];
@@ -3100,43 +3141,14 @@ void NavEKF::FuseOptFlow()
         // normalise the quaternion states
         state.quat.normalize();
         // correct the covariance P = (I - K*H)*P
-        // take advantage of the empty columns in KH to reduce the
-        // number of operations
-        for (uint8_t i = 0; i <= 21; i++)
+        // H_LOS is only non-zero for the quaternion, velocity and height states
+        static const uint8_t flowIndex[8] = {0, 1, 2, 3, 4, 5, 6, 9};
+        ftype H_nz[8];
+        for (uint8_t k = 0; k < 8; k++)
         {
-            for (uint8_t j = 0; j <= 6; j++)
-            {
-                KH[i][j] = Kfusion[i] * H_LOS[j];
-            }
-            for (uint8_t j = 7; j <= 8; j++)
-            {
-                KH[i][j] = 0.0f;
-            }
-            KH[i][9] = Kfusion[i] * H_LOS[9];
-            for (uint8_t j = 10; j <= 21; j++)
-            {
-                KH[i][j] = 0.0f;
-            }
-        }
-        for (uint8_t i = 0; i <= 21; i++)
-        {
-            for (uint8_t j = 0; j <= 21; j++)
-            {
-                KHP[i][j] = 0.0f;
-                for (uint8_t k = 0; k <= 6; k++)
-                {
-                    KHP[i][j] = KHP[i][j] + KH[i][k] * P[k][j];
-                }
-                KHP[i][j] = KHP[i][j] + KH[i][9] * P[9][j];
-            }
-        }
-        for (uint8_t i = 0; i <=  21; i++)
-        {
-            for (uint8_t j = 0; j <=  21; j++)
-            {
-                P[i][j] = P[i][j] - KHP[i][j];
-            }
+            H_nz[k] = H_LOS[flowIndex[k]];
         }
+        CovarianceUpdate(P, Kfusion, H_nz, flowIndex, 8);
     } else if (obsIndex == 0) {
         // store the fact we have failed the X conponent so that a combined X and Y axis pass/fail can be calculated next time round
         flowXfailed = true;
@@ -3152,6 +3164,7 @@ void NavEKF::FuseAirspeed()
 {
     // start performance timer
     perf_begin(_perf_FuseAirspeed);
+    fusionSteps++;
 
     // declarations
     float vn;
@@ -3265,43 +3278,14 @@ void NavEKF::FuseAirspeed()
             state.quat.normalize();
 
             // correct the covariance P = (I - K*H)*P
-            // take advantage of the empty columns in H to reduce the number of operations
-            for (uint8_t i = 0; i<=21; i++)
-            {
-                for (uint8_t j = 0; j<=3; j++) KH[i][j] = 0.0f;
-                for (uint8_t j = 4; j<=6; j++)
-                {
-                    KH[i][j] = Kfusion[i] * H_TAS[j];
-                }
-                for (uint8_t j = 7; j<=13; j++) KH[i][j] = 0.0f;
-                for (uint8_t j = 14; j<=15; j++)
-                {
-                    KH[i][j] = Kfusion[i] * H_TAS[j];
-                }
-                for (uint8_t j = 16; j<=21; j++) KH[i][j] = 0.0f;
-            }
-            for (uint8_t i = 0; i<=21; i++)
-            {
-                for (uint8_t j = 0; j<=21; j++)
-                {
-                    KHP[i][j] = 0;
-                    for (uint8_t k = 4; k<=6; k++)
-                    {
-                        KHP[i][j] = KHP[i][j] + KH[i][k] * P[k][j];
-                    }
-                    for (uint8_t k = 14; k<=15; k++)
-                    {
-                        KHP[i][j] = KHP[i][j] + KH[i][k] * P[k][j];
-                    }
-                }
-            }
-            for (uint8_t i = 0; i<=21; i++)
+            // H_TAS is only non-zero for the velocity and wind states
+            static const uint8_t tasIndex[5] = {4, 5, 6, 14, 15};
+            ftype H_nz[5];
+            for (uint8_t k = 0; k<5; k++)
             {
-                for (uint8_t j = 0; j<=21; j++)
-                {
-                    P[i][j] = P[i][j] - KHP[i][j];
-                }
+                H_nz[k] = H_TAS[tasIndex[k]];
             }
+            CovarianceUpdate(P, Kfusion, H_nz, tasIndex, 5);
         }
     }
 
@@ -3318,6 +3302,7 @@ void NavEKF::FuseSideslip()
 {
     // start performance timer
     perf_begin(_perf_FuseSideslip);
+    fusionSteps++;
 
     // declarations
     float q0;
@@ -3456,43 +3441,14 @@ void NavEKF::FuseSideslip()
         state.quat.normalize();
 
         // correct the covariance P = (I - K*H)*P
-        // take advantage of the empty columns in H to reduce the
-        // number of operations
-        for (uint8_t i = 0; i<=21; i++)
-        {
-            for (uint8_t j = 0; j<=6; j++)
-            {
-                KH[i][j] = Kfusion[i] * H_BETA[j];
-            }
-            for (uint8_t j = 7; j<=13; j++) KH[i][j] = 0.0f;
-            for (uint8_t j = 14; j<=15; j++)
-            {
-                KH[i][j] = Kfusion[i] * H_BETA[j];
-            }
-            for (uint8_t j = 16; j<=21; j++) KH[i][j] = 0.0f;
-        }
-        for (uint8_t i = 0; i<=21; i++)
-        {
-            for (uint8_t j = 0; j<=21; j++)
-            {
-                KHP[i][j] = 0;
-                for (uint8_t k = 0; k<=6; k++)
-                {
-                    KHP[i][j] = KHP[i][j] + KH[i][k] * P[k][j];
-                }
-                for (uint8_t k = 14; k<=15; k++)
-                {
-                    KHP[i][j] = KHP[i][j] + KH[i][k] * P[k][j];
-                }
-            }
-        }
-        for (uint8_t i = 0; i<=21; i++)
+        // H_BETA is only non-zero for the quaternion, velocity and wind states
+        static const uint8_t betaIndex[9] = {0, 1, 2, 3, 4, 5, 6, 14, 15};
+        ftype H_nz[9];
+        for (uint8_t k = 0; k<9; k++)
         {
-            for (uint8_t j = 0; j<=21; j++)
-            {
-                P[i][j] = P[i][j] - KHP[i][j];
-            }
+            H_nz[k] = H_BETA[betaIndex[k]];
         }
+        CovarianceUpdate(P, Kfusion, H_nz, betaIndex, 9);
     }
 
     // force the covariance matrix to me symmetrical and limit the variances to prevent ill-condiioning.
@@ -3964,6 +3920,38 @@ void NavEKF::CovarianceInit()
 
 }
 
+/*
+  apply the covariance correction P = P - K*H*P for a single observation.
+
+  H*P is a single row, formed from only the rows of P where H is
+  non-zero, so the update is a rank-1 correction to P. It is applied
+  one contiguous row at a time, without the 22x22 intermediate
+  matrices of the general form, and states with zero gain are skipped.
+ */
+void NavEKF::CovarianceUpdate(Matrix22 &P, const Vector31 &K, const ftype *H_nz, const uint8_t *idx, uint8_t nnz)
+{
+    ftype HP[22];
+    for (uint8_t j = 0; j<=21; j++) {
+        HP[j] = 0;
+    }
+    for (uint8_t k = 0; k<nnz; k++) {
+        const ftype Hk = H_nz[k];
+        const uint8_t row = idx[k];
+        for (uint8_t j = 0; j<=21; j++) {
+            HP[j] += Hk * P[row][j];
+        }
+    }
+    for (uint8_t i = 0; i<=21; i++) {
+        const ftype Ki = K[i];
+        if (Ki == 0) {
+            continue;
+        }
+        for (uint8_t j = 0; j<=21; j++) {
+            P[i][j] -= Ki * HP[j];
+        }
+    }
+}
+
 // force symmetry on the covariance matrix to prevent ill-conditioning
 void NavEKF::ForceSymmetry()
 {
@@ -4054,46 +4042,104 @@ bool NavEKF::readDeltaAngle(uint8_t ins_index, Vector3f &dAng) {
     return false;
 }
 
-// update IMU delta angle and delta velocity measurements
-void NavEKF::readIMUData()
+// read the delta angle and delta velocities of the latest IMU sample
+void NavEKF::readIMUDeltas(Vector3f &dAng, Vector3f &dVel1, float &dtVel1, Vector3f &dVel2, float &dtVel2)
 {
     const AP_InertialSensor &ins = _ahrs->get_ins();
 
-    dtIMUavg = 1.0f/ins.get_sample_rate();
-    dtIMUactual = max(ins.get_delta_time(),1.0e-4f);
-
-    // the imu sample time is used as a common time reference throughout the filter
-    imuSampleTime_ms = hal.scheduler->millis();
+    if (imuIndex >= 0) {
+        // single IMU lane - use our own IMU while it is healthy, otherwise
+        // the primary so the filter keeps running until it is deselected
+        uint8_t accel_index = ins.get_accel_health(imuIndex) ? imuIndex : ins.get_primary_accel();
+        uint8_t gyro_index = ins.get_gyro_health(imuIndex) ? imuIndex : ins.get_primary_gyro();
+        readDeltaVelocity(accel_index, dVel1, dtVel1);
+        dtVel2 = dtVel1;
+        dVel2 = dVel1;
+        readDeltaAngle(gyro_index, dAng);
+        return;
+    }
 
     if (ins.get_accel_health(0) && ins.get_accel_health(1)) {
         // dual accel mode
-        readDeltaVelocity(0, dVelIMU1, dtDelVel1);
-        readDeltaVelocity(1, dVelIMU2, dtDelVel2);
+        readDeltaVelocity(0, dVel1, dtVel1);
+        readDeltaVelocity(1, dVel2, dtVel2);
     } else {
         // single accel mode - one of the first two accelerometers are unhealthy
-        // read primary accelerometer into dVelIMU1 and copy to dVelIMU2
-        readDeltaVelocity(ins.get_primary_accel(), dVelIMU1, dtDelVel1);
+        // read primary accelerometer into dVel1 and copy to dVel2
+        readDeltaVelocity(ins.get_primary_accel(), dVel1, dtVel1);
 
-        dtDelVel2 = dtDelVel1;
-        dVelIMU2 = dVelIMU1;
+        dtVel2 = dtVel1;
+        dVel2 = dVel1;
     }
 
     if (ins.get_gyro_health(0) && ins.get_gyro_health(1)) {
         // dual gyro mode - average first two gyros
-        Vector3f dAng;
-        dAngIMU.zero();
-        readDeltaAngle(0, dAng);
-        dAngIMU += dAng;
-        readDeltaAngle(1, dAng);
-        dAngIMU += dAng;
-        dAngIMU *= 0.5f;
+        Vector3f dAngSample;
+        dAng.zero();
+        readDeltaAngle(0, dAngSample);
+        dAng += dAngSample;
+        readDeltaAngle(1, dAngSample);
+        dAng += dAngSample;
+        dAng *= 0.5f;
     } else {
         // single gyro mode - one of the first two gyros are unhealthy or don't exist
         // just read primary gyro
-        readDeltaAngle(ins.get_primary_gyro(), dAngIMU);
+        readDeltaAngle(ins.get_primary_gyro(), dAng);
+    }
+}
+
+// add the latest IMU sample to the sums used by the next filter update
+void NavEKF::AccumulateIMU()
+{
+    if (!statesInitialised) {
+        return;
+    }
+
+    Vector3f dAng, dVel1, dVel2;
+    float dtVel1 = 0, dtVel2 = 0;
+    readIMUDeltas(dAng, dVel1, dtVel1, dVel2, dtVel2);
+
+    imuAccum.dAng += dAng;
+    imuAccum.dVel1 += dVel1;
+    imuAccum.dVel2 += dVel2;
+    imuAccum.dtVel1 += dtVel1;
+    imuAccum.dtVel2 += dtVel2;
+    imuAccum.dt += _ahrs->get_ins().get_delta_time();
+    if (imuAccum.count < 255) {
+        imuAccum.count++;
     }
 }
 
+// update IMU delta angle and delta velocity measurements
+void NavEKF::readIMUData()
+{
+    const AP_InertialSensor &ins = _ahrs->get_ins();
+
+    dtIMUavg = float(imuRateDivider)/ins.get_sample_rate();
+
+    // the imu sample time is used as a common time reference throughout the filter
+    imuSampleTime_ms = hal.scheduler->millis();
+
+    if (imuAccum.count > 0) {
+        // the samples accumulated since the last update, which may be
+        // more than imuRateDivider if an update was skipped. The
+        // summed delta angle is used without coning correction, which
+        // is small over the few samples of a filter step
+        dtIMUactual = max(imuAccum.dt,1.0e-4f);
+        dAngIMU = imuAccum.dAng;
+        dVelIMU1 = imuAccum.dVel1;
+        dVelIMU2 = imuAccum.dVel2;
+        dtDelVel1 = max(imuAccum.dtVel1,1.0e-4f);
+        dtDelVel2 = max(imuAccum.dtVel2,1.0e-4f);
+        imuAccum = imu_accum();
+        return;
+    }
+
+    // initialising the filter, before any samples are accumulated
+    dtIMUactual = max(ins.get_delta_time(),1.0e-4f);
+    readIMUDeltas(dAngIMU, dVelIMU1, dtDelVel1, dVelIMU2, dtDelVel2);
+}
+
 // check for new valid GPS data and update stored measurement if available
 void NavEKF::readGpsData()
 {
@@ -4112,9 +4158,20 @@ void NavEKF::readGpsData()
         newDataGps = true;
 
         // get state vectors that were stored at the time that is closest to when the the GPS measurement
-        // time after accounting for measurement delays
-        RecallStates(statesAtVelTime, (imuSampleTime_ms - constrain_int16(_msecVelDelay, 0, 500)));
-        RecallStates(statesAtPosTime, (imuSampleTime_ms - constrain_int16(_msecPosDelay, 0, 500)));
+        // time after accounting for measurement delays. The delays are taken from the arrival of the
+        // fix, so the time taken to process it does not add jitter. A blended GPS solution is aligned
+        // to the fix times of the receivers in it, so it carries its own delay
+        uint32_t gpsArrival_ms = _ahrs->get_gps().fix_arrival_ms();
+        if (imuSampleTime_ms - gpsArrival_ms > 500) {
+            gpsArrival_ms = imuSampleTime_ms;
+        }
+        int16_t velDelay_ms = _msecVelDelay;
+        int16_t posDelay_ms = _msecPosDelay;
+        if (_ahrs->get_gps().blending()) {
+            velDelay_ms = posDelay_ms = _ahrs->get_gps().get_lag() * 1000;
+        }
+        RecallStates(statesAtVelTime, (gpsArrival_ms - constrain_int16(velDelay_ms, 0, 500)));
+        RecallStates(statesAtPosTime, (gpsArrival_ms - constrain_int16(posDelay_ms, 0, 500)));
 
         // read the NED velocity from the GPS
         velNED = _ahrs->get_gps().velocity();
@@ -4527,9 +4584,51 @@ void  NavEKF::getVariances(float &velVar, float &posVar, float &hgtVar, Vector3f
     offset   = gpsPosGlitchOffsetNE;
 }
 
+// copy the values for the EKF log messages
+void NavEKF::getLogSnapshot(struct log_snapshot &snap) const
+{
+    snap.quat = state.quat;
+    snap.trim = _ahrs->get_trim();
+    snap.velocity = state.velocity;
+    getPosNED(snap.position);
+    getGyroBias(snap.gyro_bias);
+    getAccelZBias(snap.accel_zbias1, snap.accel_zbias2);
+    snap.imu1_weighting = IMU1_weighting;
+    snap.wind = state.wind_vel;
+    snap.earth_magfield = state.earth_magfield;
+    snap.body_magfield = state.body_magfield;
+    for (uint8_t i=0; i<6; i++) {
+        snap.innovVelPos[i] = innovVelPos[i];
+    }
+    snap.innovMag = innovMag;
+    snap.innovVtas = innovVtas;
+    snap.velTestRatio = velTestRatio;
+    snap.posTestRatio = posTestRatio;
+    snap.hgtTestRatio = hgtTestRatio;
+    snap.magTestRatio = magTestRatio;
+    snap.tasTestRatio = tasTestRatio;
+    snap.gpsPosGlitchOffsetNE = gpsPosGlitchOffsetNE;
+    getFilterFaults(snap.faults);
+    getFilterTimeouts(snap.timeouts);
+    nav_filter_status solutionStatus;
+    getFilterStatus(solutionStatus);
+    snap.status = solutionStatus.value;
+    snap.flowTestRatio = max(flowTestRatio[0],flowTestRatio[1]);
+    snap.terrainState = terrainState;
+    snap.innovOptFlow[0] = innovOptFlow[0];
+    snap.innovOptFlow[1] = innovOptFlow[1];
+    snap.auxFlowObsInnov = auxFlowObsInnov;
+    snap.innovRng = innovRng;
+    snap.rngMea = rngMea;
+    snap.Popt = Popt;
+}
+
 // Use a function call rather than a constructor to initialise variables because it enables the filter to be re-started in flight if necessary.
 void NavEKF::InitialiseVariables()
 {
+    // discard IMU samples accumulated before the filter (re)started
+    imuAccum = imu_accum();
+
     // initialise time stamps
     imuSampleTime_ms = hal.scheduler->millis();
     lastHealthyMagTime_ms = imuSampleTime_ms;
@@ -4621,6 +4720,8 @@ void NavEKF::InitialiseVariables()
     hgtRate = 0.0f;
     mag_state.q0 = 1;
     mag_state.DCM.identity();
+    mag_state.obsIndex = 3;
+    tasFuseDeferred = false;
     IMU1_weighting = 0.5f;
     onGround = true;
     manoeuvring = false;
@@ -5075,10 +5176,6 @@ bool NavEKF::calcGpsGoodToAlign(void)
 // Read at 20Hz and apply a median filter
 void NavEKF::readRangeFinder(void)
 {
-    static float storedRngMeas[3];
-    static uint32_t storedRngMeasTime_ms[3];
-    static uint32_t lastRngMeasTime_ms = 0;
-    static uint8_t rngMeasIndex = 0;
     uint8_t midIndex;
     uint8_t maxIndex;
     uint8_t minIndex;
@@ -5188,6 +5285,14 @@ void NavEKF::alignMagStateDeclination()
     // rotate the NE values so that the declination matches the published value
     Vector3f initMagNED = state.earth_magfield;
     float magLengthNE = pythagorous2(initMagNED.x,initMagNED.y);
+
+    // when the field at the location is known use its horizontal and
+    // vertical strength as well, converted from milligauss
+    Vector3f fieldNED;
+    if (use_compass() && _ahrs->get_compass()->get_earth_field_ef(fieldNED)) {
+        magLengthNE = pythagorous2(fieldNED.x,fieldNED.y) * 0.001f;
+        state.earth_magfield.z = fieldNED.z * 0.001f;
+    }
     state.earth_magfield.x = magLengthNE * cosf(magDecAng);
     state.earth_magfield.y = magLengthNE * sinf(magDecAng);
 }
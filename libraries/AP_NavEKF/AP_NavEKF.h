@@ -105,6 +105,36 @@ public:
     // Check basic filter health metrics and return a consolidated health status
     bool healthy(void) const;
 
+    // Feed the filter from a single IMU instead of the blend of the first two.
+    // An index of -1 selects the blended IMU data (the default)
+    void setIMUIndex(int8_t index) { imuIndex = index; }
+    int8_t getIMUIndex(void) const { return imuIndex; }
+
+    // Run the filter once every div IMU samples. UpdateFilter() then
+    // uses the delta angles and velocities summed by AccumulateIMU(),
+    // which must be called on every IMU sample. Set before the filter
+    // is initialised, as the measurement update counts depend on it
+    void setIMURateDivider(uint8_t div) { imuRateDivider = max(div, 1); }
+    uint8_t getIMURateDivider(void) const { return imuRateDivider; }
+
+    // add the latest IMU sample to the data used by the next
+    // UpdateFilter() call. Must be called on every IMU sample, as
+    // UpdateFilter() only uses the samples accumulated since its
+    // last run
+    void AccumulateIMU(void);
+
+    // execution time of UpdateFilter() and the number of fusion steps
+    // (covariance predictions and observation fusions) it performed
+    struct frame_timing {
+        uint32_t last_us;
+        uint32_t max_us;
+        uint32_t avg_us;        // filtered
+        uint8_t last_steps;
+        uint8_t max_steps;
+        uint32_t deferrals;     // fusion steps moved to the next frame
+    };
+    void getFrameTiming(struct frame_timing &timing) const { timing = frameTiming; }
+
     // Return the last calculated NED position relative to the reference point (m).
     // If a calculated solution is not available, use the best available data and return false
     // If false returned, do not use for flight control
@@ -243,6 +273,45 @@ public:
     */
     void  getFilterStatus(nav_filter_status &status) const;
 
+    /*
+      the raw values behind the EKF1 to EKF5 log messages. Filling
+      this is a few copies, so the logger can take a snapshot in the
+      main loop and leave the scaling and packing for later
+     */
+    struct log_snapshot {
+        Quaternion quat;            // NED to body rotation
+        Vector3f trim;              // AHRS trim to remove from the euler angles (rad)
+        Vector3f velocity;          // NED velocity (m/s)
+        Vector3f position;          // NED position from getPosNED() (m)
+        Vector3f gyro_bias;         // body gyro bias (rad/s)
+        float accel_zbias1;         // IMU1 Z accel bias (m/s^2)
+        float accel_zbias2;         // IMU2 Z accel bias (m/s^2)
+        float imu1_weighting;       // weighting of the first IMU
+        Vector2f wind;              // NE wind velocity (m/s)
+        Vector3f earth_magfield;    // earth field (gauss)
+        Vector3f body_magfield;     // body field (gauss)
+        float innovVelPos[6];       // NED velocity and position innovations
+        Vector3f innovMag;          // magnetometer innovations (gauss)
+        float innovVtas;            // airspeed innovation
+        float velTestRatio;         // innovation test ratios, squared
+        float posTestRatio;
+        float hgtTestRatio;
+        Vector3f magTestRatio;
+        float tasTestRatio;
+        Vector2f gpsPosGlitchOffsetNE;
+        uint8_t faults;
+        uint8_t timeouts;
+        uint16_t status;
+        float flowTestRatio;        // larger of the optical flow test ratios
+        float terrainState;         // terrain position state (m)
+        float innovOptFlow[2];
+        float auxFlowObsInnov;
+        float innovRng;
+        float rngMea;
+        float Popt;
+    };
+    void getLogSnapshot(struct log_snapshot &snap) const;
+
     // send an EKF_STATUS_REPORT message to GCS
     void send_status_report(mavlink_channel_t chan);
 
@@ -255,9 +324,15 @@ public:
     // returns a zero rotation quaternion if the INS calculation was not performed on that time step.
     Quaternion getDeltaQuaternion(void) const;
 
+    // apply P = P - K*H*P for a single observation. H is non-zero only
+    // at the nnz states listed in idx[], and H_nz[] holds those elements
+    static void CovarianceUpdate(Matrix22 &P, const Vector31 &K, const ftype *H_nz, const uint8_t *idx, uint8_t nnz);
+
     static const struct AP_Param::GroupInfo var_info[];
 
 private:
+    friend class NavEKF_Lanes;
+
     const AP_AHRS *_ahrs;
     AP_Baro &_baro;
     const RangeFinder &_rng;
@@ -343,6 +418,7 @@ private:
     // helper functions for readIMUData
     bool readDeltaVelocity(uint8_t ins_index, Vector3f &dVel, float &dVel_dt);
     bool readDeltaAngle(uint8_t ins_index, Vector3f &dAng);
+    void readIMUDeltas(Vector3f &dAng, Vector3f &dVel1, float &dtVel1, Vector3f &dVel2, float &dtVel2);
 
     // update IMU delta angle and delta velocity measurements
     void readIMUData();
@@ -490,6 +566,7 @@ private:
     AP_Float _maxFlowRate;          // Maximum flow rate magnitude that will be accepted by the filter
     AP_Int8 _fallback;              // EKF-to-DCM fallback strictness. 0 = trust EKF more, 1 = fallback more conservatively.
     AP_Int8 _altSource;             // Primary alt source during optical flow navigation. 0 = use Baro, 1 = use range finder.
+    AP_Int8 _laneCount;             // Number of single IMU filter lanes. 0 or 1 = one filter blending IMU1 and IMU2
 
     // Tuning parameters
     const float gpsNEVelVarAccScale;    // Scale factor applied to NE velocity measurement variance due to manoeuvre acceleration
@@ -546,8 +623,6 @@ private:
 
     float gpsNoiseScaler;           // Used to scale the  GPS measurement noise and consistency gates to compensate for operation with small satellite counts
     Vector31 Kfusion;               // Kalman gain vector
-    Matrix22 KH;                    // intermediate result used for covariance updates
-    Matrix22 KHP;                   // intermediate result used for covariance updates
     Matrix22 P;                     // covariance matrix
     VectorN<state_elements,50> storedStates;       // state vectors stored for the last 50 time steps
     Vector_u32_50 statetimeStamp;    // time stamp for each state vector stored
@@ -747,6 +822,32 @@ private:
     // IMU processing
     float dtDelVel1;
     float dtDelVel2;
+    int8_t imuIndex;                // IMU used by this filter, or -1 to blend the first two
+    uint8_t imuRateDivider;         // IMU samples per filter update
+
+    // IMU samples summed by AccumulateIMU() since the last filter update
+    struct imu_accum {
+        Vector3f dAng;
+        Vector3f dVel1;
+        Vector3f dVel2;
+        float dtVel1;
+        float dtVel2;
+        float dt;
+        uint8_t count;
+    } imuAccum;
+    bool prevUpdateArmed;           // arm status at the previous UpdateFilter() call
+
+    // load spreading
+    bool tasFuseDeferred;           // true when airspeed fusion has been deferred to the next time step
+    uint8_t fusionSteps;            // fusion steps performed in this time step
+    float frameTimeAvg_us;          // filtered execution time of UpdateFilter()
+    struct frame_timing frameTiming;
+
+    // range finder median filter
+    float storedRngMeas[3];
+    uint32_t storedRngMeasTime_ms[3];
+    uint32_t lastRngMeasTime_ms;
+    uint8_t rngMeasIndex;
 
     // baro ground effect
     bool expectGndEffectTakeoff;      // external state from ArduCopter - takeoff expected
@@ -0,0 +1,409 @@
+/// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+
+#include <AP_HAL.h>
+
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_150
+
+#include "AP_NavEKF_Lanes.h"
+#include <AP_AHRS.h>
+#include <stdlib.h>
+#include <new>
+
+extern const AP_HAL::HAL& hal;
+
+// a healthy lane is only replaced when its innovation test ratio is
+// above NAVEKF_LANE_SWITCH_SCORE and another lane has been below
+// NAVEKF_LANE_SWITCH_RATIO times that for NAVEKF_LANE_SWITCH_MS
+#define NAVEKF_LANE_SWITCH_SCORE    0.5f
+#define NAVEKF_LANE_SWITCH_RATIO    0.5f
+#define NAVEKF_LANE_SWITCH_MS       1000
+
+// time constant in seconds over which the step between two lanes is
+// blended out after a switch
+#define NAVEKF_LANE_RESET_TC        2.0f
+
+NavEKF_Lanes::NavEKF_Lanes(const AP_AHRS *ahrs, AP_Baro &baro, const RangeFinder &rng, NavEKF &primary) :
+    _ahrs(ahrs),
+    _baro(baro),
+    _rng(rng),
+    _primary(primary),
+    _num_lanes(1),
+    _lanes_created(false),
+    _imu_rate_div(1),
+    _active(0),
+    _candidate(0),
+    _candidate_start_ms(0),
+    _switch_count(0),
+    _last_param_sync_ms(0),
+    _offset_update_ms(0)
+{
+    _lane[0].ekf = &_primary;
+    for (uint8_t i=0; i<NAVEKF_MAX_LANES; i++) {
+        _lane_proc[i] = FUNCTOR_BIND(&_lane[i], &NavEKF_Lanes::Lane::update, void);
+    }
+}
+
+NavEKF_Lanes::Lane::Lane() :
+    ekf(NULL),
+    budget_us(0),
+    timing(),
+    avg_us(0),
+    seq(0),
+    output()
+{
+}
+
+/*
+  create the extra lanes, one per IMU after the first, if EKF_LANES
+  asks for them
+ */
+void NavEKF_Lanes::create_lanes(void)
+{
+    _lanes_created = true;
+
+    const AP_InertialSensor &ins = _ahrs->get_ins();
+    uint8_t count = min(ins.get_gyro_count(), ins.get_accel_count());
+    if (count > _primary._laneCount) {
+        count = _primary._laneCount;
+    }
+    if (count > NAVEKF_MAX_LANES) {
+        count = NAVEKF_MAX_LANES;
+    }
+
+    uint32_t budget_us = 1000000UL * _imu_rate_div / max(ins.get_sample_rate(), 1);
+    _lane[0].budget_us = budget_us;
+
+    if (count < 2) {
+        // a single filter blending the first two IMUs, as without lanes
+        return;
+    }
+
+    for (uint8_t i=1; i<count; i++) {
+        // NavEKF expects zeroed memory, like the vehicle's static instance
+        void *mem = calloc(1, sizeof(NavEKF));
+        if (mem == NULL) {
+            break;
+        }
+        _lane[i].ekf = new (mem) NavEKF(_ahrs, _baro, _rng);
+        _lane[i].ekf->setIMUIndex(i);
+        _lane[i].ekf->setIMURateDivider(_imu_rate_div);
+        _lane[i].budget_us = budget_us;
+        _num_lanes++;
+    }
+    if (_num_lanes > 1) {
+        _primary.setIMUIndex(0);
+    }
+    sync_parameters();
+}
+
+/*
+  make the extra lanes follow the parameters of the vehicle's filter
+ */
+void NavEKF_Lanes::sync_parameters(void)
+{
+    for (uint8_t i=1; i<_num_lanes; i++) {
+        AP_Param::copy_object_values(_lane[i].ekf, &_primary, NavEKF::var_info);
+    }
+    _last_param_sync_ms = hal.scheduler->millis();
+}
+
+bool NavEKF_Lanes::InitialiseFilterDynamic(void)
+{
+    if (!_lanes_created) {
+        create_lanes();
+    }
+    _euler_offset.zero();
+    _vel_offset.zero();
+    _pos_offset.zero();
+    // the extra lanes are retried in UpdateFilter() if they fail to start
+    for (uint8_t i=1; i<_num_lanes; i++) {
+        _lane[i].ekf->InitialiseFilterDynamic();
+    }
+    return _primary.InitialiseFilterDynamic();
+}
+
+bool NavEKF_Lanes::InitialiseFilterBootstrap(void)
+{
+    _euler_offset.zero();
+    _vel_offset.zero();
+    _pos_offset.zero();
+    for (uint8_t i=1; i<_num_lanes; i++) {
+        _lane[i].ekf->InitialiseFilterBootstrap();
+    }
+    return _primary.InitialiseFilterBootstrap();
+}
+
+void NavEKF_Lanes::setIMURateDivider(uint8_t div)
+{
+    _imu_rate_div = max(div, 1);
+    for (uint8_t i=0; i<_num_lanes; i++) {
+        _lane[i].ekf->setIMURateDivider(_imu_rate_div);
+    }
+}
+
+void NavEKF_Lanes::AccumulateIMU(void)
+{
+    for (uint8_t i=0; i<_num_lanes; i++) {
+        _lane[i].ekf->AccumulateIMU();
+    }
+}
+
+/*
+  run one lane and record how long it took. This runs on a worker
+  thread when lanes run in parallel
+ */
+void NavEKF_Lanes::Lane::update(void)
+{
+    uint32_t start_us = hal.scheduler->micros();
+    ekf->UpdateFilter();
+    uint32_t elapsed_us = hal.scheduler->micros() - start_us;
+
+    timing.last_us = elapsed_us;
+    if (elapsed_us > timing.max_us) {
+        timing.max_us = elapsed_us;
+    }
+    avg_us = 0.98f * avg_us + 0.02f * elapsed_us;
+    timing.avg_us = avg_us;
+    if (elapsed_us > budget_us) {
+        timing.overruns++;
+    }
+
+    publish();
+}
+
+/*
+  publish the lane's solution. Readers retry if the sequence counter
+  is odd or changes while they copy the output
+ */
+void NavEKF_Lanes::Lane::publish(void)
+{
+    struct lane_output out;
+    float velVar, posVar, hgtVar, tasVar;
+    Vector3f magVar;
+    Vector2f offset;
+
+    out.time_ms = hal.scheduler->millis();
+    out.imu = ekf->getIMUIndex();
+    out.healthy = ekf->healthy();
+    ekf->getVariances(velVar, posVar, hgtVar, magVar, tasVar, offset);
+    out.score = max(max(velVar, posVar), max(hgtVar, tasVar));
+    out.score = max(out.score, max(magVar.x, max(magVar.y, magVar.z)));
+    ekf->getEulerAngles(out.euler);
+    ekf->getVelNED(out.velNED);
+    ekf->getPosNED(out.posNED);
+    ekf->getGyroBias(out.gyro_bias);
+
+    __atomic_store_n(&seq, seq+1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    output = out;
+    __atomic_store_n(&seq, seq+1, __ATOMIC_RELEASE);
+}
+
+bool NavEKF_Lanes::get_output(uint8_t i, struct lane_output &out) const
+{
+    if (i >= _num_lanes) {
+        return false;
+    }
+    const Lane &lane = _lane[i];
+    // a bounded number of tries, so a reader that has preempted the
+    // lane on the same CPU cannot spin forever
+    for (uint8_t tries=0; tries<4; tries++) {
+        uint32_t seq1 = __atomic_load_n(&lane.seq, __ATOMIC_ACQUIRE);
+        if (seq1 & 1) {
+            continue;
+        }
+        out = lane.output;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&lane.seq, __ATOMIC_RELAXED) == seq1) {
+            return seq1 != 0;
+        }
+    }
+    return false;
+}
+
+void NavEKF_Lanes::get_timing(uint8_t i, struct lane_timing &timing) const
+{
+    timing = _lane[i < _num_lanes ? i : 0].timing;
+}
+
+/*
+  run all lanes, in parallel where the board allows it, then select
+  the lane for the AHRS to use
+ */
+void NavEKF_Lanes::UpdateFilter(void)
+{
+    if (_num_lanes > 1) {
+        if (hal.scheduler->millis() - _last_param_sync_ms >= 1000) {
+            sync_parameters();
+        }
+        for (uint8_t i=1; i<_num_lanes; i++) {
+            if (!_lane[i].ekf->statesInitialised) {
+                _lane[i].ekf->InitialiseFilterDynamic();
+            }
+        }
+    }
+
+    hal.scheduler->run_parallel(_lane_proc, _num_lanes);
+
+    decay_offsets();
+    select_lane();
+}
+
+/*
+  a lane can be selected if its filter and its IMU are healthy. The
+  score is its largest innovation test ratio
+ */
+bool NavEKF_Lanes::lane_usable(uint8_t i, float &score) const
+{
+    const NavEKF &ekf = *_lane[i].ekf;
+    if (!ekf.statesInitialised || !_lane[i].output.healthy) {
+        return false;
+    }
+    int8_t imu = ekf.getIMUIndex();
+    const AP_InertialSensor &ins = _ahrs->get_ins();
+    if (imu >= 0 && (!ins.get_gyro_health(imu) || !ins.get_accel_health(imu))) {
+        return false;
+    }
+    score = _lane[i].output.score;
+    return true;
+}
+
+void NavEKF_Lanes::select_lane(void)
+{
+    if (_num_lanes < 2) {
+        return;
+    }
+
+    float active_score = 0;
+    bool active_usable = lane_usable(_active, active_score);
+
+    uint8_t best = _active;
+    float best_score = 0;
+    for (uint8_t i=0; i<_num_lanes; i++) {
+        float score;
+        if (i != _active && lane_usable(i, score) &&
+            (best == _active || score < best_score)) {
+            best = i;
+            best_score = score;
+        }
+    }
+    if (best == _active) {
+        _candidate = _active;
+        return;
+    }
+
+    if (active_usable) {
+        // only move away from a healthy lane for a clear and sustained
+        // improvement, so we don't flap between lanes
+        if (active_score < NAVEKF_LANE_SWITCH_SCORE ||
+            best_score > NAVEKF_LANE_SWITCH_RATIO * active_score) {
+            _candidate = _active;
+            return;
+        }
+        uint32_t now = hal.scheduler->millis();
+        if (best != _candidate) {
+            _candidate = best;
+            _candidate_start_ms = now;
+            return;
+        }
+        if (now - _candidate_start_ms < NAVEKF_LANE_SWITCH_MS) {
+            return;
+        }
+    }
+
+    switch_lane(best);
+}
+
+/*
+  make another lane the selected lane. The offsets take up the
+  difference between the two lanes' solutions, so the output carries
+  on from where the old lane left it
+ */
+void NavEKF_Lanes::switch_lane(uint8_t lane)
+{
+    const struct lane_output &from = _lane[_active].output;
+    const struct lane_output &to = _lane[lane].output;
+
+    Vector3f step = from.euler - to.euler;
+    _euler_offset.x = wrap_PI(_euler_offset.x + wrap_PI(step.x));
+    _euler_offset.y = wrap_PI(_euler_offset.y + wrap_PI(step.y));
+    _euler_offset.z = wrap_PI(_euler_offset.z + wrap_PI(step.z));
+    _vel_offset += from.velNED - to.velNED;
+
+    // the lanes may have set their origins at different times, so
+    // move the old position into the new lane's frame first
+    Vector3f from_pos = from.posNED;
+    struct Location from_origin, to_origin;
+    if (_lane[_active].ekf->getOriginLLH(from_origin) &&
+        _lane[lane].ekf->getOriginLLH(to_origin)) {
+        Vector2f shift = location_diff(to_origin, from_origin);
+        from_pos.x += shift.x;
+        from_pos.y += shift.y;
+        from_pos.z += (to_origin.alt - from_origin.alt) * 0.01f;
+    }
+    _pos_offset += from_pos - to.posNED;
+
+    _active = lane;
+    _candidate = lane;
+    _switch_count++;
+}
+
+/*
+  blend out the offsets of the last lane switch
+ */
+void NavEKF_Lanes::decay_offsets(void)
+{
+    uint32_t now = hal.scheduler->millis();
+    float dt = (now - _offset_update_ms) * 0.001f;
+    _offset_update_ms = now;
+    float scale = 1.0f - constrain_float(dt / NAVEKF_LANE_RESET_TC, 0.0f, 1.0f);
+    _euler_offset *= scale;
+    _vel_offset *= scale;
+    _pos_offset *= scale;
+}
+
+void NavEKF_Lanes::getEulerAngles(Vector3f &euler) const
+{
+    active().getEulerAngles(euler);
+    if (!_euler_offset.is_zero()) {
+        euler.x = wrap_PI(euler.x + _euler_offset.x);
+        euler.y = wrap_PI(euler.y + _euler_offset.y);
+        euler.z = wrap_PI(euler.z + _euler_offset.z);
+    }
+}
+
+void NavEKF_Lanes::getRotationBodyToNED(Matrix3f &mat) const
+{
+    if (_euler_offset.is_zero()) {
+        active().getRotationBodyToNED(mat);
+        return;
+    }
+    Vector3f euler;
+    getEulerAngles(euler);
+    mat.from_euler(euler.x, euler.y, euler.z);
+}
+
+void NavEKF_Lanes::getVelNED(Vector3f &vel) const
+{
+    active().getVelNED(vel);
+    vel += _vel_offset;
+}
+
+bool NavEKF_Lanes::getPosNED(Vector3f &pos) const
+{
+    bool ret = active().getPosNED(pos);
+    pos += _pos_offset;
+    return ret;
+}
+
+bool NavEKF_Lanes::getLLH(struct Location &loc) const
+{
+    bool ret = active().getLLH(loc);
+    if (!_pos_offset.is_zero()) {
+        location_offset(loc, _pos_offset.x, _pos_offset.y);
+        loc.alt -= _pos_offset.z * 100;
+    }
+    return ret;
+}
+
+#endif // HAL_CPU_CLASS
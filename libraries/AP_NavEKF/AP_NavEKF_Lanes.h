@@ -0,0 +1,161 @@
+/// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+  NavEKF lanes: one independent NavEKF per IMU
+
+  Lane 0 is the vehicle's own NavEKF, which also holds the EKF_
+  parameters. The other lanes are created when EKF_LANES is 2 or more
+  and there is more than one IMU, and follow the parameters of lane
+  0. All lanes run each update through hal.scheduler->run_parallel(),
+  so on boards with spare cores they run concurrently. The lane with
+  the most consistent innovations is selected for use by the AHRS.
+
+  Each lane publishes a summary of its solution under a sequence
+  counter, so it can be read from any thread without locking.
+
+  When the selected lane changes, the difference between the old and
+  new lanes' solutions is kept as an offset that is added to the new
+  lane's attitude, velocity and position. The offset decays over
+  NAVEKF_LANE_RESET_TC, so a switch gives no step in the output.
+ */
+
+#ifndef AP_NavEKF_Lanes_H
+#define AP_NavEKF_Lanes_H
+
+#include "AP_NavEKF.h"
+
+#define NAVEKF_MAX_LANES INS_MAX_INSTANCES
+
+class NavEKF_Lanes
+{
+public:
+    NavEKF_Lanes(const AP_AHRS *ahrs, AP_Baro &baro, const RangeFinder &rng, NavEKF &primary);
+
+    // start the filters, creating the extra lanes the first time
+    bool InitialiseFilterDynamic(void);
+
+    // restart the filters when the vehicle is static
+    bool InitialiseFilterBootstrap(void);
+
+    // run all lanes, then select the lane to use
+    void UpdateFilter(void);
+
+    // run the lanes once every div IMU samples, see NavEKF::setIMURateDivider()
+    void setIMURateDivider(uint8_t div);
+
+    // add the latest IMU sample to the next update of every lane
+    void AccumulateIMU(void);
+
+    // number of lanes. This is 1 unless lanes are enabled
+    uint8_t num_lanes(void) const { return _num_lanes; }
+
+    // a lane's filter. Lane 0 is the vehicle's NavEKF
+    NavEKF &get_lane(uint8_t i) { return *_lane[i < _num_lanes ? i : 0].ekf; }
+    const NavEKF &get_lane(uint8_t i) const { return *_lane[i < _num_lanes ? i : 0].ekf; }
+
+    // the selected lane
+    uint8_t active_lane(void) const { return _active; }
+    NavEKF &active(void) { return *_lane[_active].ekf; }
+    const NavEKF &active(void) const { return *_lane[_active].ekf; }
+
+    // number of times the selected lane has changed
+    uint16_t switch_count(void) const { return _switch_count; }
+
+    // the selected lane's solution, with the offset that hides the
+    // last lane switch
+    void getEulerAngles(Vector3f &euler) const;
+    void getRotationBodyToNED(Matrix3f &mat) const;
+    void getVelNED(Vector3f &vel) const;
+    bool getPosNED(Vector3f &pos) const;
+    bool getLLH(struct Location &loc) const;
+
+    // summary of a lane's solution, published at the end of each update
+    struct lane_output {
+        uint32_t time_ms;
+        int8_t imu;             // IMU used by the lane, -1 for blended
+        bool healthy;
+        float score;            // largest innovation test ratio
+        Vector3f euler;         // radians
+        Vector3f velNED;        // m/s
+        Vector3f posNED;        // m from the EKF origin
+        Vector3f gyro_bias;     // rad/s
+    };
+
+    // get the last published output of a lane. Safe to call from
+    // any thread. Returns false if the lane has not published yet
+    bool get_output(uint8_t i, struct lane_output &out) const;
+
+    // execution time of a lane's UpdateFilter() calls
+    struct lane_timing {
+        uint32_t last_us;
+        uint32_t max_us;
+        uint32_t avg_us;        // filtered
+        uint32_t overruns;      // updates longer than the filter update period
+    };
+    void get_timing(uint8_t i, struct lane_timing &timing) const;
+
+private:
+    class Lane {
+    public:
+        Lane();
+
+        NavEKF *ekf;
+        uint32_t budget_us;
+        struct lane_timing timing;
+        float avg_us;
+
+        // the published output and its sequence counter, which is
+        // odd while the output is being written
+        uint32_t seq;
+        struct lane_output output;
+
+        void update(void);
+        void publish(void);
+    };
+
+    const AP_AHRS *_ahrs;
+    AP_Baro &_baro;
+    const RangeFinder &_rng;
+    NavEKF &_primary;
+
+    Lane _lane[NAVEKF_MAX_LANES];
+    AP_HAL::MemberProc _lane_proc[NAVEKF_MAX_LANES];
+    uint8_t _num_lanes;
+    bool _lanes_created;
+    uint8_t _imu_rate_div;
+
+    uint8_t _active;
+    uint8_t _candidate;
+    uint32_t _candidate_start_ms;
+    uint16_t _switch_count;
+    uint32_t _last_param_sync_ms;
+
+    // offsets added to the selected lane's solution after a switch
+    Vector3f _euler_offset;     // radians
+    Vector3f _vel_offset;       // m/s
+    Vector3f _pos_offset;       // m
+    uint32_t _offset_update_ms;
+
+    void create_lanes(void);
+    void sync_parameters(void);
+    bool lane_usable(uint8_t i, float &score) const;
+    void select_lane(void);
+    void switch_lane(uint8_t lane);
+    void decay_offsets(void);
+};
+
+#endif // AP_NavEKF_Lanes_H
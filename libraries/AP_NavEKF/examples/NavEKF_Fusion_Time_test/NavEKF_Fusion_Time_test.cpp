@@ -0,0 +1,189 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+
+/*
+ *       Benchmark of the NavEKF covariance update for each type of
+ *       fused observation, against the KH/KHP form it replaced
+ */
+
+#include <AP_HAL.h>
+#include <AP_Common.h>
+#include <AP_Progmem.h>
+#include <AP_Math.h>
+#include <AP_Param.h>
+#include <AP_InertialSensor.h>
+#include <AP_ADC.h>
+#include <AP_ADC_AnalogSource.h>
+#include <AP_Baro.h>
+#include <AP_GPS.h>
+#include <AP_AHRS.h>
+#include <AP_Compass.h>
+#include <AP_Declination.h>
+#include <AP_Airspeed.h>
+#include <GCS_MAVLink.h>
+#include <AP_Mission.h>
+#include <StorageManager.h>
+#include <AP_Terrain.h>
+#include <Filter.h>
+#include <SITL.h>
+#include <AP_Buffer.h>
+#include <AP_Notify.h>
+#include <AP_Vehicle.h>
+#include <DataFlash.h>
+#include <AP_NavEKF.h>
+#include <AP_Rally.h>
+#include <AP_Scheduler.h>
+
+#include <AP_HAL_AVR.h>
+#include <AP_HAL_SITL.h>
+#include <AP_HAL_Empty.h>
+#include <AP_HAL_Linux.h>
+#include <AP_HAL_PX4.h>
+#include <AP_BattMonitor.h>
+#include <AP_SerialManager.h>
+#include <RC_Channel.h>
+#include <AP_RangeFinder.h>
+
+const AP_HAL::HAL& hal = AP_HAL_BOARD_DRIVER;
+
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_150
+
+#define NUM_UPDATES 2000
+
+// the non-zero states of H for each type of observation fused by NavEKF
+static const struct {
+    const char *name;
+    uint8_t nnz;
+    uint8_t idx[10];
+} observations[] = {
+    { "velocity/position", 1,  { 4 } },
+    { "magnetometer",      10, { 0, 1, 2, 3, 16, 17, 18, 19, 20, 21 } },
+    { "optical flow",      8,  { 0, 1, 2, 3, 4, 5, 6, 9 } },
+    { "airspeed",          5,  { 4, 5, 6, 14, 15 } },
+    { "sideslip",          9,  { 0, 1, 2, 3, 4, 5, 6, 14, 15 } },
+};
+
+static NavEKF::Matrix22 P_start;
+static NavEKF::Matrix22 P_ref;
+static NavEKF::Matrix22 P_new;
+static NavEKF::Matrix22 KH;
+static NavEKF::Matrix22 KHP;
+static NavEKF::Vector22 H;
+static NavEKF::Vector31 K;
+
+// the general form P = P - K*H*P, skipping the zero columns of H
+static void update_reference(uint8_t nnz, const uint8_t *idx)
+{
+    for (uint8_t i = 0; i<=21; i++) {
+        for (uint8_t j = 0; j<=21; j++) {
+            KH[i][j] = K[i] * H[j];
+        }
+    }
+    for (uint8_t i = 0; i<=21; i++) {
+        for (uint8_t j = 0; j<=21; j++) {
+            KHP[i][j] = 0;
+            for (uint8_t k = 0; k<nnz; k++) {
+                KHP[i][j] = KHP[i][j] + KH[i][idx[k]] * P_ref[idx[k]][j];
+            }
+        }
+    }
+    for (uint8_t i = 0; i<=21; i++) {
+        for (uint8_t j = 0; j<=21; j++) {
+            P_ref[i][j] = P_ref[i][j] - KHP[i][j];
+        }
+    }
+}
+
+static void copy_matrix(NavEKF::Matrix22 &dst, const NavEKF::Matrix22 &src)
+{
+    for (uint8_t i = 0; i<=21; i++) {
+        for (uint8_t j = 0; j<=21; j++) {
+            dst[i][j] = src[i][j];
+        }
+    }
+}
+
+// setup routine
+void setup()
+{
+    hal.console->printf("NavEKF covariance update benchmark\n\n");
+
+    // a well conditioned covariance matrix with some correlation
+    for (uint8_t i = 0; i<=21; i++) {
+        for (uint8_t j = 0; j<=21; j++) {
+            P_start[i][j] = (i == j) ? 1.0f + 0.1f*i : 0.01f * cosf(i+j);
+        }
+    }
+}
+
+void loop()
+{
+    float total_ref = 0, total_new = 0;
+
+    for (uint8_t n = 0; n < sizeof(observations)/sizeof(observations[0]); n++) {
+        uint8_t nnz = observations[n].nnz;
+        const uint8_t *idx = observations[n].idx;
+        NavEKF::ftype H_nz[10];
+
+        for (uint8_t j = 0; j<=21; j++) {
+            H[j] = 0;
+        }
+        for (uint8_t k = 0; k<nnz; k++) {
+            H_nz[k] = (nnz == 1) ? 1.0f : 0.5f * sinf(k + 1);
+            H[idx[k]] = H_nz[k];
+        }
+
+        // a small gain, so repeated updates don't collapse P
+        for (uint8_t i = 0; i<31; i++) {
+            K[i] = (i <= 21) ? 0.0005f * cosf(i) : 0;
+        }
+
+        copy_matrix(P_ref, P_start);
+        uint32_t start_time = hal.scheduler->micros();
+        for (uint16_t u = 0; u < NUM_UPDATES; u++) {
+            update_reference(nnz, idx);
+        }
+        uint32_t ref_time = hal.scheduler->micros() - start_time;
+
+        copy_matrix(P_new, P_start);
+        start_time = hal.scheduler->micros();
+        for (uint16_t u = 0; u < NUM_UPDATES; u++) {
+            NavEKF::CovarianceUpdate(P_new, K, H_nz, idx, nnz);
+        }
+        uint32_t new_time = hal.scheduler->micros() - start_time;
+
+        float max_error = 0;
+        for (uint8_t i = 0; i<=21; i++) {
+            for (uint8_t j = 0; j<=21; j++) {
+                max_error = max(max_error, fabsf(P_ref[i][j] - P_new[i][j]));
+            }
+        }
+
+        // fused observations per second
+        unsigned long ref_rate = NUM_UPDATES * 1.0e6f / max(ref_time, (uint32_t)1);
+        unsigned long new_rate = NUM_UPDATES * 1.0e6f / max(new_time, (uint32_t)1);
+        total_ref += ref_time;
+        total_new += new_time;
+        hal.console->printf("%-18s KHP %8lu/s  rank-1 %8lu/s  max difference %g\n",
+                            observations[n].name, ref_rate, new_rate, max_error);
+    }
+
+    hal.console->printf("speedup %.2f\n\n", total_ref / max(total_new, 1.0f));
+
+    hal.scheduler->delay(5000);
+}
+
+#else
+
+void setup()
+{
+    hal.console->printf("NavEKF is not supported on this board\n");
+}
+
+void loop()
+{
+    hal.scheduler->delay(1000);
+}
+
+#endif // HAL_CPU_CLASS
+
+AP_HAL_MAIN();
@@ -853,6 +853,38 @@ void AP_Param::setup_object_defaults(const void *object_pointer, const struct Gr
     }
 }
 
+// copy the scalar values of a group from one object to another object
+// of the same class, such as a second instance of a library that should
+// follow the parameters of the first
+void AP_Param::copy_object_values(void *dst_object, const void *src_object,
+                                  const struct GroupInfo *group_info)
+{
+    uintptr_t dst = (uintptr_t)dst_object;
+    uintptr_t src = (uintptr_t)src_object;
+    uint8_t type;
+    for (uint8_t i=0;
+         (type=PGM_UINT8(&group_info[i].type)) != AP_PARAM_NONE;
+         i++) {
+        uint16_t ofs = PGM_UINT16(&group_info[i].offset);
+        switch (type) {
+        case AP_PARAM_INT8:
+            ((AP_Int8 *)(dst + ofs))->set(((const AP_Int8 *)(src + ofs))->get());
+            break;
+        case AP_PARAM_INT16:
+            ((AP_Int16 *)(dst + ofs))->set(((const AP_Int16 *)(src + ofs))->get());
+            break;
+        case AP_PARAM_INT32:
+            ((AP_Int32 *)(dst + ofs))->set(((const AP_Int32 *)(src + ofs))->get());
+            break;
+        case AP_PARAM_FLOAT:
+            ((AP_Float *)(dst + ofs))->set(((const AP_Float *)(src + ofs))->get());
+            break;
+        default:
+            break;
+        }
+    }
+}
+
 // set a value directly in an object. This should only be used by
 // example code, not by mainline vehicle code
 void AP_Param::set_object_value(const void *object_pointer, 
@@ -209,6 +209,11 @@ public:
     // load default values for scalars in a group
     static void         setup_object_defaults(const void *object_pointer, const struct GroupInfo *group_info);
 
+    // copy the scalar values of a group from one object to another
+    // object of the same class
+    static void         copy_object_values(void *dst_object, const void *src_object,
+                                           const struct GroupInfo *group_info);
+
     // set a value directly in an object. This should only be used by
     // example code, not by mainline vehicle code
     static void set_object_value(const void *object_pointer, 
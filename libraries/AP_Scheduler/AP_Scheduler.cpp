@@ -35,6 +35,15 @@ const AP_Param::GroupInfo AP_Scheduler::var_info[] PROGMEM = {
     // @Values: 0:Disabled,2:ShowSlips,3:ShowOverruns
     // @User: Advanced
     AP_GROUPINFO("DEBUG",    0, AP_Scheduler, _debug, 0),
+
+    // @Param: LOOP_RATE
+    // @DisplayName: Scheduler loop rate
+    // @Description: The main loop rate in Hz. The fast rate loop tasks and the IMU run at this rate, while the other tasks keep running at the rates in the vehicle task table. The loop rate is rounded down to the task table rate times a power of two, up to 8 times the table rate. A value of zero uses the task table rate. The CPU must be fast enough to run the task table at the higher rate, as the time allowed for each task is reduced in proportion.
+    // @Values: 0:Default,50:50Hz,100:100Hz,200:200Hz,400:400Hz
+    // @User: Advanced
+    // @RebootRequired: True
+    AP_GROUPINFO("LOOP_RATE", 1, AP_Scheduler, _loop_rate_hz_param, 0),
+
     AP_GROUPEND
 };
 
@@ -45,7 +54,75 @@ void AP_Scheduler::init(const AP_Scheduler::Task *tasks, uint8_t num_tasks)
     _num_tasks = num_tasks;
     _last_run = new uint16_t[_num_tasks];
     memset(_last_run, 0, sizeof(_last_run[0]) * _num_tasks);
+    _last_trigger = new uint32_t[_num_tasks];
+    memset(_last_trigger, 0, sizeof(_last_trigger[0]) * _num_tasks);
+    _due_task = new uint8_t[_num_tasks];
+    _due_deadline = new int16_t[_num_tasks];
     _tick_counter = 0;
+    _tick_scale = 1;
+    _loop_rate_hz = 0;
+    _num_fast_tasks = 0;
+}
+
+// initialise the scheduler with a rate loop
+void AP_Scheduler::init(const AP_Scheduler::Task *tasks, uint8_t num_tasks,
+                        const AP_Scheduler::Task *fast_tasks, uint8_t num_fast_tasks,
+                        uint16_t table_rate_hz)
+{
+    init(tasks, num_tasks);
+
+    // run the loop at the table rate times a power of two, so that
+    // the task intervals scale exactly and the loop rate is one the
+    // IMU drivers support
+    _loop_rate_hz = table_rate_hz;
+    while (_tick_scale < 8 && _loop_rate_hz*2 <= _loop_rate_hz_param) {
+        _tick_scale *= 2;
+        _loop_rate_hz *= 2;
+    }
+
+    _fast_tasks = fast_tasks;
+    _num_fast_tasks = num_fast_tasks;
+    _fast_last_run = new uint16_t[_num_fast_tasks];
+    memset(_fast_last_run, 0, sizeof(_fast_last_run[0]) * _num_fast_tasks);
+
+    // the latency budget is the sum of the fast task times, which are
+    // given for a tick at the table rate
+    uint32_t budget = 0;
+    for (uint8_t i=0; i<_num_fast_tasks; i++) {
+        budget += _max_time_micros(_fast_tasks[i]);
+    }
+    _fast_budget_usec = budget;
+    reset_fast_stats();
+}
+
+// loop ticks between runs of a task at rate_hz
+uint16_t AP_Scheduler::get_rate_ticks(uint16_t rate_hz) const
+{
+    if (rate_hz == 0 || _loop_rate_hz <= rate_hz) {
+        return 1;
+    }
+    return _loop_rate_hz / rate_hz;
+}
+
+// interval of a task in loop ticks
+uint16_t AP_Scheduler::_interval_ticks(const struct Task &task) const
+{
+    uint16_t interval = pgm_read_word(&task.interval_ticks);
+    if (interval & AP_SCHEDULER_RATE_FLAG) {
+        return get_rate_ticks(interval & ~AP_SCHEDULER_RATE_FLAG);
+    }
+    return interval * _tick_scale;
+}
+
+// time allowed for a task. Table times are for a tick at the table
+// rate, while a task given as a rate has the time of one run
+uint16_t AP_Scheduler::_max_time_micros(const struct Task &task) const
+{
+    uint16_t max_time = pgm_read_word(&task.max_time_micros);
+    if (pgm_read_word(&task.interval_ticks) & AP_SCHEDULER_RATE_FLAG) {
+        return max_time;
+    }
+    return max_time / _tick_scale;
 }
 
 // one tick has passed
@@ -54,64 +131,126 @@ void AP_Scheduler::tick(void)
     _tick_counter++;
 }
 
+/*
+  check if a task is due to run. Periodic tasks are due once their
+  interval has passed, with a deadline of one more interval before
+  they slip. Triggered tasks are due when their trigger has changed
+  and at least their interval has passed, with a deadline of one
+  interval
+ */
+bool AP_Scheduler::_task_due(uint8_t i, int16_t &deadline)
+{
+    uint16_t dt = _tick_counter - _last_run[i];
+    uint16_t interval_ticks = _interval_ticks(_tasks[i]);
+    if (dt < interval_ticks) {
+        return false;
+    }
+
+    int32_t ticks_left;
+    trigger_fn_t trigger;
+    pgm_read_block(&_tasks[i].trigger, &trigger, sizeof(trigger));
+    if (!trigger) {
+        ticks_left = (int32_t)interval_ticks*2 - dt;
+    } else if (trigger() != _last_trigger[i]) {
+        ticks_left = interval_ticks;
+    } else if (dt >= (uint32_t)interval_ticks*TRIGGER_TIMEOUT) {
+        ticks_left = (int32_t)interval_ticks*(TRIGGER_TIMEOUT+1) - dt;
+    } else {
+        return false;
+    }
+
+    if (ticks_left > 32767) {
+        ticks_left = 32767;
+    } else if (ticks_left < -32768) {
+        ticks_left = -32768;
+    }
+    deadline = ticks_left;
+    return true;
+}
+
 /*
   run one tick
-  this will run as many scheduler tasks as we can in the specified time
+  this will run as many scheduler tasks as we can in the specified
+  time, earliest deadline first
  */
 void AP_Scheduler::run(uint16_t time_available)
 {
     uint32_t run_started_usec = hal.scheduler->micros();
     uint32_t now = run_started_usec;
 
+    // build the list of due tasks in deadline order. The insertion
+    // sort is stable, so tasks with the same deadline run in table
+    // order
+    uint8_t num_due = 0;
     for (uint8_t i=0; i<_num_tasks; i++) {
-        uint16_t dt = _tick_counter - _last_run[i];
-        uint16_t interval_ticks = pgm_read_word(&_tasks[i].interval_ticks);
-        if (dt >= interval_ticks) {
-            // this task is due to run. Do we have enough time to run it?
-            _task_time_allowed = pgm_read_word(&_tasks[i].max_time_micros);
-
-            if (dt >= interval_ticks*2) {
-                // we've slipped a whole run of this task!
-                if (_debug > 1) {
-                    hal.console->printf_P(PSTR("Scheduler slip task[%u] (%u/%u/%u)\n"),
+        int16_t deadline;
+        if (!_task_due(i, deadline)) {
+            continue;
+        }
+        uint8_t j = num_due++;
+        while (j > 0 && _due_deadline[j-1] > deadline) {
+            _due_task[j] = _due_task[j-1];
+            _due_deadline[j] = _due_deadline[j-1];
+            j--;
+        }
+        _due_task[j] = i;
+        _due_deadline[j] = deadline;
+    }
+
+    for (uint8_t n=0; n<num_due; n++) {
+        uint8_t i = _due_task[n];
+
+        // this task is due to run. Do we have enough time to run it?
+        _task_time_allowed = _max_time_micros(_tasks[i]);
+
+        if (_due_deadline[n] <= 0) {
+            // we've slipped a whole run of this task!
+            if (_debug > 1) {
+                hal.console->printf_P(PSTR("Scheduler slip task[%u] (%u/%u/%u)\n"),
+                                      (unsigned)i, 
+                                      (unsigned)(uint16_t)(_tick_counter - _last_run[i]),
+                                      (unsigned)_interval_ticks(_tasks[i]),
+                                      (unsigned)_task_time_allowed);
+            }
+        }
+
+        if (_task_time_allowed <= time_available) {
+            // run it
+            _task_time_started = now;
+            task_fn_t func;
+            pgm_read_block(&_tasks[i].function, &func, sizeof(func));
+            trigger_fn_t trigger;
+            pgm_read_block(&_tasks[i].trigger, &trigger, sizeof(trigger));
+            if (trigger) {
+                // note the trigger before running, so data that
+                // arrives while the task runs triggers it again
+                _last_trigger[i] = trigger();
+            }
+            current_task = i;
+            func();
+            current_task = -1;
+
+            // record the tick counter when we ran. This drives
+            // when we next run the event
+            _last_run[i] = _tick_counter;
+
+            // work out how long the event actually took
+            now = hal.scheduler->micros();
+            uint32_t time_taken = now - _task_time_started;
+
+            if (time_taken > _task_time_allowed) {
+                // the event overran!
+                if (_debug > 2) {
+                    hal.console->printf_P(PSTR("Scheduler overrun task[%u] (%u/%u)\n"),
                                           (unsigned)i, 
-                                          (unsigned)dt,
-                                          (unsigned)interval_ticks,
+                                          (unsigned)time_taken,
                                           (unsigned)_task_time_allowed);
                 }
             }
-            
-            if (_task_time_allowed <= time_available) {
-                // run it
-                _task_time_started = now;
-                task_fn_t func;
-                pgm_read_block(&_tasks[i].function, &func, sizeof(func));
-                current_task = i;
-                func();
-                current_task = -1;
-                
-                // record the tick counter when we ran. This drives
-                // when we next run the event
-                _last_run[i] = _tick_counter;
-                
-                // work out how long the event actually took
-                now = hal.scheduler->micros();
-                uint32_t time_taken = now - _task_time_started;
-                
-                if (time_taken > _task_time_allowed) {
-                    // the event overran!
-                    if (_debug > 2) {
-                        hal.console->printf_P(PSTR("Scheduler overrun task[%u] (%u/%u)\n"),
-                                              (unsigned)i, 
-                                              (unsigned)time_taken,
-                                              (unsigned)_task_time_allowed);
-                    }
-                }
-                if (time_taken >= time_available) {
-                    goto update_spare_ticks;
-                }
-                time_available -= time_taken;
+            if (time_taken >= time_available) {
+                goto update_spare_ticks;
             }
+            time_available -= time_taken;
         }
     }
 
@@ -126,6 +265,41 @@ update_spare_ticks:
     }
 }
 
+/*
+  run the fast tasks. These run in order on every tick they are due,
+  however long they take, and the time from the IMU sample to the end
+  of the last task is checked against the latency budget
+ */
+void AP_Scheduler::run_fast(uint32_t sample_time_usec)
+{
+    for (uint8_t i=0; i<_num_fast_tasks; i++) {
+        uint16_t dt = _tick_counter - _fast_last_run[i];
+        uint16_t interval_ticks = _interval_ticks(_fast_tasks[i]);
+        if (dt < interval_ticks) {
+            continue;
+        }
+        _task_time_allowed = _max_time_micros(_fast_tasks[i]);
+        _task_time_started = hal.scheduler->micros();
+        task_fn_t func;
+        pgm_read_block(&_fast_tasks[i].function, &func, sizeof(func));
+        func();
+        _fast_last_run[i] = _tick_counter;
+    }
+
+    uint32_t latency = hal.scheduler->micros() - sample_time_usec;
+    if (latency > _fast_latency_max_usec) {
+        _fast_latency_max_usec = latency > 0xFFFF ? 0xFFFF : latency;
+    }
+    if (latency > _fast_budget_usec) {
+        _fast_overruns++;
+        if (_debug > 2) {
+            hal.console->printf_P(PSTR("Scheduler fast loop overrun (%u/%u)\n"),
+                                  (unsigned)latency,
+                                  (unsigned)_fast_budget_usec);
+        }
+    }
+}
+
 /*
   return number of micros until the current task reaches its deadline
  */
@@ -33,25 +33,63 @@
 
   To run tasks use scheduler.run(), passing the amount of time that
   the scheduler is allowed to use before it must return
+
+  Sketches may also give a table of fast "rate loop" tasks, which are
+  run in order by scheduler.run_fast() on every tick, ahead of the
+  other tasks and without regard to the time available. The main loop
+  can then tick faster than the task table rate (set with the
+  LOOP_RATE parameter) so that the rate loop runs at the IMU rate,
+  while the other tasks keep running at the rates given in the
+  table. The sum of the max_time_micros of the fast tasks is the
+  latency budget from the IMU sample to the end of the rate loop.
+
+  A task may also have a trigger, which returns a value that changes
+  whenever a driver has new data for it (a sample count or a message
+  time, for example). A triggered task runs when the trigger value
+  changes, but not more often than its interval_ticks. If it is not
+  triggered for TRIGGER_TIMEOUT intervals it is run anyway, so the
+  task can notice that the data has stopped. Due tasks are run
+  earliest deadline first in the time available.
+
+  A task that must run at a fixed rate whatever the loop rate, such as
+  an estimator tuned for that rate, gives AP_SCHEDULER_RATE_HZ(hz) as
+  its interval. It runs every get_rate_ticks(hz) loop ticks, so at the
+  loop rate if that is lower, and its max_time_micros is for one run.
  */
 
 #include <AP_HAL.h>
 #include <AP_Vehicle.h>
 
+#define AP_SCHEDULER_RATE_FLAG 0x8000
+#define AP_SCHEDULER_RATE_HZ(hz) (AP_SCHEDULER_RATE_FLAG | (hz))
+
 class AP_Scheduler
 {
 public:
     FUNCTOR_TYPEDEF(task_fn_t, void);
+    FUNCTOR_TYPEDEF(trigger_fn_t, uint32_t);
 
     struct Task {
         task_fn_t function;
         uint16_t interval_ticks;
         uint16_t max_time_micros;
+        trigger_fn_t trigger;
     };
 
+    // number of intervals a triggered task waits for its trigger
+    // before it is run anyway
+    static const uint8_t TRIGGER_TIMEOUT = 10;
+
     // initialise scheduler
     void init(const Task *tasks, uint8_t num_tasks);
 
+    // initialise scheduler with a table of fast tasks. The intervals
+    // in both tables are in ticks at table_rate_hz, and an interval
+    // of zero means every tick at the loop rate
+    void init(const Task *tasks, uint8_t num_tasks,
+              const Task *fast_tasks, uint8_t num_fast_tasks,
+              uint16_t table_rate_hz);
+
     // call when one tick has passed
     void tick(void);
 
@@ -60,6 +98,41 @@ public:
     // tasks in microseconds
     void run(uint16_t time_available);
 
+    // run the fast tasks. Call this once per 'tick', before
+    // run(). sample_time_usec is the time the IMU sample that started
+    // this tick arrived, used to measure the rate loop latency
+    void run_fast(uint32_t sample_time_usec);
+
+    // return the main loop rate in Hz. This is the rate tick()
+    // should be called at, and the rate to sample the IMU at. Zero
+    // if the sketch did not give a table rate to init()
+    uint16_t get_loop_rate_hz(void) const { return _loop_rate_hz; }
+
+    // return the main loop period in microseconds
+    uint32_t get_loop_period_us(void) const {
+        return _loop_rate_hz ? 1000000UL / _loop_rate_hz : 0;
+    }
+
+    // return the number of loop ticks between runs of a task at
+    // rate_hz, at least 1
+    uint16_t get_rate_ticks(uint16_t rate_hz) const;
+
+    // return the latency budget of the fast tasks in microseconds
+    uint16_t get_fast_budget_usec(void) const { return _fast_budget_usec; }
+
+    // return the maximum fast task latency since the last reset
+    uint16_t get_fast_latency_max_usec(void) const { return _fast_latency_max_usec; }
+
+    // return the number of ticks where the fast tasks went over
+    // their latency budget since the last reset
+    uint16_t get_fast_overruns(void) const { return _fast_overruns; }
+
+    // reset the fast task latency statistics
+    void reset_fast_stats(void) {
+        _fast_latency_max_usec = 0;
+        _fast_overruns = 0;
+    }
+
     // return the number of microseconds available for the current task
     uint16_t time_available_usec(void);
 
@@ -80,6 +153,9 @@ private:
     // used to enable scheduler debugging
     AP_Int8 _debug;
 
+    // requested main loop rate in Hz
+    AP_Int16 _loop_rate_hz_param;
+
     // progmem list of tasks to run
     const struct Task *_tasks;
 
@@ -93,9 +169,46 @@ private:
     // tick counter at the time we last ran each task
     uint16_t *_last_run;
 
+    // trigger value at the time we last ran each task
+    uint32_t *_last_trigger;
+
+    // tasks that are due to run this tick, in deadline order
+    uint8_t *_due_task;
+
+    // ticks until the deadline of each due task
+    int16_t *_due_deadline;
+
+    // progmem list of fast tasks to run on every tick
+    const struct Task *_fast_tasks;
+
+    // number of tasks in _fast_tasks list
+    uint8_t _num_fast_tasks;
+
+    // tick counter at the time we last ran each fast task
+    uint16_t *_fast_last_run;
+
+    // main loop rate in Hz
+    uint16_t _loop_rate_hz;
+
+    // number of loop ticks per task table tick
+    uint8_t _tick_scale;
+
+    // latency budget for the fast tasks
+    uint16_t _fast_budget_usec;
+
+    // maximum fast task latency seen
+    uint16_t _fast_latency_max_usec;
+
+    // number of fast task latency budget overruns
+    uint16_t _fast_overruns;
+
     // number of microseconds allowed for the current task
     uint32_t _task_time_allowed;
 
+    // interval in loop ticks and time allowed of a task table entry
+    uint16_t _interval_ticks(const struct Task &task) const;
+    uint16_t _max_time_micros(const struct Task &task) const;
+
     // the time in microseconds when the task started
     uint32_t _task_time_started;
 
@@ -104,6 +217,10 @@ private:
 
     // number of ticks that _spare_micros is counted over
     uint8_t _spare_ticks;
+
+    // check if a task is due to run, and if so how many ticks
+    // there are until its deadline
+    bool _task_due(uint8_t i, int16_t &deadline);
 };
 
 #endif // AP_SCHEDULER_H
@@ -53,6 +53,7 @@ private:
     AP_Scheduler scheduler;
 
     uint32_t ins_counter;
+    static const AP_Scheduler::Task fast_tasks[];
     static const AP_Scheduler::Task scheduler_tasks[];
 
     void ins_update(void);
@@ -64,13 +65,19 @@ static SchedTest schedtest;
 
 #define SCHED_TASK(func) FUNCTOR_BIND(&schedtest, &SchedTest::func, void)
 
+/*
+  rate loop table - run on every tick at the loop rate
+ */
+const AP_Scheduler::Task SchedTest::fast_tasks[] PROGMEM = {
+    { SCHED_TASK(ins_update),             0,   1000 },
+};
+
 /*
   scheduler table - all regular tasks are listed here, along with how
   often they should be called (in 20ms units) and the maximum time
   they are expected to take (in microseconds)
  */
 const AP_Scheduler::Task SchedTest::scheduler_tasks[] PROGMEM = {
-    { SCHED_TASK(ins_update),             1,   1000 },
     { SCHED_TASK(one_hz_print),          50,   1000 },
     { SCHED_TASK(five_second_call),     250,   1800 },
 };
@@ -78,24 +85,34 @@ const AP_Scheduler::Task SchedTest::scheduler_tasks[] PROGMEM = {
 
 void SchedTest::setup(void)
 {
-    // we 
-    ins.init(AP_InertialSensor::COLD_START, 
-			 AP_InertialSensor::RATE_50HZ);
+    // initialise the scheduler, with the task table in 50Hz ticks
+    scheduler.init(&scheduler_tasks[0], sizeof(scheduler_tasks)/sizeof(scheduler_tasks[0]),
+                   &fast_tasks[0], sizeof(fast_tasks)/sizeof(fast_tasks[0]),
+                   50);
 
-    // initialise the scheduler
-    scheduler.init(&scheduler_tasks[0], sizeof(scheduler_tasks)/sizeof(scheduler_tasks[0]));
+    // sample the INS at the loop rate
+    ins.init(AP_InertialSensor::COLD_START, 
+			 (AP_InertialSensor::Sample_rate)scheduler.get_loop_rate_hz());
 }
 
 void SchedTest::loop(void)
 {
     // wait for an INS sample
     ins.wait_for_sample();
+    uint32_t timer = hal.scheduler->micros();
 
     // tell the scheduler one tick has passed
     scheduler.tick();
 
-    // run all tasks that fit in 20ms
-    scheduler.run(20000);
+    // run the rate loop
+    scheduler.run_fast(timer);
+
+    // run all tasks that fit in the rest of the loop period
+    uint32_t remaining = (timer + scheduler.get_loop_period_us()) - hal.scheduler->micros();
+    if (remaining > scheduler.get_loop_period_us()) {
+        remaining = 0;
+    }
+    scheduler.run(remaining);
 }
 
 /*
@@ -112,7 +129,11 @@ void SchedTest::ins_update(void)
  */
 void SchedTest::one_hz_print(void)
 {
-    hal.console->printf("one_hz: t=%lu\n", hal.scheduler->millis());
+    hal.console->printf("one_hz: t=%lu rate loop latency=%u/%u\n",
+                        hal.scheduler->millis(),
+                        (unsigned)scheduler.get_fast_latency_max_usec(),
+                        (unsigned)scheduler.get_fast_budget_usec());
+    scheduler.reset_fast_stats();
 }
 
 /*
@@ -27,6 +27,11 @@
 #define DATAFLASH_NO_CLI
 #endif
 
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+#define DATAFLASH_MAX_LOG_RATES 16
+#define DATAFLASH_REPLAY_LOGGING 1
+#endif
+
 class DataFlash_Class
 {
 public:
@@ -47,8 +52,17 @@ public:
     virtual uint16_t find_last_log(void) = 0;
     virtual void get_log_boundaries(uint16_t log_num, uint16_t & start_page, uint16_t & end_page) = 0;
     virtual void get_log_info(uint16_t log_num, uint32_t &size, uint32_t &time_utc) = 0;
+    // returns the number of bytes read, -1 on error, or
+    // DATAFLASH_LOG_DATA_PENDING if the data is not ready yet and
+    // the call should be retried later
     virtual int16_t get_log_data(uint16_t log_num, uint16_t page, uint32_t offset, uint16_t len, uint8_t *data) = 0;
     virtual uint16_t get_num_logs(void) = 0;
+    // limit the size of each log and of all logs. Zero means no
+    // limit. Only backends with a filesystem support this
+    virtual void set_log_quotas(uint32_t log_max_bytes, uint64_t total_max_bytes) {}
+    // compress finished logs in the background. Downloads are
+    // decompressed. Only backends with a filesystem support this
+    virtual void set_log_compression(bool enable) {}
 #ifndef DATAFLASH_NO_CLI
     virtual void LogReadProcess(uint16_t log_num,
                                 uint16_t start_page, uint16_t end_page, 
@@ -62,7 +76,47 @@ public:
     /* logging methods common to all vehicles */
     uint16_t StartNewLog(void);
     void AddLogFormats(const struct LogStructure *structures, uint8_t num_types);
+
+    /*
+      limit how often periodic messages are written. Each message type
+      in the table is written at most once per interval_ms, and then
+      only on one call in every decimation. Other types are always
+      written
+     */
+#ifdef DATAFLASH_MAX_LOG_RATES
+    void SetLogRates(const struct LogRate *rates, uint8_t num_rates);
+    bool should_write(uint8_t msg_type);
+#else
+    void SetLogRates(const struct LogRate *rates, uint8_t num_rates) {}
+    bool should_write(uint8_t msg_type) { return true; }
+#endif
     void EnableWrites(bool enable) { _writes_enabled = enable; }
+
+    /*
+      replay logging records every sample of the sensors the EKF
+      uses, in full precision and stamped with the time it was
+      received, so Tools/Replay can feed the EKF exactly what it saw
+      in flight. The sensor frontends call the Log_Write_Replay_*
+      functions themselves. It has its own budget of bytes per
+      second, so it can't starve the other messages. Zero disables it
+     */
+#ifdef DATAFLASH_REPLAY_LOGGING
+    void SetReplayLogging(uint32_t bytes_per_second) { _replay.bytes_per_second = bytes_per_second; }
+    bool replay_logging(void) const { return _replay.bytes_per_second != 0 && _writes_enabled && log_write_started; }
+    void Log_Write_Replay_IMU(const AP_InertialSensor &ins);
+    void Log_Write_Replay_GPS(const AP_GPS &gps, uint8_t instance);
+    void Log_Write_Replay_Baro(const AP_Baro &baro, uint8_t instance);
+    void Log_Write_Replay_Compass(const Compass &compass, uint8_t instance);
+    void Log_Write_Replay_Airspeed(AP_Airspeed &airspeed);
+#else
+    void SetReplayLogging(uint32_t bytes_per_second) {}
+    bool replay_logging(void) const { return false; }
+    void Log_Write_Replay_IMU(const AP_InertialSensor &ins) {}
+    void Log_Write_Replay_GPS(const AP_GPS &gps, uint8_t instance) {}
+    void Log_Write_Replay_Baro(const AP_Baro &baro, uint8_t instance) {}
+    void Log_Write_Replay_Compass(const Compass &compass, uint8_t instance) {}
+    void Log_Write_Replay_Airspeed(AP_Airspeed &airspeed) {}
+#endif
     void Log_Write_Format(const struct LogStructure *structure);
     void Log_Write_Parameter(const char *name, float value);
     void Log_Write_GPS(const AP_GPS &gps, uint8_t instance, int32_t relative_alt);
@@ -77,6 +131,20 @@ public:
     void Log_Write_POS(AP_AHRS &ahrs);
 #if AP_AHRS_NAVEKF_AVAILABLE
     void Log_Write_EKF(AP_AHRS_NavEKF &ahrs, bool optFlowEnabled);
+    void Log_Write_EKF_Lanes(const NavEKF_Lanes &lanes);
+    void Log_Write_EKF_Timing(const NavEKF &ekf);
+
+    // the EKF state behind the EKF1 to EKF5 messages at one time
+    struct ekf_snapshot {
+        uint64_t time_us;
+        uint8_t mask;           // bit n set to write EKF(n+1)
+        NavEKF::log_snapshot ekf;
+    };
+
+    // pack the messages selected in snap.mask into buf, which must
+    // hold DATAFLASH_EKF_PACKETS_MAX bytes. Returns the length. This
+    // uses no other state, so any thread may call it
+    static uint16_t Log_Pack_EKF(const struct ekf_snapshot &snap, uint8_t *buf);
 #endif
     void Log_Write_MavCmd(uint16_t cmd_total, const mavlink_mission_item_t& mav_cmd);
     void Log_Write_Radio(const mavlink_radio_t &packet);
@@ -125,11 +193,38 @@ protected:
                              enum ap_var_type type);
     virtual uint16_t start_new_log(void) = 0;
 
+#if AP_AHRS_NAVEKF_AVAILABLE
+    // write the messages for an EKF snapshot. Backends with an IO
+    // thread may pack them there instead
+    virtual void Log_Write_EKF_Snapshot(const struct ekf_snapshot &snap);
+#endif
+
     const struct LogStructure *_structures;
     uint8_t _num_types;
     bool _writes_enabled;
     bool log_write_started;
 
+#ifdef DATAFLASH_MAX_LOG_RATES
+    struct log_rate_state {
+        uint8_t msg_type;
+        uint8_t decimation;
+        uint8_t count;
+        uint16_t interval_ms;
+        uint32_t last_ms;
+    } _log_rates[DATAFLASH_MAX_LOG_RATES];
+    uint8_t _num_log_rates;
+#endif
+
+#ifdef DATAFLASH_REPLAY_LOGGING
+    struct {
+        uint32_t bytes_per_second;
+        uint64_t credit;        // bytes times one million
+        uint64_t last_us;
+        uint32_t dropped;       // messages dropped for lack of budget
+    } _replay;
+    bool replay_budget(uint16_t size);
+#endif
+
     /*
       read a block
     */
@@ -149,6 +244,9 @@ protected:
 #define HEAD_BYTE1  0xA3    // Decimal 163
 #define HEAD_BYTE2  0x95    // Decimal 149
 
+// get_log_data() return when the data is still being read
+#define DATAFLASH_LOG_DATA_PENDING -2
+
 // structure used to define logging format
 struct LogStructure {
     uint8_t msg_type;
@@ -158,6 +256,13 @@ struct LogStructure {
     const char labels[64];
 };
 
+// maximum rate of a periodic message, see SetLogRates()
+struct LogRate {
+    uint8_t msg_type;
+    uint16_t interval_ms;
+    uint8_t decimation;
+};
+
 /*
   log structures common to all vehicle types
  */
@@ -395,6 +500,11 @@ struct PACKED log_EKF5 {
     uint16_t errHAGL;
 };
 
+// room for all of the EKF1 to EKF5 packets
+#define DATAFLASH_EKF_PACKETS_MAX (sizeof(struct log_EKF1) + sizeof(struct log_EKF2) + \
+                                   sizeof(struct log_EKF3) + sizeof(struct log_EKF4) + \
+                                   sizeof(struct log_EKF5))
+
 struct PACKED log_Cmd {
     LOG_PACKET_HEADER;
     uint64_t time_us;
@@ -589,6 +699,116 @@ struct PACKED log_GYRO {
     float GyrX, GyrY, GyrZ;
 };
 
+/*
+  replay logging messages. The time of each sensor message is the time
+  the sample reached the frontend. The instance byte of RIMU holds the
+  instance in its low bits and the LOG_REPLAY_IMU_* flags above them
+ */
+#define LOG_REPLAY_IMU_GYRO_OK      (1U<<4)
+#define LOG_REPLAY_IMU_ACCEL_OK     (1U<<5)
+#define LOG_REPLAY_IMU_DELTA_ANGLE  (1U<<6)
+#define LOG_REPLAY_IMU_DELTA_VEL    (1U<<7)
+
+struct PACKED log_ReplayIMU {
+    LOG_PACKET_HEADER;
+    uint64_t time_us;
+    uint8_t  instance;
+    float    delta_vel_dt;
+    float    delta_ang_x, delta_ang_y, delta_ang_z;
+    float    delta_vel_x, delta_vel_y, delta_vel_z;
+    float    gyro_x, gyro_y, gyro_z;
+    float    accel_x, accel_y, accel_z;
+};
+
+// ends the RIMU messages of one INS update
+struct PACKED log_ReplayFrame {
+    LOG_PACKET_HEADER;
+    uint64_t time_us;
+    float    delta_time;
+    uint32_t dropped;
+};
+
+struct PACKED log_ReplayGPS {
+    LOG_PACKET_HEADER;
+    uint64_t time_us;
+    uint8_t  instance;
+    uint8_t  status;
+    uint8_t  num_sats;
+    uint16_t hdop;
+    uint32_t gps_week_ms;
+    uint16_t gps_week;
+    int32_t  latitude;
+    int32_t  longitude;
+    int32_t  altitude;
+    float    vel_north, vel_east, vel_down;
+    uint8_t  have_vz;
+};
+
+// written just before the RGPS it goes with. Missing accuracies are negative
+struct PACKED log_ReplayGPSAccuracy {
+    LOG_PACKET_HEADER;
+    uint64_t time_us;
+    uint8_t  instance;
+    float    horizontal_accuracy;
+    float    vertical_accuracy;
+    float    speed_accuracy;
+    uint32_t arrival_ms;
+};
+
+struct PACKED log_ReplayBaro {
+    LOG_PACKET_HEADER;
+    uint64_t time_us;
+    uint8_t  instance;
+    float    pressure;
+    float    temperature;
+    float    ground_pressure;
+    float    ground_temperature;
+};
+
+// the field after orientation, offsets and motor compensation
+struct PACKED log_ReplayCompass {
+    LOG_PACKET_HEADER;
+    uint64_t time_us;
+    uint8_t  instance;
+    float    mag_x, mag_y, mag_z;
+};
+
+struct PACKED log_ReplayAirspeed {
+    LOG_PACKET_HEADER;
+    uint64_t time_us;
+    float    airspeed;
+    float    diffpressure;
+    float    temperature;
+    float    EAS2TAS;
+};
+
+// one per EKF lane when EKF_LANES is enabled
+struct PACKED log_EKF_Lane {
+    LOG_PACKET_HEADER;
+    uint64_t time_us;
+    uint8_t  lane;
+    int8_t   imu;
+    uint8_t  active;
+    uint8_t  healthy;
+    float    score;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint32_t avg_us;
+    uint32_t overruns;
+};
+
+// execution time of the EKF update and fusion steps per frame
+struct PACKED log_EKF_Timing {
+    LOG_PACKET_HEADER;
+    uint64_t time_us;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint32_t avg_us;
+    uint8_t  last_steps;
+    uint8_t  max_steps;
+    uint32_t deferrals;
+};
+
 /*
 Format characters in the format string for binary log messages
   b   : int8_t
@@ -732,7 +952,29 @@ Format characters in the format string for binary log messages
     { LOG_IMUDT2_MSG, sizeof(log_IMUDT), \
       "IMT2","Qffffffff","TimeUS,DelT,DelvT,DelAX,DelAY,DelAZ,DelVX,DelVY,DelVZ" }, \
     { LOG_IMUDT3_MSG, sizeof(log_IMUDT), \
-      "IMT3","Qffffffff","TimeUS,DelT,DelvT,DelAX,DelAY,DelAZ,DelVX,DelVY,DelVZ" }
+      "IMT3","Qffffffff","TimeUS,DelT,DelvT,DelAX,DelAY,DelAZ,DelVX,DelVY,DelVZ" }, \
+    { LOG_RIMU_MSG, sizeof(log_ReplayIMU), \
+      "RIMU","QBfffffffffffff","TimeUS,I,DelvT,DAX,DAY,DAZ,DVX,DVY,DVZ,GX,GY,GZ,AX,AY,AZ" }, \
+    { LOG_RFRM_MSG, sizeof(log_ReplayFrame), \
+      "RFRM","QfI","TimeUS,DelT,Drop" }, \
+    { LOG_RGPS_MSG, sizeof(log_ReplayGPS), \
+      "RGPS","QBBBHIHLLefffB","TimeUS,I,Status,NSats,HDop,GMS,GWk,Lat,Lng,Alt,VN,VE,VD,VV" }, \
+    { LOG_RGPA_MSG, sizeof(log_ReplayGPSAccuracy), \
+      "RGPA","QBfffI","TimeUS,I,HAcc,VAcc,SAcc,ArrMS" }, \
+    { LOG_RBAR_MSG, sizeof(log_ReplayBaro), \
+      "RBAR","QBffff","TimeUS,I,Press,Temp,GndPress,GndTemp" }, \
+    { LOG_RMAG_MSG, sizeof(log_ReplayCompass), \
+      "RMAG","QBfff","TimeUS,I,MagX,MagY,MagZ" }, \
+    { LOG_RASP_MSG, sizeof(log_ReplayAirspeed), \
+      "RASP","Qffff","TimeUS,Airspeed,DiffPress,Temp,EAS2TAS" }, \
+    { LOG_EKFL_MSG, sizeof(log_EKF_Lane), \
+      "EKFL","QBbBBfIIII","TimeUS,L,IMU,Act,H,Score,TUS,TMax,TAvg,Ovr" }, \
+    { LOG_EKFT_MSG, sizeof(log_EKF_Timing), \
+      "EKFT","QIIIBBI","TimeUS,TUS,TMax,TAvg,Stp,MStp,Def" }, \
+    { LOG_GPS3_MSG, sizeof(log_GPS2), \
+      "GPS3",  "QBIHBcLLeEefBI", "TimeUS,Status,GMS,GWk,NSats,HDp,Lat,Lng,Alt,Spd,GCrs,VZ,DSc,DAg" }, \
+    { LOG_GPSB_MSG, sizeof(log_GPS2), \
+      "GPSB",  "QBIHBcLLeEefBI", "TimeUS,Status,GMS,GWk,NSats,HDp,Lat,Lng,Alt,Spd,GCrs,VZ,DSc,DAg" }
 
 #if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
 #define LOG_COMMON_STRUCTURES LOG_BASE_STRUCTURES, LOG_EXTRA_STRUCTURES
@@ -802,6 +1044,17 @@ Format characters in the format string for binary log messages
 #define LOG_IMUDT_MSG     184
 #define LOG_IMUDT2_MSG    185
 #define LOG_IMUDT3_MSG    186
+#define LOG_RIMU_MSG      187
+#define LOG_RFRM_MSG      188
+#define LOG_RGPS_MSG      189
+#define LOG_RGPA_MSG      190
+#define LOG_RBAR_MSG      191
+#define LOG_RMAG_MSG      192
+#define LOG_RASP_MSG      193
+#define LOG_EKFL_MSG      194
+#define LOG_EKFT_MSG      195
+#define LOG_GPS3_MSG      196
+#define LOG_GPSB_MSG      197
 
 // message types 200 to 210 reversed for GPS driver use
 // message types 211 to 220 reversed for autotune use
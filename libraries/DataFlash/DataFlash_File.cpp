@@ -25,11 +25,30 @@
 #include <time.h>
 #include <dirent.h>
 #include "../AP_HAL/utility/RingBuffer.h"
+#include "DataFlash_LZ.h"
 
 extern const AP_HAL::HAL& hal;
 
 #define MAX_LOG_FILES 500U
 #define DATAFLASH_PAGE_SIZE 1024UL
+#define READ_AHEAD_BLOCK_SIZE 4096U
+
+/*
+  a compressed log N.BLZ is a header followed by the log in blocks of
+  READ_AHEAD_BLOCK_SIZE bytes. Each block is a 16 bit length then the
+  DataFlash_LZ data, or the raw block if LZ_BLOCK_STORED is set
+ */
+#define LZ_MAGIC 0x315A4C42UL          // "BLZ1"
+#define LZ_BLOCK_STORED 0x8000U
+#define LZ_COMPRESS_INTERVAL_US 10000U // at most one block per interval
+
+struct PACKED lz_header {
+    uint32_t magic;
+    uint32_t size;                     // size of the log
+    uint32_t time_utc;                 // modification time of the log
+    uint16_t block_size;
+    uint16_t reserved;
+};
 
 /*
   constructor
@@ -42,8 +61,6 @@ DataFlash_File::DataFlash_File(const char *log_directory) :
     _initialised(false),
     _open_error(false),
     _log_directory(log_directory),
-    _writebuf(NULL),
-    _writebuf_size(16*1024),
 #if defined(CONFIG_ARCH_BOARD_PX4FMU_V1)
     // V1 gets IO errors with larger than 512 byte writes
     _writebuf_chunk(512),
@@ -62,16 +79,61 @@ DataFlash_File::DataFlash_File(const char *log_directory) :
 #else
     _writebuf_chunk(4096),
 #endif
-    _writebuf_head(0),
-    _writebuf_tail(0),
-    _last_write_time(0)
+    _last_write_time(0),
+    _log_index(NULL),
+    _index_last_log(0),
+    _index_num_logs(0),
+    _write_log_num(0),
+    _log_max_bytes(0),
+    _total_max_bytes(0),
+    _log_full(false),
+    _io_running(false),
+    _write_fd_log_num(0),
+    _log_change(0),
+    _log_change_done(0),
+    _next_log_num(0),
+    _log_start(0),
+    _writebuf_in(0),
+    _writebuf_out(0),
+    _io_requests(0),
+    _lz_enabled(false),
+    _lz_paused(false),
+    _lz_rescan(false),
+    _lz_scan_num(0),
+    _lz_log_num(0),
+    _lz_in_fd(-1),
+    _lz_out_fd(-1),
+    _lz_offset(0),
+    _lz_time_utc(0),
+    _lz_last_us(0),
+    _lz_buf(NULL),
+    _ra_log_num(0),
+    _ra_start_offset(0),
+    _ra_generation(0),
+    _ra_window_start(0),
+    _ra_fd(-1),
+    _ra_fd_log_num(0),
+    _ra_io_generation(0),
+    _ra_next_offset(0),
+    _ra_fill_index(0),
+    _ra_lz(false),
+    _ra_lz_size(0),
+    _ra_lz_pos(0),
+    _ra_lz_block(0)
+#if AP_AHRS_NAVEKF_AVAILABLE
+    ,_ekf_snapshots(4),
+    _ekf_packets(1024),
+    _ekf_drop_pending(false)
+#endif
 #if CONFIG_HAL_BOARD == HAL_BOARD_PX4 || CONFIG_HAL_BOARD == HAL_BOARD_VRBRAIN
     ,_perf_write(perf_alloc(PC_ELAPSED, "DF_write")),
     _perf_fsync(perf_alloc(PC_ELAPSED, "DF_fsync")),
     _perf_errors(perf_alloc(PC_COUNT, "DF_errors")),
     _perf_overruns(perf_alloc(PC_COUNT, "DF_overruns"))
 #endif
-{}
+{
+    memset(_ra_block, 0, sizeof(_ra_block));
+}
 
 
 // initialisation
@@ -105,28 +167,23 @@ void DataFlash_File::Init(const struct LogStructure *structure, uint8_t num_type
         hal.console->printf("Failed to create log directory %s", _log_directory);
         return;
     }
-    if (_writebuf != NULL) {
-        free(_writebuf);
-        _writebuf = NULL;
-    }
 
     /*
       if we can't allocate the full writebuf then try reducing it
       until we can allocate it
      */
-    while (_writebuf == NULL && _writebuf_size >= _writebuf_chunk) {
-        _writebuf = (uint8_t *)malloc(_writebuf_size);
-        if (_writebuf == NULL) {
-            _writebuf_size /= 2;
+    uint32_t bufsize = 16*1024;
+    while (!_writebuf.set_size(bufsize)) {
+        bufsize /= 2;
+        if (bufsize < _writebuf_chunk) {
+            hal.console->printf("Out of memory for logging\n");
+            return;
         }
     }
-    if (_writebuf == NULL) {
-        hal.console->printf("Out of memory for logging\n");
-        return;        
-    }
-    _writebuf_head = _writebuf_tail = 0;
+    _index_build();
     _initialised = true;
     hal.scheduler->register_io_process(FUNCTOR_BIND_MEMBER(&DataFlash_File::_io_timer, void));
+    _io_running = true;
 }
 
 // return true for CardInserted() if we successfully initialised
@@ -144,18 +201,34 @@ bool DataFlash_File::NeedErase(void)
 }
 
 /*
-  construct a log file name given a log number. 
+  construct a log file name given a log number. The extension is BIN
+  for a log, BLZ for a compressed log and TMP while compressing
   Note: Caller must free.
  */
-char *DataFlash_File::_log_file_name(uint16_t log_num)
+char *DataFlash_File::_log_file_name(uint16_t log_num, const char *ext)
 {
     char *buf = NULL;
-    if (asprintf(&buf, "%s/%u.BIN", _log_directory, (unsigned)log_num) == 0) {
+    if (asprintf(&buf, "%s/%u.%s", _log_directory, (unsigned)log_num, ext) == 0) {
         return NULL;
     }
     return buf;
 }
 
+/*
+  delete a log, compressed or not
+ */
+void DataFlash_File::_unlink_log(uint16_t log_num)
+{
+    const char *exts[] = { "BIN", "BLZ", "TMP" };
+    for (uint8_t i=0; i<sizeof(exts)/sizeof(exts[0]); i++) {
+        char *fname = _log_file_name(log_num, exts[i]);
+        if (fname != NULL) {
+            unlink(fname);
+            free(fname);
+        }
+    }
+}
+
 /*
   return path name of the lastlog.txt marker file
   Note: Caller must free.
@@ -175,55 +248,54 @@ void DataFlash_File::EraseAll()
 {
     uint16_t log_num;
     stop_logging();
+    _read_ahead_stop();
+    _lz_pause(true);
     for (log_num=0; log_num<MAX_LOG_FILES; log_num++) {
-        char *fname = _log_file_name(log_num);
-        if (fname == NULL) {
-            break;
-        }
-        unlink(fname);
-        free(fname);
+        _unlink_log(log_num);
     }
+    _lz_pause(false);
     char *fname = _lastlog_file_name();
     if (fname != NULL) {
         unlink(fname);
         free(fname);
     }
+    if (_log_index != NULL) {
+        memset(_log_index, 0, (MAX_LOG_FILES+1)*sizeof(_log_index[0]));
+    }
+    _index_last_log = 0;
+    _index_num_logs = 0;
+    _write_log_num = 0;
 }
 
 /* Write a block of data at current offset */
 void DataFlash_File::WriteBlock(const void *pBuffer, uint16_t size)
 {
-    if (_write_fd == -1 || !_initialised || _open_error || !_writes_enabled) {
+    if (_log_full) {
+        if (_write_fd == -1 &&
+            __atomic_load_n(&_log_change_done, __ATOMIC_ACQUIRE) == _log_change) {
+            // the IO thread has closed the full log. Clearing
+            // log_write_started makes the vehicle start a new one
+            _log_full = false;
+            log_write_started = false;
+        }
         return;
     }
-    uint16_t _head;
-    uint16_t space = BUF_SPACE(_writebuf);
-    if (space < size) {
+    if (!log_write_started || !_initialised || _open_error || !_writes_enabled) {
+        return;
+    }
+    if (_writebuf.space() < size) {
         // discard the whole write, to keep the log consistent
         perf_count(_perf_overruns);
         return;
     }
-
-    if (_writebuf_tail < _head) {
-        // perform as single memcpy
-        assert(_writebuf_tail+size <= _writebuf_size);
-        memcpy(&_writebuf[_writebuf_tail], pBuffer, size);
-        BUF_ADVANCETAIL(_writebuf, size);
-    } else {
-        // perform as two memcpy calls
-        uint16_t n = _writebuf_size - _writebuf_tail;
-        if (n > size) n = size;
-        assert(_writebuf_tail+n <= _writebuf_size);
-        memcpy(&_writebuf[_writebuf_tail], pBuffer, n);
-        BUF_ADVANCETAIL(_writebuf, n);
-        pBuffer = (const void *)(((const uint8_t *)pBuffer) + n);
-        n = size - n;
-        if (n > 0) {
-            assert(_writebuf_tail+n <= _writebuf_size);
-            memcpy(&_writebuf[_writebuf_tail], pBuffer, n);
-            BUF_ADVANCETAIL(_writebuf, n);
-        }
+    if (_log_max_bytes != 0 && (_writebuf_in - _log_start) + size > _log_max_bytes) {
+        // stop here and leave the IO thread to finish off the log
+        _log_full = true;
+        return;
     }
+
+    _writebuf.write((const uint8_t *)pBuffer, size);
+    _writebuf_in += size;
 }
 
 /*
@@ -245,9 +317,9 @@ bool DataFlash_File::ReadBlock(void *pkt, uint16_t size)
 
 
 /*
-  find the highest log number
+  read the highest log number from lastlog.txt
  */
-uint16_t DataFlash_File::find_last_log(void)
+uint16_t DataFlash_File::_read_lastlog(void)
 {
     unsigned ret = 0;
     char *fname = _lastlog_file_name();
@@ -268,35 +340,147 @@ uint16_t DataFlash_File::find_last_log(void)
     return ret;
 }
 
-
-uint32_t DataFlash_File::_get_log_size(uint16_t log_num)
+/*
+  get the size and modification time of a log file
+ */
+bool DataFlash_File::_stat_log(uint16_t log_num, uint32_t &size, uint32_t &time_utc)
 {
+    size = 0;
+    time_utc = 0;
     char *fname = _log_file_name(log_num);
     if (fname == NULL) {
-        return 0;
+        return false;
     }
     struct stat st;
-    if (::stat(fname, &st) != 0) {
+    if (::stat(fname, &st) == 0) {
         free(fname);
-        return 0;
+        size = st.st_size;
+        time_utc = st.st_mtime;
+        return true;
     }
     free(fname);
-    return st.st_size;
-}
 
-uint32_t DataFlash_File::_get_log_time(uint16_t log_num)
-{
-    char *fname = _log_file_name(log_num);
+    // a compressed log has the size and time of the log in its header
+    fname = _log_file_name(log_num, "BLZ");
     if (fname == NULL) {
-        return 0;
+        return false;
     }
-    struct stat st;
-    if (::stat(fname, &st) != 0) {
+    int fd = ::open(fname, O_RDONLY);
+    free(fname);
+    if (fd == -1) {
+        return false;
+    }
+    struct lz_header hdr;
+    bool ok = ::read(fd, &hdr, sizeof(hdr)) == sizeof(hdr) && hdr.magic == LZ_MAGIC;
+    ::close(fd);
+    if (!ok) {
+        return false;
+    }
+    size = hdr.size;
+    time_utc = hdr.time_utc;
+    return true;
+}
+
+/*
+  get the space a log takes on the card, compressed or not
+ */
+uint32_t DataFlash_File::_log_disk_size(uint16_t log_num)
+{
+    const char *exts[] = { "BIN", "BLZ" };
+    for (uint8_t i=0; i<sizeof(exts)/sizeof(exts[0]); i++) {
+        char *fname = _log_file_name(log_num, exts[i]);
+        if (fname == NULL) {
+            return 0;
+        }
+        struct stat st;
+        int ret = ::stat(fname, &st);
         free(fname);
-        return 0;
+        if (ret == 0) {
+            return st.st_size;
+        }
     }
-    free(fname);
-    return st.st_mtime;
+    return 0;
+}
+
+/*
+  build the log index with one pass over the log directory
+ */
+void DataFlash_File::_index_build(void)
+{
+    if (_log_index == NULL) {
+        _log_index = (struct log_index_entry *)malloc((MAX_LOG_FILES+1)*sizeof(_log_index[0]));
+        if (_log_index == NULL) {
+            // fall back to looking at the files each time
+            return;
+        }
+    }
+    memset(_log_index, 0, (MAX_LOG_FILES+1)*sizeof(_log_index[0]));
+    _index_last_log = _read_lastlog();
+    _write_log_num = 0;
+
+    DIR *d = opendir(_log_directory);
+    if (d != NULL) {
+        for (struct dirent *de=readdir(d); de; de=readdir(d)) {
+            unsigned log_num = 0;
+            char ext[5];
+            memset(ext, 0, sizeof(ext));
+            if (sscanf(de->d_name, "%u.%4s", &log_num, ext) != 2 ||
+                (strcasecmp(ext, "BIN") != 0 && strcasecmp(ext, "BLZ") != 0) ||
+                log_num == 0 || log_num > MAX_LOG_FILES) {
+                continue;
+            }
+            _stat_log(log_num, _log_index[log_num].size, _log_index[log_num].time_utc);
+        }
+        closedir(d);
+    }
+    _index_count_logs();
+}
+
+/*
+  count the consecutive non-empty logs ending at the last log
+ */
+void DataFlash_File::_index_count_logs(void)
+{
+    uint16_t ret;
+    uint16_t high = _index_last_log;
+    for (ret=0; ret<high; ret++) {
+        if (_get_log_size(high - ret) == 0) {
+            break;
+        }
+    }
+    _index_num_logs = ret;
+}
+
+/*
+  find the highest log number
+ */
+uint16_t DataFlash_File::find_last_log(void)
+{
+    if (_log_index == NULL) {
+        return _read_lastlog();
+    }
+    return _index_last_log;
+}
+
+
+uint32_t DataFlash_File::_get_log_size(uint16_t log_num)
+{
+    if (_log_index != NULL && log_num <= MAX_LOG_FILES && log_num != _write_log_num) {
+        return _log_index[log_num].size;
+    }
+    uint32_t size, time_utc;
+    _stat_log(log_num, size, time_utc);
+    return size;
+}
+
+uint32_t DataFlash_File::_get_log_time(uint16_t log_num)
+{
+    if (_log_index != NULL && log_num <= MAX_LOG_FILES && log_num != _write_log_num) {
+        return _log_index[log_num].time_utc;
+    }
+    uint32_t size, time_utc;
+    _stat_log(log_num, size, time_utc);
+    return time_utc;
 }
 
 /*
@@ -309,65 +493,104 @@ void DataFlash_File::get_log_boundaries(uint16_t log_num, uint16_t & start_page,
 }
 
 /*
-  find the number of pages in a log
+  restart the read-ahead at the block holding the given offset
+ */
+void DataFlash_File::_read_ahead_start(uint16_t log_num, uint32_t ofs)
+{
+    _ra_log_num = log_num;
+    _ra_start_offset = ofs - (ofs % READ_AHEAD_BLOCK_SIZE);
+    _ra_window_start = _ra_start_offset;
+    __atomic_store_n(&_ra_generation, _ra_generation+1, __ATOMIC_RELEASE);
+}
+
+/*
+  stop the read-ahead, closing its file
+ */
+void DataFlash_File::_read_ahead_stop(void)
+{
+    if (_ra_log_num != 0) {
+        _read_ahead_start(0, 0);
+    }
+}
+
+/*
+  get log data for download, from the read-ahead buffers
  */
 int16_t DataFlash_File::get_log_data(uint16_t log_num, uint16_t page, uint32_t offset, uint16_t len, uint8_t *data)
 {
     if (!_initialised || _open_error) {
         return -1;
     }
-    if (_read_fd != -1 && log_num != _read_fd_log_num) {
-        ::close(_read_fd);
-        _read_fd = -1;
-    }
-    if (_read_fd == -1) {
-        char *fname = _log_file_name(log_num);
-        if (fname == NULL) {
+    if (_ra_block[0].data == NULL) {
+        // allocate the buffers on the first download. They are
+        // never freed, as the IO thread may be using them
+        uint8_t *buf = (uint8_t *)malloc(2*READ_AHEAD_BLOCK_SIZE);
+        if (buf == NULL) {
             return -1;
         }
-        stop_logging();
-        _read_fd = ::open(fname, O_RDONLY);
-        if (_read_fd == -1) {
-            _open_error = true;
-            int saved_errno = errno;
-            ::printf("Log read open fail for %s - %s\n",
-                     fname, strerror(saved_errno));
-            hal.console->printf("Log read open fail for %s - %s\n",
-                                fname, strerror(saved_errno));
-            free(fname);
-            return -1;            
-        }
-        free(fname);
-        _read_offset = 0;
-        _read_fd_log_num = log_num;
+        _ra_block[0].data = buf;
+        _ra_block[1].data = buf + READ_AHEAD_BLOCK_SIZE;
     }
+
     uint32_t ofs = page * (uint32_t)DATAFLASH_PAGE_SIZE + offset;
+    uint32_t generation = _ra_generation;
+    uint16_t copied = 0;
 
-    /*
-      this rather strange bit of code is here to work around a bug
-      in file offsets in NuttX. Every few hundred blocks of reads
-      (starting at around 350k into a file) NuttX will get the
-      wrong offset for sequential reads. The offset it gets is
-      typically 128k earlier than it should be. It turns out that
-      calling lseek() with 0 offset and SEEK_CUR works around the
-      bug. We can remove this once we find the real bug.
-    */
-    if (ofs / 4096 != (ofs+len) / 4096) {
-        off_t seek_current = ::lseek(_read_fd, 0, SEEK_CUR);
-        if (seek_current != (off_t)_read_offset) {
-            ::lseek(_read_fd, _read_offset, SEEK_SET);
-        }
+    if (log_num != _ra_log_num) {
+        _read_ahead_start(log_num, ofs);
+        return DATAFLASH_LOG_DATA_PENDING;
     }
 
-    if (ofs != _read_offset) {
-        ::lseek(_read_fd, ofs, SEEK_SET);
-        _read_offset = ofs;
+    while (copied < len) {
+        uint32_t pos = ofs + copied;
+        struct read_ahead_block *b = NULL;
+        bool eof = false;
+        for (uint8_t i=0; i<2; i++) {
+            struct read_ahead_block &blk = _ra_block[i];
+            if (!__atomic_load_n(&blk.ready, __ATOMIC_ACQUIRE) || blk.generation != generation) {
+                continue;
+            }
+            if (blk.error && pos >= blk.offset) {
+                // the IO thread could not read the log from here
+                return copied > 0 ? copied : -1;
+            }
+            if (pos >= blk.offset && pos < blk.offset + blk.len) {
+                b = &blk;
+                break;
+            }
+            if (blk.len < READ_AHEAD_BLOCK_SIZE && pos >= blk.offset + blk.len) {
+                // a short block is the end of the file
+                eof = true;
+            }
+        }
+        if (b == NULL) {
+            if (eof) {
+                break;
+            }
+            if (pos < _ra_window_start || pos >= _ra_window_start + 2*READ_AHEAD_BLOCK_SIZE) {
+                // not data that is on its way, start again here
+                _read_ahead_start(log_num, pos);
+            }
+            return DATAFLASH_LOG_DATA_PENDING;
+        }
+        uint16_t n = min((uint32_t)(len - copied), b->offset + b->len - pos);
+        memcpy(&data[copied], &b->data[pos - b->offset], n);
+        copied += n;
     }
-    int16_t ret = (int16_t)::read(_read_fd, data, len);
-    if (ret > 0) {
-        _read_offset += ret;
+
+    // hand back whole blocks we have finished with, so the IO
+    // thread can read further ahead
+    for (uint8_t i=0; i<2; i++) {
+        struct read_ahead_block &blk = _ra_block[i];
+        if (__atomic_load_n(&blk.ready, __ATOMIC_ACQUIRE) &&
+            blk.generation == generation &&
+            blk.len == READ_AHEAD_BLOCK_SIZE &&
+            ofs + copied >= blk.offset + blk.len) {
+            _ra_window_start = max(_ra_window_start, blk.offset + blk.len);
+            __atomic_store_n(&blk.ready, false, __ATOMIC_RELEASE);
+        }
     }
-    return ret;
+    return copied;
 }
 
 /*
@@ -375,8 +598,12 @@ int16_t DataFlash_File::get_log_data(uint16_t log_num, uint16_t page, uint32_t o
  */
 void DataFlash_File::get_log_info(uint16_t log_num, uint32_t &size, uint32_t &time_utc)
 {
-    size = _get_log_size(log_num);
-    time_utc = _get_log_time(log_num);
+    if (_log_index != NULL && log_num <= MAX_LOG_FILES && log_num != _write_log_num) {
+        size = _log_index[log_num].size;
+        time_utc = _log_index[log_num].time_utc;
+        return;
+    }
+    _stat_log(log_num, size, time_utc);
 }
 
 
@@ -386,59 +613,161 @@ void DataFlash_File::get_log_info(uint16_t log_num, uint32_t &size, uint32_t &ti
  */
 uint16_t DataFlash_File::get_num_logs(void)
 {
-    uint16_t ret;
-    uint16_t high = find_last_log();
-    for (ret=0; ret<high; ret++) {
-        if (_get_log_size(high - ret) <= 0) {
-            break;
-        }
+    if (_log_index == NULL) {
+        _index_count_logs();
+    } else if (_write_log_num != 0 && _write_log_num == _index_last_log &&
+               _index_num_logs == 0) {
+        // the log being written may have become non-empty
+        _index_count_logs();
     }
-    return ret;
+    return _index_num_logs;
 }
 
 /*
-  stop logging
+  set the maximum size of a log and of all logs, in bytes. Zero
+  means no limit. They take effect from the next start_new_log()
  */
-void DataFlash_File::stop_logging(void)
+void DataFlash_File::set_log_quotas(uint32_t log_max_bytes, uint64_t total_max_bytes)
 {
-    if (_write_fd != -1) {
-        int fd = _write_fd;
-        _write_fd = -1;
-        log_write_started = false;
-        ::close(fd);
+    _log_max_bytes = log_max_bytes;
+    _total_max_bytes = total_max_bytes;
+}
+
+/*
+  set whether finished logs are compressed in the background
+ */
+void DataFlash_File::set_log_compression(bool enable)
+{
+    if (enable && !_lz_enabled) {
+        __atomic_store_n(&_lz_rescan, true, __ATOMIC_RELEASE);
     }
+    _lz_enabled = enable;
 }
 
+/*
+  delete the oldest logs until there is room for a new log within
+  the total quota. The quota is for the space used on the card, so
+  compressed logs count at their compressed size. Called from the IO
+  thread, with no log being compressed
+ */
+void DataFlash_File::_prune_logs(void)
+{
+    if (_total_max_bytes == 0 || _log_index == NULL) {
+        return;
+    }
+    uint64_t total = 0;
+    for (uint16_t i=1; i<=MAX_LOG_FILES; i++) {
+        if (_log_index[i].size != 0) {
+            total += _log_disk_size(i);
+        }
+    }
+    uint64_t limit = 0;
+    if (_total_max_bytes > _log_max_bytes) {
+        limit = _total_max_bytes - _log_max_bytes;
+    }
+
+    // the oldest log is the first one after the last log, allowing
+    // for the log numbers wrapping. The last log, which is the new
+    // one, and the log before it are always kept
+    uint16_t last_log = _index_last_log;
+    for (uint16_t i=1; i<MAX_LOG_FILES-1 && total > limit; i++) {
+        uint16_t log_num = (last_log + i - 1) % MAX_LOG_FILES + 1;
+        if (_log_index[log_num].size == 0) {
+            continue;
+        }
+        uint32_t disk_size = _log_disk_size(log_num);
+        _unlink_log(log_num);
+        total -= min((uint64_t)disk_size, total);
+        _log_index[log_num].size = 0;
+        _log_index[log_num].time_utc = 0;
+    }
+}
 
 /*
-  start writing to a new log file
+  stop logging. The IO thread may be writing to the log, so it is
+  left to close it. EKF snapshots still queued belong to this log, so
+  they are dropped rather than written into the next one
  */
-uint16_t DataFlash_File::start_new_log(void)
+void DataFlash_File::stop_logging(void)
 {
-    stop_logging();
+    log_write_started = false;
+    _request_log_change(0);
+}
 
-    if (_open_error) {
-        // we have previously failed to open a file - don't try again
-        // to prevent us trying to open files while in flight
-        return 0xFFFF;
+/*
+  ask the IO thread to close the log and open log_num, or no log if
+  log_num is zero. This does not wait, see _log_change
+ */
+void DataFlash_File::_request_log_change(uint16_t log_num)
+{
+    __atomic_store_n(&_log_change, _log_change+1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    _next_log_num = log_num;
+    _log_start = _writebuf_in;
+    __atomic_store_n(&_log_change, _log_change+1, __ATOMIC_RELEASE);
+#if AP_AHRS_NAVEKF_AVAILABLE
+    _ekf_drop_pending = true;
+#endif
+    if (!_io_running || hal.scheduler->in_timerprocess()) {
+        // there is no IO thread to race with
+        _io_log_change();
     }
+}
 
-    if (_read_fd != -1) {
-        ::close(_read_fd);
-        _read_fd = -1;
+/*
+  close the old log and open the new one when the main thread has
+  changed the log, called from the IO thread
+ */
+void DataFlash_File::_io_log_change(void)
+{
+    uint32_t change = __atomic_load_n(&_log_change, __ATOMIC_ACQUIRE);
+    if (change == _log_change_done || (change & 1)) {
+        return;
+    }
+    uint16_t log_num = _next_log_num;
+    uint32_t log_start = _log_start;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&_log_change, __ATOMIC_RELAXED) != change) {
+        // changed again as we read it, try on the next tick
+        return;
     }
 
-    uint16_t log_num = find_last_log();
-    // re-use empty logs if possible
-    if (_get_log_size(log_num) > 0 || log_num == 0) {
-        log_num++;
+    _io_close_log();
+
+    // the data before log_start belongs to the old log
+    _writebuf.advance(log_start - _writebuf_out);
+    _writebuf_out = log_start;
+#if AP_AHRS_NAVEKF_AVAILABLE
+    _ekf_snapshots.clear();
+#endif
+
+    if (log_num != 0) {
+        _io_open_log(log_num);
     }
-    if (log_num > MAX_LOG_FILES) {
-        log_num = 1;
+    __atomic_store_n(&_log_change_done, change, __ATOMIC_RELEASE);
+}
+
+/*
+  open a new log, called from the IO thread
+ */
+void DataFlash_File::_io_open_log(uint16_t log_num)
+{
+    if (_open_error) {
+        return;
     }
+
+    // we may be compressing a log we are about to delete or reuse
+    _lz_abandon();
+    _prune_logs();
+
+    // remove any compressed log with the same number
+    _unlink_log(log_num);
     char *fname = _log_file_name(log_num);
-    _write_fd = ::open(fname, O_WRONLY|O_CREAT|O_TRUNC, 0666);
-    if (_write_fd == -1) {
+    if (fname == NULL) {
+        return;
+    }
+    int fd = ::open(fname, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    if (fd == -1) {
         _initialised = false;
         _open_error = true;
         int saved_errno = errno;
@@ -447,20 +776,129 @@ uint16_t DataFlash_File::start_new_log(void)
         hal.console->printf("Log open fail for %s - %s\n",
                             fname, strerror(saved_errno));
         free(fname);
-        return 0xFFFF;
+        return;
     }
     free(fname);
     _write_offset = 0;
-    _writebuf_head = 0;
-    _writebuf_tail = 0;
-    log_write_started = true;
+    _write_fd_log_num = log_num;
+    _write_fd = fd;
 
     // now update lastlog.txt with the new log number
     fname = _lastlog_file_name();
-    FILE *f = ::fopen(fname, "w");
-    fprintf(f, "%u\r\n", (unsigned)log_num);
-    fclose(f);    
-    free(fname);
+    if (fname != NULL) {
+        FILE *f = ::fopen(fname, "w");
+        if (f != NULL) {
+            fprintf(f, "%u\r\n", (unsigned)log_num);
+            fclose(f);
+        }
+        free(fname);
+    }
+
+    // the log that has just finished can be compressed
+    __atomic_store_n(&_lz_rescan, true, __ATOMIC_RELEASE);
+}
+
+/*
+  close the log being written, if any, and fix its index entry.
+  Called from the IO thread
+ */
+void DataFlash_File::_io_close_log(void)
+{
+    if (_write_fd == -1) {
+        return;
+    }
+    ::close(_write_fd);
+    _write_fd = -1;
+    uint16_t log_num = _write_fd_log_num;
+    if (_log_index != NULL && log_num != 0 && log_num <= MAX_LOG_FILES) {
+        _stat_log(log_num, _log_index[log_num].size, _log_index[log_num].time_utc);
+    }
+}
+
+/*
+  ask the IO thread to do something and wait until it is done
+ */
+void DataFlash_File::_io_request(uint8_t request)
+{
+    __atomic_or_fetch(&_io_requests, request, __ATOMIC_ACQ_REL);
+    if (!_io_running || hal.scheduler->in_timerprocess()) {
+        // there is no IO thread to race with
+        _io_handle_requests();
+        return;
+    }
+    uint32_t start_ms = hal.scheduler->millis();
+    while (__atomic_load_n(&_io_requests, __ATOMIC_ACQUIRE) & request) {
+        if (hal.scheduler->millis() - start_ms > 1000) {
+            // the IO thread is not running, so it is safe to do
+            // the request here
+            _io_handle_requests();
+            break;
+        }
+        hal.scheduler->delay_microseconds(500);
+    }
+}
+
+/*
+  do the requests of the main thread, called from the IO thread. A
+  log change made before the requests is done first
+ */
+void DataFlash_File::_io_handle_requests(void)
+{
+    uint8_t requests = __atomic_load_n(&_io_requests, __ATOMIC_ACQUIRE);
+    _io_log_change();
+    if (requests == 0) {
+        return;
+    }
+    if (requests & IO_REQUEST_STOP_COMPRESS) {
+        _lz_abandon();
+    }
+    __atomic_and_fetch(&_io_requests, (uint8_t)~requests, __ATOMIC_ACQ_REL);
+}
+
+
+/*
+  start writing to a new log file. The IO thread opens it, and data
+  written meanwhile is kept for it
+ */
+uint16_t DataFlash_File::start_new_log(void)
+{
+    if (_open_error) {
+        // we have previously failed to open a file - don't try again
+        // to prevent us trying to open files while in flight
+        stop_logging();
+        return 0xFFFF;
+    }
+
+    if (_read_fd != -1) {
+        ::close(_read_fd);
+        _read_fd = -1;
+    }
+    _read_ahead_stop();
+    _log_full = false;
+
+    uint16_t log_num = find_last_log();
+    // re-use empty logs if possible. The IO thread may not have
+    // written out the log we have just finished, so it is never
+    // reused
+    if (log_num == 0 || log_num == _write_log_num || _get_log_size(log_num) > 0) {
+        log_num++;
+    }
+    if (log_num > MAX_LOG_FILES) {
+        log_num = 1;
+    }
+
+    if (_log_index != NULL) {
+        // the IO thread fixes the entry of the previous log when it
+        // closes it
+        _log_index[log_num].size = 0;
+        _log_index[log_num].time_utc = 0;
+        _index_last_log = log_num;
+        _index_num_logs = 0;
+        _write_log_num = log_num;
+    }
+
+    _request_log_change(log_num);
+    log_write_started = true;
 
     return log_num;
 }
@@ -488,6 +926,11 @@ void DataFlash_File::LogReadProcess(uint16_t log_num,
     _read_fd = ::open(fname, O_RDONLY);
     free(fname);
     if (_read_fd == -1) {
+        uint32_t size, time_utc;
+        if (_stat_log(log_num, size, time_utc)) {
+            port->printf_P(PSTR("Log %u is compressed, download it with MAVLink\n"),
+                           (unsigned)log_num);
+        }
         return;
     }
     _read_fd_log_num = log_num;
@@ -576,25 +1019,23 @@ void DataFlash_File::ListAvailableLogs(AP_HAL::BetterStream *port)
 
     for (uint16_t i=num_logs; i>=1; i--) {
         uint16_t log_num = last_log_num - i + 1;
-        off_t size;
+        uint32_t size, time_utc;
 
         char *filename = _log_file_name(log_num);
         if (filename != NULL) {
-            size = _get_log_size(log_num);
+            get_log_info(log_num, size, time_utc);
             if (size != 0) {
-                struct stat st;
-                if (stat(filename, &st) == 0) {
-                    struct tm *tm = gmtime(&st.st_mtime);
-                    port->printf_P(PSTR("Log %u in %s of size %u %u/%u/%u %u:%u\n"), 
-                                   (unsigned)log_num, 
-                                   filename,
-                                   (unsigned)size,
-                                   (unsigned)tm->tm_year+1900,
-                                   (unsigned)tm->tm_mon+1,
-                                   (unsigned)tm->tm_mday,
-                                   (unsigned)tm->tm_hour,
-                                   (unsigned)tm->tm_min);
-                }
+                time_t t = time_utc;
+                struct tm *tm = gmtime(&t);
+                port->printf_P(PSTR("Log %u in %s of size %u %u/%u/%u %u:%u\n"), 
+                               (unsigned)log_num, 
+                               filename,
+                               (unsigned)size,
+                               (unsigned)tm->tm_year+1900,
+                               (unsigned)tm->tm_mon+1,
+                               (unsigned)tm->tm_mday,
+                               (unsigned)tm->tm_hour,
+                               (unsigned)tm->tm_min);
             }
             free(filename);
         }
@@ -605,17 +1046,269 @@ void DataFlash_File::ListAvailableLogs(AP_HAL::BetterStream *port)
 
 void DataFlash_File::_io_timer(void)
 {
-    uint16_t _tail;
+    _io_handle_requests();
+#if AP_AHRS_NAVEKF_AVAILABLE
+    _io_pack_ekf();
+#endif
+    _io_write();
+    _io_read_ahead();
+    _io_compress();
+}
+
+#if AP_AHRS_NAVEKF_AVAILABLE
+/*
+  queue an EKF snapshot for the IO thread to pack, after writing out
+  any messages it has already packed
+ */
+void DataFlash_File::Log_Write_EKF_Snapshot(const struct ekf_snapshot &snap)
+{
+    _write_ekf_packets();
+    if (!_initialised || _ekf_drop_pending || !_ekf_snapshots.push(snap)) {
+        // no IO thread, or it has fallen behind
+        DataFlash_Class::Log_Write_EKF_Snapshot(snap);
+    }
+}
+
+/*
+  copy messages packed by the IO thread into the log
+ */
+void DataFlash_File::_write_ekf_packets(void)
+{
+    if (_ekf_drop_pending) {
+        if (__atomic_load_n(&_log_change_done, __ATOMIC_ACQUIRE) != _log_change) {
+            return;
+        }
+        // the IO thread has dropped the snapshots of the old log, so
+        // it packs no more of them
+        _ekf_packets.clear();
+        _ekf_drop_pending = false;
+    }
+    uint8_t len;
+    while (_ekf_packets.peek(&len, 1) == 1 &&
+           _ekf_packets.available() >= 1U + len) {
+        uint8_t buf[DATAFLASH_EKF_PACKETS_MAX];
+        _ekf_packets.advance(1);
+        _ekf_packets.read(buf, len);
+        WriteBlock(buf, len);
+    }
+}
+
+/*
+  pack queued EKF snapshots, called from the IO thread
+ */
+void DataFlash_File::_io_pack_ekf(void)
+{
+    uint32_t n;
+    const struct ekf_snapshot *snap = _ekf_snapshots.peek(n);
+    while (n > 0) {
+        uint8_t buf[1+DATAFLASH_EKF_PACKETS_MAX];
+        buf[0] = Log_Pack_EKF(*snap, &buf[1]);
+        if (_ekf_packets.space() < 1U + buf[0]) {
+            // wait for the main thread to catch up
+            break;
+        }
+        _ekf_packets.write(buf, 1 + buf[0]);
+        _ekf_snapshots.advance(1);
+        snap = _ekf_snapshots.peek(n);
+    }
+}
+#endif // AP_AHRS_NAVEKF_AVAILABLE
+
+/*
+  read ahead in the log being downloaded, filling the free blocks
+ */
+void DataFlash_File::_io_read_ahead(void)
+{
+    uint32_t generation = __atomic_load_n(&_ra_generation, __ATOMIC_ACQUIRE);
+    if (generation != _ra_io_generation) {
+        // a new request. Drop what we have read and start again
+        _ra_io_generation = generation;
+        __atomic_store_n(&_ra_block[0].ready, false, __ATOMIC_RELEASE);
+        __atomic_store_n(&_ra_block[1].ready, false, __ATOMIC_RELEASE);
+        _ra_fill_index = 0;
+        _ra_next_offset = _ra_start_offset;
+        if (_ra_fd != -1 && _ra_fd_log_num != _ra_log_num) {
+            ::close(_ra_fd);
+            _ra_fd = -1;
+        }
+        if (_ra_fd == -1 && _ra_log_num != 0) {
+            char *fname = _log_file_name(_ra_log_num);
+            if (fname == NULL) {
+                _io_read_ahead_fail(generation);
+                return;
+            }
+            _ra_fd = ::open(fname, O_RDONLY);
+            free(fname);
+            _ra_fd_log_num = _ra_log_num;
+            _ra_lz = false;
+            if (_ra_fd == -1) {
+                // it may have been compressed
+                fname = _log_file_name(_ra_log_num, "BLZ");
+                if (fname != NULL) {
+                    _ra_fd = ::open(fname, O_RDONLY);
+                    free(fname);
+                }
+                struct lz_header hdr;
+                if (_ra_fd != -1 &&
+                    (::read(_ra_fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+                     hdr.magic != LZ_MAGIC ||
+                     hdr.block_size != READ_AHEAD_BLOCK_SIZE ||
+                     !_lz_alloc())) {
+                    ::close(_ra_fd);
+                    _ra_fd = -1;
+                }
+                if (_ra_fd != -1) {
+                    _ra_lz = true;
+                    _ra_lz_size = hdr.size;
+                    _ra_lz_pos = sizeof(hdr);
+                    _ra_lz_block = 0;
+                }
+            }
+            if (_ra_fd == -1) {
+                _io_read_ahead_fail(generation);
+                return;
+            }
+        }
+    }
+    if (_ra_fd == -1 || _ra_log_num == 0) {
+        return;
+    }
+
+    while (!__atomic_load_n(&_ra_block[_ra_fill_index].ready, __ATOMIC_ACQUIRE)) {
+        struct read_ahead_block &blk = _ra_block[_ra_fill_index];
+        ssize_t n = _io_read_block(blk.data);
+        if (n < 0) {
+            _io_read_ahead_fail(generation);
+            return;
+        }
+        blk.offset = _ra_next_offset;
+        blk.len = n;
+        blk.error = false;
+        blk.generation = generation;
+        __atomic_store_n(&blk.ready, true, __ATOMIC_RELEASE);
+        if (n < (ssize_t)READ_AHEAD_BLOCK_SIZE) {
+            // end of file, nothing more to read until restarted
+            return;
+        }
+        _ra_next_offset += n;
+        _ra_fill_index = 1 - _ra_fill_index;
+    }
+}
+
+/*
+  read the block of the log at _ra_next_offset, decompressing it if
+  need be. Returns the length read, which is short at the end of the
+  log, or -1 on error
+ */
+ssize_t DataFlash_File::_io_read_block(uint8_t *data)
+{
+    if (!_ra_lz) {
+        /*
+          seek explicitly on each block, which also avoids the NuttX
+          bug with file offsets on long sequential reads
+         */
+        if (::lseek(_ra_fd, _ra_next_offset, SEEK_SET) != (off_t)_ra_next_offset) {
+            return -1;
+        }
+        return ::read(_ra_fd, data, READ_AHEAD_BLOCK_SIZE);
+    }
+
+    if (_ra_next_offset >= _ra_lz_size) {
+        return 0;
+    }
+    if (!_ra_lz_seek(_ra_next_offset)) {
+        return -1;
+    }
+    uint16_t hdr;
+    if (::lseek(_ra_fd, _ra_lz_pos, SEEK_SET) != (off_t)_ra_lz_pos ||
+        ::read(_ra_fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+        return -1;
+    }
+    uint16_t len = hdr & ~LZ_BLOCK_STORED;
+    uint16_t raw_len = min(_ra_lz_size - _ra_next_offset, READ_AHEAD_BLOCK_SIZE);
+    if (len > READ_AHEAD_BLOCK_SIZE) {
+        return -1;
+    }
+    int32_t n;
+    if (hdr & LZ_BLOCK_STORED) {
+        n = ::read(_ra_fd, data, len);
+    } else {
+        uint8_t *comp = &_lz_buf[READ_AHEAD_BLOCK_SIZE];
+        if (::read(_ra_fd, comp, len) != len) {
+            return -1;
+        }
+        n = DataFlash_LZ::decompress(comp, len, data, READ_AHEAD_BLOCK_SIZE);
+    }
+    if (n != raw_len) {
+        return -1;
+    }
+    _ra_lz_pos += sizeof(hdr) + len;
+    _ra_lz_block++;
+    return n;
+}
+
+/*
+  move to the compressed block holding a log offset by walking the
+  block lengths, from the start if it is behind us
+ */
+bool DataFlash_File::_ra_lz_seek(uint32_t offset)
+{
+    uint32_t block = offset / READ_AHEAD_BLOCK_SIZE;
+    if (block < _ra_lz_block) {
+        _ra_lz_block = 0;
+        _ra_lz_pos = sizeof(struct lz_header);
+    }
+    while (_ra_lz_block < block) {
+        uint16_t hdr;
+        if (::lseek(_ra_fd, _ra_lz_pos, SEEK_SET) != (off_t)_ra_lz_pos ||
+            ::read(_ra_fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+            return false;
+        }
+        _ra_lz_pos += sizeof(hdr) + (hdr & ~LZ_BLOCK_STORED);
+        _ra_lz_block++;
+    }
+    return true;
+}
+
+/*
+  report a read-ahead failure to get_log_data() with an empty error
+  block in place of the next block. The file is closed, so nothing
+  more is read until the main thread restarts the read-ahead
+ */
+void DataFlash_File::_io_read_ahead_fail(uint32_t generation)
+{
+    if (_ra_fd != -1) {
+        ::close(_ra_fd);
+        _ra_fd = -1;
+    }
+    struct read_ahead_block &blk = _ra_block[_ra_fill_index];
+    blk.offset = _ra_next_offset;
+    blk.len = 0;
+    blk.error = true;
+    blk.generation = generation;
+    __atomic_store_n(&blk.ready, true, __ATOMIC_RELEASE);
+}
+
+/*
+  write out buffered log data
+ */
+void DataFlash_File::_io_write(void)
+{
     if (_write_fd == -1 || !_initialised || _open_error) {
         return;
     }
 
-    uint16_t nbytes = BUF_AVAILABLE(_writebuf);
+    uint16_t nbytes = _writebuf.available();
     if (nbytes == 0) {
+        if (_log_full) {
+            // the full log has been flushed, close it so the main
+            // thread can start a new one
+            _io_close_log();
+        }
         return;
     }
     uint32_t tnow = hal.scheduler->micros();
-    if (nbytes < _writebuf_chunk && 
+    if (nbytes < _writebuf_chunk && !_log_full &&
         tnow - _last_write_time < 2000000UL) {
         // write in 512 byte chunks, but always write at least once
         // per 2 seconds if data is available
@@ -629,9 +1322,11 @@ void DataFlash_File::_io_timer(void)
         // be kind to the FAT PX4 filesystem
         nbytes = _writebuf_chunk;
     }
-    if (_writebuf_head > _tail) {
-        // only write to the end of the buffer
-        nbytes = min(nbytes, _writebuf_size - _writebuf_head);
+    // only write to the end of the buffer
+    uint32_t contiguous;
+    const uint8_t *data = _writebuf.peek(contiguous);
+    if (nbytes > contiguous) {
+        nbytes = contiguous;
     }
 
     // try to align writes on a 512 byte boundary to avoid filesystem
@@ -643,8 +1338,7 @@ void DataFlash_File::_io_timer(void)
         }
     }
 
-    assert(_writebuf_head+nbytes <= _writebuf_size);
-    ssize_t nwritten = ::write(_write_fd, &_writebuf[_writebuf_head], nbytes);
+    ssize_t nwritten = ::write(_write_fd, data, nbytes);
     if (nwritten <= 0) {
         perf_count(_perf_errors);
         close(_write_fd);
@@ -658,7 +1352,8 @@ void DataFlash_File::_io_timer(void)
           chunk, ensuring the directory entry is updated after each
           write.
          */
-        BUF_ADVANCEHEAD(_writebuf, nwritten);
+        _writebuf.advance(nwritten);
+        _writebuf_out += nwritten;
 #if CONFIG_HAL_BOARD != HAL_BOARD_SITL && CONFIG_HAL_BOARD_SUBTYPE != HAL_BOARD_SUBTYPE_LINUX_NONE
         ::fsync(_write_fd);
 #endif
@@ -666,5 +1361,245 @@ void DataFlash_File::_io_timer(void)
     perf_end(_perf_write);
 }
 
-#endif // HAL_OS_POSIX_IO
+/*
+  allocate the IO thread scratch space used for compression and for
+  reading compressed logs
+ */
+bool DataFlash_File::_lz_alloc(void)
+{
+    if (_lz_buf == NULL) {
+        _lz_buf = (uint8_t *)malloc(2*READ_AHEAD_BLOCK_SIZE + DATAFLASH_LZ_HASH_SIZE*sizeof(uint16_t));
+    }
+    return _lz_buf != NULL;
+}
 
+/*
+  true if a log may be in use, so should not be compressed now
+ */
+bool DataFlash_File::_lz_skip_log(uint16_t log_num)
+{
+    return (_write_fd != -1 && log_num == _write_fd_log_num) ||
+        log_num == _ra_log_num ||
+        (_ra_fd != -1 && log_num == _ra_fd_log_num) ||
+        (_read_fd != -1 && log_num == _read_fd_log_num);
+}
+
+/*
+  find the next log to compress, looking at a few log numbers per
+  call. A pass over the log numbers is started each time the main
+  thread sets _lz_rescan
+ */
+bool DataFlash_File::_lz_next_log(void)
+{
+    if (_lz_scan_num == 0 &&
+        !__atomic_exchange_n(&_lz_rescan, false, __ATOMIC_ACQ_REL)) {
+        return false;
+    }
+    for (uint8_t i=0; i<8; i++) {
+        _lz_scan_num++;
+        if (_lz_scan_num > MAX_LOG_FILES) {
+            _lz_scan_num = 0;
+            return false;
+        }
+        if (!_lz_skip_log(_lz_scan_num) && _lz_start(_lz_scan_num)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+  start compressing a log, if it exists and is not empty
+ */
+bool DataFlash_File::_lz_start(uint16_t log_num)
+{
+    char *fname = _log_file_name(log_num);
+    if (fname == NULL) {
+        return false;
+    }
+    int in_fd = ::open(fname, O_RDONLY);
+    free(fname);
+    if (in_fd == -1) {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(in_fd, &st) != 0 || st.st_size == 0 || !_lz_alloc()) {
+        ::close(in_fd);
+        return false;
+    }
+    fname = _log_file_name(log_num, "TMP");
+    if (fname == NULL) {
+        ::close(in_fd);
+        return false;
+    }
+    int out_fd = ::open(fname, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    free(fname);
+    if (out_fd == -1) {
+        ::close(in_fd);
+        return false;
+    }
+    // the header is written when the log is done
+    struct lz_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    if (::write(out_fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+        ::close(in_fd);
+        ::close(out_fd);
+        return false;
+    }
+    _lz_in_fd = in_fd;
+    _lz_out_fd = out_fd;
+    _lz_log_num = log_num;
+    _lz_offset = 0;
+    _lz_time_utc = st.st_mtime;
+    return true;
+}
+
+/*
+  compress the next block of a finished log, called from the IO
+  thread. This only runs when the log being written has been
+  flushed, and at most every LZ_COMPRESS_INTERVAL_US
+ */
+void DataFlash_File::_io_compress(void)
+{
+    if (!_lz_enabled || _open_error) {
+        if (_lz_log_num != 0) {
+            _lz_abandon();
+        }
+        return;
+    }
+    if (__atomic_load_n(&_lz_paused, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    if (_lz_log_num != 0 && _lz_skip_log(_lz_log_num)) {
+        // it is being downloaded. Start again later
+        _lz_abandon();
+        __atomic_store_n(&_lz_rescan, true, __ATOMIC_RELEASE);
+        return;
+    }
+    uint32_t now = hal.scheduler->micros();
+    if (now - _lz_last_us < LZ_COMPRESS_INTERVAL_US ||
+        _writebuf.available() >= _writebuf_chunk) {
+        return;
+    }
+    _lz_last_us = now;
+    if (_lz_log_num == 0 && !_lz_next_log()) {
+        return;
+    }
+
+    uint8_t *raw = _lz_buf;
+    uint8_t *comp = &_lz_buf[READ_AHEAD_BLOCK_SIZE];
+    uint16_t *table = (uint16_t *)&_lz_buf[2*READ_AHEAD_BLOCK_SIZE];
+    if (::lseek(_lz_in_fd, _lz_offset, SEEK_SET) != (off_t)_lz_offset) {
+        _lz_abandon();
+        return;
+    }
+    ssize_t n = ::read(_lz_in_fd, raw, READ_AHEAD_BLOCK_SIZE);
+    if (n < 0) {
+        _lz_abandon();
+        return;
+    }
+    if (n == 0) {
+        _lz_finish();
+        return;
+    }
+
+    // blocks that don't compress are stored as they are
+    uint16_t len = DataFlash_LZ::compress(raw, n, comp, n-1, table);
+    uint16_t hdr = len;
+    const uint8_t *data = comp;
+    if (len == 0) {
+        len = n;
+        hdr = len | LZ_BLOCK_STORED;
+        data = raw;
+    }
+    if (::write(_lz_out_fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+        ::write(_lz_out_fd, data, len) != len) {
+        _lz_abandon();
+        return;
+    }
+    _lz_offset += n;
+    if (n < (ssize_t)READ_AHEAD_BLOCK_SIZE) {
+        _lz_finish();
+    }
+}
+
+/*
+  finish compressing a log, replacing N.BIN with N.BLZ
+ */
+void DataFlash_File::_lz_finish(void)
+{
+    struct lz_header hdr;
+    hdr.magic = LZ_MAGIC;
+    hdr.size = _lz_offset;
+    hdr.time_utc = _lz_time_utc;
+    hdr.block_size = READ_AHEAD_BLOCK_SIZE;
+    hdr.reserved = 0;
+    if (::lseek(_lz_out_fd, 0, SEEK_SET) != 0 ||
+        ::write(_lz_out_fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+        ::fsync(_lz_out_fd) != 0) {
+        _lz_abandon();
+        return;
+    }
+    ::close(_lz_in_fd);
+    ::close(_lz_out_fd);
+    _lz_in_fd = -1;
+    _lz_out_fd = -1;
+
+    char *tmp_name = _log_file_name(_lz_log_num, "TMP");
+    char *lz_name = _log_file_name(_lz_log_num, "BLZ");
+    char *bin_name = _log_file_name(_lz_log_num);
+    if (tmp_name != NULL && lz_name != NULL && bin_name != NULL) {
+        // there is always a BIN or a BLZ file, and _stat_log()
+        // prefers the BIN file while there are both. A BLZ file left
+        // by an earlier attempt is replaced, as FAT rename() won't
+        ::unlink(lz_name);
+        if (::rename(tmp_name, lz_name) == 0) {
+            ::unlink(bin_name);
+        } else {
+            ::unlink(tmp_name);
+        }
+    }
+    free(tmp_name);
+    free(lz_name);
+    free(bin_name);
+    _lz_log_num = 0;
+}
+
+/*
+  stop compressing a log, leaving it as it was
+ */
+void DataFlash_File::_lz_abandon(void)
+{
+    if (_lz_in_fd != -1) {
+        ::close(_lz_in_fd);
+        _lz_in_fd = -1;
+    }
+    if (_lz_out_fd != -1) {
+        ::close(_lz_out_fd);
+        _lz_out_fd = -1;
+    }
+    if (_lz_log_num != 0) {
+        char *fname = _log_file_name(_lz_log_num, "TMP");
+        if (fname != NULL) {
+            ::unlink(fname);
+            free(fname);
+        }
+        _lz_log_num = 0;
+    }
+}
+
+/*
+  pause compression while the main thread deletes logs
+ */
+void DataFlash_File::_lz_pause(bool pause)
+{
+    if (pause) {
+        __atomic_store_n(&_lz_paused, true, __ATOMIC_RELEASE);
+        _io_request(IO_REQUEST_STOP_COMPRESS);
+    } else {
+        __atomic_store_n(&_lz_paused, false, __ATOMIC_RELEASE);
+        __atomic_store_n(&_lz_rescan, true, __ATOMIC_RELEASE);
+    }
+}
+
+#endif // HAL_OS_POSIX_IO
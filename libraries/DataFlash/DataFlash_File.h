@@ -18,6 +18,8 @@
 #define perf_count(x)
 #endif
 
+#include "../AP_HAL/utility/RingBuffer.h"
+
 
 class DataFlash_File : public DataFlash_Class
 {
@@ -43,6 +45,8 @@ public:
     int16_t get_log_data(uint16_t log_num, uint16_t page, uint32_t offset, uint16_t len, uint8_t *data);
     uint16_t get_num_logs(void);
     uint16_t start_new_log(void);
+    void set_log_quotas(uint32_t log_max_bytes, uint64_t total_max_bytes);
+    void set_log_compression(bool enable);
     void LogReadProcess(uint16_t log_num,
                         uint16_t start_page, uint16_t end_page, 
                         print_mode_fn print_mode,
@@ -51,6 +55,11 @@ public:
     void ShowDeviceInfo(AP_HAL::BetterStream *port);
     void ListAvailableLogs(AP_HAL::BetterStream *port);
 
+protected:
+#if AP_AHRS_NAVEKF_AVAILABLE
+    void Log_Write_EKF_Snapshot(const struct ekf_snapshot &snap);
+#endif
+
 private:
     int _write_fd;
     int _read_fd;
@@ -67,22 +76,199 @@ private:
     bool ReadBlock(void *pkt, uint16_t size);
 
     // write buffer
-    uint8_t *_writebuf;
-    uint16_t _writebuf_size;
+    ByteBuffer _writebuf;
     const uint16_t _writebuf_chunk;
-    volatile uint16_t _writebuf_head;
-    volatile uint16_t _writebuf_tail;
     uint32_t _last_write_time;
 
     /* construct a file name given a log number. Caller must free. */
-    char *_log_file_name(uint16_t log_num);
+    char *_log_file_name(uint16_t log_num, const char *ext="BIN");
     char *_lastlog_file_name(void);
     uint32_t _get_log_size(uint16_t log_num);
     uint32_t _get_log_time(uint16_t log_num);
+    bool _stat_log(uint16_t log_num, uint32_t &size, uint32_t &time_utc);
+    uint32_t _log_disk_size(uint16_t log_num);
+    void _unlink_log(uint16_t log_num);
+    uint16_t _read_lastlog(void);
+
+    /*
+      index of the log directory, so listing logs and starting a new
+      one don't need a stat() per log. It is built by scanning the
+      directory in Init() and kept up to date as logs are started and
+      erased. The log being written is still stat'ed as it grows
+     */
+    struct log_index_entry {
+        uint32_t size;
+        uint32_t time_utc;
+    };
+    struct log_index_entry *_log_index;
+    uint16_t _index_last_log;
+    uint16_t _index_num_logs;
+    uint16_t _write_log_num;
+
+    void _index_build(void);
+    void _index_count_logs(void);
+
+    // log size quotas, see set_log_quotas()
+    uint32_t _log_max_bytes;
+    uint64_t _total_max_bytes;
+
+    // set by the main thread when the log has reached _log_max_bytes.
+    // The IO thread then flushes and closes it
+    volatile bool _log_full;
+
+    void _prune_logs(void);
 
     void stop_logging(void);
 
     void _io_timer(void);
+    void _io_write(void);
+
+    // true once the IO thread has been registered
+    bool _io_running;
+
+    // log number of _write_fd, set before _write_fd for the IO thread
+    uint16_t _write_fd_log_num;
+
+    /*
+      starting and stopping logs. The main thread never waits for the
+      IO thread: it sets the log to open (zero for none) and the
+      position in _writebuf where the data for it starts, between two
+      increments of _log_change. On its next tick the IO thread closes
+      the old log, discards what is left of it, prunes old logs and
+      opens the new one, then copies _log_change to _log_change_done.
+      It ignores the fields while _log_change is odd or changes as it
+      reads them. Bytes in and out of _writebuf are counted to find
+      the start of the new log
+     */
+    uint32_t _log_change;
+    uint32_t _log_change_done;
+    uint16_t _next_log_num;
+    uint32_t _log_start;
+    uint32_t _writebuf_in;
+    uint32_t _writebuf_out;
+
+    void _request_log_change(uint16_t log_num);
+    void _io_log_change(void);
+    void _io_open_log(uint16_t log_num);
+    void _io_close_log(void);
+
+    /*
+      requests from the main thread to the IO thread, used when the
+      vehicle is not flying. The main thread sets a bit and waits
+      until the IO thread has done the request and cleared it, so
+      the files used by the IO thread are only ever closed by the IO
+      thread
+     */
+    enum io_request {
+        IO_REQUEST_STOP_COMPRESS  = 1,  // abandon the log being compressed
+    };
+    uint8_t _io_requests;
+
+    void _io_request(uint8_t request);
+    void _io_handle_requests(void);
+
+    /*
+      background compression. When enabled the IO thread compresses
+      finished logs one block at a time into N.BLZ, deleting N.BIN
+      when done. The log being written or downloaded is left
+      alone. The main thread pauses compression while it deletes
+      logs, and sets _lz_rescan when there may be a new log to
+      compress
+     */
+    bool _lz_enabled;
+    bool _lz_paused;
+    bool _lz_rescan;
+    uint16_t _lz_scan_num;
+    uint16_t _lz_log_num;
+    int _lz_in_fd;
+    int _lz_out_fd;
+    uint32_t _lz_offset;
+    uint32_t _lz_time_utc;
+    uint32_t _lz_last_us;
+
+    // IO thread scratch space for a raw block, a compressed block and
+    // the compressor hash table
+    uint8_t *_lz_buf;
+
+    bool _lz_alloc(void);
+    void _io_compress(void);
+    bool _lz_next_log(void);
+    bool _lz_skip_log(uint16_t log_num);
+    bool _lz_start(uint16_t log_num);
+    void _lz_finish(void);
+    void _lz_abandon(void);
+    void _lz_pause(bool pause);
+
+    /*
+      log download read-ahead. The IO thread reads the log being
+      downloaded in large blocks into a pair of buffers, using its
+      own file descriptor, so get_log_data() can be served from
+      memory without stopping logging. A block is owned by the IO
+      thread until it sets ready, and by the main thread until it
+      clears it again. The main thread restarts the read-ahead by
+      changing _ra_generation. If the log cannot be read the IO
+      thread publishes an empty block with error set
+     */
+    struct read_ahead_block {
+        uint8_t *data;
+        uint32_t offset;
+        uint16_t len;
+        uint32_t generation;
+        bool error;
+        bool ready;
+    } _ra_block[2];
+
+    // set by the main thread to request a log and start offset
+    uint16_t _ra_log_num;
+    uint32_t _ra_start_offset;
+    uint32_t _ra_generation;
+
+    // main thread state. Data from _ra_window_start on is still to
+    // come from the IO thread
+    uint32_t _ra_window_start;
+
+    // IO thread state
+    int _ra_fd;
+    uint16_t _ra_fd_log_num;
+    uint32_t _ra_io_generation;
+    uint32_t _ra_next_offset;
+    uint8_t _ra_fill_index;
+
+    // read-ahead state for a compressed log: the log size, and the
+    // file position and number of the next block
+    bool _ra_lz;
+    uint32_t _ra_lz_size;
+    uint32_t _ra_lz_pos;
+    uint32_t _ra_lz_block;
+
+    ssize_t _io_read_block(uint8_t *data);
+    bool _ra_lz_seek(uint32_t offset);
+
+    void _read_ahead_start(uint16_t log_num, uint32_t ofs);
+    void _read_ahead_stop(void);
+    void _io_read_ahead(void);
+    void _io_read_ahead_fail(uint32_t generation);
+
+#if AP_AHRS_NAVEKF_AVAILABLE
+    /*
+      EKF snapshots are packed into messages by the IO thread. The
+      main thread queues snapshots in _ekf_snapshots and copies the
+      packed messages from _ekf_packets into the log on its next
+      call, so they land in the log a little after messages written
+      at the same time. Each set of messages in _ekf_packets is
+      preceded by a length byte
+     */
+    ObjectBuffer<struct ekf_snapshot> _ekf_snapshots;
+    ByteBuffer _ekf_packets;
+
+    // set when the log changes, until the IO thread has dropped the
+    // snapshots of the old log. Snapshots are written directly
+    // meanwhile
+    bool _ekf_drop_pending;
+
+    void _write_ekf_packets(void);
+    void _io_pack_ekf(void);
+#endif
 
 #if CONFIG_HAL_BOARD == HAL_BOARD_PX4 || CONFIG_HAL_BOARD == HAL_BOARD_VRBRAIN
     // performance counters
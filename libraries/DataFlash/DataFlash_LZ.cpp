@@ -0,0 +1,178 @@
+/// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+
+/*
+  LZ77 block compression for DataFlash logs, see DataFlash_LZ.h
+ */
+
+#include "DataFlash_LZ.h"
+#include <string.h>
+
+#define LZ_MIN_MATCH 4
+
+static inline uint32_t read32(const uint8_t *p)
+{
+    return p[0] | (p[1]<<8) | (p[2]<<16) | ((uint32_t)p[3]<<24);
+}
+
+static inline uint16_t lz_hash(uint32_t v)
+{
+    return (v * 2654435761U) >> 22;
+}
+
+/*
+  write a length as extra bytes after a token nibble of 15. Returns
+  false if there is no room
+ */
+static bool write_length(uint8_t *dst, uint16_t dst_max, uint16_t &op, uint16_t len)
+{
+    while (len >= 255) {
+        if (op >= dst_max) {
+            return false;
+        }
+        dst[op++] = 255;
+        len -= 255;
+    }
+    if (op >= dst_max) {
+        return false;
+    }
+    dst[op++] = len;
+    return true;
+}
+
+/*
+  write a sequence of literals followed by a match. A match length of
+  zero writes the final sequence of a block
+ */
+static bool write_sequence(uint8_t *dst, uint16_t dst_max, uint16_t &op,
+                           const uint8_t *literals, uint16_t num_literals,
+                           uint16_t offset, uint16_t match_len)
+{
+    if (op >= dst_max) {
+        return false;
+    }
+    uint16_t token_pos = op++;
+    uint8_t token = (num_literals >= 15 ? 15 : num_literals) << 4;
+    if (num_literals >= 15 && !write_length(dst, dst_max, op, num_literals - 15)) {
+        return false;
+    }
+    if ((uint32_t)op + num_literals > dst_max) {
+        return false;
+    }
+    memcpy(&dst[op], literals, num_literals);
+    op += num_literals;
+
+    if (match_len != 0) {
+        if ((uint32_t)op + 2 > dst_max) {
+            return false;
+        }
+        dst[op++] = offset & 0xFF;
+        dst[op++] = offset >> 8;
+        uint16_t extra = match_len - LZ_MIN_MATCH;
+        token |= (extra >= 15 ? 15 : extra);
+        if (extra >= 15 && !write_length(dst, dst_max, op, extra - 15)) {
+            return false;
+        }
+    }
+    dst[token_pos] = token;
+    return true;
+}
+
+uint16_t DataFlash_LZ::compress(const uint8_t *src, uint16_t len,
+                                uint8_t *dst, uint16_t dst_max,
+                                uint16_t *table)
+{
+    // table entries are positions plus one, so zero is empty
+    memset(table, 0, DATAFLASH_LZ_HASH_SIZE * sizeof(table[0]));
+
+    uint16_t op = 0;
+    uint16_t anchor = 0;
+    uint16_t ip = 0;
+    while ((uint32_t)ip + LZ_MIN_MATCH <= len) {
+        uint32_t v = read32(&src[ip]);
+        uint16_t h = lz_hash(v);
+        uint16_t ref = table[h];
+        table[h] = ip + 1;
+        if (ref == 0 || read32(&src[ref-1]) != v) {
+            ip++;
+            continue;
+        }
+        ref--;
+        uint16_t match_len = LZ_MIN_MATCH;
+        while (ip + match_len < len && src[ref + match_len] == src[ip + match_len]) {
+            match_len++;
+        }
+        if (!write_sequence(dst, dst_max, op, &src[anchor], ip - anchor, ip - ref, match_len)) {
+            return 0;
+        }
+        ip += match_len;
+        anchor = ip;
+    }
+
+    if (!write_sequence(dst, dst_max, op, &src[anchor], len - anchor, 0, 0)) {
+        return 0;
+    }
+    return op;
+}
+
+/*
+  read extra length bytes. Returns false if the block ends first
+ */
+static bool read_length(const uint8_t *src, uint16_t len, uint16_t &ip, uint32_t &length)
+{
+    uint8_t b;
+    do {
+        if (ip >= len) {
+            return false;
+        }
+        b = src[ip++];
+        length += b;
+    } while (b == 255);
+    return true;
+}
+
+int32_t DataFlash_LZ::decompress(const uint8_t *src, uint16_t len,
+                                 uint8_t *dst, uint16_t dst_max)
+{
+    uint16_t ip = 0;
+    uint32_t op = 0;
+    while (ip < len) {
+        uint8_t token = src[ip++];
+
+        uint32_t num_literals = token >> 4;
+        if (num_literals == 15 && !read_length(src, len, ip, num_literals)) {
+            return -1;
+        }
+        if (ip + num_literals > len || op + num_literals > dst_max) {
+            return -1;
+        }
+        memcpy(&dst[op], &src[ip], num_literals);
+        ip += num_literals;
+        op += num_literals;
+
+        if (ip == len) {
+            // the final sequence has no match
+            break;
+        }
+
+        if ((uint32_t)ip + 2 > len) {
+            return -1;
+        }
+        uint16_t offset = src[ip] | (src[ip+1]<<8);
+        ip += 2;
+        uint32_t match_len = token & 0x0F;
+        if (match_len == 15 && !read_length(src, len, ip, match_len)) {
+            return -1;
+        }
+        match_len += LZ_MIN_MATCH;
+        if (offset == 0 || offset > op || op + match_len > dst_max) {
+            return -1;
+        }
+        // byte at a time, as a match may overlap its own output
+        const uint8_t *ref = &dst[op - offset];
+        for (uint32_t i=0; i<match_len; i++) {
+            dst[op + i] = ref[i];
+        }
+        op += match_len;
+    }
+    return op;
+}
@@ -0,0 +1,42 @@
+/// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+  A small LZ77 block compressor for DataFlash logs
+
+  The sequences are those of the LZ4 block format: a token with the
+  literal count in the top four bits and the match length less 4 in
+  the bottom four, then any extra literal count bytes, the literals,
+  a 16 bit little-endian match offset and any extra match length
+  bytes. A block ends with a sequence of literals only, but without
+  LZ4's minimum number of literals at the end.
+
+  Logs are sequences of fixed-size records with few fields changing
+  between records of the same type, so a simple greedy search with a
+  small hash table finds most of the redundancy.
+ */
+
+#ifndef DATAFLASH_LZ_H
+#define DATAFLASH_LZ_H
+
+#include <stdint.h>
+
+// number of entries in the hash table passed to compress()
+#define DATAFLASH_LZ_HASH_SIZE 1024U
+
+class DataFlash_LZ
+{
+public:
+    // compress len bytes from src into dst. table is scratch space
+    // of DATAFLASH_LZ_HASH_SIZE entries. Returns the compressed
+    // length, or 0 if it would be more than dst_max bytes
+    static uint16_t compress(const uint8_t *src, uint16_t len,
+                             uint8_t *dst, uint16_t dst_max,
+                             uint16_t *table);
+
+    // decompress a block of len bytes from src into dst. Returns the
+    // decompressed length, or -1 if the block is corrupt or would
+    // decompress to more than dst_max bytes
+    static int32_t decompress(const uint8_t *src, uint16_t len,
+                              uint8_t *dst, uint16_t dst_max);
+};
+
+#endif // DATAFLASH_LZ_H
@@ -17,7 +17,70 @@ void DataFlash_Class::Init(const struct LogStructure *structure, uint8_t num_typ
     _num_types = num_types;
     _structures = structure;
     _writes_enabled = true;
+#ifdef DATAFLASH_MAX_LOG_RATES
+    _num_log_rates = 0;
+#endif
+#ifdef DATAFLASH_REPLAY_LOGGING
+    memset(&_replay, 0, sizeof(_replay));
+#endif
+}
+
+#ifdef DATAFLASH_MAX_LOG_RATES
+/*
+  set the table of message rates, replacing any earlier table
+ */
+void DataFlash_Class::SetLogRates(const struct LogRate *rates, uint8_t num_rates)
+{
+    if (num_rates > DATAFLASH_MAX_LOG_RATES) {
+        num_rates = DATAFLASH_MAX_LOG_RATES;
+    }
+    for (uint8_t i=0; i<num_rates; i++) {
+        _log_rates[i].msg_type = rates[i].msg_type;
+        _log_rates[i].interval_ms = rates[i].interval_ms;
+        _log_rates[i].decimation = rates[i].decimation;
+        _log_rates[i].count = 0;
+        _log_rates[i].last_ms = 0;
+    }
+    _num_log_rates = num_rates;
+}
+
+/*
+  return true if a message of this type is due. The time of the last
+  write is advanced by whole intervals so the rate holds on average
+  when the caller runs at a multiple of it, with an eighth of an
+  interval allowed for scheduling jitter
+ */
+bool DataFlash_Class::should_write(uint8_t msg_type)
+{
+    for (uint8_t i=0; i<_num_log_rates; i++) {
+        struct log_rate_state &r = _log_rates[i];
+        if (r.msg_type != msg_type) {
+            continue;
+        }
+        if (r.interval_ms != 0) {
+            uint32_t now = hal.scheduler->millis();
+            uint32_t elapsed = now - r.last_ms;
+            if (elapsed + r.interval_ms/8 < r.interval_ms) {
+                return false;
+            }
+            if (elapsed >= 2*(uint32_t)r.interval_ms) {
+                // start again after a gap
+                r.last_ms = now;
+            } else {
+                r.last_ms += r.interval_ms;
+            }
+        }
+        if (r.decimation > 1) {
+            if (++r.count < r.decimation) {
+                return false;
+            }
+            r.count = 0;
+        }
+        return true;
+    }
+    return true;
 }
+#endif // DATAFLASH_MAX_LOG_RATES
 
 // This function determines the number of whole or partial log files in the DataFlash
 // Wholly overwritten files are (of course) lost.
@@ -701,27 +764,41 @@ void DataFlash_Class::Log_Write_GPS(const AP_GPS &gps, uint8_t i, int32_t relati
         WriteBlock(&pkt, sizeof(pkt));
     }
 #if HAL_CPU_CLASS > HAL_CPU_CLASS_16
-    if (i > 0) {
-        const struct Location &loc2 = gps.location(i);
-        struct log_GPS2 pkt2 = {
-            LOG_PACKET_HEADER_INIT(LOG_GPS2_MSG),
-            time_us       : hal.scheduler->micros64(),
-            status        : (uint8_t)gps.status(i),
-            gps_week_ms   : gps.time_week_ms(i),
-            gps_week      : gps.time_week(i),
-            num_sats      : gps.num_sats(i),
-            hdop          : gps.get_hdop(i),
-            latitude      : loc2.lat,
-            longitude     : loc2.lng,
-            altitude      : loc2.alt,
-            ground_speed  : (uint32_t)(gps.ground_speed(i)*100),
-            ground_course : gps.ground_course_cd(i),
-            vel_z         : gps.velocity(i).z,
-            dgps_numch    : 0,
-            dgps_age      : 0
-        };
-        WriteBlock(&pkt2, sizeof(pkt2));
+    // the other receivers, and the blended solution, have no relative
+    // altitude
+    uint8_t msg_type;
+    if (i == 1) {
+        msg_type = LOG_GPS2_MSG;
+#if GPS_MAX_INSTANCES > 2
+    } else if (i == 2) {
+        msg_type = LOG_GPS3_MSG;
+#endif
+#if GPS_BLENDING_AVAILABLE
+    } else if (i == GPS_BLENDED_INSTANCE) {
+        msg_type = LOG_GPSB_MSG;
+#endif
+    } else {
+        return;
     }
+    const struct Location &loc2 = gps.location(i);
+    struct log_GPS2 pkt2 = {
+        LOG_PACKET_HEADER_INIT(msg_type),
+        time_us       : hal.scheduler->micros64(),
+        status        : (uint8_t)gps.status(i),
+        gps_week_ms   : gps.time_week_ms(i),
+        gps_week      : gps.time_week(i),
+        num_sats      : gps.num_sats(i),
+        hdop          : gps.get_hdop(i),
+        latitude      : loc2.lat,
+        longitude     : loc2.lng,
+        altitude      : loc2.alt,
+        ground_speed  : (uint32_t)(gps.ground_speed(i)*100),
+        ground_course : gps.ground_course_cd(i),
+        vel_z         : gps.velocity(i).z,
+        dgps_numch    : 0,
+        dgps_age      : 0
+    };
+    WriteBlock(&pkt2, sizeof(pkt2));
 #endif
 }
 
@@ -803,6 +880,10 @@ void DataFlash_Class::Log_Write_Baro(AP_Baro &baro)
 // Write an raw accel/gyro data packet
 void DataFlash_Class::Log_Write_IMU(const AP_InertialSensor &ins)
 {
+    // the rate of IMU applies to IMU2 and IMU3 too
+    if (!should_write(LOG_IMU_MSG)) {
+        return;
+    }
     uint64_t time_us = hal.scheduler->micros64();
     const Vector3f &gyro = ins.get_gyro(0);
     const Vector3f &accel = ins.get_accel(0);
@@ -871,6 +952,10 @@ void DataFlash_Class::Log_Write_IMU(const AP_InertialSensor &ins)
 // Write an accel/gyro delta time data packet
 void DataFlash_Class::Log_Write_IMUDT(const AP_InertialSensor &ins)
 {
+    // the rate of IMT applies to IMT2 and IMT3 too
+    if (!should_write(LOG_IMUDT_MSG)) {
+        return;
+    }
     float delta_t = ins.get_delta_time();
     float delta_vel_t = ins.get_delta_velocity_dt(0);
     Vector3f delta_angle, delta_velocity;
@@ -945,6 +1030,9 @@ void DataFlash_Class::Log_Write_IMUDT(const AP_InertialSensor &ins)
 void DataFlash_Class::Log_Write_Vibration(const AP_InertialSensor &ins)
 {
 #if INS_VIBRATION_CHECK
+    if (!should_write(LOG_VIBE_MSG)) {
+        return;
+    }
     uint64_t time_us = hal.scheduler->micros64();
     Vector3f vibration = ins.get_vibration_levels();
     struct log_Vibe pkt = {
@@ -1005,6 +1093,9 @@ void DataFlash_Class::Log_Write_AHRS2(AP_AHRS &ahrs)
 {
     Vector3f euler;
     struct Location loc;
+    if (!should_write(LOG_AHR2_MSG)) {
+        return;
+    }
     if (!ahrs.get_secondary_attitude(euler) || !ahrs.get_secondary_position(loc)) {
         return;
     }
@@ -1025,7 +1116,7 @@ void DataFlash_Class::Log_Write_AHRS2(AP_AHRS &ahrs)
 void DataFlash_Class::Log_Write_POS(AP_AHRS &ahrs)
 {
     Location loc;
-    if (!ahrs.get_position(loc)) {
+    if (!should_write(LOG_POS_MSG) || !ahrs.get_position(loc)) {
         return;
     }
     Vector3f pos;
@@ -1042,145 +1133,219 @@ void DataFlash_Class::Log_Write_POS(AP_AHRS &ahrs)
 }
 
 #if AP_AHRS_NAVEKF_AVAILABLE
+/*
+  take a snapshot of the EKF for the EKF1 to EKF5 messages that are
+  due. Packing them is left to Log_Write_EKF_Snapshot()
+ */
 void DataFlash_Class::Log_Write_EKF(AP_AHRS_NavEKF &ahrs, bool optFlowEnabled)
 {
-	// Write first EKF packet
-    Vector3f euler;
-    Vector3f posNED;
-    Vector3f velNED;
-    Vector3f dAngBias;
-    Vector3f dVelBias;
-    Vector3f gyroBias;
-    ahrs.get_NavEKF().getEulerAngles(euler);
-    ahrs.get_NavEKF().getVelNED(velNED);
-    ahrs.get_NavEKF().getPosNED(posNED);
-    ahrs.get_NavEKF().getGyroBias(gyroBias);
-    struct log_EKF1 pkt = {
-        LOG_PACKET_HEADER_INIT(LOG_EKF1_MSG),
-        time_us : hal.scheduler->micros64(),
-        roll    : (int16_t)(100*degrees(euler.x)), // roll angle (centi-deg, displayed as deg due to format string)
-        pitch   : (int16_t)(100*degrees(euler.y)), // pitch angle (centi-deg, displayed as deg due to format string)
-        yaw     : (uint16_t)wrap_360_cd(100*degrees(euler.z)), // yaw angle (centi-deg, displayed as deg due to format string)
-        velN    : (float)(velNED.x), // velocity North (m/s)
-        velE    : (float)(velNED.y), // velocity East (m/s)
-        velD    : (float)(velNED.z), // velocity Down (m/s)
-        posN    : (float)(posNED.x), // metres North
-        posE    : (float)(posNED.y), // metres East
-        posD    : (float)(posNED.z), // metres Down
-        gyrX    : (int16_t)(100*degrees(gyroBias.x)), // cd/sec, displayed as deg/sec due to format string
-        gyrY    : (int16_t)(100*degrees(gyroBias.y)), // cd/sec, displayed as deg/sec due to format string
-        gyrZ    : (int16_t)(100*degrees(gyroBias.z)) // cd/sec, displayed as deg/sec due to format string
+    struct ekf_snapshot snap;
+    snap.mask = 0;
+    if (should_write(LOG_EKF1_MSG)) {
+        snap.mask |= 1;
+    }
+    if (should_write(LOG_EKF2_MSG)) {
+        snap.mask |= 2;
+    }
+    if (should_write(LOG_EKF3_MSG)) {
+        snap.mask |= 4;
+    }
+    if (should_write(LOG_EKF4_MSG)) {
+        snap.mask |= 8;
+    }
+    if (optFlowEnabled && should_write(LOG_EKF5_MSG)) {
+        snap.mask |= 16;
+    }
+    Log_Write_EKF_Lanes(ahrs.get_NavEKF_lanes());
+    Log_Write_EKF_Timing(ahrs.get_NavEKF());
+    if (snap.mask == 0) {
+        return;
+    }
+    snap.time_us = hal.scheduler->micros64();
+    ahrs.get_NavEKF().getLogSnapshot(snap.ekf);
+    Log_Write_EKF_Snapshot(snap);
+}
+
+// write the status and timing of each EKF lane
+void DataFlash_Class::Log_Write_EKF_Lanes(const NavEKF_Lanes &lanes)
+{
+    if (lanes.num_lanes() < 2 || !should_write(LOG_EKFL_MSG)) {
+        return;
+    }
+    uint64_t time_us = hal.scheduler->micros64();
+    for (uint8_t i=0; i<lanes.num_lanes(); i++) {
+        NavEKF_Lanes::lane_output out;
+        NavEKF_Lanes::lane_timing timing;
+        if (!lanes.get_output(i, out)) {
+            continue;
+        }
+        lanes.get_timing(i, timing);
+        struct log_EKF_Lane pkt = {
+            LOG_PACKET_HEADER_INIT(LOG_EKFL_MSG),
+            time_us  : time_us,
+            lane     : i,
+            imu      : out.imu,
+            active   : (uint8_t)(i == lanes.active_lane()),
+            healthy  : (uint8_t)out.healthy,
+            score    : out.score,
+            last_us  : timing.last_us,
+            max_us   : timing.max_us,
+            avg_us   : timing.avg_us,
+            overruns : timing.overruns
+        };
+        WriteBlock(&pkt, sizeof(pkt));
+    }
+}
+
+// write the per-frame execution time of the EKF in use
+void DataFlash_Class::Log_Write_EKF_Timing(const NavEKF &ekf)
+{
+    if (!should_write(LOG_EKFT_MSG)) {
+        return;
+    }
+    NavEKF::frame_timing timing;
+    ekf.getFrameTiming(timing);
+    struct log_EKF_Timing pkt = {
+        LOG_PACKET_HEADER_INIT(LOG_EKFT_MSG),
+        time_us    : hal.scheduler->micros64(),
+        last_us    : timing.last_us,
+        max_us     : timing.max_us,
+        avg_us     : timing.avg_us,
+        last_steps : timing.last_steps,
+        max_steps  : timing.max_steps,
+        deferrals  : timing.deferrals
     };
     WriteBlock(&pkt, sizeof(pkt));
+}
 
-    // Write second EKF packet
-    float ratio;
-    float az1bias, az2bias;
-    Vector3f wind;
-    Vector3f magNED;
-    Vector3f magXYZ;
-    ahrs.get_NavEKF().getIMU1Weighting(ratio);
-    ahrs.get_NavEKF().getAccelZBias(az1bias, az2bias);
-    ahrs.get_NavEKF().getWind(wind);
-    ahrs.get_NavEKF().getMagNED(magNED);
-    ahrs.get_NavEKF().getMagXYZ(magXYZ);
-    struct log_EKF2 pkt2 = {
-        LOG_PACKET_HEADER_INIT(LOG_EKF2_MSG),
-        time_us : hal.scheduler->micros64(),
-        Ratio   : (int8_t)(100*ratio),
-        AZ1bias : (int8_t)(100*az1bias),
-        AZ2bias : (int8_t)(100*az2bias),
-        windN   : (int16_t)(100*wind.x),
-        windE   : (int16_t)(100*wind.y),
-        magN    : (int16_t)(magNED.x),
-        magE    : (int16_t)(magNED.y),
-        magD    : (int16_t)(magNED.z),
-        magX    : (int16_t)(magXYZ.x),
-        magY    : (int16_t)(magXYZ.y),
-        magZ    : (int16_t)(magXYZ.z)
-    };
-    WriteBlock(&pkt2, sizeof(pkt2));
+// pack and write the messages for an EKF snapshot
+void DataFlash_Class::Log_Write_EKF_Snapshot(const struct ekf_snapshot &snap)
+{
+    uint8_t buf[DATAFLASH_EKF_PACKETS_MAX];
+    uint16_t len = Log_Pack_EKF(snap, buf);
+    WriteBlock(buf, len);
+}
 
-    // Write third EKF packet
-    Vector3f velInnov;
-    Vector3f posInnov;
-    Vector3f magInnov;
-    float tasInnov;
-    ahrs.get_NavEKF().getInnovations(velInnov, posInnov, magInnov, tasInnov);
-    struct log_EKF3 pkt3 = {
-        LOG_PACKET_HEADER_INIT(LOG_EKF3_MSG),
-        time_us : hal.scheduler->micros64(),
-        innovVN : (int16_t)(100*velInnov.x),
-        innovVE : (int16_t)(100*velInnov.y),
-        innovVD : (int16_t)(100*velInnov.z),
-        innovPN : (int16_t)(100*posInnov.x),
-        innovPE : (int16_t)(100*posInnov.y),
-        innovPD : (int16_t)(100*posInnov.z),
-        innovMX : (int16_t)(magInnov.x),
-        innovMY : (int16_t)(magInnov.y),
-        innovMZ : (int16_t)(magInnov.z),
-        innovVT : (int16_t)(100*tasInnov)
-    };
-    WriteBlock(&pkt3, sizeof(pkt3));
+/*
+  pack the EKF messages selected in the snapshot mask
+ */
+uint16_t DataFlash_Class::Log_Pack_EKF(const struct ekf_snapshot &snap, uint8_t *buf)
+{
+    const NavEKF::log_snapshot &ekf = snap.ekf;
+    uint16_t len = 0;
+
+    if (snap.mask & 1) {
+        // first EKF packet
+        Vector3f euler;
+        ekf.quat.to_euler(euler.x, euler.y, euler.z);
+        euler -= ekf.trim;
+        struct log_EKF1 pkt = {
+            LOG_PACKET_HEADER_INIT(LOG_EKF1_MSG),
+            time_us : snap.time_us,
+            roll    : (int16_t)(100*degrees(euler.x)), // roll angle (centi-deg, displayed as deg due to format string)
+            pitch   : (int16_t)(100*degrees(euler.y)), // pitch angle (centi-deg, displayed as deg due to format string)
+            yaw     : (uint16_t)wrap_360_cd(100*degrees(euler.z)), // yaw angle (centi-deg, displayed as deg due to format string)
+            velN    : (float)(ekf.velocity.x), // velocity North (m/s)
+            velE    : (float)(ekf.velocity.y), // velocity East (m/s)
+            velD    : (float)(ekf.velocity.z), // velocity Down (m/s)
+            posN    : (float)(ekf.position.x), // metres North
+            posE    : (float)(ekf.position.y), // metres East
+            posD    : (float)(ekf.position.z), // metres Down
+            gyrX    : (int16_t)(100*degrees(ekf.gyro_bias.x)), // cd/sec, displayed as deg/sec due to format string
+            gyrY    : (int16_t)(100*degrees(ekf.gyro_bias.y)), // cd/sec, displayed as deg/sec due to format string
+            gyrZ    : (int16_t)(100*degrees(ekf.gyro_bias.z)) // cd/sec, displayed as deg/sec due to format string
+        };
+        memcpy(&buf[len], &pkt, sizeof(pkt));
+        len += sizeof(pkt);
+    }
 
-    // Write fourth EKF packet
-    float velVar;
-    float posVar;
-    float hgtVar;
-    Vector3f magVar;
-    float tasVar;
-    Vector2f offset;
-    uint8_t faultStatus, timeoutStatus;
-    nav_filter_status solutionStatus;
-    ahrs.get_NavEKF().getVariances(velVar, posVar, hgtVar, magVar, tasVar, offset);
-    ahrs.get_NavEKF().getFilterFaults(faultStatus);
-    ahrs.get_NavEKF().getFilterTimeouts(timeoutStatus);
-    ahrs.get_NavEKF().getFilterStatus(solutionStatus);
-    struct log_EKF4 pkt4 = {
-        LOG_PACKET_HEADER_INIT(LOG_EKF4_MSG),
-        time_us : hal.scheduler->micros64(),
-        sqrtvarV : (int16_t)(100*velVar),
-        sqrtvarP : (int16_t)(100*posVar),
-        sqrtvarH : (int16_t)(100*hgtVar),
-        sqrtvarMX : (int16_t)(100*magVar.x),
-        sqrtvarMY : (int16_t)(100*magVar.y),
-        sqrtvarMZ : (int16_t)(100*magVar.z),
-        sqrtvarVT : (int16_t)(100*tasVar),
-        offsetNorth : (int8_t)(offset.x),
-        offsetEast : (int8_t)(offset.y),
-        faults : (uint8_t)(faultStatus),
-        timeouts : (uint8_t)(timeoutStatus),
-        solution : (uint16_t)(solutionStatus.value)
-    };
-    WriteBlock(&pkt4, sizeof(pkt4));
-
-
-    // Write fifth EKF packet
-    if (optFlowEnabled) {
-        float normInnov; // normalised innovation variance ratio for optical flow observations fused by the main nav filter
-        float gndOffset; // estimated vertical position of the terrain relative to the nav filter zero datum
-        float flowInnovX, flowInnovY; // optical flow LOS rate vector innovations from the main nav filter
-        float auxFlowInnov; // optical flow LOS rate innovation from terrain offset estimator
-        float HAGL; // height above ground level
-        float rngInnov; // range finder innovations
-        float range; // measured range
-        float gndOffsetErr; // filter ground offset state error
-        ahrs.get_NavEKF().getFlowDebug(normInnov, gndOffset, flowInnovX, flowInnovY, auxFlowInnov, HAGL, rngInnov, range, gndOffsetErr);
+    if (snap.mask & 2) {
+        // second EKF packet. The fields are in milligauss
+        Vector3f magNED = ekf.earth_magfield * 1000.0f;
+        Vector3f magXYZ = ekf.body_magfield * 1000.0f;
+        struct log_EKF2 pkt2 = {
+            LOG_PACKET_HEADER_INIT(LOG_EKF2_MSG),
+            time_us : snap.time_us,
+            Ratio   : (int8_t)(100*ekf.imu1_weighting),
+            AZ1bias : (int8_t)(100*ekf.accel_zbias1),
+            AZ2bias : (int8_t)(100*ekf.accel_zbias2),
+            windN   : (int16_t)(100*ekf.wind.x),
+            windE   : (int16_t)(100*ekf.wind.y),
+            magN    : (int16_t)(magNED.x),
+            magE    : (int16_t)(magNED.y),
+            magD    : (int16_t)(magNED.z),
+            magX    : (int16_t)(magXYZ.x),
+            magY    : (int16_t)(magXYZ.y),
+            magZ    : (int16_t)(magXYZ.z)
+        };
+        memcpy(&buf[len], &pkt2, sizeof(pkt2));
+        len += sizeof(pkt2);
+    }
+
+    if (snap.mask & 4) {
+        // third EKF packet
+        Vector3f magInnov = ekf.innovMag * 1000.0f;
+        struct log_EKF3 pkt3 = {
+            LOG_PACKET_HEADER_INIT(LOG_EKF3_MSG),
+            time_us : snap.time_us,
+            innovVN : (int16_t)(100*ekf.innovVelPos[0]),
+            innovVE : (int16_t)(100*ekf.innovVelPos[1]),
+            innovVD : (int16_t)(100*ekf.innovVelPos[2]),
+            innovPN : (int16_t)(100*ekf.innovVelPos[3]),
+            innovPE : (int16_t)(100*ekf.innovVelPos[4]),
+            innovPD : (int16_t)(100*ekf.innovVelPos[5]),
+            innovMX : (int16_t)(magInnov.x),
+            innovMY : (int16_t)(magInnov.y),
+            innovMZ : (int16_t)(magInnov.z),
+            innovVT : (int16_t)(100*ekf.innovVtas)
+        };
+        memcpy(&buf[len], &pkt3, sizeof(pkt3));
+        len += sizeof(pkt3);
+    }
+
+    if (snap.mask & 8) {
+        // fourth EKF packet
+        struct log_EKF4 pkt4 = {
+            LOG_PACKET_HEADER_INIT(LOG_EKF4_MSG),
+            time_us : snap.time_us,
+            sqrtvarV : (int16_t)(100*sqrtf(ekf.velTestRatio)),
+            sqrtvarP : (int16_t)(100*sqrtf(ekf.posTestRatio)),
+            sqrtvarH : (int16_t)(100*sqrtf(ekf.hgtTestRatio)),
+            sqrtvarMX : (int16_t)(100*sqrtf(ekf.magTestRatio.x)),
+            sqrtvarMY : (int16_t)(100*sqrtf(ekf.magTestRatio.y)),
+            sqrtvarMZ : (int16_t)(100*sqrtf(ekf.magTestRatio.z)),
+            sqrtvarVT : (int16_t)(100*sqrtf(ekf.tasTestRatio)),
+            offsetNorth : (int8_t)(ekf.gpsPosGlitchOffsetNE.x),
+            offsetEast : (int8_t)(ekf.gpsPosGlitchOffsetNE.y),
+            faults : ekf.faults,
+            timeouts : ekf.timeouts,
+            solution : ekf.status
+        };
+        memcpy(&buf[len], &pkt4, sizeof(pkt4));
+        len += sizeof(pkt4);
+    }
+
+    if (snap.mask & 16) {
+        // fifth EKF packet, for optical flow
+        float HAGL = ekf.terrainState - ekf.position.z; // height above ground level
         struct log_EKF5 pkt5 = {
             LOG_PACKET_HEADER_INIT(LOG_EKF5_MSG),
-            time_us : hal.scheduler->micros64(),
-            normInnov : (uint8_t)(min(100*normInnov,255)),
-            FIX : (int16_t)(1000*flowInnovX),
-            FIY : (int16_t)(1000*flowInnovY),
-            AFI : (int16_t)(1000*auxFlowInnov),
+            time_us : snap.time_us,
+            normInnov : (uint8_t)(min(100*ekf.flowTestRatio,255)),
+            FIX : (int16_t)(1000*ekf.innovOptFlow[0]),
+            FIY : (int16_t)(1000*ekf.innovOptFlow[1]),
+            AFI : (int16_t)(1000*ekf.auxFlowObsInnov),
             HAGL : (int16_t)(100*HAGL),
-            offset : (int16_t)(100*gndOffset),
-            RI : (int16_t)(100*rngInnov),
-            meaRng : (uint16_t)(100*range),
-            errHAGL : (uint16_t)(100*gndOffsetErr)
+            offset : (int16_t)(100*ekf.terrainState),
+            RI : (int16_t)(100*ekf.innovRng),
+            meaRng : (uint16_t)(100*ekf.rngMea),
+            errHAGL : (uint16_t)(100*sqrtf(ekf.Popt)) // Popt is constrained to be non-negative
          };
-        WriteBlock(&pkt5, sizeof(pkt5));
+        memcpy(&buf[len], &pkt5, sizeof(pkt5));
+        len += sizeof(pkt5);
     }
+
+    return len;
 }
 #endif
 
@@ -1251,6 +1416,9 @@ void DataFlash_Class::Log_Write_Camera(const AP_AHRS &ahrs, const AP_GPS &gps, c
 // Write an attitude packet
 void DataFlash_Class::Log_Write_Attitude(AP_AHRS &ahrs, const Vector3f &targets)
 {
+    if (!should_write(LOG_ATTITUDE_MSG)) {
+        return;
+    }
     struct log_Attitude pkt = {
         LOG_PACKET_HEADER_INIT(LOG_ATTITUDE_MSG),
         time_us         : hal.scheduler->micros64(),
@@ -1426,6 +1594,9 @@ void DataFlash_Class::Log_Write_Airspeed(AP_Airspeed &airspeed)
 // Write a Yaw PID packet
 void DataFlash_Class::Log_Write_PID(uint8_t msg_type, const PID_Info &info)
 {
+    if (!should_write(msg_type)) {
+        return;
+    }
     struct log_PID pkt = {
         LOG_PACKET_HEADER_INIT(msg_type),
         time_us         : hal.scheduler->micros64(),
@@ -1438,3 +1609,207 @@ void DataFlash_Class::Log_Write_PID(uint8_t msg_type, const PID_Info &info)
     };
     WriteBlock(&pkt, sizeof(pkt));
 }
+
+#ifdef DATAFLASH_REPLAY_LOGGING
+/*
+  take size bytes from the replay logging budget. The budget refills
+  at bytes_per_second and can save up a quarter of a second, so the
+  messages of one sensor update go out together or not at all
+ */
+bool DataFlash_Class::replay_budget(uint16_t size)
+{
+    uint64_t now = hal.scheduler->micros64();
+    uint64_t elapsed = now - _replay.last_us;
+    _replay.last_us = now;
+    if (elapsed > 250000) {
+        elapsed = 250000;
+    }
+    const uint64_t limit = 250000ULL * _replay.bytes_per_second;
+    _replay.credit += elapsed * _replay.bytes_per_second;
+    if (_replay.credit > limit) {
+        _replay.credit = limit;
+    }
+    const uint64_t cost = size * 1000000ULL;
+    if (_replay.credit < cost) {
+        _replay.dropped++;
+        return false;
+    }
+    _replay.credit -= cost;
+    return true;
+}
+
+/*
+  write the INS data of the last update, one RIMU per instance
+  followed by an RFRM. Tools/Replay runs the AHRS on each RFRM
+ */
+void DataFlash_Class::Log_Write_Replay_IMU(const AP_InertialSensor &ins)
+{
+    if (!replay_logging()) {
+        return;
+    }
+    uint8_t count = max(ins.get_gyro_count(), ins.get_accel_count());
+    if (!replay_budget(count*sizeof(struct log_ReplayIMU) + sizeof(struct log_ReplayFrame))) {
+        return;
+    }
+    uint64_t time_us = hal.scheduler->micros64();
+    for (uint8_t i=0; i<count; i++) {
+        uint8_t flags = i;
+        Vector3f delta_angle, delta_velocity;
+        if (ins.get_gyro_health(i)) {
+            flags |= LOG_REPLAY_IMU_GYRO_OK;
+        }
+        if (ins.get_accel_health(i)) {
+            flags |= LOG_REPLAY_IMU_ACCEL_OK;
+        }
+        if (ins.get_delta_angle(i, delta_angle)) {
+            flags |= LOG_REPLAY_IMU_DELTA_ANGLE;
+        }
+        if (ins.get_delta_velocity(i, delta_velocity)) {
+            flags |= LOG_REPLAY_IMU_DELTA_VEL;
+        }
+        const Vector3f &gyro = ins.get_gyro(i);
+        const Vector3f &accel = ins.get_accel(i);
+        struct log_ReplayIMU pkt = {
+            LOG_PACKET_HEADER_INIT(LOG_RIMU_MSG),
+            time_us      : time_us,
+            instance     : flags,
+            delta_vel_dt : ins.get_delta_velocity_dt(i),
+            delta_ang_x  : delta_angle.x,
+            delta_ang_y  : delta_angle.y,
+            delta_ang_z  : delta_angle.z,
+            delta_vel_x  : delta_velocity.x,
+            delta_vel_y  : delta_velocity.y,
+            delta_vel_z  : delta_velocity.z,
+            gyro_x       : gyro.x,
+            gyro_y       : gyro.y,
+            gyro_z       : gyro.z,
+            accel_x      : accel.x,
+            accel_y      : accel.y,
+            accel_z      : accel.z
+        };
+        WriteBlock(&pkt, sizeof(pkt));
+    }
+    struct log_ReplayFrame frame = {
+        LOG_PACKET_HEADER_INIT(LOG_RFRM_MSG),
+        time_us    : time_us,
+        delta_time : ins.get_delta_time(),
+        dropped    : _replay.dropped
+    };
+    WriteBlock(&frame, sizeof(frame));
+}
+
+/*
+  write a new GPS fix. It is stamped with the time it was processed,
+  and the RGPA carries the time it started to arrive
+ */
+void DataFlash_Class::Log_Write_Replay_GPS(const AP_GPS &gps, uint8_t i)
+{
+    if (!replay_logging() ||
+        !replay_budget(sizeof(struct log_ReplayGPSAccuracy) + sizeof(struct log_ReplayGPS))) {
+        return;
+    }
+    uint64_t time_us = gps.last_message_time_ms(i) * 1000ULL;
+    float hacc, vacc, sacc;
+    if (!gps.horizontal_accuracy(i, hacc)) {
+        hacc = -1;
+    }
+    if (!gps.vertical_accuracy(i, vacc)) {
+        vacc = -1;
+    }
+    if (!gps.speed_accuracy(i, sacc)) {
+        sacc = -1;
+    }
+    struct log_ReplayGPSAccuracy acc = {
+        LOG_PACKET_HEADER_INIT(LOG_RGPA_MSG),
+        time_us             : time_us,
+        instance            : i,
+        horizontal_accuracy : hacc,
+        vertical_accuracy   : vacc,
+        speed_accuracy      : sacc,
+        arrival_ms          : gps.fix_arrival_ms(i)
+    };
+    WriteBlock(&acc, sizeof(acc));
+
+    const Location &loc = gps.location(i);
+    const Vector3f &vel = gps.velocity(i);
+    struct log_ReplayGPS pkt = {
+        LOG_PACKET_HEADER_INIT(LOG_RGPS_MSG),
+        time_us     : time_us,
+        instance    : i,
+        status      : (uint8_t)gps.status(i),
+        num_sats    : gps.num_sats(i),
+        hdop        : gps.get_hdop(i),
+        gps_week_ms : gps.time_week_ms(i),
+        gps_week    : gps.time_week(i),
+        latitude    : loc.lat,
+        longitude   : loc.lng,
+        altitude    : loc.alt,
+        vel_north   : vel.x,
+        vel_east    : vel.y,
+        vel_down    : vel.z,
+        have_vz     : gps.have_vertical_velocity(i)
+    };
+    WriteBlock(&pkt, sizeof(pkt));
+}
+
+// write a new barometer sample
+void DataFlash_Class::Log_Write_Replay_Baro(const AP_Baro &baro, uint8_t i)
+{
+    if (!replay_logging() || !replay_budget(sizeof(struct log_ReplayBaro))) {
+        return;
+    }
+    struct log_ReplayBaro pkt = {
+        LOG_PACKET_HEADER_INIT(LOG_RBAR_MSG),
+        time_us            : baro.get_last_update(i) * 1000ULL,
+        instance           : i,
+        pressure           : baro.get_pressure(i),
+        temperature        : baro.get_temperature(i),
+        ground_pressure    : baro.get_ground_pressure(i),
+        ground_temperature : baro.get_ground_temperature(i)
+    };
+    WriteBlock(&pkt, sizeof(pkt));
+}
+
+/*
+  write a new compass sample. Each compass keeps a 32 bit update time,
+  which is widened using the current time
+ */
+void DataFlash_Class::Log_Write_Replay_Compass(const Compass &compass, uint8_t i)
+{
+    if (!replay_logging() || !replay_budget(sizeof(struct log_ReplayCompass))) {
+        return;
+    }
+    uint64_t now = hal.scheduler->micros64();
+    const Vector3f &mag = compass.get_field(i);
+    struct log_ReplayCompass pkt = {
+        LOG_PACKET_HEADER_INIT(LOG_RMAG_MSG),
+        time_us  : now - (uint32_t)((uint32_t)now - compass.last_update_usec(i)),
+        instance : i,
+        mag_x    : mag.x,
+        mag_y    : mag.y,
+        mag_z    : mag.z
+    };
+    WriteBlock(&pkt, sizeof(pkt));
+}
+
+// write a new airspeed sample
+void DataFlash_Class::Log_Write_Replay_Airspeed(AP_Airspeed &airspeed)
+{
+    if (!replay_logging() || !replay_budget(sizeof(struct log_ReplayAirspeed))) {
+        return;
+    }
+    float temperature;
+    if (!airspeed.get_temperature(temperature)) {
+        temperature = 0;
+    }
+    struct log_ReplayAirspeed pkt = {
+        LOG_PACKET_HEADER_INIT(LOG_RASP_MSG),
+        time_us      : airspeed.last_update_ms() * 1000ULL,
+        airspeed     : airspeed.get_airspeed(),
+        diffpressure : airspeed.get_differential_pressure(),
+        temperature  : temperature,
+        EAS2TAS      : airspeed.get_EAS2TAS()
+    };
+    WriteBlock(&pkt, sizeof(pkt));
+}
+#endif // DATAFLASH_REPLAY_LOGGING
@@ -10,6 +10,8 @@
 #include "FilterWithBuffer.h"
 #include "LowPassFilter.h"
 #include "ModeFilter.h"
+#include "MedianFilter.h"
+#include "SavitzkyGolayDerivativeFilter.h"
 #include "Butter.h"
 
 #endif //__FILTER_H__
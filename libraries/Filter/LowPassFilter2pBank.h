@@ -0,0 +1,123 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOWPASSFILTER2PBANK_H
+#define LOWPASSFILTER2PBANK_H
+
+/// @file   LowPassFilter2pBank.h
+/// @brief  A bank of N second order low pass filters updated together.
+///         Filter coefficients and state are held as structure-of-arrays
+///         so that apply() is a single branch-free loop over the channels
+///         which the compiler can vectorise (NEON on ARM, SSE on x86).
+///         Each channel gives the same output as a LowPassFilter2pfloat
+///         with the same sample and cutoff frequency.
+
+#include <AP_Math.h>
+#include "LowPassFilter2p.h"
+
+template <uint8_t N>
+class LowPassFilter2pBank
+{
+public:
+    // constructor - all channels pass samples through unfiltered
+    LowPassFilter2pBank() {
+        set_cutoff_frequency(0, N, 0.0f, 0.0f);
+        reset();
+    }
+
+    // constructor - all channels share a sample and cutoff frequency
+    LowPassFilter2pBank(float sample_freq, float cutoff_freq) {
+        set_cutoff_frequency(0, N, sample_freq, cutoff_freq);
+        reset();
+    }
+
+    // change parameters of all channels
+    void set_cutoff_frequency(float sample_freq, float cutoff_freq) {
+        set_cutoff_frequency(0, N, sample_freq, cutoff_freq);
+    }
+
+    // change parameters of channels first to first+count-1
+    void set_cutoff_frequency(uint8_t first, uint8_t count, float sample_freq, float cutoff_freq);
+
+    // return the cutoff frequency of a channel
+    float get_cutoff_freq(uint8_t channel) const {
+        return _cutoff_freq[channel];
+    }
+
+    // apply - filter N new samples, writing N filtered results to ret
+    void apply(const float *sample, float *ret);
+
+    // reset - clear the filter state of all channels
+    void reset() {
+        for (uint8_t i=0; i<N; i++) {
+            _delay_element_1[i] = 0.0f;
+            _delay_element_2[i] = 0.0f;
+        }
+    }
+
+    // get number of channels
+    uint8_t get_num_channels() const {
+        return N;
+    }
+
+private:
+    float _a1[N];
+    float _a2[N];
+    float _b0[N];
+    float _b1[N];
+    float _b2[N];
+    float _delay_element_1[N];
+    float _delay_element_2[N];
+    float _cutoff_freq[N];
+};
+
+template <uint8_t N>
+void LowPassFilter2pBank<N>::set_cutoff_frequency(uint8_t first, uint8_t count, float sample_freq, float cutoff_freq)
+{
+    DigitalBiquadFilter::biquad_params params;
+    if (is_zero(cutoff_freq) || is_zero(sample_freq)) {
+        // a unity gain filter with no feedback, so apply() stays branch free
+        params.b0 = 1.0f;
+        params.b1 = params.b2 = params.a1 = params.a2 = 0.0f;
+    } else {
+        DigitalBiquadFilter::compute_params(sample_freq, cutoff_freq, params);
+    }
+    for (uint8_t i=first; i<first+count && i<N; i++) {
+        _a1[i] = params.a1;
+        _a2[i] = params.a2;
+        _b0[i] = params.b0;
+        _b1[i] = params.b1;
+        _b2[i] = params.b2;
+        _cutoff_freq[i] = cutoff_freq;
+    }
+}
+
+template <uint8_t N>
+void LowPassFilter2pBank<N>::apply(const float * __restrict sample, float * __restrict ret)
+{
+    for (uint8_t i=0; i<N; i++) {
+        float delay_element_0 = sample[i] - _delay_element_1[i] * _a1[i] - _delay_element_2[i] * _a2[i];
+        if (isnan(delay_element_0) || isinf(delay_element_0)) {
+            delay_element_0 = sample[i];
+        }
+        ret[i] = delay_element_0 * _b0[i] + _delay_element_1[i] * _b1[i] + _delay_element_2[i] * _b2[i];
+        _delay_element_2[i] = _delay_element_1[i];
+        _delay_element_1[i] = delay_element_0;
+    }
+}
+
+#endif // LOWPASSFILTER2PBANK_H
@@ -0,0 +1,227 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+/// @file	MedianFilter.h
+/// @brief	A sliding window median filter with O(log N) cost per sample.
+///         Unlike ModeFilter, which re-sorts its buffer on every sample, this keeps a
+///         max-heap of the lower half and a min-heap of the upper half of the window
+///         back to back in one array, with the median at the join. A new sample
+///         replaces the oldest one in place and is sifted through the heaps, so large
+///         windows are affordable. The filter size should be an odd number.
+
+#ifndef __MEDIAN_FILTER_H__
+#define __MEDIAN_FILTER_H__
+
+#include <inttypes.h>
+#include "FilterClass.h"
+
+template <class T, uint8_t FILTER_SIZE>
+class MedianFilter : public Filter<T>
+{
+public:
+    // constructor
+    MedianFilter();
+
+    // apply - Add a new raw value to the filter, retrieve the filtered result
+    virtual T apply(T sample);
+
+    // reset - clear the filter
+    virtual void reset();
+
+    // get filter size
+    uint8_t get_filter_size() const {
+        return FILTER_SIZE;
+    };
+
+    // return the current median without adding a sample
+    T get() const {
+        return _samples[_heap(0)];
+    }
+
+private:
+    T               _samples[FILTER_SIZE];      // circular buffer of samples, oldest at _sample_index
+    uint8_t         _heap_buf[FILTER_SIZE];     // sample indexes arranged as max-heap | median | min-heap
+    int16_t         _pos[FILTER_SIZE];          // heap position of each sample, relative to the median
+    uint8_t         _sample_index;              // next sample to be replaced
+    uint8_t         _count;                     // number of samples in the window
+
+    // access the heap with position 0 at the median, negative
+    // positions in the max-heap and positive in the min-heap
+    uint8_t &_heap(int16_t i) { return _heap_buf[i + FILTER_SIZE/2]; }
+    uint8_t _heap(int16_t i) const { return _heap_buf[i + FILTER_SIZE/2]; }
+
+    int16_t _min_count() const { return (_count-1)/2; }
+    int16_t _max_count() const { return _count/2; }
+
+    bool _less(int16_t i, int16_t j) const { return _samples[_heap(i)] < _samples[_heap(j)]; }
+    bool _exchange_if_less(int16_t i, int16_t j);
+    void _min_sort_down(int16_t i);
+    void _max_sort_down(int16_t i);
+    bool _min_sort_up(int16_t i);
+    bool _max_sort_up(int16_t i);
+};
+
+// Typedef for convenience
+typedef MedianFilter<int16_t,5> MedianFilterInt16_Size5;
+typedef MedianFilter<int16_t,9> MedianFilterInt16_Size9;
+typedef MedianFilter<int16_t,15> MedianFilterInt16_Size15;
+typedef MedianFilter<int16_t,31> MedianFilterInt16_Size31;
+typedef MedianFilter<uint16_t,5> MedianFilterUInt16_Size5;
+typedef MedianFilter<uint16_t,9> MedianFilterUInt16_Size9;
+typedef MedianFilter<uint16_t,15> MedianFilterUInt16_Size15;
+typedef MedianFilter<uint16_t,31> MedianFilterUInt16_Size31;
+typedef MedianFilter<float,5> MedianFilterFloat_Size5;
+typedef MedianFilter<float,9> MedianFilterFloat_Size9;
+typedef MedianFilter<float,15> MedianFilterFloat_Size15;
+typedef MedianFilter<float,31> MedianFilterFloat_Size31;
+
+// Constructor    //////////////////////////////////////////////////////////////
+
+template <class T, uint8_t FILTER_SIZE>
+MedianFilter<T,FILTER_SIZE>::MedianFilter()
+{
+    reset();
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+// reset - clear all samples from the window
+template <class T, uint8_t FILTER_SIZE>
+void MedianFilter<T,FILTER_SIZE>::reset()
+{
+    // interleave the initial slots between the two heaps so that the
+    // heaps fill evenly while the window is filling
+    for (uint8_t i=0; i<FILTER_SIZE; i++) {
+        _samples[i] = 0;
+        _pos[i] = ((i+1)/2) * ((i&1) ? -1 : 1);
+        _heap(_pos[i]) = i;
+    }
+    _sample_index = 0;
+    _count = 0;
+}
+
+// apply - replace the oldest sample with a new one and return the median
+template <class T, uint8_t FILTER_SIZE>
+T MedianFilter<T,FILTER_SIZE>::apply(T sample)
+{
+    bool is_new = _count < FILTER_SIZE;
+    int16_t p = _pos[_sample_index];
+    T old = _samples[_sample_index];
+
+    _samples[_sample_index] = sample;
+    if (++_sample_index >= FILTER_SIZE) {
+        _sample_index = 0;
+    }
+    if (is_new) {
+        _count++;
+    }
+
+    if (p > 0) {
+        // the replaced sample is in the min-heap
+        if (!is_new && old < sample) {
+            _min_sort_down(p*2);
+        } else if (_min_sort_up(p)) {
+            _max_sort_down(-1);
+        }
+    } else if (p < 0) {
+        // the replaced sample is in the max-heap
+        if (!is_new && sample < old) {
+            _max_sort_down(p*2);
+        } else if (_max_sort_up(p)) {
+            _min_sort_down(1);
+        }
+    } else {
+        // the replaced sample is the median
+        if (_max_count() > 0) {
+            _max_sort_down(-1);
+        }
+        if (_min_count() > 0) {
+            _min_sort_down(1);
+        }
+    }
+
+    return get();
+}
+
+// Private Methods //////////////////////////////////////////////////////////////
+
+// swap heap positions i and j if the sample at i is less than the sample at j
+template <class T, uint8_t FILTER_SIZE>
+bool MedianFilter<T,FILTER_SIZE>::_exchange_if_less(int16_t i, int16_t j)
+{
+    if (!_less(i, j)) {
+        return false;
+    }
+    uint8_t t = _heap(i);
+    _heap(i) = _heap(j);
+    _heap(j) = t;
+    _pos[_heap(i)] = i;
+    _pos[_heap(j)] = j;
+    return true;
+}
+
+// move a sample down the min-heap, starting by comparing the child
+// at position i with its parent. Position 1 is the child of the median
+template <class T, uint8_t FILTER_SIZE>
+void MedianFilter<T,FILTER_SIZE>::_min_sort_down(int16_t i)
+{
+    for (; i <= _min_count(); i*=2) {
+        if (i > 1 && i < _min_count() && _less(i+1, i)) {
+            i++;
+        }
+        if (!_exchange_if_less(i, i/2)) {
+            break;
+        }
+    }
+}
+
+// move a sample down the max-heap, starting by comparing the child
+// at position i with its parent. Position -1 is the child of the median
+template <class T, uint8_t FILTER_SIZE>
+void MedianFilter<T,FILTER_SIZE>::_max_sort_down(int16_t i)
+{
+    for (; i >= -_max_count(); i*=2) {
+        if (i < -1 && i > -_max_count() && _less(i, i-1)) {
+            i--;
+        }
+        if (!_exchange_if_less(i/2, i)) {
+            break;
+        }
+    }
+}
+
+// move the sample at min-heap position i up, returning true if it reached the median
+template <class T, uint8_t FILTER_SIZE>
+bool MedianFilter<T,FILTER_SIZE>::_min_sort_up(int16_t i)
+{
+    while (i > 0 && _exchange_if_less(i, i/2)) {
+        i /= 2;
+    }
+    return i == 0;
+}
+
+// move the sample at max-heap position i up, returning true if it reached the median
+template <class T, uint8_t FILTER_SIZE>
+bool MedianFilter<T,FILTER_SIZE>::_max_sort_up(int16_t i)
+{
+    while (i < 0 && _exchange_if_less(i/2, i)) {
+        i /= 2;
+    }
+    return i == 0;
+}
+
+#endif // __MEDIAN_FILTER_H__
@@ -0,0 +1,170 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+/// @file	SavitzkyGolayDerivativeFilter.h
+/// @brief	An incremental Savitzky-Golay derivative (slope) filter.
+///         The first derivative of a quadratic least squares fit over a window of
+///         N=2M+1 samples has weights k/sum(k^2) for k=-M..M, which are linear in k.
+///         That lets the weighted sum be updated in O(1) per sample from the plain
+///         sum and the sample leaving the window, so the window size does not affect
+///         the cost. The sums are recomputed from the buffer once per window to stop
+///         rounding errors accumulating. Sample spacing is taken as the average over
+///         the window, so it is suited to nearly uniformly sampled data. It has the
+///         same interface as DerivativeFilter.
+
+#ifndef __SAVITZKY_GOLAY_DERIVATIVE_FILTER_H__
+#define __SAVITZKY_GOLAY_DERIVATIVE_FILTER_H__
+
+#include <inttypes.h>
+#include <AP_Math.h>
+#include "FilterClass.h"
+#include "FilterWithBuffer.h"
+
+// 1st parameter <T> is the type of data being filtered.
+// 2nd parameter <FILTER_SIZE> is the number of elements in the filter, and should be odd
+template <class T, uint8_t FILTER_SIZE>
+class SavitzkyGolayDerivativeFilter : public FilterWithBuffer<T,FILTER_SIZE>
+{
+public:
+    // constructor
+    SavitzkyGolayDerivativeFilter() : FilterWithBuffer<T,FILTER_SIZE>() {
+        reset();
+    };
+
+    // update - Add a new raw value to the filter, but don't recalculate
+    void update(T sample, uint32_t timestamp);
+
+    // return the derivative value, per unit of timestamp
+    float slope(void);
+
+    // reset - clear the filter
+    virtual void        reset();
+
+private:
+    // half width of the window
+    static const int16_t M = FILTER_SIZE/2;
+
+    float           _sum;           // sum of samples in the window
+    float           _weighted_sum;  // sum of samples weighted by their offset from the window centre
+    uint8_t         _count;         // number of samples in the window
+
+    // timestamps of the samples, used for the average sample spacing
+    uint32_t        _timestamps[FILTER_SIZE];
+
+    void _recalculate(void);
+};
+
+typedef SavitzkyGolayDerivativeFilter<float,7> SavitzkyGolayDerivativeFilterFloat_Size7;
+typedef SavitzkyGolayDerivativeFilter<float,15> SavitzkyGolayDerivativeFilterFloat_Size15;
+typedef SavitzkyGolayDerivativeFilter<float,31> SavitzkyGolayDerivativeFilterFloat_Size31;
+
+// reset - clear all samples
+template <class T, uint8_t FILTER_SIZE>
+void SavitzkyGolayDerivativeFilter<T,FILTER_SIZE>::reset(void)
+{
+    FilterWithBuffer<T,FILTER_SIZE>::reset();
+    for (uint8_t i=0; i<FILTER_SIZE; i++) {
+        _timestamps[i] = 0;
+    }
+    _sum = 0;
+    _weighted_sum = 0;
+    _count = 0;
+}
+
+template <class T, uint8_t FILTER_SIZE>
+void SavitzkyGolayDerivativeFilter<T,FILTER_SIZE>::update(T sample, uint32_t timestamp)
+{
+    uint8_t i = FilterWithBuffer<T,FILTER_SIZE>::sample_index;
+    uint8_t i1 = (i == 0) ? FILTER_SIZE-1 : i-1;
+    if (_count > 0 && _timestamps[i1] == timestamp) {
+        // this is not a new timestamp - ignore
+        return;
+    }
+
+    // the slot being written holds the oldest sample
+    float oldest = FilterWithBuffer<T,FILTER_SIZE>::samples[i];
+
+    _timestamps[i] = timestamp;
+    FilterWithBuffer<T,FILTER_SIZE>::apply(sample);
+
+    if (_count < FILTER_SIZE) {
+        _count++;
+        if (_count == FILTER_SIZE) {
+            _recalculate();
+        }
+        return;
+    }
+
+    if (FilterWithBuffer<T,FILTER_SIZE>::sample_index == 0) {
+        // once per window rebuild the sums to bound rounding errors
+        _recalculate();
+        return;
+    }
+
+    // every sample moves one place towards the old end of the window
+    // so each weight drops by one, the oldest sample leaves with
+    // weight -M and the new one enters with weight +M
+    _weighted_sum += (M+1)*oldest - _sum + M*(float)sample;
+    _sum += (float)sample - oldest;
+}
+
+template <class T, uint8_t FILTER_SIZE>
+float SavitzkyGolayDerivativeFilter<T,FILTER_SIZE>::slope(void)
+{
+    if (_count < FILTER_SIZE) {
+        // we haven't filled the buffer yet - assume zero derivative
+        return 0;
+    }
+
+    // the oldest sample is at sample_index, the newest just before it
+    uint8_t newest = (FilterWithBuffer<T,FILTER_SIZE>::sample_index + FILTER_SIZE - 1) % FILTER_SIZE;
+    uint32_t span = _timestamps[newest] - _timestamps[FilterWithBuffer<T,FILTER_SIZE>::sample_index];
+    if (span == 0) {
+        return 0;
+    }
+    float dt = span / (float)(FILTER_SIZE-1);
+
+    // sum of k^2 for k=-M..M
+    const float sum_k2 = M*(M+1)*(2*M+1)/3.0f;
+
+    float result = _weighted_sum / (sum_k2 * dt);
+
+    // cope with numerical errors
+    if (isnan(result) || isinf(result)) {
+        result = 0;
+    }
+    return result;
+}
+
+// recalculate the sums from the samples in the window
+template <class T, uint8_t FILTER_SIZE>
+void SavitzkyGolayDerivativeFilter<T,FILTER_SIZE>::_recalculate(void)
+{
+    _sum = 0;
+    _weighted_sum = 0;
+    uint8_t idx = FilterWithBuffer<T,FILTER_SIZE>::sample_index;
+    for (int16_t k=-M; k<=M; k++) {
+        float s = FilterWithBuffer<T,FILTER_SIZE>::samples[idx];
+        _sum += s;
+        _weighted_sum += k*s;
+        if (++idx >= FILTER_SIZE) {
+            idx = 0;
+        }
+    }
+}
+
+#endif // __SAVITZKY_GOLAY_DERIVATIVE_FILTER_H__
@@ -12,10 +12,12 @@
 #include <AP_Math.h>
 #include <Filter.h>
 #include <DerivativeFilter.h>
+#include <SavitzkyGolayDerivativeFilter.h>
 
 const AP_HAL::HAL& hal = AP_HAL_BOARD_DRIVER;
 
 DerivativeFilter<float,11> derivative;
+SavitzkyGolayDerivativeFilter<float,11> sg_derivative;
 
 // setup routine
 void setup(){}
@@ -35,7 +37,9 @@ void loop()
     uint32_t t1 = hal.scheduler->micros();
     derivative.update(s, t1);
     float output = derivative.slope() * 1.0e6f;
-    hal.console->printf("%f %f %f %f\n", t, output, s, cosf(t));
+    sg_derivative.update(s, t1);
+    float sg_output = sg_derivative.slope() * 1.0e6f;
+    hal.console->printf("%f %f %f %f %f\n", t, output, sg_output, s, cosf(t));
 }
 
 AP_HAL_MAIN();
@@ -0,0 +1,164 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+ *       Test sketch for MedianFilter and SavitzkyGolayDerivativeFilter.
+ *       The median is checked against a sorted copy of the window and the
+ *       derivative against the exact slope of a polynomial.
+ */
+
+#include <stdlib.h>
+#include <AP_Common.h>
+#include <AP_Progmem.h>
+#include <AP_HAL.h>
+#include <AP_Param.h>
+#include <StorageManager.h>
+#include <AP_Math.h>
+#include <Filter.h>
+#include <MedianFilter.h>
+#include <SavitzkyGolayDerivativeFilter.h>
+
+#include <AP_HAL_AVR.h>
+#include <AP_HAL_Linux.h>
+
+const AP_HAL::HAL& hal = AP_HAL_BOARD_DRIVER;
+
+// samples fed through each median filter
+#define MEDIAN_TEST_SAMPLES 500
+
+// samples fed through each derivative filter, and their spacing in microseconds
+#define DERIVATIVE_TEST_SAMPLES 300
+#define DERIVATIVE_TEST_STEP_US 10000
+
+static uint16_t num_pass;
+static uint16_t num_fail;
+
+static void check(bool ok, const char *name, uint8_t size, uint16_t sample)
+{
+    if (ok) {
+        num_pass++;
+    } else {
+        num_fail++;
+        hal.console->printf("FAIL: %s size %u sample %u\n", name, (unsigned)size, (unsigned)sample);
+    }
+}
+
+/*
+  the median of the last count samples by sorting them. With an even
+  count the filter returns the upper of the two middle samples
+ */
+template <class T>
+static T reference_median(const T *history, uint16_t count)
+{
+    T sorted[32];
+    for (uint16_t i=0; i<count; i++) {
+        T v = history[i];
+        uint16_t j = i;
+        for (; j>0 && v < sorted[j-1]; j--) {
+            sorted[j] = sorted[j-1];
+        }
+        sorted[j] = v;
+    }
+    return sorted[count/2];
+}
+
+/*
+  feed random samples through a median filter and compare every output
+  with the median of the window. A small range of values gives many
+  duplicates. The filter is reset half way to check it refills
+ */
+template <class T, uint8_t N>
+static void test_median(const char *name, int16_t range)
+{
+    MedianFilter<T,N> filter;
+    T history[N];
+    uint16_t count = 0;
+    uint8_t oldest = 0;
+
+    for (uint16_t i=0; i<MEDIAN_TEST_SAMPLES; i++) {
+        if (i == MEDIAN_TEST_SAMPLES/2) {
+            filter.reset();
+            count = 0;
+            oldest = 0;
+        }
+        T sample = (T)((random() % (2*range+1)) - range);
+        history[oldest] = sample;
+        oldest = (oldest + 1) % N;
+        if (count < N) {
+            count++;
+        }
+        T result = filter.apply(sample);
+        check(result == reference_median(history, count) && filter.get() == result, name, N, i);
+    }
+}
+
+// p(t) = 2 + 3t - 0.5t^2 + 0.1t^3
+static float poly(float t)
+{
+    return 2.0f + t*(3.0f + t*(-0.5f + t*0.1f));
+}
+
+static float poly_slope(float t)
+{
+    return 3.0f + t*(-1.0f + t*0.3f);
+}
+
+/*
+  the first derivative of a quadratic Savitzky-Golay fit is exact at
+  the centre of the window for polynomials up to cubic, so the slope
+  must match the derivative of the polynomial M samples back
+ */
+template <uint8_t N>
+static void test_derivative(void)
+{
+    SavitzkyGolayDerivativeFilter<float,N> filter;
+    const uint32_t start_us = 12345;
+
+    for (uint16_t i=0; i<DERIVATIVE_TEST_SAMPLES; i++) {
+        uint32_t timestamp = start_us + i*(uint32_t)DERIVATIVE_TEST_STEP_US;
+        filter.update(poly(i*DERIVATIVE_TEST_STEP_US*1.0e-6f), timestamp);
+        // a repeated timestamp must be ignored
+        filter.update(0, timestamp);
+        float slope = filter.slope() * 1.0e6f;
+        if (i+1 < N) {
+            check(is_zero(slope), "derivative fill", N, i);
+            continue;
+        }
+        float expected = poly_slope((i - N/2)*DERIVATIVE_TEST_STEP_US*1.0e-6f);
+        check(fabsf(slope - expected) < 1.0e-3f + 1.0e-3f*fabsf(expected), "derivative", N, i);
+    }
+}
+
+void setup(void)
+{
+    hal.console->println("Filter test");
+
+    // odd and even windows, with many duplicates and with few
+    test_median<int16_t,2>("median int16", 3);
+    test_median<int16_t,3>("median int16", 3);
+    test_median<int16_t,4>("median int16", 3);
+    test_median<int16_t,5>("median int16", 3);
+    test_median<int16_t,8>("median int16", 3);
+    test_median<int16_t,9>("median int16", 3);
+    test_median<int16_t,16>("median int16", 3);
+    test_median<int16_t,31>("median int16", 3);
+    test_median<int16_t,5>("median int16", 10000);
+    test_median<int16_t,16>("median int16", 10000);
+    test_median<int16_t,31>("median int16", 10000);
+    test_median<uint16_t,9>("median uint16", 4);
+    test_median<uint16_t,15>("median uint16", 10000);
+    test_median<float,7>("median float", 2);
+    test_median<float,32>("median float", 1000);
+
+    test_derivative<5>();
+    test_derivative<7>();
+    test_derivative<15>();
+    test_derivative<31>();
+
+    hal.console->printf("%u tests passed, %u failed\n", (unsigned)num_pass, (unsigned)num_fail);
+}
+
+void loop(void)
+{
+    hal.scheduler->delay(1000);
+}
+
+AP_HAL_MAIN();
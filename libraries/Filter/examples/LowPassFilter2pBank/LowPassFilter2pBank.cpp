@@ -0,0 +1,105 @@
+/*
+ *       Benchmark of the LowPassFilter2pBank library against the
+ *       equivalent set of LowPassFilter2pVector3f filters, using the
+ *       accel+gyro layout of the MPU6000/MPU9250 backends
+ */
+
+#include <AP_Common.h>
+#include <AP_Progmem.h>
+#include <AP_HAL.h>
+#include <AP_HAL_AVR.h>
+#include <AP_HAL_PX4.h>
+#include <AP_HAL_Linux.h>
+#include <AP_HAL_FLYMAPLE.h>
+#include <AP_Param.h>
+#include <StorageManager.h>
+#include <AP_Math.h>            // ArduPilot Mega Vector/Matrix math Library
+#include <Filter.h>                     // Filter library
+#include <LowPassFilter2p.h>
+#include <LowPassFilter2pBank.h>
+
+const AP_HAL::HAL& hal = AP_HAL_BOARD_DRIVER;
+
+static LowPassFilter2pBank<6> filter_bank;
+
+#define NUM_SAMPLES 10000
+
+// setup routine
+static void setup()
+{
+    hal.console->printf("ArduPilot LowPassFilter2pBank benchmark\n\n");
+
+    // 1kHz sample rate, 20Hz accel cutoff and 30Hz gyro cutoff
+    filter_bank.set_cutoff_frequency(0, 3, 1000, 20);
+    filter_bank.set_cutoff_frequency(3, 3, 1000, 30);
+}
+
+// generate a test sample for all six channels
+static void make_sample(uint16_t i, float sample[6])
+{
+    for (uint8_t c=0; c<6; c++) {
+        sample[c] = sinf((float)i*2*PI*(5+c)/1000.0f) + 0.1f*sinf((float)i*2*PI*(150+c)/1000.0f);
+    }
+}
+
+void loop()
+{
+    float sample[6];
+    float filtered[6];
+    float max_error = 0;
+    Vector3f accel, gyro;
+    uint32_t start_time;
+    LowPassFilter2pVector3f accel_filter(1000, 20);
+    LowPassFilter2pVector3f gyro_filter(1000, 30);
+
+    filter_bank.reset();
+
+    // time the per-axis filters
+    start_time = hal.scheduler->micros();
+    for (uint16_t i=0; i<NUM_SAMPLES; i++) {
+        make_sample(i, sample);
+        accel = accel_filter.apply(Vector3f(sample[0], sample[1], sample[2]));
+        gyro = gyro_filter.apply(Vector3f(sample[3], sample[4], sample[5]));
+    }
+    uint32_t vector3f_time = hal.scheduler->micros() - start_time;
+
+    // time the filter bank
+    start_time = hal.scheduler->micros();
+    for (uint16_t i=0; i<NUM_SAMPLES; i++) {
+        make_sample(i, sample);
+        filter_bank.apply(sample, filtered);
+    }
+    uint32_t bank_time = hal.scheduler->micros() - start_time;
+
+    // time the sample generation alone so it can be subtracted
+    start_time = hal.scheduler->micros();
+    for (uint16_t i=0; i<NUM_SAMPLES; i++) {
+        make_sample(i, sample);
+    }
+    uint32_t overhead_time = hal.scheduler->micros() - start_time;
+
+    // check the outputs are equivalent, starting from a clean state
+    accel_filter = LowPassFilter2pVector3f(1000, 20);
+    gyro_filter = LowPassFilter2pVector3f(1000, 30);
+    filter_bank.reset();
+    for (uint16_t i=0; i<NUM_SAMPLES; i++) {
+        make_sample(i, sample);
+        accel = accel_filter.apply(Vector3f(sample[0], sample[1], sample[2]));
+        gyro = gyro_filter.apply(Vector3f(sample[3], sample[4], sample[5]));
+        filter_bank.apply(sample, filtered);
+        float ref[6] = { accel.x, accel.y, accel.z, gyro.x, gyro.y, gyro.z };
+        for (uint8_t c=0; c<6; c++) {
+            max_error = max(max_error, fabsf(ref[c] - filtered[c]));
+        }
+    }
+
+    hal.console->printf("Vector3f filters: %lu usec for %u samples\n",
+                        (unsigned long)(vector3f_time - overhead_time), (unsigned)NUM_SAMPLES);
+    hal.console->printf("filter bank:      %lu usec for %u samples\n",
+                        (unsigned long)(bank_time - overhead_time), (unsigned)NUM_SAMPLES);
+    hal.console->printf("max difference:   %f\n\n", max_error);
+
+    hal.scheduler->delay(5000);
+}
+
+AP_HAL_MAIN();
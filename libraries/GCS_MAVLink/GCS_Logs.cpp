@@ -159,11 +159,15 @@ void GCS_MAVLINK::handle_log_send(DataFlash_Class &dataflash)
         // when on USB we can send a lot more data
         num_sends = 40;
     } else if (have_flow_control()) {
-        num_sends = 10;        
+        // the log data is read ahead into memory, so keep going
+        // until the link has no more space
+        num_sends = 40;
     }
 
-#if CONFIG_HAL_BOARD == HAL_BOARD_SITL
-    // assume USB speeds in SITL for the purposes of log download
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL || CONFIG_HAL_BOARD == HAL_BOARD_LINUX
+    // assume USB speeds in SITL and on Linux, where a companion
+    // computer is usually on a network link, for the purposes of
+    // log download
     num_sends = 40;
 #endif
 
@@ -227,6 +231,10 @@ bool GCS_MAVLINK::handle_log_send_data(DataFlash_Class &dataflash)
         len = 90;
     }
     ret = dataflash.get_log_data(_log_num_data, _log_data_page, _log_data_offset, len, packet.data);
+    if (ret == DATAFLASH_LOG_DATA_PENDING) {
+        // not read yet, try again on the next call
+        return false;
+    }
     if (ret < 0) {
         // report as EOF on error
         ret = 0;